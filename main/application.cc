@@ -11,6 +11,7 @@
 #include "assets/lang_config.h"
 #include "mcp_server.h"
 #include "audio_debugger.h"
+#include "voice_latency_tracer.h"
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "afe_audio_processor.h"
@@ -30,7 +31,6 @@
 #include <esp_log.h>
 #include <cJSON.h>
 #include <driver/gpio.h>
-#include <arpa/inet.h>
 
 #define TAG "Application"
 
@@ -154,7 +154,8 @@ void Application::CheckNewVersion(Ota& ota) {
             codec->EnableOutput(false);
             {
                 std::lock_guard<std::mutex> lock(mutex_);
-                audio_decode_queue_.clear();
+                audio_decode_queue_.Clear();
+                pending_sounds_.clear();
             }
             background_task_->WaitForCompletion();
             delete background_task_;
@@ -226,7 +227,6 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
         digit_sound{'9', Lang::Sounds::P3_9}
     }};
 
-    // This sentence uses 9KB of SRAM, so we need to wait for it to finish
     Alert(Lang::Strings::ACTIVATION, message.c_str(), "happy", Lang::Sounds::P3_ACTIVATION);
 
     for (const auto& digit : code) {
@@ -259,33 +259,16 @@ void Application::DismissAlert() {
     }
 }
 
+// Queues the sound and returns right away. The decode task plays queued
+// sounds in order, reading the Opus frames in place from flash.
 void Application::PlaySound(const std::string_view& sound) {
-    // Wait for the previous sound to finish
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        audio_decode_cv_.wait(lock, [this]() {
-            return audio_decode_queue_.empty();
-        });
-    }
-    background_task_->WaitForCompletion();
-
-    const char* data = sound.data();
-    size_t size = sound.size();
-    for (const char* p = data; p < data + size; ) {
-        auto p3 = (BinaryProtocol3*)p;
-        p += sizeof(BinaryProtocol3);
-
-        auto payload_size = ntohs(p3->payload_size);
-        AudioStreamPacket packet;
-        packet.sample_rate = 16000;
-        packet.frame_duration = 60;
-        packet.payload.resize(payload_size);
-        memcpy(packet.payload.data(), p3->payload, payload_size);
-        p += payload_size;
-
-        std::lock_guard<std::mutex> lock(mutex_);
-        audio_decode_queue_.emplace_back(std::move(packet));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_sounds_.size() >= MAX_PENDING_SOUNDS) {
+        ESP_LOGW(TAG, "Too many sounds queued, dropping one");
+        return;
     }
+    pending_sounds_.emplace_back(sound);
+    audio_decode_cv_.notify_all();
 }
 
 void Application::EnterAudioTestingMode() {
@@ -297,9 +280,10 @@ void Application::EnterAudioTestingMode() {
 void Application::ExitAudioTestingMode() {
     ESP_LOGI(TAG, "Exiting audio testing mode");
     SetDeviceState(kDeviceStateWifiConfiguring);
-    // Copy audio_testing_queue_ to audio_decode_queue_
+    // Move audio_testing_queue_ to audio_decode_queue_
     std::lock_guard<std::mutex> lock(mutex_);
-    audio_decode_queue_ = std::move(audio_testing_queue_);
+    audio_decode_queue_.Clear();
+    audio_decode_queue_.Swap(audio_testing_queue_);
     audio_decode_cv_.notify_all();
 }
 
@@ -321,6 +305,7 @@ void Application::ToggleChatState() {
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        VoiceLatencyTracer::GetInstance().Begin("button");
         Schedule([this]() {
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
@@ -357,6 +342,7 @@ void Application::StartListening() {
     }
     
     if (device_state_ == kDeviceStateIdle) {
+        VoiceLatencyTracer::GetInstance().Begin("button");
         Schedule([this]() {
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
@@ -408,7 +394,7 @@ void Application::Start() {
 
     /* Setup the audio codec */
     auto codec = board.GetAudioCodec();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    opus_decoder_ = std::make_unique<OpusVoiceDecoder>(codec->output_sample_rate(), OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
     if (aec_mode_ != kAecOff) {
         ESP_LOGI(TAG, "AEC mode: %d, setting opus encoder complexity to 0", aec_mode_);
@@ -427,6 +413,19 @@ void Application::Start() {
     }
     codec->Start();
 
+    /* All playback goes through the mixer, only the output task writes to the codec */
+    audio_mixer_ = std::make_unique<AudioMixer>(AUDIO_MIXER_QUEUE_SAMPLES);
+    xTaskCreate([](void* arg) {
+        Application* app = (Application*)arg;
+        app->AudioOutputLoop();
+        vTaskDelete(NULL);
+    }, "audio_output", 4096, this, 8, &audio_output_task_handle_);
+    xTaskCreate([](void* arg) {
+        Application* app = (Application*)arg;
+        app->AudioDecodeLoop();
+        vTaskDelete(NULL);
+    }, "audio_decode", 4096 * 4, this, 7, &audio_decode_task_handle_);
+
 #if CONFIG_USE_AUDIO_PROCESSOR
     xTaskCreatePinnedToCore([](void* arg) {
         Application* app = (Application*)arg;
@@ -477,11 +476,19 @@ void Application::Start() {
     });
     protocol_->OnIncomingAudio([this](AudioStreamPacket&& packet) {
         std::lock_guard<std::mutex> lock(mutex_);
-        if (device_state_ == kDeviceStateSpeaking && audio_decode_queue_.size() < MAX_AUDIO_PACKETS_IN_QUEUE) {
-            audio_decode_queue_.emplace_back(std::move(packet));
+        // The payload is invalid when the packet pool was exhausted
+        if (device_state_ == kDeviceStateSpeaking && packet.payload.valid() &&
+            audio_decode_queue_.size() < MAX_AUDIO_PACKETS_IN_QUEUE) {
+            if (packet.sequence != 0) {
+                jitter_buffer_.OnArrival(packet.sequence, packet.frame_duration, esp_timer_get_time() / 1000);
+            }
+            audio_decode_queue_.Push(std::move(packet));
+            audio_decode_cv_.notify_all();
+            VoiceLatencyTracer::GetInstance().Mark(VoiceLatencyTracer::kFirstPacketQueued);
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
+        VoiceLatencyTracer::GetInstance().Mark(VoiceLatencyTracer::kChannelOpened);
         board.SetPowerSaveMode(false);
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
@@ -511,6 +518,7 @@ void Application::Start() {
         if (strcmp(type->valuestring, "tts") == 0) {
             auto state = cJSON_GetObjectItem(root, "state");
             if (strcmp(state->valuestring, "start") == 0) {
+                VoiceLatencyTracer::GetInstance().Mark(VoiceLatencyTracer::kTtsStarted);
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
@@ -538,6 +546,7 @@ void Application::Start() {
                 }
             }
         } else if (strcmp(type->valuestring, "stt") == 0) {
+            VoiceLatencyTracer::GetInstance().Mark(VoiceLatencyTracer::kSttReceived);
             auto text = cJSON_GetObjectItem(root, "text");
             if (cJSON_IsString(text)) {
                 ESP_LOGI(TAG, ">> %s", text->valuestring);
@@ -603,7 +612,7 @@ void Application::Start() {
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
         {
             std::lock_guard<std::mutex> lock(mutex_);
-            if (audio_send_queue_.size() >= MAX_AUDIO_PACKETS_IN_QUEUE) {
+            if (audio_send_queue_.full()) {
                 ESP_LOGW(TAG, "Too many audio packets in queue, drop the newest packet");
                 return;
             }
@@ -611,29 +620,21 @@ void Application::Start() {
         background_task_->Schedule([this, data = std::move(data)]() mutable {
             opus_encoder_->Encode(std::move(data), [this](std::vector<uint8_t>&& opus) {
                 AudioStreamPacket packet;
-                packet.payload = std::move(opus);
 #ifdef CONFIG_USE_SERVER_AEC
-                {
-                    std::lock_guard<std::mutex> lock(timestamp_mutex_);
-                    if (!timestamp_queue_.empty()) {
-                        packet.timestamp = timestamp_queue_.front();
-                        timestamp_queue_.pop_front();
-                    } else {
-                        packet.timestamp = 0;
-                    }
-
-                    if (timestamp_queue_.size() > 3) { // 限制队列长度3
-                        timestamp_queue_.pop_front(); // 该包发送前先出队保持队列长度
-                        return;
-                    }
-                }
+                packet.timestamp = GetPlayingTimestamp();
 #endif
                 std::lock_guard<std::mutex> lock(mutex_);
-                if (audio_send_queue_.size() >= MAX_AUDIO_PACKETS_IN_QUEUE) {
+                if (audio_send_queue_.full()) {
                     ESP_LOGW(TAG, "Too many audio packets in queue, drop the oldest packet");
-                    audio_send_queue_.pop_front();
+                    AudioStreamPacket oldest;
+                    audio_send_queue_.Pop(oldest);
                 }
-                audio_send_queue_.emplace_back(std::move(packet));
+                // The encoder owns its output vector, copy it into a pool slot
+                packet.payload = AudioPacketPool::GetInstance().Acquire(opus.data(), opus.size());
+                if (!packet.payload.valid()) {
+                    return;
+                }
+                audio_send_queue_.Push(std::move(packet));
                 xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
             });
         });
@@ -654,6 +655,9 @@ void Application::Start() {
 
     wake_word_->Initialize(codec);
     wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+        if (device_state_ == kDeviceStateIdle) {
+            VoiceLatencyTracer::GetInstance().Begin("wake word");
+        }
         Schedule([this, &wake_word]() {
             if (!protocol_) {
                 return;
@@ -672,10 +676,14 @@ void Application::Start() {
 
                 ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
 #if CONFIG_USE_AFE_WAKE_WORD
-                AudioStreamPacket packet;
+                std::vector<uint8_t> opus;
                 // Encode and send the wake word data to the server
-                while (wake_word_->GetWakeWordOpus(packet.payload)) {
-                    protocol_->SendAudio(packet);
+                while (wake_word_->GetWakeWordOpus(opus)) {
+                    AudioStreamPacket packet;
+                    packet.payload = AudioPacketPool::GetInstance().Acquire(opus.data(), opus.size());
+                    if (packet.payload.valid() && protocol_->SendAudio(packet)) {
+                        VoiceLatencyTracer::GetInstance().Mark(VoiceLatencyTracer::kFirstAudioSent);
+                    }
                 }
                 // Set the chat state to wake word detected
                 protocol_->SendWakeWordDetected(wake_word);
@@ -727,7 +735,7 @@ void Application::OnClockTimer() {
     if (clock_ticks_ % 10 == 0) {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
-        SystemInfo::PrintHeapStats();
+        VoiceLatencyTracer::GetInstance().PrintStats();
 
         // If we have synchronized server time, set the status to clock "HH:MM" if the device is idle
         if (has_server_time_) {
@@ -764,13 +772,20 @@ void Application::MainEventLoop() {
         auto bits = xEventGroupWaitBits(event_group_, SCHEDULE_EVENT | SEND_AUDIO_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
 
         if (bits & SEND_AUDIO_EVENT) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto packets = std::move(audio_send_queue_);
-            lock.unlock();
-            for (auto& packet : packets) {
+            AudioStreamPacket packet;
+            while (true) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (!audio_send_queue_.Pop(packet)) {
+                    break;
+                }
+                lock.unlock();
                 if (!protocol_->SendAudio(packet)) {
+                    // Drop the rest, the channel is gone
+                    lock.lock();
+                    audio_send_queue_.Clear();
                     break;
                 }
+                VoiceLatencyTracer::GetInstance().Mark(VoiceLatencyTracer::kFirstAudioSent);
             }
         }
 
@@ -785,76 +800,238 @@ void Application::MainEventLoop() {
     }
 }
 
-// The Audio Loop is used to input and output audio data
+// The Audio Loop reads and processes audio input, decoding runs in its own task
 void Application::AudioLoop() {
-    auto codec = Board::GetInstance().GetAudioCodec();
     while (true) {
         OnAudioInput();
-        if (codec->output_enabled()) {
-            OnAudioOutput();
-        }
     }
 }
 
-void Application::OnAudioOutput() {
-    if (busy_decoding_audio_) {
-        return;
+int Application::GetOutputLatencyMs(AudioMixerSource source) {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    if (!audio_mixer_ || codec->output_sample_rate() <= 0) {
+        return 0;
     }
+    size_t queued_frames = audio_mixer_->Queued(source) / codec->output_channels();
+    return queued_frames * 1000 / codec->output_sample_rate() + codec->output_latency_ms();
+}
 
-    auto now = std::chrono::steady_clock::now();
-    auto codec = Board::GetInstance().GetAudioCodec();
-    const int max_silence_seconds = 10;
+// Timestamp of the downlink packet the speaker is playing right now, 0 when silent
+uint32_t Application::GetPlayingTimestamp() {
+    uint64_t played = Board::GetInstance().GetAudioCodec()->output_frames_played();
+    std::lock_guard<std::mutex> lock(timestamp_mutex_);
+    while (!timestamp_queue_.empty() && timestamp_queue_.front().end_frame <= played) {
+        timestamp_queue_.pop_front();
+    }
+    if (timestamp_queue_.empty() || timestamp_queue_.front().start_frame > played) {
+        return 0;
+    }
+    return timestamp_queue_.front().timestamp;
+}
 
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (audio_decode_queue_.empty()) {
-        // Disable the output if there is no audio data for a long time
-        if (device_state_ == kDeviceStateIdle) {
-            auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - last_output_time_).count();
-            if (duration > max_silence_seconds) {
-                codec->EnableOutput(false);
-            }
+void Application::AudioOutputLoop() {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    int16_t buffer[AudioMixer::kMaxReadSamples];
+    auto& tracer = VoiceLatencyTracer::GetInstance();
+    while (true) {
+        // Voice queued before the read is in this block
+        bool voice = tracer.active() && audio_mixer_->Queued(kAudioSourceVoice) > 0;
+        size_t samples = audio_mixer_->Read(buffer, AudioMixer::kMaxReadSamples, 100);
+        if (samples == 0 || !codec->output_enabled()) {
+            continue;
         }
-        return;
+        codec->OutputData(buffer, samples);
+        if (voice) {
+            tracer.Mark(VoiceLatencyTracer::kFirstOutput);
+        }
+        last_output_us_ = esp_timer_get_time();
     }
+}
 
-    auto packet = std::move(audio_decode_queue_.front());
-    audio_decode_queue_.pop_front();
-    lock.unlock();
-    audio_decode_cv_.notify_all();
+// The voice decode task wakes when packets are queued and decodes ahead into
+// the mixer's voice queue, blocking there while it is full. Decoding no longer
+// waits behind audio input reads or Opus encoding on the background task.
+// Packets with a sequence number go through the jitter buffer, which puts them
+// back in order and has lost frames rebuilt from FEC or concealed; the rest
+// are local sounds or came over an ordered transport and play as queued.
+void Application::AudioDecodeLoop() {
+    auto codec = Board::GetInstance().GetAudioCodec();
+    const int max_silence_seconds = 10;
+    std::vector<int16_t> pcm;
+    std::vector<int16_t> resampled;
 
-    // Synchronize the sample rate and frame duration
-    SetDecodeSampleRate(packet.sample_rate, packet.frame_duration);
+    // Decode-ahead statistics of the current voice stream, logged when it ends
+    int stream_frames = 0;
+    int stream_underruns = 0;
+    int min_ahead_ms = 0;
+    int64_t total_ahead_ms = 0;
+    int64_t last_frame_us = 0;
 
-    busy_decoding_audio_ = true;
-    background_task_->Schedule([this, codec, packet = std::move(packet)]() mutable {
-        busy_decoding_audio_ = false;
+    while (true) {
+        AudioStreamPacket packet;
+        auto action = AudioJitterBuffer::Action::kNone;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (codec->output_enabled()) {
+                int64_t now_ms = esp_timer_get_time() / 1000;
+                while (!audio_decode_queue_.empty()) {
+                    uint32_t sequence = audio_decode_queue_.front().sequence;
+                    if (sequence == 0) {
+                        // Keep the order with sequenced packets still in the jitter buffer
+                        if (jitter_buffer_.empty()) {
+                            audio_decode_queue_.Pop(packet);
+                            action = AudioJitterBuffer::Action::kPacket;
+                        }
+                        break;
+                    }
+                    if (!jitter_buffer_.Fits(sequence)) {
+                        break;
+                    }
+                    AudioStreamPacket sequenced;
+                    audio_decode_queue_.Pop(sequenced);
+                    jitter_buffer_.Put(std::move(sequenced), now_ms);
+                }
+
+                // Sounds play once the voice and earlier packets have played out
+                while (action == AudioJitterBuffer::Action::kNone && audio_decode_queue_.empty() &&
+                       jitter_buffer_.empty() && !pending_sounds_.empty()) {
+                    if (pending_sounds_.front().NextPacket(packet)) {
+                        action = AudioJitterBuffer::Action::kPacket;
+                    } else {
+                        pending_sounds_.pop_front();
+                    }
+                }
+
+                if (action == AudioJitterBuffer::Action::kNone) {
+                    // Less than a frame left for the speaker, a missing packet is not worth waiting for
+                    size_t frame_samples = codec->output_sample_rate() * codec->output_channels() * OPUS_FRAME_DURATION_MS / 1000;
+                    bool urgent = audio_mixer_->Queued(kAudioSourceVoice) < frame_samples;
+                    action = jitter_buffer_.Next(now_ms, urgent, packet);
+                    if (action == AudioJitterBuffer::Action::kFec) {
+                        auto next = jitter_buffer_.PeekNext();
+                        fec_buffer_.assign(next->payload.data(), next->payload.data() + next->payload.size());
+                    }
+                }
+            }
+
+            if (action == AudioJitterBuffer::Action::kNone) {
+                bool ready;
+                if (jitter_buffer_.empty()) {
+                    // Packets wait in the queue while the output is disabled, poll for it to be enabled again
+                    ready = audio_decode_cv_.wait_for(lock, std::chrono::milliseconds(100), [this, codec]() {
+                        return (!audio_decode_queue_.empty() || !pending_sounds_.empty()) && codec->output_enabled();
+                    });
+                } else {
+                    // The jitter buffer waits for a missing packet or for its prebuffer to fill
+                    audio_decode_cv_.wait_for(lock, std::chrono::milliseconds(10));
+                    ready = true;
+                }
+                if (!ready) {
+                    // Disable the output if there is no audio data for a long time
+                    if (audio_decode_queue_.empty() && pending_sounds_.empty() && device_state_ == kDeviceStateIdle) {
+                        int64_t silence_us = esp_timer_get_time() - last_output_us_;
+                        if (silence_us > max_silence_seconds * 1000000LL) {
+                            codec->EnableOutput(false);
+                        }
+                    }
+
+                    bool stream_ended = stream_frames > 0 && esp_timer_get_time() - last_frame_us > VOICE_STREAM_IDLE_MS * 1000;
+                    auto stats = jitter_buffer_.stats();
+                    int jitter_ms = jitter_buffer_.jitter_ms();
+                    int depth = jitter_buffer_.target_depth();
+                    if (stream_ended) {
+                        jitter_buffer_.ResetStats();
+                    }
+                    lock.unlock();
+
+                    if (stream_ended) {
+                        ESP_LOGI(TAG, "Voice stream: %d frames, decode-ahead avg %lldms min %dms, %d underruns",
+                                 stream_frames, total_ahead_ms / stream_frames, min_ahead_ms, stream_underruns);
+                        if (stats.played > 0) {
+                            ESP_LOGI(TAG, "Jitter buffer: jitter %dms depth %d, lost %lu (fec %lu) skipped %lu expanded %lu late %lu duplicate %lu",
+                                     jitter_ms, depth, (unsigned long)stats.lost, (unsigned long)stats.fec,
+                                     (unsigned long)stats.skipped, (unsigned long)stats.expanded,
+                                     (unsigned long)stats.late, (unsigned long)stats.duplicate);
+                        }
+                        stream_frames = 0;
+                        stream_underruns = 0;
+                        total_ahead_ms = 0;
+                    }
+                }
+                continue;
+            }
+        }
+        audio_decode_cv_.notify_all();
         if (aborted_) {
-            return;
+            continue;
         }
 
-        std::vector<int16_t> pcm;
-        if (!opus_decoder_->Decode(std::move(packet.payload), pcm)) {
-            return;
+        {
+            std::lock_guard<std::mutex> lock(decoder_mutex_);
+            bool decoded;
+            if (action == AudioJitterBuffer::Action::kPacket) {
+                // Synchronize the sample rate and frame duration
+                SetDecodeSampleRate(packet.sample_rate, packet.frame_duration);
+                decoded = opus_decoder_->Decode(packet.payload.data(), packet.payload.size(), pcm);
+                packet.payload.Release();
+            } else if (action == AudioJitterBuffer::Action::kFec) {
+                decoded = opus_decoder_->DecodeFec(fec_buffer_.data(), fec_buffer_.size(), pcm);
+            } else {
+                decoded = opus_decoder_->Conceal(pcm);
+            }
+            if (!decoded) {
+                continue;
+            }
+            // Resample if the sample rate is different
+            if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
+                // Music may have switched the codec rate while the voice decoder kept its own
+                if (output_resample_rate_ != codec->output_sample_rate()) {
+                    output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+                    output_resample_rate_ = codec->output_sample_rate();
+                }
+                resampled.resize(output_resampler_.GetOutputSamples(pcm.size()));
+                output_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
+                pcm.swap(resampled);
+            }
         }
-        // Resample if the sample rate is different
-        if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-            int target_size = output_resampler_.GetOutputSamples(pcm.size());
-            std::vector<int16_t> resampled(target_size);
-            output_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
-            pcm = std::move(resampled);
+
+        // How much decoded voice was still waiting for the speaker when this frame
+        // arrived; running dry in the middle of a stream is an audible gap
+        size_t queued_samples = audio_mixer_->Queued(kAudioSourceVoice);
+        int ahead_ms = queued_samples / codec->output_channels() * 1000 / codec->output_sample_rate();
+        if (stream_frames > 0 && queued_samples == 0) {
+            stream_underruns++;
         }
-        codec->OutputData(pcm);
+        min_ahead_ms = stream_frames == 0 ? ahead_ms : std::min(min_ahead_ms, ahead_ms);
+        total_ahead_ms += ahead_ms;
+        stream_frames++;
+        last_frame_us = esp_timer_get_time();
+
 #ifdef CONFIG_USE_SERVER_AEC
-        std::lock_guard<std::mutex> lock(timestamp_mutex_);
-        timestamp_queue_.push_back(packet.timestamp);
+        {
+            // The packet starts playing once everything already handed to the codec
+            // and the voice queued ahead of it have been played
+            uint64_t start_frame = codec->output_frames_written() + queued_samples / codec->output_channels();
+            std::lock_guard<std::mutex> lock(timestamp_mutex_);
+            timestamp_queue_.push_back({packet.timestamp, start_frame, start_frame + pcm.size() / codec->output_channels()});
+            if (timestamp_queue_.size() > MAX_OUTPUT_TIMESTAMPS) {
+                timestamp_queue_.pop_front();
+            }
+        }
 #endif
-        last_output_time_ = std::chrono::steady_clock::now();
-    });
+        // The output task paces the voice queue, wait for room instead of dropping speech
+        size_t queued = 0;
+        while (queued < pcm.size() && !aborted_) {
+            queued += audio_mixer_->Write(kAudioSourceVoice, pcm.data() + queued, pcm.size() - queued, 100);
+        }
+    }
 }
 
 void Application::OnAudioInput() {
     if (device_state_ == kDeviceStateAudioTesting) {
-        if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+        // Recording also ends early when the packet pool runs out of slots
+        if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS ||
+            AudioPacketPool::GetInstance().available() == 0) {
             ExitAudioTestingMode();
             return;
         }
@@ -864,11 +1041,13 @@ void Application::OnAudioInput() {
             background_task_->Schedule([this, data = std::move(data)]() mutable {
                 opus_encoder_->Encode(std::move(data), [this](std::vector<uint8_t>&& opus) {
                     AudioStreamPacket packet;
-                    packet.payload = std::move(opus);
+                    packet.payload = AudioPacketPool::GetInstance().Acquire(opus.data(), opus.size());
                     packet.frame_duration = OPUS_FRAME_DURATION_MS;
                     packet.sample_rate = 16000;
                     std::lock_guard<std::mutex> lock(mutex_);
-                    audio_testing_queue_.push_back(std::move(packet));
+                    if (packet.payload.valid()) {
+                        audio_testing_queue_.Push(std::move(packet));
+                    }
                 });
             });
             return;
@@ -975,15 +1154,29 @@ void Application::SetDeviceState(DeviceState state) {
     auto led = board.GetLed();
     led->OnStateChanged();
     
-    // 当从idle状态变成其他任何状态时，停止音乐播放
-    if (previous_state == kDeviceStateIdle && state != kDeviceStateIdle) {
-        auto music = board.GetMusic();
-        if (music) {
-            ESP_LOGI(TAG, "Stopping music streaming due to state change: %s -> %s", 
-                    STATE_STRINGS[previous_state], STATE_STRINGS[state]);
-            music->StopStreaming();
+    // 对话期间暂停音乐并保留下载和缓冲，回到待机后从暂停处继续；
+    // 关闭 MUSIC_PAUSE_DURING_CONVERSATION 时继续播放，由混音器压低音量。
+    // 进入其他状态（升级、配网等）时停止音乐
+    bool conversation = state == kDeviceStateIdle || state == kDeviceStateConnecting ||
+                        state == kDeviceStateListening || state == kDeviceStateSpeaking;
+    auto music = board.GetMusic();
+    if (music && !conversation) {
+        ESP_LOGI(TAG, "Stopping music streaming due to state change: %s -> %s", 
+                STATE_STRINGS[previous_state], STATE_STRINGS[state]);
+        music->StopStreaming();
+    }
+#if CONFIG_MUSIC_PAUSE_DURING_CONVERSATION
+    else if (music) {
+        if (state == kDeviceStateIdle) {
+            music->Resume();
+        } else {
+            music->Suspend();
         }
     }
+#endif
+    if (audio_mixer_) {
+        audio_mixer_->SetDucked(state != kDeviceStateIdle);
+    }
     
     switch (state) {
         case kDeviceStateUnknown:
@@ -1002,6 +1195,10 @@ void Application::SetDeviceState(DeviceState state) {
         case kDeviceStateListening:
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
+            if (previous_state == kDeviceStateSpeaking) {
+                // The next turn starts right away in auto and realtime listening
+                VoiceLatencyTracer::GetInstance().Begin("listening", false);
+            }
             // Update the IoT states before sending the start listening command
 #if CONFIG_IOT_PROTOCOL_XIAOZHI
             UpdateIotStates();
@@ -1012,8 +1209,14 @@ void Application::SetDeviceState(DeviceState state) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
                 if (previous_state == kDeviceStateSpeaking) {
-                    audio_decode_queue_.clear();
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        audio_decode_queue_.Clear();
+                        jitter_buffer_.Reset();
+                        pending_sounds_.clear();
+                    }
                     audio_decode_cv_.notify_all();
+                    audio_mixer_->Clear(kAudioSourceVoice);
                     // FIXME: Wait for the speaker to empty the buffer
                     vTaskDelay(pdMS_TO_TICKS(120));
                 }
@@ -1044,10 +1247,15 @@ void Application::SetDeviceState(DeviceState state) {
 
 void Application::ResetDecoder() {
     std::lock_guard<std::mutex> lock(mutex_);
-    opus_decoder_->ResetState();
-    audio_decode_queue_.clear();
+    {
+        std::lock_guard<std::mutex> decoder_lock(decoder_mutex_);
+        opus_decoder_->ResetState();
+    }
+    audio_decode_queue_.Clear();
+    jitter_buffer_.Reset();
+    pending_sounds_.clear();
     audio_decode_cv_.notify_all();
-    last_output_time_ = std::chrono::steady_clock::now();
+    last_output_us_ = esp_timer_get_time();
     auto codec = Board::GetInstance().GetAudioCodec();
     codec->EnableOutput(true);
 }
@@ -1058,12 +1266,14 @@ void Application::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     }
 
     opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    opus_decoder_ = std::make_unique<OpusVoiceDecoder>(sample_rate, frame_duration);
+    output_resample_rate_ = 0;
 
     auto codec = Board::GetInstance().GetAudioCodec();
     if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
         ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
         output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+        output_resample_rate_ = codec->output_sample_rate();
     }
 }
 
@@ -1152,87 +1362,23 @@ void Application::SetAecMode(AecMode mode) {
 }
 
 // 新增：接收外部音频数据（如音乐播放）
-void Application::AddAudioData(AudioStreamPacket&& packet) {
+// 数据已经由调用方转换为编解码器的输出采样率和声道数，放入混音器的音乐队列，由输出任务写入编解码器
+size_t Application::AddAudioData(const int16_t* pcm, size_t samples) {
     auto codec = Board::GetInstance().GetAudioCodec();
-    if (device_state_ == kDeviceStateIdle && codec->output_enabled()) {
-        // packet.payload包含的是原始PCM数据（int16_t）
-        if (packet.payload.size() >= 2) {
-            size_t num_samples = packet.payload.size() / sizeof(int16_t);
-            std::vector<int16_t> pcm_data(num_samples);
-            memcpy(pcm_data.data(), packet.payload.data(), packet.payload.size());
-            
-            // 检查采样率是否匹配，如果不匹配则进行简单重采样
-            if (packet.sample_rate != codec->output_sample_rate()) {
-                // ESP_LOGI(TAG, "Resampling music audio from %d to %d Hz", 
-                //         packet.sample_rate, codec->output_sample_rate());
-                
-                // 验证采样率参数
-                if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
-                    ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
-                            packet.sample_rate, codec->output_sample_rate());
-                    return;
-                }
-                
-                std::vector<int16_t> resampled;
-                
-                if (packet.sample_rate > codec->output_sample_rate()) {
-                    ESP_LOGI(TAG, "音乐播放：将采样率从 %d Hz 切换到 %d Hz", 
-                        codec->output_sample_rate(), packet.sample_rate);
-
-                    // 尝试动态切换采样率
-                    if (codec->SetOutputSampleRate(packet.sample_rate)) {
-                        ESP_LOGI(TAG, "成功切换到音乐播放采样率: %d Hz", packet.sample_rate);
-                    } else {
-                        ESP_LOGW(TAG, "无法切换采样率，继续使用当前采样率: %d Hz", codec->output_sample_rate());
-                    }
-                } else {
-                    // 上采样：线性插值
-                    float upsample_ratio = codec->output_sample_rate() / static_cast<float>(packet.sample_rate);
-                    size_t expected_size = static_cast<size_t>(pcm_data.size() * upsample_ratio + 0.5f);
-                    resampled.reserve(expected_size);
-                    
-                    for (size_t i = 0; i < pcm_data.size(); ++i) {
-                        // 添加原始样本
-                        resampled.push_back(pcm_data[i]);
-                        
-                        // 计算需要插值的样本数
-                        int interpolation_count = static_cast<int>(upsample_ratio) - 1;
-                        if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
-                            int16_t current = pcm_data[i];
-                            int16_t next = pcm_data[i + 1];
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                float t = static_cast<float>(j) / (interpolation_count + 1);
-                                int16_t interpolated = static_cast<int16_t>(current + (next - current) * t);
-                                resampled.push_back(interpolated);
-                            }
-                        } else if (interpolation_count > 0) {
-                            // 最后一个样本，直接重复
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                resampled.push_back(pcm_data[i]);
-                            }
-                        }
-                    }
-                    
-                    ESP_LOGI(TAG, "Upsampled %d -> %d samples (ratio: %.2f)", 
-                            pcm_data.size(), resampled.size(), upsample_ratio);
-                }
-                
-                pcm_data = std::move(resampled);
-            }
-            
-            // 确保音频输出已启用
-            if (!codec->output_enabled()) {
-                codec->EnableOutput(true);
-            }
-            
-            // 发送PCM数据到音频编解码器
-            codec->OutputData(pcm_data);
-            
-            // 更新最后输出时间，防止OnAudioOutput自动禁用音频
-            {
-                std::lock_guard<std::mutex> lock(mutex_);
-                last_output_time_ = std::chrono::steady_clock::now();
-            }
-        }
+    if (!audio_mixer_ || !codec->output_enabled() || samples == 0) {
+        return 0;
+    }
+    return audio_mixer_->Write(kAudioSourceMusic, pcm, samples, 100);
+}
+
+void Application::ClearAudioData() {
+    if (audio_mixer_) {
+        audio_mixer_->Clear(kAudioSourceMusic);
+    }
+}
+
+void Application::PauseAudioData(bool paused) {
+    if (audio_mixer_) {
+        audio_mixer_->SetPaused(kAudioSourceMusic, paused);
     }
 }
\ No newline at end of file
@@ -8,13 +8,14 @@
 
 #include <string>
 #include <mutex>
+#include <atomic>
 #include <list>
+#include <deque>
 #include <vector>
 #include <condition_variable>
 #include <memory>
 
 #include <opus_encoder.h>
-#include <opus_decoder.h>
 #include <opus_resampler.h>
 
 #include "protocol.h"
@@ -23,6 +24,10 @@
 #include "audio_processor.h"
 #include "wake_word.h"
 #include "audio_debugger.h"
+#include "audio_mixer.h"
+#include "audio_jitter_buffer.h"
+#include "opus_voice_decoder.h"
+#include "p3_sound.h"
 
 #define SCHEDULE_EVENT (1 << 0)
 #define SEND_AUDIO_EVENT (1 << 1)
@@ -50,7 +55,13 @@ enum DeviceState {
 
 #define OPUS_FRAME_DURATION_MS 60
 #define MAX_AUDIO_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+// 混音器每个音源的队列长度（样本数），24kHz时约170ms
+#define AUDIO_MIXER_QUEUE_SAMPLES 4096
+#define MAX_OUTPUT_TIMESTAMPS 32
+// 解码线程空闲这么久之后认为一段语音结束，输出预解码统计
+#define VOICE_STREAM_IDLE_MS 1000
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
+#define MAX_PENDING_SOUNDS 16
 
 class Application {
 public:
@@ -83,8 +94,15 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     BackgroundTask* GetBackgroundTask() const { return background_task_; }
     
-    // 新增：接收外部音频数据（如音乐播放）
-    void AddAudioData(AudioStreamPacket&& packet);
+    // 新增：接收外部音频数据（如音乐播放），PCM需为编解码器的输出采样率和声道数
+    // 混音队列满时最多等待100ms，返回实际放入的样本数，输出未启用时返回0
+    size_t AddAudioData(const int16_t* pcm, size_t samples);
+    // 丢弃尚未播放的音乐数据
+    void ClearAudioData();
+    // 暂停时保留尚未播放的音乐数据，恢复后从暂停处继续
+    void PauseAudioData(bool paused);
+    // 现在写入该音源的数据要多久才会被播放出来：混音队列加上编解码器 DMA 中的数据
+    int GetOutputLatencyMs(AudioMixerSource source);
 
 private:
     Application();
@@ -105,33 +123,51 @@ private:
     bool has_server_time_ = false;
     bool aborted_ = false;
     bool voice_detected_ = false;
-    bool busy_decoding_audio_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
 
     // Audio encode / decode
     TaskHandle_t audio_loop_task_handle_ = nullptr;
+    TaskHandle_t audio_output_task_handle_ = nullptr;
+    TaskHandle_t audio_decode_task_handle_ = nullptr;
+    std::unique_ptr<AudioMixer> audio_mixer_;
     BackgroundTask* background_task_ = nullptr;
-    std::chrono::steady_clock::time_point last_output_time_;
-    std::list<AudioStreamPacket> audio_send_queue_;
-    std::list<AudioStreamPacket> audio_decode_queue_;
+    // Written by the output task after every block, read without mutex_
+    std::atomic<int64_t> last_output_us_{0};
+    // Packet payloads live in AudioPacketPool slots; the decode and testing
+    // queues can hold every slot so a recording can be swapped into playback
+    AudioPacketQueue audio_send_queue_{MAX_AUDIO_PACKETS_IN_QUEUE};
+    AudioPacketQueue audio_decode_queue_{CONFIG_AUDIO_PACKET_POOL_SLOTS};
     std::condition_variable audio_decode_cv_;
-    std::list<AudioStreamPacket> audio_testing_queue_;
-
-    // 新增：用于维护音频包的timestamp队列
-    std::list<uint32_t> timestamp_queue_;
+    AudioPacketQueue audio_testing_queue_{CONFIG_AUDIO_PACKET_POOL_SLOTS};
+    // Sounds waiting to play, decoded straight from flash once the decode queue is empty
+    std::deque<P3Sound> pending_sounds_;
+    // Sequenced packets move from audio_decode_queue_ into the jitter buffer, guarded by mutex_
+    AudioJitterBuffer jitter_buffer_;
+    std::vector<uint8_t> fec_buffer_;  // Copy of the packet a lost frame is rebuilt from, reused by the decode task
+    std::mutex decoder_mutex_;  // Guards opus_decoder_ and output_resampler_ against ResetDecoder
+
+    // 服务端回声消除：每个下行音频包的时间戳和它在编解码器输出中的帧区间
+    // 上行数据取采集时正在播放的那个包的时间戳
+    struct OutputTimestamp {
+        uint32_t timestamp;
+        uint64_t start_frame;
+        uint64_t end_frame;
+    };
+    std::deque<OutputTimestamp> timestamp_queue_;
     std::mutex timestamp_mutex_;
+    uint32_t GetPlayingTimestamp();
 
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
+    std::unique_ptr<OpusVoiceDecoder> opus_decoder_;
 
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
+    int output_resample_rate_ = 0;  // Codec rate output_resampler_ was configured for
 
     void MainEventLoop();
     void OnAudioInput();
-    void OnAudioOutput();
     bool ReadAudio(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
@@ -140,6 +176,8 @@ private:
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
     void AudioLoop();
+    void AudioOutputLoop();
+    void AudioDecodeLoop();
     void EnterAudioTestingMode();
     void ExitAudioTestingMode();
 };
@@ -1,6 +1,8 @@
 // Auto-generated language config
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 #ifndef zh_cn
@@ -207,5 +209,78 @@ namespace Lang {
         static_cast<const char*>(p3_wificonfig_start),
         static_cast<size_t>(p3_wificonfig_end - p3_wificonfig_start)
         };
+
+        // 构建时生成的帧索引：每帧 Opus 数据在音效中的偏移，播放时不用再逐帧解析头部
+        struct FrameIndex {
+            const char* data;
+            const uint16_t* offsets;
+            size_t count;
+        };
+
+        inline constexpr uint16_t P3_0_FRAMES[] = {4, 80, 173, 308, 449, 554, 663, 784, 893, 997, 1092, 1182, 1227, 1252, 1277, 1302};
+
+        inline constexpr uint16_t P3_1_FRAMES[] = {4, 91, 188, 338, 485, 618, 726, 830, 953, 1094, 1197, 1274, 1329, 1379, 1404, 1429, 1454};
+
+        inline constexpr uint16_t P3_2_FRAMES[] = {4, 87, 169, 285, 396, 510, 632, 766, 864, 960, 1023, 1066, 1091, 1116, 1141};
+
+        inline constexpr uint16_t P3_3_FRAMES[] = {4, 92, 199, 317, 428, 553, 644, 750, 870, 991, 1078, 1180, 1262, 1293, 1318, 1343};
+
+        inline constexpr uint16_t P3_4_FRAMES[] = {4, 93, 199, 315, 436, 555, 683, 821, 981, 1097, 1184, 1279, 1345, 1381, 1406, 1431, 1456};
+
+        inline constexpr uint16_t P3_5_FRAMES[] = {4, 94, 193, 332, 446, 562, 697, 827, 959, 1068, 1156, 1262, 1331, 1382, 1407, 1432, 1457};
+
+        inline constexpr uint16_t P3_6_FRAMES[] = {4, 80, 170, 307, 432, 550, 683, 810, 922, 1023, 1107, 1204, 1255, 1280, 1305, 1330};
+
+        inline constexpr uint16_t P3_7_FRAMES[] = {4, 103, 199, 328, 455, 575, 676, 762, 843, 958, 1104, 1201, 1298, 1382, 1441, 1467, 1492, 1517};
+
+        inline constexpr uint16_t P3_8_FRAMES[] = {4, 90, 183, 296, 398, 499, 599, 713, 821, 905, 998, 1067, 1102, 1127, 1152};
+
+        inline constexpr uint16_t P3_9_FRAMES[] = {4, 85, 173, 297, 423, 553, 675, 811, 903, 996, 1077, 1126, 1160, 1185, 1210};
+
+        inline constexpr uint16_t P3_ACTIVATION_FRAMES[] = {4, 69, 141, 256, 388, 497, 621, 732, 861, 973, 1091, 1229, 1370, 1491, 1602, 1714, 1836, 1973, 2076, 2204, 2354, 2482, 2606, 2741, 2863, 2989, 3102, 3246, 3372, 3511, 3618, 3740, 3866, 3987, 4088, 4219, 4348, 4470, 4603, 4731, 4829, 4965, 5097, 5225, 5344, 5466, 5580, 5695, 5817, 5951, 6057, 6177, 6300, 6411, 6539, 6675, 6815, 6934, 7056, 7177, 7308, 7446, 7565, 7682, 7814, 7930, 8057, 8175, 8304, 8425, 8565, 8696, 8755, 8794, 8841, 8866, 8891, 8916};
+
+        inline constexpr uint16_t P3_ERR_PIN_FRAMES[] = {4, 84, 168, 286, 410, 538, 688, 814, 925, 1033, 1147, 1272, 1424, 1541, 1666, 1797, 1916, 2017, 2138, 2242, 2375, 2503, 2637, 2774, 2904, 3035, 3162, 3279, 3372, 3442, 3496, 3540, 3565, 3590, 3615};
+
+        inline constexpr uint16_t P3_ERR_REG_FRAMES[] = {4, 74, 145, 286, 412, 552, 684, 811, 904, 1042, 1150, 1298, 1404, 1512, 1636, 1767, 1896, 2019, 2140, 2274, 2433, 2572, 2695, 2830, 2927, 3018, 3114, 3194, 3311, 3440, 3568, 3708, 3833, 3967, 4113, 4241, 4364, 4492, 4628, 4742, 4878, 4986, 5104, 5248, 5380, 5483, 5612, 5731, 5843, 5979, 6134, 6240, 6345, 6448, 6528, 6593, 6643, 6675, 6700, 6725};
+
+        inline constexpr uint16_t P3_EXCLAMATION_FRAMES[] = {4, 43, 87, 132, 175, 273, 401, 551, 643, 721, 860, 1004, 1100, 1178, 1328, 1445, 1577};
+
+        inline constexpr uint16_t P3_LOW_BATTERY_FRAMES[] = {4, 108, 251, 380, 559, 707, 864, 999, 1159, 1317, 1466, 1587, 1706, 1832, 1987, 2158, 2297};
+
+        inline constexpr uint16_t P3_POPUP_FRAMES[] = {4, 74, 167, 261, 414, 569, 730, 894};
+
+        inline constexpr uint16_t P3_SUCCESS_FRAMES[] = {4, 74, 228, 391, 575, 761, 926, 1077, 1218, 1335, 1421, 1497, 1581, 1661, 1749, 1829, 1948};
+
+        inline constexpr uint16_t P3_UPGRADE_FRAMES[] = {4, 68, 156, 268, 400, 524, 679, 783, 904, 1036, 1168, 1282, 1428, 1553, 1677, 1829, 1956, 2068, 2189, 2314, 2440, 2536, 2621, 2677, 2726, 2751, 2776, 2801};
+
+        inline constexpr uint16_t P3_VIBRATION_FRAMES[] = {4, 64, 161, 265, 349, 431, 526, 671, 812, 955, 1073, 1215, 1315, 1440, 1562, 1650, 1735};
+
+        inline constexpr uint16_t P3_WELCOME_FRAMES[] = {4, 63, 136, 276, 420, 575, 724, 841, 965, 1075, 1168, 1260, 1371, 1504, 1624, 1766, 1898, 2023, 2147, 2288, 2411, 2541, 2659, 2776, 2885, 3027, 3166, 3301, 3411, 3488, 3556, 3614, 3648, 3673, 3698};
+
+        inline constexpr uint16_t P3_WIFICONFIG_FRAMES[] = {4, 85, 172, 288, 404, 503, 601, 713, 842, 978, 1118, 1250, 1377, 1486, 1601, 1728, 1851, 1986, 2130, 2251, 2369, 2496, 2631, 2779, 2855, 2935, 2999, 3054, 3090, 3115, 3140};
+        inline const FrameIndex FRAME_INDEXES[] = {
+            {p3_0_start, P3_0_FRAMES, 16},
+            {p3_1_start, P3_1_FRAMES, 17},
+            {p3_2_start, P3_2_FRAMES, 15},
+            {p3_3_start, P3_3_FRAMES, 16},
+            {p3_4_start, P3_4_FRAMES, 17},
+            {p3_5_start, P3_5_FRAMES, 17},
+            {p3_6_start, P3_6_FRAMES, 16},
+            {p3_7_start, P3_7_FRAMES, 18},
+            {p3_8_start, P3_8_FRAMES, 15},
+            {p3_9_start, P3_9_FRAMES, 15},
+            {p3_activation_start, P3_ACTIVATION_FRAMES, 78},
+            {p3_err_pin_start, P3_ERR_PIN_FRAMES, 35},
+            {p3_err_reg_start, P3_ERR_REG_FRAMES, 60},
+            {p3_exclamation_start, P3_EXCLAMATION_FRAMES, 17},
+            {p3_low_battery_start, P3_LOW_BATTERY_FRAMES, 17},
+            {p3_popup_start, P3_POPUP_FRAMES, 8},
+            {p3_success_start, P3_SUCCESS_FRAMES, 17},
+            {p3_upgrade_start, P3_UPGRADE_FRAMES, 28},
+            {p3_vibration_start, P3_VIBRATION_FRAMES, 17},
+            {p3_welcome_start, P3_WELCOME_FRAMES, 35},
+            {p3_wificonfig_start, P3_WIFICONFIG_FRAMES, 31},
+            {nullptr, nullptr, 0},
+        };
     }
 }
@@ -3,6 +3,8 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_attr.h>
+#include <algorithm>
 #include <cstring>
 #include <driver/i2s_common.h>
 
@@ -15,7 +17,44 @@ AudioCodec::~AudioCodec() {
 }
 
 void AudioCodec::OutputData(std::vector<int16_t>& data) {
-    Write(data.data(), data.size());
+    OutputData(data.data(), data.size());
+}
+
+void AudioCodec::OutputData(const int16_t* data, int samples) {
+    // 先计入等待发送的帧数，写入过程中 DMA 发送完成的缓冲区才能正确扣除
+    int frames = samples / output_channels_;
+    output_frames_pending_.fetch_add(frames, std::memory_order_relaxed);
+    Write(data, samples);
+    output_frames_written_.fetch_add(frames, std::memory_order_relaxed);
+}
+
+// 每发送完一个 DMA 缓冲区调用一次（中断上下文）
+// 没有新数据时 DMA 继续发送静音，等待发送的帧数保持为 0
+bool IRAM_ATTR AudioCodec::OnOutputSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<AudioCodec*>(user_ctx);
+    int32_t pending = codec->output_frames_pending_.load(std::memory_order_relaxed);
+    int32_t remaining;
+    do {
+        remaining = pending > AUDIO_CODEC_DMA_FRAME_NUM ? pending - AUDIO_CODEC_DMA_FRAME_NUM : 0;
+    } while (pending > 0 && !codec->output_frames_pending_.compare_exchange_weak(pending, remaining, std::memory_order_relaxed));
+    return false;
+}
+
+uint64_t AudioCodec::output_frames_played() const {
+    uint64_t written = output_frames_written_.load(std::memory_order_relaxed);
+    uint64_t pending = output_tracking_ ? std::max<int32_t>(0, output_frames_pending_.load(std::memory_order_relaxed))
+                                        : AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM;
+    return written > pending ? written - pending : 0;
+}
+
+int AudioCodec::output_latency_ms() const {
+    if (output_sample_rate_ <= 0) {
+        return 0;
+    }
+    // 没有发送完成回调时按 DMA 缓冲区全满估算
+    int32_t pending = output_tracking_ ? output_frames_pending_.load(std::memory_order_relaxed)
+                                       : AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM;
+    return std::max<int32_t>(0, pending) * 1000 / output_sample_rate_;
 }
 
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
@@ -40,6 +79,14 @@ void AudioCodec::Start() {
         ESP_LOGI(TAG, "Saved original output sample rate: %d Hz", original_output_sample_rate_);
     }
 
+    // 回调只能在通道启用前注册，已经由板级代码启用的通道退回到按 DMA 深度估算
+    i2s_event_callbacks_t callbacks = {};
+    callbacks.on_sent = OnOutputSent;
+    output_tracking_ = i2s_channel_register_event_callback(tx_handle_, &callbacks, this) == ESP_OK;
+    if (!output_tracking_) {
+        ESP_LOGW(TAG, "Output position tracking unavailable, latency is estimated");
+    }
+
     ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
     ESP_ERROR_CHECK(i2s_channel_enable(rx_handle_));
 
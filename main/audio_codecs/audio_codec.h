@@ -8,6 +8,7 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <atomic>
 
 #include "board.h"
 
@@ -26,6 +27,7 @@ public:
     virtual bool SetOutputSampleRate(int sample_rate);
 
     virtual void OutputData(std::vector<int16_t>& data);
+    void OutputData(const int16_t* data, int samples);
     virtual bool InputData(std::vector<int16_t>& data);
     virtual void Start();
 
@@ -40,6 +42,13 @@ public:
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
 
+    // 播放位置：已交给 I2S DMA 的帧数和已经由 DMA 发送完成的帧数（每声道样本数）
+    // 音乐进度、歌词和服务端回声消除的参考时间都以此为准
+    inline uint64_t output_frames_written() const { return output_frames_written_.load(std::memory_order_relaxed); }
+    uint64_t output_frames_played() const;
+    // 已写入但还没有播放出去的数据对应的时长
+    int output_latency_ms() const;
+
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
     i2s_chan_handle_t rx_handle_ = nullptr;
@@ -55,6 +64,12 @@ protected:
     int output_channels_ = 1;
     int output_volume_ = 70;
 
+    std::atomic<uint64_t> output_frames_written_{0};
+    std::atomic<int32_t> output_frames_pending_{0};  // DMA 中等待发送的帧数，发送完成中断里减少
+    bool output_tracking_ = false;                    // 是否注册了发送完成回调
+
+    static bool OnOutputSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
+
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
 };
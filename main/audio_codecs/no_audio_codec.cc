@@ -2,6 +2,7 @@
 
 #include <esp_log.h>
 #include <cmath>
+#include <algorithm>
 #include <cstring>
 
 #define TAG "NoAudioCodec"
@@ -336,25 +337,31 @@ NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output
 }
 
 int NoAudioCodec::Write(const int16_t* data, int samples) {
-    std::vector<int32_t> buffer(samples);
+    // 按 DMA 帧大小分块转换，栈上缓冲区不需要每次分配，也不会被多个线程共享
+    int32_t buffer[AUDIO_CODEC_DMA_FRAME_NUM];
 
     // output_volume_: 0-100
     // volume_factor_: 0-65536
     int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-    for (int i = 0; i < samples; i++) {
-        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
-        if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
-        } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
-        } else {
-            buffer[i] = static_cast<int32_t>(temp);
+    size_t total_written = 0;
+    for (int offset = 0; offset < samples; offset += AUDIO_CODEC_DMA_FRAME_NUM) {
+        int count = std::min(samples - offset, AUDIO_CODEC_DMA_FRAME_NUM);
+        for (int i = 0; i < count; i++) {
+            int64_t temp = int64_t(data[offset + i]) * volume_factor; // 使用 int64_t 进行乘法运算
+            if (temp > INT32_MAX) {
+                buffer[i] = INT32_MAX;
+            } else if (temp < INT32_MIN) {
+                buffer[i] = INT32_MIN;
+            } else {
+                buffer[i] = static_cast<int32_t>(temp);
+            }
         }
-    }
 
-    size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
-    return bytes_written / sizeof(int32_t);
+        size_t bytes_written;
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer, count * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+        total_written += bytes_written;
+    }
+    return total_written / sizeof(int32_t);
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
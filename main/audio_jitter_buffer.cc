@@ -0,0 +1,213 @@
+#include "audio_jitter_buffer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "AudioJitterBuffer"
+
+// Sequence numbers wrap around, compare them by their signed distance
+static inline int32_t SequenceDiff(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b);
+}
+
+void AudioJitterBuffer::OnArrival(uint32_t sequence, int frame_duration, int64_t now_ms) {
+    if (frame_duration > 0) {
+        frame_ms_ = frame_duration;
+    }
+    int32_t advance = has_arrival_ ? SequenceDiff(sequence, last_arrival_sequence_) : 0;
+    // Reordered or duplicated, the newest packet stays the reference but its lateness still counts
+    bool reordered = has_arrival_ && advance <= 0 && advance > -kCapacity;
+
+    if (!reordered && (!has_arrival_ || advance >= kCapacity || advance <= -kCapacity ||
+                       now_ms - last_arrival_ms_ >= kStreamIdleMs)) {
+        // A new stream, the pause before it is not network delay
+        stream_sequence_ = sequence;
+        min_transit_ = now_ms;
+    }
+    // Network delay plus an unknown offset, only differences between packets matter.
+    // Sequence numbers count from the start of the stream so they can wrap around.
+    int64_t transit = now_ms - (int64_t)SequenceDiff(sequence, stream_sequence_) * frame_ms_;
+    if (transit < min_transit_) {
+        // The server sending ahead of real time does not count as jitter
+        min_transit_ = transit;
+    }
+
+    // Follow rising lateness quickly and let it fade slowly, so the depth
+    // covers the late packets rather than the average one
+    int lateness_q4 = (int)std::min<int64_t>(transit - min_transit_, kStreamIdleMs) * 16;
+    if (lateness_q4 > jitter_q4_) {
+        jitter_q4_ += (lateness_q4 - jitter_q4_) / 4;
+    } else {
+        jitter_q4_ += (lateness_q4 - jitter_q4_) / 64;
+    }
+    if (!reordered) {
+        has_arrival_ = true;
+        last_arrival_sequence_ = sequence;
+        last_arrival_ms_ = now_ms;
+    }
+}
+
+int AudioJitterBuffer::target_depth() const {
+    // Enough frames to cover the lateness
+    int depth = kMinDepth + (jitter_ms() + frame_ms_ - 1) / frame_ms_;
+    return std::min(depth, kMaxDepth);
+}
+
+bool AudioJitterBuffer::Fits(uint32_t sequence) const {
+    if (count_ == 0) {
+        return true;
+    }
+    if (playing_) {
+        // Late packets and a restarted sequence are handled by Put
+        return SequenceDiff(sequence, expected_) < kCapacity;
+    }
+    uint32_t low = SequenceDiff(sequence, min_sequence_) < 0 ? sequence : min_sequence_;
+    uint32_t high = SequenceDiff(sequence, max_sequence_) > 0 ? sequence : max_sequence_;
+    return SequenceDiff(high, low) < kCapacity;
+}
+
+void AudioJitterBuffer::Put(AudioStreamPacket&& packet, int64_t now_ms) {
+    uint32_t sequence = packet.sequence;
+    if (playing_) {
+        int32_t offset = SequenceDiff(sequence, expected_);
+        // The sequence only restarts with a new audio channel, which resets the
+        // buffer, so while audio is flowing an older packet is a late one
+        if (offset < 0 && (offset > -kCapacity || now_ms - last_output_ms_ < kStreamIdleMs)) {
+            // Its frame has been played or given up on already
+            stats_.late++;
+            return;
+        }
+        if (offset < 0 || offset >= kCapacity) {
+            ESP_LOGI(TAG, "Sequence jumped from %lu to %lu, restarting",
+                     (unsigned long)expected_, (unsigned long)sequence);
+            Clear();
+        }
+    }
+
+    int index = Index(sequence);
+    if (present_[index]) {
+        stats_.duplicate++;
+        return;
+    }
+    if (count_ == 0) {
+        min_sequence_ = sequence;
+        max_sequence_ = sequence;
+        if (!playing_) {
+            first_put_ms_ = now_ms;
+        }
+    } else {
+        if (SequenceDiff(sequence, min_sequence_) < 0) {
+            min_sequence_ = sequence;
+        }
+        if (SequenceDiff(sequence, max_sequence_) > 0) {
+            max_sequence_ = sequence;
+        }
+    }
+    slots_[index] = std::move(packet);
+    present_[index] = true;
+    count_++;
+}
+
+AudioJitterBuffer::Action AudioJitterBuffer::Next(int64_t now_ms, bool urgent, AudioStreamPacket& packet) {
+    if (count_ == 0) {
+        if (playing_ && now_ms - last_output_ms_ >= kStreamIdleMs) {
+            playing_ = false;
+        }
+        return Action::kNone;
+    }
+
+    int depth = target_depth();
+    if (!playing_) {
+        // Prebuffer a new stream, but never longer than the depth takes to arrive
+        if (count_ < depth && now_ms - first_put_ms_ < depth * frame_ms_) {
+            return Action::kNone;
+        }
+        playing_ = true;
+        expected_ = min_sequence_;
+        missing_since_ms_ = -1;
+    }
+    if (present_[Index(expected_)]) {
+        return Take(now_ms, packet);
+    }
+
+    // The next frame is missing while later ones have arrived. Wait for it as
+    // long as the output has audio left and the buffer stays within its depth.
+    if (missing_since_ms_ < 0) {
+        missing_since_ms_ = now_ms;
+    }
+    if (!urgent && count_ <= depth && now_ms - missing_since_ms_ < (depth + 1) * frame_ms_) {
+        return Action::kNone;
+    }
+    last_output_ms_ = now_ms;
+    if (urgent && count_ < depth && expanded_ < kMaxConcealFrames) {
+        // The buffer is shallower than the jitter calls for. Conceal a frame
+        // and keep waiting, the packet has one more frame time to arrive.
+        expanded_++;
+        stats_.expanded++;
+        return Action::kConceal;
+    }
+    missing_since_ms_ = -1;
+    expanded_ = 0;
+
+    uint32_t next = FirstBuffered();
+    int gap = SequenceDiff(next, expected_);
+    if (gap > kMaxConcealFrames) {
+        // Concealing this long only smears the last sound, resume at the next packet
+        ESP_LOGW(TAG, "Skipping %d lost frames", gap);
+        stats_.skipped += gap;
+        expected_ = next;
+        return Take(now_ms, packet);
+    }
+    expected_++;
+    stats_.lost++;
+    if (present_[Index(expected_)]) {
+        stats_.fec++;
+        return Action::kFec;
+    }
+    return Action::kConceal;
+}
+
+const AudioStreamPacket* AudioJitterBuffer::PeekNext() const {
+    int index = Index(expected_);
+    return present_[index] ? &slots_[index] : nullptr;
+}
+
+void AudioJitterBuffer::Reset() {
+    Clear();
+    has_arrival_ = false;
+}
+
+void AudioJitterBuffer::Clear() {
+    for (int i = 0; i < kCapacity; i++) {
+        if (present_[i]) {
+            slots_[i].payload.Release();
+            present_[i] = false;
+        }
+    }
+    count_ = 0;
+    playing_ = false;
+    missing_since_ms_ = -1;
+    expanded_ = 0;
+}
+
+AudioJitterBuffer::Action AudioJitterBuffer::Take(int64_t now_ms, AudioStreamPacket& packet) {
+    int index = Index(expected_);
+    packet = std::move(slots_[index]);
+    present_[index] = false;
+    count_--;
+    expected_++;
+    missing_since_ms_ = -1;
+    expanded_ = 0;
+    last_output_ms_ = now_ms;
+    stats_.played++;
+    return Action::kPacket;
+}
+
+uint32_t AudioJitterBuffer::FirstBuffered() const {
+    for (int i = 0; i < kCapacity; i++) {
+        if (present_[Index(expected_ + i)]) {
+            return expected_ + i;
+        }
+    }
+    return expected_;
+}
@@ -0,0 +1,94 @@
+#ifndef AUDIO_JITTER_BUFFER_H
+#define AUDIO_JITTER_BUFFER_H
+
+#include <cstdint>
+
+#include "audio_packet_pool.h"
+
+// Reorders downlink packets by sequence number and decides, one frame at a
+// time, whether the next frame can be played or has to be given up on. A lost
+// frame is rebuilt from the FEC data of the packet after it when that packet
+// has already arrived, otherwise it is concealed. The prebuffer depth follows
+// the measured arrival jitter: how much later than the fastest packet of the
+// stream each packet arrives, so bursts sent ahead of real time do not count.
+// When the jitter grows in the middle of a stream, a missing frame is
+// concealed while its packet is still awaited, which adds one frame of
+// latency each time until the buffer reaches the deeper target.
+//
+// Times are passed in by the caller so the buffer can be driven from recorded
+// traces. Not thread-safe, the caller provides the locking.
+class AudioJitterBuffer {
+public:
+    static constexpr int kCapacity = 16;         // Reorder window in packets, about 1s of 60ms frames
+    static constexpr int kMinDepth = 1;
+    static constexpr int kMaxDepth = 6;
+    static constexpr int kMaxConcealFrames = 3;  // Longer gaps are skipped instead of concealed
+    static constexpr int kStreamIdleMs = 1000;   // After this much silence the next packet starts a new stream
+
+    enum class Action {
+        kNone,     // Nothing to play yet
+        kPacket,   // Decode the returned packet
+        kFec,      // A frame was lost, rebuild it from the FEC data of PeekNext()
+        kConceal,  // A frame was lost and cannot be recovered, or is late and still awaited; conceal it
+    };
+
+    struct Stats {
+        uint32_t played;
+        uint32_t lost;       // Frames given up on, recovered with FEC or concealed
+        uint32_t fec;        // Lost frames rebuilt from the next packet
+        uint32_t skipped;    // Frames of gaps too long to conceal
+        uint32_t expanded;   // Frames concealed while waiting for a late packet, one frame of latency each
+        uint32_t late;       // Packets that arrived after their frame was given up on
+        uint32_t duplicate;
+    };
+
+    // Record when a packet arrived from the network, before it is queued
+    void OnArrival(uint32_t sequence, int frame_duration, int64_t now_ms);
+    // Packets outside the reorder window have to wait in the caller's queue
+    bool Fits(uint32_t sequence) const;
+    void Put(AudioStreamPacket&& packet, int64_t now_ms);
+    // urgent: the output runs dry unless a frame is produced now
+    Action Next(int64_t now_ms, bool urgent, AudioStreamPacket& packet);
+    // The packet after a lost frame, valid until the next Put or Next
+    const AudioStreamPacket* PeekNext() const;
+    // Drop the buffered packets and start over with the next packet
+    void Reset();
+
+    bool empty() const { return count_ == 0; }
+    int size() const { return count_; }
+    int jitter_ms() const { return jitter_q4_ / 16; }
+    int target_depth() const;
+    const Stats& stats() const { return stats_; }
+    void ResetStats() { stats_ = {}; }
+
+private:
+    AudioStreamPacket slots_[kCapacity];
+    bool present_[kCapacity] = {};
+    int count_ = 0;
+    uint32_t min_sequence_ = 0;  // Lowest and highest buffered sequence, valid while count_ > 0
+    uint32_t max_sequence_ = 0;
+
+    bool playing_ = false;
+    uint32_t expected_ = 0;      // Sequence of the next frame to play while playing_
+    int64_t first_put_ms_ = 0;
+    int64_t missing_since_ms_ = -1;
+    int expanded_ = 0;           // Frames concealed while waiting for the current missing frame
+    int64_t last_output_ms_ = 0;
+
+    int frame_ms_ = 60;
+    bool has_arrival_ = false;
+    uint32_t last_arrival_sequence_ = 0;
+    int64_t last_arrival_ms_ = 0;
+    uint32_t stream_sequence_ = 0;  // First sequence of the stream, transit times count from it
+    int64_t min_transit_ = 0;    // Arrival time less sequence time of the fastest packet in the stream
+    int jitter_q4_ = 0;          // Lateness against the fastest packet, 1/16 ms
+
+    Stats stats_ = {};
+
+    static int Index(uint32_t sequence) { return sequence % kCapacity; }
+    void Clear();
+    Action Take(int64_t now_ms, AudioStreamPacket& packet);
+    uint32_t FirstBuffered() const;
+};
+
+#endif // AUDIO_JITTER_BUFFER_H
@@ -0,0 +1,172 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define TAG "AudioMixer"
+
+// Keep music ducked for a while after the last voice sample, so short pauses
+// between sentences do not pump the music volume
+static constexpr int64_t kVoiceHoldUs = 600 * 1000;
+// Maximum gain change per Read: duck quickly, recover slowly
+static constexpr int kAttackStep = AudioMixer::kUnityGain / 8;
+static constexpr int kReleaseStep = AudioMixer::kUnityGain / 32;
+
+AudioMixer::AudioMixer(size_t queue_samples) : capacity_(queue_samples) {
+    for (auto& queue : queues_) {
+        queue.data = (int16_t*)heap_caps_malloc(capacity_ * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        if (queue.data == nullptr) {
+            queue.data = (int16_t*)heap_caps_malloc(capacity_ * sizeof(int16_t), MALLOC_CAP_8BIT);
+        }
+        if (queue.data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate mixer queue of %u samples", (unsigned int)capacity_);
+        }
+    }
+}
+
+AudioMixer::~AudioMixer() {
+    for (auto& queue : queues_) {
+        if (queue.data != nullptr) {
+            heap_caps_free(queue.data);
+        }
+    }
+}
+
+size_t AudioMixer::Write(AudioMixerSource source, const int16_t* data, size_t samples, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::unique_lock<std::mutex> lock(mutex_);
+    Queue& queue = queues_[source];
+    if (queue.data == nullptr) {
+        return 0;
+    }
+
+    size_t written = 0;
+    while (written < samples) {
+        size_t space = capacity_ - queue.size;
+        if (space == 0) {
+            if (space_cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+                break;
+            }
+            continue;
+        }
+
+        size_t count = std::min(space, samples - written);
+        size_t tail = (queue.head + queue.size) % capacity_;
+        size_t first = std::min(count, capacity_ - tail);
+        memcpy(queue.data + tail, data + written, first * sizeof(int16_t));
+        memcpy(queue.data, data + written + first, (count - first) * sizeof(int16_t));
+        queue.size += count;
+        written += count;
+        data_cv_.notify_all();
+    }
+    return written;
+}
+
+void AudioMixer::Clear(AudioMixerSource source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_[source].head = 0;
+    queues_[source].size = 0;
+    space_cv_.notify_all();
+}
+
+size_t AudioMixer::Queued(AudioMixerSource source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queues_[source].size;
+}
+
+void AudioMixer::SetGain(AudioMixerSource source, int gain_q15) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Up to 2x, so the Q15 products in Read stay within 32 bits
+    queues_[source].gain_q15 = std::max(0, std::min(gain_q15, kUnityGain * 2 - 1));
+}
+
+void AudioMixer::SetDucked(bool ducked) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ducked_ = ducked;
+}
+
+void AudioMixer::SetPaused(AudioMixerSource source, bool paused) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Queue& queue = queues_[source];
+    if (queue.paused == paused) {
+        return;
+    }
+    queue.paused = paused;
+    if (!paused) {
+        // Ramp up from silence, the queued samples start playing on the next Read
+        queue.current_gain_q15 = 0;
+        data_cv_.notify_all();
+    }
+}
+
+size_t AudioMixer::Read(int16_t* out, size_t max_samples, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool ready = data_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() {
+        for (auto& queue : queues_) {
+            if (queue.size > 0 && !queue.paused) {
+                return true;
+            }
+        }
+        return false;
+    });
+    if (!ready) {
+        return 0;
+    }
+
+    max_samples = std::min(max_samples, kMaxReadSamples);
+    size_t samples = 0;
+    for (auto& queue : queues_) {
+        if (!queue.paused) {
+            samples = std::max(samples, std::min(queue.size, max_samples));
+        }
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (queues_[kAudioSourceVoice].size > 0) {
+        voice_active_until_us_ = now + kVoiceHoldUs;
+    }
+    bool duck = ducked_ || now < voice_active_until_us_;
+
+    int32_t mix[kMaxReadSamples] = {};
+    for (int source = 0; source < kAudioSourceCount; source++) {
+        Queue& queue = queues_[source];
+        if (queue.paused) {
+            continue;
+        }
+        int target = queue.gain_q15;
+        if (source == kAudioSourceMusic && duck) {
+            target = (target * duck_gain_q15_) >> 15;
+        }
+        // Ramp the gain across this chunk to avoid clicks
+        int start = queue.current_gain_q15;
+        int end = target < start ? std::max(target, start - kAttackStep) : std::min(target, start + kReleaseStep);
+        queue.current_gain_q15 = end;
+
+        size_t count = std::min(queue.size, samples);
+        if (count == 0) {
+            continue;
+        }
+        int32_t gain = start << 8;  // Q23
+        int32_t delta = ((end - start) << 8) / (int32_t)count;
+        for (size_t i = 0; i < count; i++) {
+            mix[i] += ((int32_t)queue.data[queue.head] * (gain >> 8)) >> 15;
+            gain += delta;
+            if (++queue.head == capacity_) {
+                queue.head = 0;
+            }
+        }
+        queue.size -= count;
+    }
+    lock.unlock();
+    space_cv_.notify_all();
+
+    for (size_t i = 0; i < samples; i++) {
+        int32_t value = mix[i];
+        out[i] = value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+    }
+    return samples;
+}
@@ -0,0 +1,63 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+enum AudioMixerSource {
+    kAudioSourceMusic,
+    kAudioSourceVoice,  // TTS and notification sounds, both come from the Opus decode path
+    kAudioSourceCount,
+};
+
+// Mixing bus between audio producers and the single output task.
+// Every source has its own PCM queue at the codec output rate and channel count.
+// Producers block on Write when their queue is full, which paces them to real time
+// without touching the codec. Music is ducked while ducking is requested or
+// while voice audio is playing. A paused source keeps its queued samples and
+// fades back in from where it stopped when resumed.
+class AudioMixer {
+public:
+    static constexpr int kUnityGain = 1 << 15;        // Q15
+    static constexpr size_t kMaxReadSamples = 256;
+
+    AudioMixer(size_t queue_samples);
+    ~AudioMixer();
+
+    // Queue samples, waiting up to timeout_ms for space. Returns the number queued.
+    size_t Write(AudioMixerSource source, const int16_t* data, size_t samples, int timeout_ms);
+    void Clear(AudioMixerSource source);
+    size_t Queued(AudioMixerSource source);
+
+    // Mix up to max_samples (at most kMaxReadSamples) into out, waiting up to
+    // timeout_ms for any source to have data. Returns 0 on timeout.
+    size_t Read(int16_t* out, size_t max_samples, int timeout_ms);
+
+    void SetGain(AudioMixerSource source, int gain_q15);
+    void SetDucked(bool ducked);
+    void SetPaused(AudioMixerSource source, bool paused);
+    void SetDuckGain(int gain_q15) { duck_gain_q15_ = gain_q15; }
+
+private:
+    struct Queue {
+        int16_t* data = nullptr;
+        size_t head = 0;
+        size_t size = 0;
+        int gain_q15 = kUnityGain;
+        int current_gain_q15 = kUnityGain;  // Includes ducking, ramped per read
+        bool paused = false;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable data_cv_;
+    std::condition_variable space_cv_;
+    Queue queues_[kAudioSourceCount];
+    size_t capacity_;
+    bool ducked_ = false;
+    int duck_gain_q15_ = kUnityGain / 5;  // About -14 dB
+    int64_t voice_active_until_us_ = 0;
+};
+
+#endif // AUDIO_MIXER_H
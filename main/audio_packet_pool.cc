@@ -0,0 +1,167 @@
+#include "audio_packet_pool.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioPacketPool"
+
+AudioPayload::AudioPayload(AudioPayload&& other) noexcept
+    : pool_(other.pool_), data_(other.data_), slot_(other.slot_), size_(other.size_) {
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+AudioPayload& AudioPayload::operator=(AudioPayload&& other) noexcept {
+    if (this != &other) {
+        Release();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        slot_ = other.slot_;
+        size_ = other.size_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+AudioPayload AudioPayload::View(const uint8_t* data, size_t size) {
+    AudioPayload payload;
+    payload.data_ = const_cast<uint8_t*>(data);
+    payload.size_ = size;
+    return payload;
+}
+
+bool AudioPayload::Resize(size_t size) {
+    if (pool_ == nullptr || size > pool_->slot_size()) {
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+void AudioPayload::Release() {
+    if (pool_ != nullptr) {
+        pool_->Release(slot_);
+        pool_ = nullptr;
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+AudioPacketPool::AudioPacketPool() : slot_size_(CONFIG_AUDIO_PACKET_MAX_PAYLOAD) {
+    size_t slot_count = CONFIG_AUDIO_PACKET_POOL_SLOTS;
+    size_t bytes = slot_count * slot_size_;
+    storage_ = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    bool external = storage_ != nullptr;
+    if (storage_ == nullptr) {
+        storage_ = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    }
+    if (storage_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u packet slots", (unsigned int)slot_count);
+        return;
+    }
+
+    slot_count_ = slot_count;
+    free_slots_.reserve(slot_count_);
+    // Hand out low slots first
+    for (size_t i = slot_count_; i > 0; i--) {
+        free_slots_.push_back(i - 1);
+    }
+    min_available_ = slot_count_;
+    ESP_LOGI(TAG, "%u slots of %u bytes (%u KB) in %s", (unsigned int)slot_count_, (unsigned int)slot_size_,
+             (unsigned int)(bytes / 1024), external ? "PSRAM" : "internal RAM");
+}
+
+AudioPacketPool::~AudioPacketPool() {
+    if (storage_ != nullptr) {
+        heap_caps_free(storage_);
+    }
+}
+
+AudioPayload AudioPacketPool::Acquire(size_t size) {
+    AudioPayload payload;
+    if (size > slot_size_) {
+        ESP_LOGW(TAG, "Packet of %u bytes exceeds the %u byte slot, dropped", (unsigned int)size, (unsigned int)slot_size_);
+        dropped_count_++;
+        return payload;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_slots_.empty()) {
+        // Warn once per burst, the producer keeps trying at packet rate
+        if (dropped_count_++ % 32 == 0) {
+            ESP_LOGW(TAG, "No free packet slots, %lu packets dropped", (unsigned long)dropped_count_.load());
+        }
+        return payload;
+    }
+    uint16_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    min_available_ = std::min(min_available_, free_slots_.size());
+
+    payload.pool_ = this;
+    payload.slot_ = slot;
+    payload.data_ = storage_ + slot * slot_size_;
+    payload.size_ = size;
+    return payload;
+}
+
+AudioPayload AudioPacketPool::Acquire(const uint8_t* data, size_t size) {
+    AudioPayload payload = Acquire(size);
+    if (payload.valid()) {
+        memcpy(payload.data(), data, size);
+    }
+    return payload;
+}
+
+void AudioPacketPool::Release(uint16_t slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_slots_.push_back(slot);
+}
+
+size_t AudioPacketPool::available() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_slots_.size();
+}
+
+size_t AudioPacketPool::min_available() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return min_available_;
+}
+
+bool AudioPacketQueue::Push(AudioStreamPacket&& packet) {
+    if (full()) {
+        return false;
+    }
+    packets_[(head_ + size_) % packets_.size()] = std::move(packet);
+    size_++;
+    return true;
+}
+
+bool AudioPacketQueue::Pop(AudioStreamPacket& packet) {
+    if (empty()) {
+        return false;
+    }
+    packet = std::move(packets_[head_]);
+    head_ = (head_ + 1) % packets_.size();
+    size_--;
+    return true;
+}
+
+void AudioPacketQueue::Clear() {
+    // Return the slots to the pool right away
+    for (size_t i = 0; i < size_; i++) {
+        packets_[(head_ + i) % packets_.size()].payload.Release();
+    }
+    head_ = 0;
+    size_ = 0;
+}
+
+void AudioPacketQueue::Swap(AudioPacketQueue& other) {
+    packets_.swap(other.packets_);
+    std::swap(head_, other.head_);
+    std::swap(size_, other.size_);
+}
@@ -0,0 +1,118 @@
+#ifndef AUDIO_PACKET_POOL_H
+#define AUDIO_PACKET_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+class AudioPacketPool;
+
+// Handle to one slot of the packet pool. Move-only; the slot goes back to the
+// pool when the handle is destroyed or overwritten. A view refers to read-only
+// memory the payload does not own, such as a sound embedded in flash.
+class AudioPayload {
+public:
+    AudioPayload() = default;
+    // The data must outlive the payload and must not be written through data()
+    static AudioPayload View(const uint8_t* data, size_t size);
+    ~AudioPayload() { Release(); }
+    AudioPayload(AudioPayload&& other) noexcept;
+    AudioPayload& operator=(AudioPayload&& other) noexcept;
+    AudioPayload(const AudioPayload&) = delete;
+    AudioPayload& operator=(const AudioPayload&) = delete;
+
+    bool valid() const { return data_ != nullptr; }
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // Set the length after writing into data(), fails above the slot size and for views
+    bool Resize(size_t size);
+    void Release();
+
+private:
+    friend class AudioPacketPool;
+
+    AudioPacketPool* pool_ = nullptr;
+    uint8_t* data_ = nullptr;
+    uint16_t slot_ = 0;
+    uint16_t size_ = 0;
+};
+
+struct AudioStreamPacket {
+    int sample_rate = 0;
+    int frame_duration = 0;
+    uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // Transport sequence number, 0 when the transport is ordered and lossless
+    AudioPayload payload;
+};
+
+// Fixed-size slots for Opus packets on their way between the protocol, the
+// encoder and the decoder. All slots are allocated in one block at startup
+// (PSRAM when available), so the packets flowing at 16+ per second in each
+// direction no longer allocate list nodes and payload vectors next to the AFE
+// and LVGL buffers. Acquire fails instead of allocating when every slot is in use.
+class AudioPacketPool {
+public:
+    static AudioPacketPool& GetInstance() {
+        static AudioPacketPool instance;
+        return instance;
+    }
+    AudioPacketPool(const AudioPacketPool&) = delete;
+    AudioPacketPool& operator=(const AudioPacketPool&) = delete;
+
+    // Returns an invalid payload when the pool is exhausted or size exceeds the slot size
+    AudioPayload Acquire(size_t size);
+    AudioPayload Acquire(const uint8_t* data, size_t size);
+
+    size_t slot_size() const { return slot_size_; }
+    size_t slot_count() const { return slot_count_; }
+    size_t available();
+    // Lowest number of free slots seen so far, for sizing the pool
+    size_t min_available();
+    uint32_t dropped_count() const { return dropped_count_; }
+
+private:
+    AudioPacketPool();
+    ~AudioPacketPool();
+
+    friend class AudioPayload;
+    void Release(uint16_t slot);
+
+    std::mutex mutex_;
+    uint8_t* storage_ = nullptr;
+    size_t slot_size_;
+    size_t slot_count_ = 0;
+    std::vector<uint16_t> free_slots_;  // Reserved for every slot, never reallocates
+    size_t min_available_ = 0;
+    std::atomic<uint32_t> dropped_count_{0};
+};
+
+// Fixed-capacity FIFO of packets. Storage is allocated once in the constructor;
+// the caller provides the locking.
+class AudioPacketQueue {
+public:
+    explicit AudioPacketQueue(size_t capacity) : packets_(capacity) {}
+
+    // Fails when the queue is full
+    bool Push(AudioStreamPacket&& packet);
+    bool Pop(AudioStreamPacket& packet);
+    void Clear();
+    void Swap(AudioPacketQueue& other);
+    // Oldest packet, the queue must not be empty
+    const AudioStreamPacket& front() const { return packets_[head_]; }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return packets_.size(); }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == packets_.size(); }
+
+private:
+    std::vector<AudioStreamPacket> packets_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+#endif // AUDIO_PACKET_POOL_H
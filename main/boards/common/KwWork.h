@@ -259,12 +259,14 @@ public:
     return final(result);
   }
 
-  static string getUrl(const string & id) {
+  // br 为码率档位，例如 "100kmp3"、"320kmp3"
+  static string getUrl(const string & id, const string & br = "100kmp3") {
     stringstream ss;
     ss << "user=583781442410&prod=kwplayerhd_ar_5.1.0.0&corp=kuwo&vipver=5.1.0."
           "0&source=kwplayerhd_ar_5.1.0.0_B_jiakong_vh.apk&packageName=cn.kuwo."
           "kwmusiccar&packageSign=61ed377e85d386a8dfee6b864bd85b0bfaa5af81&"
-          "type=convert_url2&br=100kmp3&format=mp3|aac&sig=0&rid="
+          "type=convert_url2&br="
+       << br << "&format=mp3|aac&sig=0&rid="
        << id << "&priority=bitrate&loginUid=0";
     string en = KwWork::encrypt(ss.str());
     ss.str("");
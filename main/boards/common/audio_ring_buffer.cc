@@ -0,0 +1,196 @@
+#include "audio_ring_buffer.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioRingBuffer"
+
+#define RING_DATA_EVENT (1 << 0)
+#define RING_SPACE_EVENT (1 << 1)
+
+namespace {
+
+constexpr size_t kMinCapacity = 16 * 1024;
+constexpr size_t kMaxInternalCapacity = 32 * 1024;  // 没有PSRAM时最多占用的内部RAM，留给Wi-Fi和音频任务
+
+// 优先在PSRAM中分配，失败时逐级减半；容量不超过 kMaxInternalCapacity 时也尝试内部RAM
+// capacity 返回实际分配的容量
+uint8_t* AllocateStorage(size_t& capacity, size_t max_peek) {
+    // 请求的容量本身小于下限时只尝试这一种容量
+    size_t minimum = std::min(capacity, std::max(kMinCapacity, max_peek));
+    for (size_t size = capacity; size >= minimum; size /= 2) {
+        uint8_t* buffer = (uint8_t*)heap_caps_malloc(size + max_peek, MALLOC_CAP_SPIRAM);
+        if (buffer == nullptr && size <= kMaxInternalCapacity) {
+            buffer = (uint8_t*)heap_caps_malloc(size + max_peek, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (buffer != nullptr) {
+            if (size != capacity) {
+                ESP_LOGW(TAG, "Ring buffer reduced to %u bytes", (unsigned int)size);
+            }
+            capacity = size;
+            return buffer;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+AudioRingBuffer::AudioRingBuffer(size_t capacity, size_t max_peek) {
+    event_group_ = xEventGroupCreate();
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || max_peek > capacity) {
+        ESP_LOGE(TAG, "Invalid ring buffer size: capacity=%u, max_peek=%u",
+                 (unsigned int)capacity, (unsigned int)max_peek);
+        return;
+    }
+
+    max_peek_ = max_peek;
+    // 末尾多分配 max_peek 字节作为回绕时的线性化保护区
+    buffer_ = AllocateStorage(capacity, max_peek);
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for ring buffer", (unsigned int)(capacity + max_peek));
+        return;
+    }
+    capacity_ = capacity;
+    mask_ = capacity - 1;
+}
+
+AudioRingBuffer::~AudioRingBuffer() {
+    if (event_group_ != nullptr) {
+        vEventGroupDelete(event_group_);
+    }
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+size_t AudioRingBuffer::Size() const {
+    return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire);
+}
+
+size_t AudioRingBuffer::Space() const {
+    return capacity_ - Size();
+}
+
+size_t AudioRingBuffer::GetWriteSpan(uint8_t** ptr) {
+    size_t write = write_index_.load(std::memory_order_relaxed);
+    size_t read = read_index_.load(std::memory_order_acquire);
+    size_t space = capacity_ - (write - read);
+    size_t offset = write & mask_;
+    *ptr = buffer_ + offset;
+    return std::min(space, capacity_ - offset);
+}
+
+void AudioRingBuffer::CommitWrite(size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    write_index_.fetch_add(bytes, std::memory_order_release);
+    xEventGroupSetBits(event_group_, RING_DATA_EVENT);
+}
+
+void AudioRingBuffer::SetEndOfStream() {
+    end_of_stream_.store(true, std::memory_order_release);
+    if (event_group_ != nullptr) {
+        xEventGroupSetBits(event_group_, RING_DATA_EVENT);
+    }
+}
+
+size_t AudioRingBuffer::Peek(uint8_t** ptr, size_t want) {
+    size_t read = read_index_.load(std::memory_order_relaxed);
+    size_t available = write_index_.load(std::memory_order_acquire) - read;
+    size_t length = std::min(std::min(want, available), max_peek_);
+    size_t offset = read & mask_;
+    size_t contiguous = capacity_ - offset;
+
+    *ptr = buffer_ + offset;
+    if (length > contiguous) {
+        // 数据回绕：把开头的部分复制到保护区，拼成连续内存
+        memcpy(buffer_ + capacity_, buffer_, length - contiguous);
+    }
+    return length;
+}
+
+void AudioRingBuffer::Consume(size_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    read_index_.fetch_add(std::min(bytes, Size()), std::memory_order_release);
+    xEventGroupSetBits(event_group_, RING_SPACE_EVENT);
+}
+
+bool AudioRingBuffer::WaitForData(size_t bytes, TickType_t timeout) {
+    bytes = std::min(bytes, capacity_);
+    while (Size() < bytes && !IsEndOfStream() && !IsAborted()) {
+        // 事件位在满足条件前被设置也不会丢失：等待时会立即返回
+        EventBits_t bits = xEventGroupWaitBits(event_group_, RING_DATA_EVENT, pdTRUE, pdFALSE, timeout);
+        if ((bits & RING_DATA_EVENT) == 0) {
+            break;
+        }
+    }
+    return Size() >= bytes;
+}
+
+bool AudioRingBuffer::WaitForSpace(size_t bytes, TickType_t timeout) {
+    bytes = std::min(bytes, capacity_);
+    while (Space() < bytes && !IsAborted()) {
+        EventBits_t bits = xEventGroupWaitBits(event_group_, RING_SPACE_EVENT, pdTRUE, pdFALSE, timeout);
+        if ((bits & RING_SPACE_EVENT) == 0) {
+            break;
+        }
+    }
+    return Space() >= bytes;
+}
+
+void AudioRingBuffer::Abort() {
+    aborted_.store(true, std::memory_order_release);
+    if (event_group_ != nullptr) {
+        xEventGroupSetBits(event_group_, RING_DATA_EVENT | RING_SPACE_EVENT);
+    }
+}
+
+void AudioRingBuffer::Reset() {
+    write_index_.store(0, std::memory_order_relaxed);
+    read_index_.store(0, std::memory_order_relaxed);
+    end_of_stream_.store(false, std::memory_order_relaxed);
+    aborted_.store(false, std::memory_order_release);
+    if (event_group_ != nullptr) {
+        xEventGroupClearBits(event_group_, RING_DATA_EVENT | RING_SPACE_EVENT);
+    }
+}
+
+bool AudioRingBuffer::Resize(size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || max_peek_ > capacity) {
+        ESP_LOGE(TAG, "Invalid ring buffer size: capacity=%u", (unsigned int)capacity);
+        return false;
+    }
+    if (capacity != capacity_ || buffer_ == nullptr) {
+        // 先释放旧存储，PSRAM 紧张时才有空间分配新的；新容量分配失败时退回原容量
+        size_t previous = buffer_ != nullptr ? capacity_ : 0;
+        if (buffer_ != nullptr) {
+            heap_caps_free(buffer_);
+        }
+        buffer_ = AllocateStorage(capacity, max_peek_);
+        if (buffer_ == nullptr && previous > 0) {
+            ESP_LOGW(TAG, "Failed to allocate %u bytes for ring buffer, keeping %u",
+                     (unsigned int)(capacity + max_peek_), (unsigned int)previous);
+            capacity = previous;
+            buffer_ = AllocateStorage(capacity, max_peek_);
+        }
+        if (buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate ring buffer");
+            capacity_ = 0;
+            mask_ = 0;
+            return false;
+        }
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+        if (event_group_ == nullptr) {
+            event_group_ = xEventGroupCreate();
+        }
+    }
+    Reset();
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 单生产者/单消费者无锁字节环形缓冲区
+// 生产者（下载线程）直接把 HTTP 数据读进 GetWriteSpan() 返回的空间，
+// 消费者（解码线程）通过 Peek() 拿到连续的数据段直接交给解码器。
+// 数据跨越缓冲区末尾时，Peek() 会把开头的一小段复制到尾部的保护区，
+// 保证解码器始终看到连续内存；保护区只由消费者读写。
+class AudioRingBuffer {
+public:
+    // capacity 必须是 2 的幂，max_peek 为单次 Peek 能保证的最大连续长度
+    // PSRAM 不足时逐级减半容量，容量较小时改用内部 RAM，实际容量见 capacity()
+    AudioRingBuffer(size_t capacity, size_t max_peek);
+    ~AudioRingBuffer();
+
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    // 存储或事件组分配失败时为 false，此时不能读写，调用者需放弃播放
+    inline bool valid() const { return buffer_ != nullptr && event_group_ != nullptr; }
+    inline size_t capacity() const { return capacity_; }
+    inline size_t max_peek() const { return max_peek_; }
+
+    size_t Size() const;
+    size_t Space() const;
+    bool IsEndOfStream() const { return end_of_stream_.load(std::memory_order_acquire); }
+    bool IsAborted() const { return aborted_.load(std::memory_order_acquire); }
+
+    // 生产者接口
+    size_t GetWriteSpan(uint8_t** ptr);
+    void CommitWrite(size_t bytes);
+    void SetEndOfStream();
+    bool WaitForSpace(size_t bytes, TickType_t timeout);
+
+    // 消费者接口
+    size_t Peek(uint8_t** ptr, size_t want);
+    void Consume(size_t bytes);
+    bool WaitForData(size_t bytes, TickType_t timeout);
+
+    // 唤醒所有等待者，之后的等待立即返回，直到 Reset()
+    void Abort();
+    // 只能在生产者和消费者都不再访问时调用
+    void Reset();
+    // 重新分配存储并清空数据，调用条件同 Reset()，失败时保持原来的存储
+    bool Resize(size_t capacity);
+
+private:
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    size_t max_peek_ = 0;
+    std::atomic<size_t> write_index_{0};
+    std::atomic<size_t> read_index_{0};
+    std::atomic<bool> end_of_stream_{false};
+    std::atomic<bool> aborted_{false};
+    EventGroupHandle_t event_group_ = nullptr;
+};
+
+#endif // AUDIO_RING_BUFFER_H
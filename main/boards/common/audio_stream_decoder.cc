@@ -0,0 +1,69 @@
+#include "audio_stream_decoder.h"
+#include "mp3_stream_decoder.h"
+#include "wav_stream_decoder.h"
+#include "ogg_opus_stream_decoder.h"
+#include "flac_stream_decoder.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "AudioStreamDecoder"
+
+AudioStreamFormat AudioStreamDecoder::Detect(const uint8_t* data, size_t size) {
+    if (size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) {
+        return AudioStreamFormat::kWav;
+    }
+    if (size >= 4 && memcmp(data, "OggS", 4) == 0) {
+        return AudioStreamFormat::kOggOpus;
+    }
+    if (size >= 4 && memcmp(data, "fLaC", 4) == 0) {
+        return AudioStreamFormat::kFlac;
+    }
+    if (size >= 8 && memcmp(data + 4, "ftyp", 4) == 0) {
+        // MP4/M4A 容器，一般是 AAC
+        return AudioStreamFormat::kAac;
+    }
+    if (size >= 2 && data[0] == 0xFF && (data[1] & 0xF6) == 0xF0) {
+        // ADTS 帧头的 layer 字段固定为 0，MP3 不会出现这个组合
+        return AudioStreamFormat::kAac;
+    }
+    // 其余情况交给 MP3 解码器自己寻找帧同步
+    return AudioStreamFormat::kMp3;
+}
+
+std::unique_ptr<AudioStreamDecoder> AudioStreamDecoder::Create(AudioStreamFormat format) {
+    std::unique_ptr<AudioStreamDecoder> decoder;
+    switch (format) {
+    case AudioStreamFormat::kMp3:
+        decoder = std::make_unique<Mp3StreamDecoder>();
+        break;
+    case AudioStreamFormat::kWav:
+        decoder = std::make_unique<WavStreamDecoder>();
+        break;
+    case AudioStreamFormat::kOggOpus:
+        decoder = std::make_unique<OggOpusStreamDecoder>();
+        break;
+    case AudioStreamFormat::kFlac:
+        decoder = std::make_unique<FlacStreamDecoder>();
+        break;
+    default:
+        ESP_LOGW(TAG, "Unsupported audio format: %s", FormatName(format));
+        return nullptr;
+    }
+    if (!decoder->valid()) {
+        ESP_LOGE(TAG, "Failed to create %s decoder", FormatName(format));
+        return nullptr;
+    }
+    return decoder;
+}
+
+const char* AudioStreamDecoder::FormatName(AudioStreamFormat format) {
+    switch (format) {
+    case AudioStreamFormat::kMp3: return "MP3";
+    case AudioStreamFormat::kWav: return "WAV";
+    case AudioStreamFormat::kOggOpus: return "Ogg/Opus";
+    case AudioStreamFormat::kFlac: return "FLAC";
+    case AudioStreamFormat::kAac: return "AAC";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef AUDIO_STREAM_DECODER_H
+#define AUDIO_STREAM_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// 流式音频解码器接口
+// 播放线程从环形缓冲区 Peek 一段连续数据交给解码器，解码器报告消费的字节数，
+// 播放线程再据此 Consume，整个过程不需要额外拷贝压缩数据。
+// 输出为交错排列的 16 位 PCM，缓冲区由解码器持有，在下一次 Decode 之前有效。
+enum class AudioStreamFormat {
+    kUnknown,
+    kMp3,
+    kWav,
+    kOggOpus,
+    kFlac,
+    kAac,   // 只识别，暂不支持解码
+};
+
+struct AudioFrame {
+    const int16_t* pcm = nullptr;
+    int samples = 0;      // 每个声道的样本数
+    int channels = 0;
+    int sample_rate = 0;
+};
+
+class AudioStreamDecoder {
+public:
+    enum class Status {
+        kFrame,         // 输出了一帧 PCM
+        kSkipped,       // 消费了数据但没有输出，例如文件头、损坏的帧
+        kNeedMoreData,  // 当前数据不足以解码一帧，没有消费任何数据
+    };
+
+    virtual ~AudioStreamDecoder() = default;
+
+    virtual AudioStreamFormat format() const = 0;
+    // 解码器资源分配失败时返回 false
+    virtual bool valid() const { return true; }
+
+    // more_available 为 false 表示调用方已经给出了全部可用的数据（Peek 上限或流结束），
+    // 此时解码器不能再返回 kNeedMoreData。consumed 可以大于 size，表示需要跳过后续数据
+    virtual Status Decode(const uint8_t* data, size_t size, bool more_available,
+                          size_t& consumed, AudioFrame& frame) = 0;
+
+    // 跳转或切换曲目后调用，丢弃解码器内部状态
+    virtual void Reset() = 0;
+
+    // 根据数据开头（已跳过 ID3 标签）判断格式
+    static AudioStreamFormat Detect(const uint8_t* data, size_t size);
+    // 不支持的格式返回空指针
+    static std::unique_ptr<AudioStreamDecoder> Create(AudioStreamFormat format);
+    static const char* FormatName(AudioStreamFormat format);
+};
+
+#endif // AUDIO_STREAM_DECODER_H
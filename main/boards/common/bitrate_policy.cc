@@ -0,0 +1,77 @@
+#include "bitrate_policy.h"
+
+#include <algorithm>
+
+namespace {
+
+// 酷我只有 MP3 档位能由现有解码器播放，按码率从低到高排列
+const BitratePolicy::Variant kVariants[BitratePolicy::kVariantCount] = {
+    {"48kmp3", 48},
+    {"100kmp3", 100},
+    {"192kmp3", 192},
+    {"320kmp3", 320},
+};
+
+} // namespace
+
+const BitratePolicy::Variant& BitratePolicy::GetVariant(int index) {
+    return kVariants[std::max(0, std::min(index, kVariantCount - 1))];
+}
+
+int BitratePolicy::HighestFitting(int throughput_kbps, int percent) {
+    int index = 0;
+    for (int i = 1; i < kVariantCount; i++) {
+        if (kVariants[i].kbps * percent / 100 <= throughput_kbps) {
+            index = i;
+        }
+    }
+    return index;
+}
+
+int BitratePolicy::SelectForNewTrack(int throughput_kbps) {
+    int variant = PreviewForNewTrack(throughput_kbps);
+    last_variant_.store(variant, std::memory_order_relaxed);
+    return variant;
+}
+
+int BitratePolicy::PreviewForNewTrack(int throughput_kbps) const {
+    int last = last_variant_.load(std::memory_order_relaxed);
+    if (throughput_kbps <= 0) {
+        return last;
+    }
+
+    int variant = HighestFitting(throughput_kbps, kHeadroomPercent);
+    if (variant > last) {
+        // 升档要求更大的余量，并且每首歌只升一级
+        variant = std::min(last + 1, std::max(last, HighestFitting(throughput_kbps, kUpgradePercent)));
+    }
+    return variant;
+}
+
+int BitratePolicy::CheckMidTrack(int variant, int throughput_kbps, int buffered_ms, int64_t now_ms) {
+    if (variant <= 0 || throughput_kbps <= 0) {
+        return -1;
+    }
+    if (throughput_kbps >= kVariants[variant].kbps || buffered_ms >= kLowBufferMs) {
+        low_since_ms_ = -1;
+        return -1;
+    }
+    if (low_since_ms_ < 0) {
+        low_since_ms_ = now_ms;
+    }
+    if (now_ms - low_since_ms_ < kSustainMs ||
+        (last_switch_ms_ >= 0 && now_ms - last_switch_ms_ < kSwitchCooldownMs)) {
+        return -1;
+    }
+
+    low_since_ms_ = -1;
+    last_switch_ms_ = now_ms;
+    int lower = std::min(variant - 1, HighestFitting(throughput_kbps, kHeadroomPercent));
+    last_variant_.store(lower, std::memory_order_relaxed);
+    return lower;
+}
+
+void BitratePolicy::ResetMidTrack() {
+    low_since_ms_ = -1;
+    last_switch_ms_ = -1;
+}
@@ -0,0 +1,47 @@
+#ifndef BITRATE_POLICY_H
+#define BITRATE_POLICY_H
+
+#include <atomic>
+#include <cstdint>
+
+// 根据持续下载速度选择酷我播放地址的码率档位
+// 新曲目选择码率留有余量的最高档，升档每次只升一级，避免网络短暂变好时频繁来回切换；
+// 播放中下载速度持续低于当前码率且缓冲不足时降档，由下载线程用 Range 请求接到新档位的对应位置。
+// 不依赖任何 ESP-IDF 接口，时间由调用方传入，可以在主机上用限速的下载速度序列模拟。
+class BitratePolicy {
+public:
+    struct Variant {
+        const char* br;  // 酷我接口的 br 参数
+        int kbps;
+    };
+
+    static constexpr int kVariantCount = 4;
+    static constexpr int kDefaultVariant = 1;  // 还没有测得下载速度时使用，与原来固定的 100kmp3 相同
+
+    static const Variant& GetVariant(int index);
+
+    // 为新曲目选择档位，throughput_kbps 为 0 表示还没有测量结果
+    int SelectForNewTrack(int throughput_kbps);
+    // 与 SelectForNewTrack 的结果相同，但不记录为当前档位，用于提前获取后面几首的播放地址
+    int PreviewForNewTrack(int throughput_kbps) const;
+
+    // 播放中定期调用，需要降档时返回新档位，否则返回 -1
+    int CheckMidTrack(int variant, int throughput_kbps, int buffered_ms, int64_t now_ms);
+    // 开始下载新曲目时调用，清除降档判断的状态
+    void ResetMidTrack();
+
+private:
+    static constexpr int kHeadroomPercent = 150;  // 下载速度至少为码率的1.5倍
+    static constexpr int kUpgradePercent = 200;   // 升档要求下载速度达到新档位码率的2倍
+    static constexpr int kLowBufferMs = 4000;     // 缓冲低于该值才考虑降档
+    static constexpr int kSustainMs = 3000;       // 下载速度不足需要持续的时间
+    static constexpr int kSwitchCooldownMs = 10000;
+
+    static int HighestFitting(int throughput_kbps, int percent);
+
+    std::atomic<int> last_variant_{kDefaultVariant};
+    int64_t low_since_ms_ = -1;
+    int64_t last_switch_ms_ = -1;
+};
+
+#endif // BITRATE_POLICY_H
@@ -9,6 +9,8 @@
 #include <esp_log.h>
 #include <esp_heap_caps.h>
 #include <esp_pthread.h>
+#include <esp_timer.h>
+#include <esp_spiffs.h>
 #include <cJSON.h>
 #include <cstring>
 #include <chrono>
@@ -19,9 +21,17 @@
 #include <freertos/task.h>
 
 #include "KwWork.h"
+#include "json_stream_extractor.h"
+
+extern "C" {
+#include "mp3dec.h"
+}
 
 #define TAG "Esp32Music"
 
+// 缓存命中时使用的播放地址前缀，后面跟歌曲ID
+#define CACHE_URL_PREFIX "cache://"
+
 // URL编码函数
 static std::string url_encode(const std::string &str)
 {
@@ -97,152 +107,114 @@ static std::string buildUrlWithParams(const std::string &base_url, const std::st
 }
 
 Esp32Music::Esp32Music() : last_downloaded_data_(), current_music_url_(), current_song_name_(),
+                           current_song_id_(), current_artist_(),
                            song_name_displayed_(false), current_lyric_url_(), lyrics_(),
-                           current_lyric_index_(-1),
-                           is_playing_(false), is_downloading_(false),
-                           play_thread_(), download_thread_(), play_next_(), song_played_map_(), audio_buffer_(), buffer_mutex_(),
-                           buffer_cv_(), play_next_cv_(), next_mutex_(), need_to_play_next_(false), force_stop_(false), buffer_size_(0), mp3_decoder_(nullptr), mp3_frame_info_(),
-                           mp3_decoder_initialized_(false)
+                           lyrics_mutex_(), current_lyric_index_(-1), lyric_timer_(nullptr),
+                           is_playing_(false), suspended_(false), suspend_mutex_(), suspend_cv_(), is_downloading_(false),
+                           play_thread_(), download_thread_(), play_next_(), play_queue_(), rings_(), active_ring_(nullptr), track_lengths_(), startup_mutex_(), startup_trace_(), startup_pending_(false), startup_first_byte_us_(0),
+                           track_cache_(), track_cache_ready_(false), track_cache_thread_(), resolve_cache_(),
+                           seek_mutex_(), seek_table_(),
+                           variant_switch_mutex_(), variant_switch_(), variant_switch_pending_(false),
+                           prefetch_mutex_(), prefetch_ring_(nullptr), prefetch_entry_(), prefetch_url_(), prefetch_resolving_(false), prefetch_events_(nullptr),
+                           last_pcm_output_us_(0), track_transition_pending_(false), last_track_gap_ms_(0), max_track_gap_ms_(0),
+                           total_track_gap_ms_(0), track_gap_count_(0),
+                           force_stop_(false), decoder_(), output_stage_(), prebuffer_(),
+                           token_mutex_(), track_token_(std::make_shared<WorkerPool::Token>()),
+                           request_token_(std::make_shared<WorkerPool::Token>()),
+                           workers_("music_worker", MUSIC_WORKER_COUNT, MUSIC_WORKER_STACK_SIZE, 4)
 {
     ESP_LOGI(TAG, "Music player initialized");
-    InitializeMp3Decoder();
-    std::thread(&Esp32Music::PlayNextDetect, this).detach();
+    // 环形缓冲区分配在PSRAM中并复用，每次开始播放前按剩余PSRAM调整大小
+    // 预取用的缓冲区先只分配最小容量，开始预取时再按需要扩大
+    size_t capacity = ChooseBufferCapacity();
+    rings_[0] = std::make_unique<AudioRingBuffer>(capacity, DECODE_PEEK_SIZE);
+    rings_[1] = std::make_unique<AudioRingBuffer>(MIN_BUFFER_SIZE, DECODE_PEEK_SIZE);
+    for (auto &ring : rings_)
+    {
+        if (!ring->valid())
+        {
+            ESP_LOGE(TAG, "Failed to allocate audio ring buffer");
+        }
+    }
+    active_ring_ = rings_[0].get();
+    prefetch_events_ = xEventGroupCreate();
+    if (prefetch_events_ == nullptr)
+    {
+        ESP_LOGE(TAG, "Failed to create prefetch event group");
+    }
+    esp_timer_create_args_t lyric_timer_args = {
+        .callback = [](void *arg)
+        {
+            static_cast<Esp32Music *>(arg)->OnLyricTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lyric_timer",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&lyric_timer_args, &lyric_timer_);
+    // 首次启动时格式化music分区需要数秒，不阻塞开机
+    // 写flash的线程栈必须在内部RAM中，不能放到任务池里
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.stack_size = 4096;
+    cfg.prio = 2;
+    cfg.thread_name = "music_cache";
+    esp_pthread_set_cfg(&cfg);
+    track_cache_thread_ = std::thread(&Esp32Music::InitializeTrackCache, this);
+    resolve_cache_.Load();
+    play_queue_.Load();
 }
 
 Esp32Music::~Esp32Music()
 {
     ESP_LOGI(TAG, "Destroying music player - stopping all operations");
 
-    // 停止所有操作
+    // 停止所有操作，排队中的任务不再执行
     is_downloading_ = false;
     is_playing_ = false;
+    {
+        std::lock_guard<std::mutex> lock(token_mutex_);
+        track_token_->Cancel();
+        request_token_->Cancel();
+    }
+
+    // 唤醒所有阻塞在环形缓冲区上的线程
+    AbortAudioBuffers();
 
-    // 通知所有等待的线程
+    if (track_cache_thread_.joinable())
     {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
+        track_cache_thread_.join();
     }
 
-    // 等待下载线程结束，设置5秒超时
+    std::lock_guard<std::mutex> lock(stream_mutex_);
     if (download_thread_.joinable())
     {
-        ESP_LOGI(TAG, "Waiting for download thread to finish (timeout: 5s)");
-        auto start_time = std::chrono::steady_clock::now();
-
-        // 等待线程结束
-        bool thread_finished = false;
-        while (!thread_finished)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                               std::chrono::steady_clock::now() - start_time)
-                               .count();
-
-            if (elapsed >= 5)
-            {
-                ESP_LOGW(TAG, "Download thread join timeout after 5 seconds");
-                break;
-            }
-
-            // 再次设置停止标志，确保线程能够检测到
-            is_downloading_ = false;
-
-            // 通知条件变量
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex_);
-                buffer_cv_.notify_all();
-            }
-
-            // 检查线程是否已经结束
-            if (!download_thread_.joinable())
-            {
-                thread_finished = true;
-            }
-
-            // 定期打印等待信息
-            if (elapsed > 0 && elapsed % 1 == 0)
-            {
-                ESP_LOGI(TAG, "Still waiting for download thread to finish... (%ds)", (int)elapsed);
-            }
-        }
-
-        if (download_thread_.joinable())
-        {
-            download_thread_.join();
-        }
+        ESP_LOGI(TAG, "Waiting for download thread to finish");
+        download_thread_.join();
         ESP_LOGI(TAG, "Download thread finished");
     }
 
-    // 等待播放线程结束，设置3秒超时
     if (play_thread_.joinable())
     {
-        ESP_LOGI(TAG, "Waiting for playback thread to finish (timeout: 3s)");
-        auto start_time = std::chrono::steady_clock::now();
-
-        bool thread_finished = false;
-        while (!thread_finished)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                               std::chrono::steady_clock::now() - start_time)
-                               .count();
-
-            if (elapsed >= 3)
-            {
-                ESP_LOGW(TAG, "Playback thread join timeout after 3 seconds");
-                break;
-            }
-
-            // 再次设置停止标志
-            is_playing_ = false;
-
-            // 通知条件变量
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex_);
-                buffer_cv_.notify_all();
-            }
-
-            // 检查线程是否已经结束
-            if (!play_thread_.joinable())
-            {
-                thread_finished = true;
-            }
-        }
-
-        if (play_thread_.joinable())
-        {
-            play_thread_.join();
-        }
+        ESP_LOGI(TAG, "Waiting for playback thread to finish");
+        play_thread_.join();
         ESP_LOGI(TAG, "Playback thread finished");
     }
 
-    // 清理缓冲区和MP3解码器
-    ClearAudioBuffer();
-    CleanupMp3Decoder();
-
-    ESP_LOGI(TAG, "Music player destroyed successfully");
-}
+    if (lyric_timer_ != nullptr)
+    {
+        esp_timer_stop(lyric_timer_);
+        esp_timer_delete(lyric_timer_);
+    }
 
-void Esp32Music::PlayNextDetect()
-{
-    while (true)
+    // 清理缓冲区，解码器随对象一起释放
+    ClearAudioBuffer();
+    if (prefetch_events_ != nullptr)
     {
-        std::unique_lock<std::mutex> lock(next_mutex_);
-        // 等待直到 need_to_play_next_ 为 true
-        play_next_cv_.wait(lock, [this]
-                           { return need_to_play_next_; });
-        need_to_play_next_ = false;
-        // 释放锁，允许其他线程修改 need_to_play_next_
-        lock.unlock();
-        playNextSong();
-        // 重新获取锁
-        lock.lock();
-        // 检查是否有新的播放请求
-        if (need_to_play_next_)
-        {
-            continue; // 如果有新的请求，直接跳过重置步骤
-        }
+        vEventGroupDelete(prefetch_events_);
     }
+
+    ESP_LOGI(TAG, "Music player destroyed successfully");
 }
 
 bool Esp32Music::Download(const std::string &song_name)
@@ -252,157 +224,391 @@ bool Esp32Music::Download(const std::string &song_name)
     // 清空之前的下载数据
     last_downloaded_data_.clear();
 
-    // 保存歌名用于后续显示
-    current_song_name_ = song_name;
-    // 第一步：请求stream_pcm接口获取音频信息
-    std::string full_url = "https://search.kuwo.cn/r.s?pn=0&rn=3&all=" + url_encode(song_name) + "&ft=music&newsearch=1&alflac=1&itemset=web_2013&client=kt&cluster=0&vermerge=1&rformat=json&encoding=utf8&show_copyright_off=1&pcmp4=1&ver=mbox&plat=pc&vipver=MUSIC_9.1.1.2_BCS2&devid=38668888&newver=1&issubtitle=1&pcjson=1";
-    ESP_LOGI(TAG, "Request URL: %s", full_url.c_str());
+    // 用户主动点歌不计入切歌间隔统计
+    track_transition_pending_ = false;
 
-    // 使用Board提供的HTTP客户端
-    auto http = Board::GetInstance().CreateHttp();
-    // 打开GET连接
-    if (!http->Open("GET", full_url))
+    // 记录各阶段耗时，第一帧PCM送出时汇总
+    StartupTrace trace = {};
+    trace.request_us = esp_timer_get_time();
+    startup_pending_ = false;
+
+    // 同名歌曲已经缓存过或者最近搜索过时跳过搜索接口
+    std::string songId;
+    std::string artistName;
+    ResolveCache::SongInfo song_info;
+    TrackCache *cache = GetTrackCache();
+    if (cache && cache->FindByName(song_name, songId, artistName))
+    {
+        ESP_LOGI(TAG, "Found cached song %s for: %s", songId.c_str(), song_name.c_str());
+    }
+    else if (resolve_cache_.LookupQuery(song_name, song_info))
+    {
+        ESP_LOGI(TAG, "Search result cached for: %s", song_name.c_str());
+        songId = song_info.song_id;
+        artistName = song_info.artist;
+    }
+    else if (SearchSong(song_name, songId, artistName))
+    {
+        resolve_cache_.PutQuery(song_name, {songId, artistName});
+    }
+    else
     {
-        ESP_LOGE(TAG, "Failed to connect to music API");
         return false;
     }
+    trace.search_done_us = esp_timer_get_time();
 
-    // 检查响应状态码
-    int status_code = http->GetStatusCode();
-    if (status_code != 200)
+    // 只保留解析出的关键信息作为下载结果
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "id", songId.c_str());
+    cJSON_AddStringToObject(result, "artist", artistName.c_str());
+    cJSON_AddStringToObject(result, "name", song_name.c_str());
+    char *result_json = cJSON_PrintUnformatted(result);
+    if (result_json != nullptr)
     {
-        ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
-        http->Close();
+        last_downloaded_data_ = result_json;
+        cJSON_free(result_json);
+    }
+    cJSON_Delete(result);
+
+    int variant = -1;
+    std::string play_url = ResolvePlayUrl(songId, variant);
+    resolve_cache_.LogStats();
+    if (play_url.empty())
+    {
+        ESP_LOGE(TAG, "Failed to get song play url");
         return false;
     }
+    trace.url_done_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "songUrl = %s", play_url.c_str());
+    ESP_LOGI(TAG, "Starting streaming playback for: %s", song_name.c_str());
 
-    // 读取响应数据
-    std::string body(30720, '\0');
-    int bytes_read = http->Read(body.data(), 30720);
-    ESP_LOGI(TAG, "HTTP GET Status = %d, content_length = %d", status_code, bytes_read);
-    http->Close();
-    if (bytes_read > 0)
+    // 拿到播放地址后才更新当前曲目，搜索或获取地址失败时正在播放的歌曲不受影响
     {
-        last_downloaded_data_ = body.substr(0, bytes_read);
-        // 解析响应JSON以提取音频URL
-        cJSON *response_json = cJSON_Parse(last_downloaded_data_.c_str());
-        if (!response_json)
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        // 点歌打断正在播放的曲目，不触发它的自动播放下一首
+        if (is_playing_)
         {
-            return false;
+            force_stop_ = true;
         }
-
-        // 获取abslist数组
-        cJSON *abslist = cJSON_GetObjectItem(response_json, "abslist");
-        if (!cJSON_IsArray(abslist) || cJSON_GetArraySize(abslist) == 0)
+        current_is_radio_ = false;
+        SetCurrentTrack({play_url, songId, song_name, artistName, variant});
         {
-            ESP_LOGE(TAG, "can not get song info from json!");
-            cJSON_Delete(response_json);
-            return false;
+            std::lock_guard<std::mutex> startup_lock(startup_mutex_);
+            startup_trace_ = trace;
+            startup_first_byte_us_ = 0;
+            startup_pending_ = true;
         }
-
-        // 获取第一个歌曲对象
-        cJSON *firstSong = cJSON_GetArrayItem(abslist, 0);
-        cJSON *targetId = cJSON_GetObjectItem(firstSong, "DC_TARGETID");
-        cJSON *artist = cJSON_GetObjectItem(firstSong, "ARTIST");
-        cJSON *songName = cJSON_GetObjectItem(firstSong, "SONGNAME");
-        if (!targetId || !targetId->valuestring)
+        if (!StartStreamingAt(play_url, 0, 0))
         {
-            ESP_LOGE(TAG, "未找到歌曲ID");
-            cJSON_Delete(response_json);
             return false;
         }
+    }
 
-        ESP_LOGI(TAG, "歌曲ID: %s", targetId->valuestring);
-        string songId = string(targetId->valuestring);
-        string artistName = string(artist->valuestring);
-        string songNameStr = string(songName->valuestring);
-        ESP_LOGI(TAG, "歌曲名称: %s", songNameStr.c_str());
-        string url = KwWork::getUrl(songId);
-        ESP_LOGI(TAG, "url = %s", url.c_str());
-        cJSON_Delete(response_json);
-        // 打开GET连接
-        current_music_url_ = this->getSongPlayUrl(url);
-        if (current_music_url_.empty())
-        {
-            ESP_LOGE(TAG, "Failed to get song play url");
-            return false;
-        }
-        ESP_LOGI(TAG, "songUrl = %s", current_music_url_.c_str());
-        ESP_LOGI(TAG, "Starting streaming playback for: %s", song_name.c_str());
-        StartStreaming(current_music_url_);
+    // 新歌开始播放后才换歌词和播放队列，它们只依赖歌曲ID，和首次缓冲并行进行
+    ESP_LOGI(TAG, "Loading lyrics for: %s", song_name.c_str());
+    LoadLyrics(songId);
+    // 上一次点歌还没完成的推荐歌单任务不再需要
+    auto request_token = RenewToken(request_token_);
+    PlayQueue::Entry current = {songId, song_name, artistName};
+    workers_.Submit([this, current, request_token]()
+                    { ParseRecommondSong(current, request_token); },
+                    request_token);
+    return true;
+}
 
-        // 处理歌词URL
-        if (!songId.empty())
-        {
-            current_lyric_url_ = "https://www.kuwo.cn/openapi/v1/www/lyric/getlyric?musicId=" + songId;
-            ESP_LOGI(TAG, "Loading lyrics for: %s", song_name.c_str());
-            current_lyric_index_ = -1;
-            lyrics_.clear();
-            std::thread(&Esp32Music::LyricDisplayThread, this).detach();
-            std::thread(&Esp32Music::ParseRecommondSong, this, artistName, songId).detach();
-        }
-        else
-        {
-            ESP_LOGW(TAG, "No lyric URL found for this song");
-        }
-        return true;
+// 通过搜索接口按歌名查找歌曲ID和歌手
+// 边接收边提取第一首歌的字段，拿到后立即断开，不缓存整个响应
+bool Esp32Music::SearchSong(const std::string &song_name, std::string &song_id, std::string &artist)
+{
+    // 第一步：请求stream_pcm接口获取音频信息
+    std::string full_url = "https://search.kuwo.cn/r.s?pn=0&rn=3&all=" + url_encode(song_name) + "&ft=music&newsearch=1&alflac=1&itemset=web_2013&client=kt&cluster=0&vermerge=1&rformat=json&encoding=utf8&show_copyright_off=1&pcmp4=1&ver=mbox&plat=pc&vipver=MUSIC_9.1.1.2_BCS2&devid=38668888&newver=1&issubtitle=1&pcjson=1";
+    ESP_LOGI(TAG, "Request URL: %s", full_url.c_str());
+
+    enum { kSongId, kArtist, kSongName };
+    std::string found_name;
+    bool has_artist = false;
+    JsonStreamExtractor extractor({"abslist[].DC_TARGETID", "abslist[].ARTIST", "abslist[].SONGNAME"},
+                                  [&](int field, int index, const std::string &value)
+                                  {
+                                      // 只需要第一首歌
+                                      if (index > 0)
+                                      {
+                                          return false;
+                                      }
+                                      switch (field)
+                                      {
+                                      case kSongId:
+                                          song_id = value;
+                                          break;
+                                      case kArtist:
+                                          artist = value;
+                                          has_artist = true;
+                                          break;
+                                      case kSongName:
+                                          found_name = value;
+                                          break;
+                                      }
+                                      return song_id.empty() || !has_artist || found_name.empty();
+                                  });
+    song_id.clear();
+    artist.clear();
+    if (!RequestStream(full_url, [&extractor](const char *data, size_t size)
+                       { return extractor.Feed(data, size); }))
+    {
+        ESP_LOGE(TAG, "Failed to connect to music API");
+        return false;
     }
-    else
+    if (song_id.empty())
     {
-        ESP_LOGE(TAG, "Empty response from music API");
+        ESP_LOGE(TAG, "未找到歌曲ID");
+        return false;
     }
 
-    return false;
+    ESP_LOGI(TAG, "歌曲ID: %s", song_id.c_str());
+    ESP_LOGI(TAG, "歌曲名称: %s", found_name.c_str());
+    return true;
+}
+
+// 查看播放队列中的下一首并获取它的播放地址，队列位置在真正开始播放时才移动
+bool Esp32Music::ResolveNextSong(PlayQueue::Entry &entry, std::string &play_url, int &variant)
+{
+    // 随机播放一轮结束时 PeekNext 会先确定下一轮顺序，预取的歌曲与之后 MoveToNext 的一致
+    if (!play_queue_.PeekNext(false, entry))
+    {
+        ESP_LOGI(TAG, "No more songs in the play queue");
+        return false;
+    }
+    ESP_LOGI(TAG, "歌曲ID: %s", entry.song_id.c_str());
+    play_url = ResolvePlayUrl(entry.song_id, variant);
+    if (play_url.empty())
+    {
+        ESP_LOGE(TAG, "Failed to get song play url");
+        return false;
+    }
+    ESP_LOGI(TAG, "songUrl = %s", play_url.c_str());
+    return true;
+}
+
+// 获取歌曲的播放地址：优先使用本地缓存，否则按当前下载速度选择码率档位
+std::string Esp32Music::ResolvePlayUrl(const std::string &song_id, int &variant)
+{
+    TrackCache *cache = GetTrackCache();
+    if (cache && cache->Contains(song_id))
+    {
+        // 缓存命中，直接从本地存储播放，不再获取播放地址
+        variant = -1;
+        return CACHE_URL_PREFIX + song_id;
+    }
+
+    variant = bitrate_.SelectForNewTrack(prebuffer_.throughput_kbps());
+    ESP_LOGI(TAG, "Selected %s for download speed %d kbps",
+             BitratePolicy::GetVariant(variant).br, prebuffer_.throughput_kbps());
+    return ResolveVariantUrl(song_id, variant);
+}
+
+// 获取指定码率档位的播放地址，最近获取过且未过期的地址直接复用
+std::string Esp32Music::ResolveVariantUrl(const std::string &song_id, int variant)
+{
+    const char *br = BitratePolicy::GetVariant(variant).br;
+    std::string cache_key = song_id + ":" + br;
+    std::string play_url;
+    if (resolve_cache_.LookupUrl(cache_key, play_url))
+    {
+        return play_url;
+    }
+
+    string url = KwWork::getUrl(song_id, br);
+    ESP_LOGI(TAG, "url = %s", url.c_str());
+    play_url = this->getSongPlayUrl(url);
+    if (!play_url.empty())
+    {
+        resolve_cache_.PutUrl(cache_key, play_url);
+    }
+    return play_url;
 }
 
+// 当前歌曲播完后自动播放队列中的下一首
 bool Esp32Music::playNextSong()
 {
-    bool next_song_found = false;
+    PlayQueue::Entry entry;
+    if (!play_queue_.PeekNext(false, entry))
+    {
+        ESP_LOGI(TAG, "No more songs in the play queue");
+        return false;
+    }
+    return PlayEntry(entry, [this, &entry]
+                     { return play_queue_.MoveToNext(false, entry.song_id); });
+}
+
+// 播放队列中查看到的歌曲：先获取播放地址，成功后由 move_to 移动队列位置再开始播放
+// 获取地址失败或期间队列已经变化时队列位置保持不变
+bool Esp32Music::PlayEntry(const PlayQueue::Entry &entry, const std::function<bool()> &move_to)
+{
+    int variant = -1;
+    std::string play_url = ResolvePlayUrl(entry.song_id, variant);
+    if (play_url.empty())
+    {
+        ESP_LOGE(TAG, "Failed to get song play url");
+        return false;
+    }
+    ESP_LOGI(TAG, "歌曲ID: %s, songUrl = %s", entry.song_id.c_str(), play_url.c_str());
     {
-        std::lock_guard<std::mutex> lock(next_mutex_);
-        for (const auto &elem : song_played_map_)
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        if (!move_to())
         {
-            if (elem.second == false)
-            {
-                play_next_ = elem.first;
-                break;
-            }
+            ESP_LOGW(TAG, "Play queue changed while resolving %s", entry.song_id.c_str());
+            return false;
         }
-        if (next_song_found)
+        // 用户切歌时当前曲目被打断，不触发自动播放下一首
+        if (is_playing_)
         {
-            ESP_LOGI(TAG, "LyricDisplayThread: play next song: %s", play_next_.c_str());
+            force_stop_ = true;
         }
-        // 打印song_played_map_
-        for (const auto &elem : song_played_map_)
+        current_is_radio_ = false;
+        SetCurrentTrack({play_url, entry.song_id, entry.name, entry.artist, variant});
+        if (!StartStreamingAt(play_url, 0, 0))
         {
-            ESP_LOGI(TAG, "song_played_map_ key: %s, value: %d", elem.first.c_str(), elem.second);
+            return false;
         }
     }
+    SaveQueue();
+    LoadLyrics(entry.song_id);
+    RequestPreResolve();
+    return true;
+}
 
-    if (play_next_.empty())
+// 用户切到下一首，单曲循环时也切换
+bool Esp32Music::NextSong()
+{
+    PlayQueue::Entry entry;
+    if (!play_queue_.PeekNext(true, entry))
     {
-        ESP_LOGE(TAG, "song_id is empty");
+        ESP_LOGW(TAG, "Next ignored: play queue is empty or finished");
         return false;
     }
-    ESP_LOGI(TAG, "歌曲ID: %s", play_next_.c_str());
-    string url = KwWork::getUrl(play_next_);
-    ESP_LOGI(TAG, "url = %s", url.c_str());
-    current_music_url_ = this->getSongPlayUrl(url);
-    if (current_music_url_.empty())
+    // 用户切歌不计入切歌间隔统计
+    track_transition_pending_ = false;
+    return PlayEntry(entry, [this, &entry]
+                     { return play_queue_.MoveToNext(true, entry.song_id); });
+}
+
+bool Esp32Music::PreviousSong()
+{
+    PlayQueue::Entry entry;
+    if (!play_queue_.PeekPrevious(entry))
     {
-        ESP_LOGE(TAG, "Failed to get song play url");
+        ESP_LOGW(TAG, "Previous ignored: no play history");
         return false;
     }
-    song_played_map_[play_next_] = true;
-    ESP_LOGI(TAG, "songUrl = %s", current_music_url_.c_str());
-    StartStreaming(current_music_url_);
-    current_lyric_url_ = "https://www.kuwo.cn/openapi/v1/www/lyric/getlyric?musicId=" + play_next_;
-    current_lyric_index_ = -1;
-    lyrics_.clear();
-    std::thread(&Esp32Music::LyricDisplayThread, this).detach();
+    track_transition_pending_ = false;
+    return PlayEntry(entry, [this, &entry]
+                     { return play_queue_.MoveToPrevious(entry.song_id); });
+}
+
+std::string Esp32Music::GetPlayQueue()
+{
+    return play_queue_.ToJson(10);
+}
+
+bool Esp32Music::SetPlayMode(const std::string &mode)
+{
+    PlayQueue::Mode play_mode = PlayQueue::ParseMode(mode);
+    if (play_mode == PlayQueue::kModeCount)
+    {
+        ESP_LOGW(TAG, "Unknown play mode: %s", mode.c_str());
+        return false;
+    }
+    play_queue_.SetMode(play_mode);
+    SaveQueue();
+    // 接下来的歌曲变了，已经预取的下一首在切换时仍然播放
+    RequestPreResolve();
     return true;
 }
 
+// 播放网络电台，和歌曲共用下载、解码和输出流程
+// 直播流没有结尾，不加载歌词，也不自动播放队列中的下一首
+bool Esp32Music::PlayRadio(const std::string &url, const std::string &name)
+{
+    if (url.rfind("http", 0) != 0)
+    {
+        ESP_LOGE(TAG, "Invalid radio URL: %s", url.c_str());
+        return false;
+    }
+    ESP_LOGI(TAG, "Playing radio %s: %s", name.c_str(), url.c_str());
+
+    // 上一首的歌词和自动切歌任务不再需要
+    RenewToken(track_token_);
+    {
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        lyrics_.reset();
+    }
+    current_lyric_index_ = -1;
+    track_transition_pending_ = false;
+    startup_pending_ = false;
+    last_downloaded_data_.clear();
+
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    if (is_playing_)
+    {
+        force_stop_ = true;
+    }
+    current_is_radio_ = true;
+    TrackSource source = {url};
+    source.song_name = name.empty() ? "网络电台" : name;
+    source.live = true;
+    SetCurrentTrack(source);
+    return StartStreamingAt(url, 0, 0);
+}
+
+// 在任务池中获取接下来几首的播放地址，已经排队的请求不重复提交
+void Esp32Music::RequestPreResolve()
+{
+    if (preresolve_pending_.exchange(true))
+    {
+        return;
+    }
+    workers_.Submit([this]()
+                    {
+                        preresolve_pending_ = false;
+                        PreResolveUpcoming();
+                    });
+}
+
+// 队列或当前位置变化后，按当前下载速度对应的码率档位获取接下来几首的播放地址
+// 地址放进ResolveCache，切歌和预取时直接命中；本地已缓存的歌曲不需要地址
+void Esp32Music::PreResolveUpcoming()
+{
+    int variant = bitrate_.PreviewForNewTrack(prebuffer_.throughput_kbps());
+    TrackCache *cache = GetTrackCache();
+    for (auto &entry : play_queue_.Upcoming(PRERESOLVE_COUNT))
+    {
+        if (cache && cache->Contains(entry.song_id))
+        {
+            continue;
+        }
+        if (ResolveVariantUrl(entry.song_id, variant).empty())
+        {
+            ESP_LOGW(TAG, "Failed to pre-resolve song %s", entry.song_id.c_str());
+        }
+    }
+}
+
+// 任务池的任务栈在PSRAM中，不能写NVS，队列交给主循环保存
+void Esp32Music::SaveQueue()
+{
+    Application::GetInstance().Schedule([this]()
+                                        { play_queue_.Save(); });
+}
+
+// 取消旧的标记并换成新的，用旧标记提交的任务不再执行
+WorkerPool::TokenPtr Esp32Music::RenewToken(WorkerPool::TokenPtr &token)
+{
+    std::lock_guard<std::mutex> lock(token_mutex_);
+    token->Cancel();
+    token = std::make_shared<WorkerPool::Token>();
+    return token;
+}
+
 std::string Esp32Music::getSongPlayUrl(const std::string &req)
 {
     auto http = Board::GetInstance().CreateHttp();
@@ -456,6 +662,7 @@ std::string Esp32Music::getSongPlayUrl(const std::string &req)
 
 bool Esp32Music::Play()
 {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
     if (is_playing_.load())
     { // 使用atomic的load()
         ESP_LOGW(TAG, "Music is already playing");
@@ -468,18 +675,13 @@ bool Esp32Music::Play()
         return false;
     }
 
-    // 清理之前的播放线程
-    if (play_thread_.joinable())
-    {
-        play_thread_.join();
-    }
-
-    // 实际应调用流式播放接口
-    return StartStreaming(current_music_url_);
+    // 实际应调用流式播放接口，之前的线程在其中结束
+    return StartStreamingAt(CurrentTrack().url, 0, 0);
 }
 
 bool Esp32Music::Stop()
 {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
     if (!is_playing_ && !is_downloading_)
     {
         ESP_LOGW(TAG, "Music is not playing or downloading");
@@ -488,18 +690,14 @@ bool Esp32Music::Stop()
 
     ESP_LOGI(TAG, "Stopping music playback and download");
 
-    // 停止下载和播放
+    // 停止下载和播放，被停止的曲目不触发自动播放下一首
     is_downloading_ = false;
     is_playing_ = false;
+    force_stop_ = true;
+    startup_pending_ = false;
 
-    // 重置采样率到原始值
-    ResetSampleRate();
-
-    // 通知所有等待的线程
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    // 唤醒所有等待的线程
+    AbortAudioBuffers();
 
     // 等待线程结束
     if (download_thread_.joinable())
@@ -525,6 +723,13 @@ std::string Esp32Music::GetDownloadResult()
 
 // 开始流式播放
 bool Esp32Music::StartStreaming(const std::string &music_url)
+{
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    return StartStreamingAt(music_url, 0, 0);
+}
+
+// 从指定的文件偏移开始流式播放，start_ms为该偏移对应的播放时间
+bool Esp32Music::StartStreamingAt(const std::string &music_url, size_t start_offset, int64_t start_ms)
 {
     if (music_url.empty())
     {
@@ -532,32 +737,49 @@ bool Esp32Music::StartStreaming(const std::string &music_url)
         return false;
     }
 
-    ESP_LOGD(TAG, "Starting streaming for URL: %s", music_url.c_str());
+    ESP_LOGD(TAG, "Starting streaming for URL: %s, offset: %u", music_url.c_str(), (unsigned int)start_offset);
 
     // 停止之前的播放和下载
     is_downloading_ = false;
     is_playing_ = false;
 
     // 等待之前的线程完全结束
+    AbortAudioBuffers(); // 通知线程退出
     if (download_thread_.joinable())
     {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all(); // 通知线程退出
-        }
         download_thread_.join();
     }
     if (play_thread_.joinable())
     {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all(); // 通知线程退出
-        }
         play_thread_.join();
     }
+    // 旧的播放线程已经退出，打断标记只对它有效，新的曲目播完后照常播放下一首
+    force_stop_ = false;
+
+    // 从头播放时上一首的跳转索引不再有效，播放线程从第一帧重新建立
+    if (start_offset == 0)
+    {
+        std::lock_guard<std::mutex> lock(seek_mutex_);
+        seek_table_.Reset();
+    }
 
-    // 清空缓冲区
+    // 清空缓冲区，混音器里旧位置的数据也不再播放
+    ResizeAudioBuffers();
     ClearAudioBuffer();
+    Application::GetInstance().ClearAudioData();
+    if (!active_ring_.load()->valid() || prefetch_events_ == nullptr)
+    {
+        // 没有PSRAM或内存不足时无法播放，不启动下载和播放线程
+        ESP_LOGE(TAG, "Audio ring buffer not available, cannot start streaming");
+        startup_pending_ = false;
+        return false;
+    }
+
+    if (startup_pending_)
+    {
+        std::lock_guard<std::mutex> lock(startup_mutex_);
+        startup_trace_.stream_started_us = esp_timer_get_time();
+    }
 
     // 配置线程栈大小以避免栈溢出
     esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
@@ -568,25 +790,51 @@ bool Esp32Music::StartStreaming(const std::string &music_url)
 
     // 开始下载线程
     is_downloading_ = true;
-    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, music_url);
+    TrackSource source = CurrentTrack();
+    if (source.url != music_url)
+    {
+        source = {music_url};
+    }
+    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, source, start_offset);
 
     // 开始播放线程（会等待缓冲区有足够数据）
+    // 本地缓存的数据几乎立即可用，只需很少的预缓冲
+    bool from_cache = music_url.rfind(CACHE_URL_PREFIX, 0) == 0;
     is_playing_ = true;
-    play_thread_ = std::thread(&Esp32Music::PlayAudioStream, this);
+    play_thread_ = std::thread(&Esp32Music::PlayAudioStream, this, start_offset, start_ms, from_cache);
 
     ESP_LOGI(TAG, "Streaming threads started successfully");
     return true;
 }
 
+// 复制当前曲目的信息，交给下载线程或用于重新开始播放
+Esp32Music::TrackSource Esp32Music::CurrentTrack()
+{
+    std::lock_guard<std::mutex> lock(track_mutex_);
+    TrackSource source = {current_music_url_, current_song_id_, current_song_name_, current_artist_, current_variant_};
+    source.live = current_is_radio_;
+    return source;
+}
+
+// 换成新的曲目，歌名在播放线程下一次循环时显示
+void Esp32Music::SetCurrentTrack(const TrackSource &source)
+{
+    std::lock_guard<std::mutex> lock(track_mutex_);
+    current_music_url_ = source.url;
+    current_song_id_ = source.song_id;
+    current_song_name_ = source.song_name;
+    current_artist_ = source.artist;
+    current_variant_ = source.variant;
+    song_name_displayed_ = false;
+}
+
 // 停止流式播放
 bool Esp32Music::StopStreaming()
 {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
     ESP_LOGI(TAG, "Stopping music streaming - current state: downloading=%d, playing=%d",
              is_downloading_.load(), is_playing_.load());
 
-    // 重置采样率到原始值
-    ResetSampleRate();
-
     // 检查是否有流式播放正在进行
     if (!is_playing_ && !is_downloading_)
     {
@@ -598,6 +846,7 @@ bool Esp32Music::StopStreaming()
     is_downloading_ = false;
     is_playing_ = false;
     force_stop_ = true;
+    startup_pending_ = false;
 
     // 清空歌名显示
     auto &board = Board::GetInstance();
@@ -608,177 +857,719 @@ bool Esp32Music::StopStreaming()
         ESP_LOGI(TAG, "Cleared song name display");
     }
 
-    // 通知所有等待的线程
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    // 通知所有等待的线程，丢弃混音器里还没播放的音乐
+    AbortAudioBuffers();
+    Application::GetInstance().ClearAudioData();
 
     ESP_LOGI(TAG, "Music streaming stop signal sent");
     return true;
 }
 
-// 流式下载音频数据
-void Esp32Music::DownloadAudioStream(const std::string &music_url)
+// 跳转到当前歌曲的指定位置
+// 通过跳转索引算出文件偏移，从该偏移重新发起Range请求，解码器从新位置重新同步
+bool Esp32Music::Seek(int64_t position_ms)
 {
-    ESP_LOGD(TAG, "Starting audio stream download from: %s", music_url.c_str());
-
-    // 验证URL有效性
-    if (music_url.empty() || music_url.find("http") != 0)
+    std::lock_guard<std::mutex> stream_lock(stream_mutex_);
+    if (!is_playing_)
     {
-        ESP_LOGE(TAG, "Invalid URL format: %s", music_url.c_str());
-        is_downloading_ = false;
-        return;
+        ESP_LOGW(TAG, "Seek ignored: no music playing");
+        return false;
+    }
+    if (current_is_radio_)
+    {
+        ESP_LOGW(TAG, "Seek ignored: radio stream");
+        return false;
     }
 
-    auto http = Board::GetInstance().CreateHttp();
+    size_t offset = 0;
+    int64_t actual_ms = 0;
+    {
+        std::lock_guard<std::mutex> lock(seek_mutex_);
+        if (!seek_table_.Lookup(position_ms, offset, actual_ms))
+        {
+            ESP_LOGW(TAG, "Seek ignored: current song has no seek index");
+            return false;
+        }
+    }
+    ESP_LOGI(TAG, "Seeking to %lldms (byte offset %u)", actual_ms, (unsigned int)offset);
 
-    // 设置请求头
-    http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
-    http->SetHeader("Accept", "*/*");
-    http->SetHeader("Range", "bytes=0-"); // 支持断点续传
+    // 当前曲目被打断，不触发自动播放下一首
+    force_stop_ = true;
+    current_lyric_index_ = -1;
+    return StartStreamingAt(CurrentTrack().url, offset, actual_ms);
+}
 
-    if (!http->Open("GET", music_url))
+// 暂停播放，下载线程继续下载直到缓冲区写满，连接断开后按已下载的偏移用Range续传
+// 混音器里还没播放的音乐保留下来，恢复时立即从暂停处出声
+void Esp32Music::Suspend()
+{
+    if (suspended_.exchange(true))
     {
-        ESP_LOGE(TAG, "Failed to connect to music stream URL");
-        is_downloading_ = false;
         return;
     }
+    ESP_LOGI(TAG, "Music suspended at %lldms", GetPlaybackPositionMs());
+    Application::GetInstance().PauseAudioData(true);
+    // 暂停期间的时间不计入切歌间隔
+    track_transition_pending_ = false;
+    esp_timer_stop(lyric_timer_);
+}
 
-    int status_code = http->GetStatusCode();
-    if (status_code != 200 && status_code != 206)
-    { // 206 for partial content
-        ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
-        http->Close();
+void Esp32Music::Resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(suspend_mutex_);
+        if (!suspended_)
+        {
+            return;
+        }
+        suspended_ = false;
+        suspend_cv_.notify_all();
+    }
+    Application::GetInstance().PauseAudioData(false);
+    if (is_playing_)
+    {
+        ESP_LOGI(TAG, "Music resumed at %lldms", GetPlaybackPositionMs());
+        ScheduleLyricUpdate(0);
+    }
+}
+
+// 流式下载音频数据
+// 当前曲目下载完成后，在另一个缓冲区里预取推荐列表中的下一首，
+// 播放线程读完当前缓冲区后直接切换过去，曲目之间不再需要重新建立连接和缓冲
+void Esp32Music::DownloadAudioStream(TrackSource source, size_t start_offset)
+{
+    AudioRingBuffer *ring = active_ring_.load();
+    if (!ring->valid())
+    {
+        ring->SetEndOfStream();
         is_downloading_ = false;
         return;
     }
+    prefetch_resolving_ = true;
 
-    ESP_LOGI(TAG, "Started downloading audio stream, status: %d", status_code);
+    if (source.live)
+    {
+        // 电台直播流一直播放到用户停止，没有下一首需要预取
+        StreamRadio(source, ring);
+    }
 
-    // 分块读取音频数据
-    const size_t chunk_size = 4096; // 4KB每块
-    char buffer[chunk_size];
-    size_t total_downloaded = 0;
+    while (!source.live && is_downloading_ && is_playing_)
+    {
+        if (!DownloadTrack(source, ring, start_offset))
+        {
+            break;
+        }
+        start_offset = 0;
+
+        // 另一个缓冲区可能还在播放上一首，等播放线程切换到本曲后才能复用
+        while (is_downloading_ && is_playing_ && active_ring_.load() != ring)
+        {
+            xEventGroupWaitBits(prefetch_events_, PREFETCH_SWITCHED_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+        }
+        if (!is_downloading_ || !is_playing_)
+        {
+            break;
+        }
+
+        PlayQueue::Entry next_entry;
+        std::string next_url;
+        int next_variant = -1;
+        if (!ResolveNextSong(next_entry, next_url, next_variant))
+        {
+            break;
+        }
+
+        AudioRingBuffer *next_ring = (ring == rings_[0].get()) ? rings_[1].get() : rings_[0].get();
+        if (!next_ring->valid())
+        {
+            // 第二个缓冲区分配失败时不预取，本曲播完后由任务池开始下一首
+            ESP_LOGW(TAG, "Prefetch buffer not available");
+            break;
+        }
+        // 按下一首的预缓冲需要调整容量，上一首用过的大缓冲区在这里缩小，不再同时占用两份
+        size_t prefetch_capacity = ChoosePrefetchCapacity(next_variant);
+        if (next_ring->capacity() != prefetch_capacity && !next_ring->Resize(prefetch_capacity))
+        {
+            ESP_LOGW(TAG, "Failed to resize prefetch buffer to %u bytes, keeping %u",
+                     (unsigned int)prefetch_capacity, (unsigned int)next_ring->capacity());
+        }
+        next_ring->Reset();
+        track_lengths_[RingIndex(next_ring)] = 0;
+        if (!is_downloading_ || !is_playing_)
+        {
+            // Reset会清除停止时设置的Abort标记，这里补上，避免播放线程卡在等待中
+            next_ring->Abort();
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex_);
+            prefetch_ring_ = next_ring;
+            prefetch_entry_ = next_entry;
+            prefetch_url_ = next_url;
+            prefetch_variant_ = next_variant;
+        }
+        xEventGroupSetBits(prefetch_events_, PREFETCH_READY_EVENT);
+        ESP_LOGI(TAG, "Prefetching next song: %s (%u bytes buffer)", next_entry.song_id.c_str(),
+                 (unsigned int)next_ring->capacity());
+        ring = next_ring;
+        source = {next_url, next_entry.song_id, next_entry.name, next_entry.artist};
+        source.variant = next_variant;
+    }
+
+    prefetch_resolving_ = false;
+    // 播放线程可能正在等待预取结果，通知它不会再有下一首
+    xEventGroupSetBits(prefetch_events_, PREFETCH_READY_EVENT);
+    is_downloading_ = false;
+    ESP_LOGI(TAG, "Audio stream download thread finished");
+}
 
+// 从本地缓存读取歌曲写入环形缓冲区，完整读完后校验CRC
+bool Esp32Music::StreamFromCache(const std::string &song_id, AudioRingBuffer *ring, size_t start_offset)
+{
+    TrackCache *cache = GetTrackCache();
+    auto reader = cache ? cache->OpenReader(song_id, start_offset) : nullptr;
+    if (!reader)
+    {
+        ESP_LOGE(TAG, "Cached song %s is not available", song_id.c_str());
+        ring->SetEndOfStream();
+        return false;
+    }
+    track_lengths_[RingIndex(ring)] = reader->size();
+    ESP_LOGI(TAG, "Playing song %s from cache, offset: %u", song_id.c_str(), (unsigned int)start_offset);
+
+    const size_t chunk_size = 4096;
+    size_t total_read = start_offset;
     while (is_downloading_ && is_playing_)
     {
-        int bytes_read = http->Read(buffer, chunk_size);
-        if (bytes_read < 0)
+        uint8_t *write_ptr = nullptr;
+        size_t span = ring->GetWriteSpan(&write_ptr);
+        if (span == 0)
         {
-            ESP_LOGE(TAG, "Failed to read audio data: error code %d", bytes_read);
-            break;
+            ring->WaitForSpace(chunk_size, pdMS_TO_TICKS(100));
+            continue;
         }
+        size_t bytes_read = reader->Read(write_ptr, std::min(span, chunk_size));
         if (bytes_read == 0)
         {
-            ESP_LOGI(TAG, "Audio stream download completed, total: %d bytes", total_downloaded);
             break;
         }
+        ring->CommitWrite(bytes_read);
+        if (startup_pending_ && startup_first_byte_us_ == 0)
+        {
+            startup_first_byte_us_ = esp_timer_get_time();
+        }
+        total_read += bytes_read;
+    }
+    if (total_read == reader->size())
+    {
+        reader->Verify();
+    }
+
+    ring->SetEndOfStream();
+    return total_read > start_offset;
+}
+
+// 挂载music分区作为歌曲缓存，分区不存在时不启用缓存
+void Esp32Music::InitializeTrackCache()
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = "/music",
+        .partition_label = "music",
+        .max_files = 4,
+        .format_if_mount_failed = true,
+    };
+    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Music cache partition not available: %s", esp_err_to_name(ret));
+        return;
+    }
 
-        // 打印数据块信息
-        // ESP_LOGI(TAG, "Downloaded chunk: %d bytes at offset %d", bytes_read, total_downloaded);
+    size_t total = 0, used = 0;
+    esp_spiffs_info(conf.partition_label, &total, &used);
+    // SPIFFS写满时性能急剧下降，只使用四分之三的空间
+    track_cache_ = std::make_unique<TrackCache>(std::make_unique<StdioTrackStorage>(conf.base_path), total / 4 * 3);
+    track_cache_->Load();
+    track_cache_ready_ = true;
+}
 
-        // 安全地打印数据块的十六进制内容（前16字节）
-        if (bytes_read >= 16)
+// 歌曲缓存还没加载完成时按没有缓存处理
+TrackCache *Esp32Music::GetTrackCache()
+{
+    return track_cache_ready_ ? track_cache_.get() : nullptr;
+}
+
+// 音乐文件的下载连接，停止播放时放弃丢弃数据
+RangeReader Esp32Music::CreateRangeReader()
+{
+    return RangeReader([]()
+                       { return Board::GetInstance().CreateHttp(); },
+                       [this]()
+                       { return is_downloading_ && is_playing_; });
+}
+
+// 读取文件中从offset开始的一小段数据，返回实际读到的长度
+size_t Esp32Music::ReadRange(const std::string &url, size_t offset, uint8_t *data, size_t size, size_t &file_length)
+{
+    RangeReader reader = CreateRangeReader();
+    if (!reader.Open(url, offset))
+    {
+        return 0;
+    }
+    size_t total = 0;
+    while (total < size)
+    {
+        int bytes_read = reader.Read((char *)data + total, size - total);
+        if (bytes_read <= 0)
         {
-            // ESP_LOGI(TAG, "Data: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X ...",
-            //         (unsigned char)buffer[0], (unsigned char)buffer[1], (unsigned char)buffer[2], (unsigned char)buffer[3],
-            //         (unsigned char)buffer[4], (unsigned char)buffer[5], (unsigned char)buffer[6], (unsigned char)buffer[7],
-            //         (unsigned char)buffer[8], (unsigned char)buffer[9], (unsigned char)buffer[10], (unsigned char)buffer[11],
-            //         (unsigned char)buffer[12], (unsigned char)buffer[13], (unsigned char)buffer[14], (unsigned char)buffer[15]);
+            break;
         }
-        else
+        total += bytes_read;
+    }
+    file_length = reader.content_length();
+    return total;
+}
+
+// 读取另一个码率档位文件的帧头建立它自己的跳转索引，ID3标签长度和帧长度都和当前文件不同
+// frame_offset 返回 position_ms 附近第一个帧头在新文件中的偏移
+bool Esp32Music::PrepareVariantSwitch(const std::string &url, int64_t position_ms, Mp3SeekTable &table, size_t &frame_offset)
+{
+    std::vector<uint8_t> buffer(DECODE_PEEK_SIZE);
+    size_t file_length = 0;
+    size_t size = ReadRange(url, 0, buffer.data(), buffer.size(), file_length);
+    size_t audio_start = GetId3TagSize(buffer.data(), size);
+    if (audio_start > 0)
+    {
+        size = ReadRange(url, audio_start, buffer.data(), buffer.size(), file_length);
+    }
+    int sync = Mp3SeekTable::FindSync(buffer.data(), size);
+    if (sync < 0 || !table.Parse(buffer.data() + sync, size - sync, audio_start + sync, file_length))
+    {
+        return false;
+    }
+
+    // 索引给出的偏移不一定在帧头上，读一小段找到下一个帧头
+    size_t offset = 0;
+    int64_t actual_ms = 0;
+    if (!table.Lookup(position_ms, offset, actual_ms))
+    {
+        return false;
+    }
+    size = ReadRange(url, offset, buffer.data(), buffer.size(), file_length);
+    sync = Mp3SeekTable::FindSync(buffer.data(), size);
+    if (sync < 0)
+    {
+        return false;
+    }
+    frame_offset = offset + sync;
+    return true;
+}
+
+// 播放线程读到下载线程记录的切换点后，换用新文件的偏移、跳转索引和播放地址
+// 之后的跳转和播放位置都按新文件计算
+bool Esp32Music::ApplyVariantSwitch(AudioRingBuffer *ring, size_t &stream_offset)
+{
+    std::lock_guard<std::mutex> lock(variant_switch_mutex_);
+    if (!variant_switch_pending_ || variant_switch_.ring != ring || stream_offset < variant_switch_.switch_at)
+    {
+        return false;
+    }
+    stream_offset = variant_switch_.new_offset + (stream_offset - variant_switch_.switch_at);
+    {
+        std::lock_guard<std::mutex> seek_lock(seek_mutex_);
+        seek_table_ = variant_switch_.table;
+    }
+    {
+        // 只换地址和码率档位，歌名不变，不需要重新显示
+        std::lock_guard<std::mutex> track_lock(track_mutex_);
+        current_music_url_ = variant_switch_.url;
+        current_variant_ = variant_switch_.variant;
+    }
+    ESP_LOGI(TAG, "Now playing %s at offset %u", BitratePolicy::GetVariant(variant_switch_.variant).br,
+             (unsigned int)stream_offset);
+    variant_switch_ = {};
+    variant_switch_pending_ = false;
+    return true;
+}
+
+// 按指数退避等待下一次重连，期间停止播放会立即返回false
+bool Esp32Music::WaitForRetry(int attempt)
+{
+    int delay_ms = std::min(DOWNLOAD_RETRY_BASE_MS << (attempt - 1), DOWNLOAD_RETRY_MAX_MS);
+    ESP_LOGW(TAG, "Reconnecting in %dms (attempt %d/%d)", delay_ms, attempt, DOWNLOAD_MAX_RETRIES);
+    for (int waited = 0; waited < delay_ms; waited += 100)
+    {
+        if (!is_downloading_ || !is_playing_)
         {
-            ESP_LOGI(TAG, "Data chunk too small: %d bytes", bytes_read);
+            return false;
         }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return is_downloading_ && is_playing_;
+}
+
+// 连接电台，请求服务器在音频中插入ICY元数据
+// 直播流没有文件长度，也不支持Range，重连后从服务器当前的位置继续
+Http *Esp32Music::OpenRadioStream(const std::string &url, size_t &metaint, std::string &station)
+{
+    auto http = Board::GetInstance().CreateHttp();
+    http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+    http->SetHeader("Accept", "*/*");
+    http->SetHeader("Icy-MetaData", "1");
+
+    if (!http->Open("GET", url))
+    {
+        ESP_LOGE(TAG, "Failed to connect to radio stream");
+        delete http;
+        return nullptr;
+    }
+    int status_code = http->GetStatusCode();
+    if (status_code != 200)
+    {
+        ESP_LOGE(TAG, "Radio stream failed with status code: %d", status_code);
+        http->Close();
+        delete http;
+        return nullptr;
+    }
+
+    metaint = strtoul(http->GetResponseHeader("icy-metaint").c_str(), nullptr, 10);
+    station = http->GetResponseHeader("icy-name");
+    ESP_LOGI(TAG, "Radio stream connected: %s, metaint: %u, content-type: %s", station.c_str(),
+             (unsigned int)metaint, http->GetResponseHeader("Content-Type").c_str());
+    return http;
+}
 
-        // 尝试检测文件格式（检查文件头）
-        if (total_downloaded == 0 && bytes_read >= 4)
+// 持续接收电台直播流写入环形缓冲区，元数据在写入前就地去掉，解码器只看到连续的音频
+// 连接断开后重连，只要重连后收到了数据就重新计数，网络短暂中断不会停止播放
+void Esp32Music::StreamRadio(const TrackSource &source, AudioRingBuffer *ring)
+{
+    const size_t chunk_size = 4096;
+    track_lengths_[RingIndex(ring)] = 0;
+    IcyMetadataParser icy;
+    Http *http = nullptr;
+    int retry_count = 0;
+    size_t total_downloaded = 0;
+    // 歌名显示之前收到的标题先保留，避免被播放线程显示的电台名覆盖
+    std::string pending_title;
+
+    while (is_downloading_ && is_playing_)
+    {
+        if (http == nullptr)
         {
-            if (memcmp(buffer, "ID3", 3) == 0)
+            size_t metaint = 0;
+            std::string station;
+            http = OpenRadioStream(source.url, metaint, station);
+            if (http == nullptr)
             {
-                ESP_LOGI(TAG, "Detected MP3 file with ID3 tag");
+                if (++retry_count > DOWNLOAD_MAX_RETRIES || !WaitForRetry(retry_count))
+                {
+                    break;
+                }
+                continue;
             }
-            else if (buffer[0] == 0xFF && (buffer[1] & 0xE0) == 0xE0)
+            icy.Reset(metaint);
+        }
+
+        uint8_t *write_ptr = nullptr;
+        size_t span = ring->GetWriteSpan(&write_ptr);
+        if (span == 0)
+        {
+            // 缓冲区已满，等待播放线程消费
+            ring->WaitForSpace(chunk_size, pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        int64_t read_start_us = esp_timer_get_time();
+        int bytes_read = http->Read((char *)write_ptr, std::min(span, chunk_size));
+        if (bytes_read <= 0)
+        {
+            // 直播流不会正常结束，读到结尾也按断线处理
+            ESP_LOGW(TAG, "Radio stream interrupted after %u bytes: %d", (unsigned int)total_downloaded, bytes_read);
+            http->Close();
+            delete http;
+            http = nullptr;
+            if (++retry_count > DOWNLOAD_MAX_RETRIES || !WaitForRetry(retry_count))
             {
-                ESP_LOGI(TAG, "Detected MP3 file header");
+                break;
             }
-            else if (memcmp(buffer, "RIFF", 4) == 0)
+            continue;
+        }
+        prebuffer_.AddDownloadSample(bytes_read, esp_timer_get_time() - read_start_us);
+        retry_count = 0;
+
+        size_t audio_bytes = icy.Feed(write_ptr, bytes_read);
+        ring->CommitWrite(audio_bytes);
+        size_t previous_total = total_downloaded;
+        total_downloaded += audio_bytes;
+        if (previous_total / (1024 * 1024) != total_downloaded / (1024 * 1024))
+        {
+            ESP_LOGI(TAG, "Radio received %u bytes, buffer size: %u", (unsigned int)total_downloaded,
+                     (unsigned int)ring->Size());
+        }
+
+        std::string title;
+        if (icy.TakeTitle(title))
+        {
+            ESP_LOGI(TAG, "Radio title: %s", title.c_str());
+            pending_title = title;
+        }
+        if (!pending_title.empty() && song_name_displayed_)
+        {
+            auto display = Board::GetInstance().GetDisplay();
+            if (display)
             {
-                ESP_LOGI(TAG, "Detected WAV file");
+                std::string formatted_title = source.song_name + "：《" + pending_title + "》";
+                display->SetMusicInfo(formatted_title.c_str());
             }
-            else if (memcmp(buffer, "fLaC", 4) == 0)
+            pending_title.clear();
+        }
+    }
+
+    if (http != nullptr)
+    {
+        http->Close();
+        delete http;
+    }
+    if (retry_count > DOWNLOAD_MAX_RETRIES)
+    {
+        ESP_LOGE(TAG, "Radio stream lost after %d reconnect attempts", DOWNLOAD_MAX_RETRIES);
+    }
+    ring->SetEndOfStream();
+}
+
+// 下载单首歌曲到指定的环形缓冲区，返回是否下载到了数据
+// 连接中断时记录已下载的字节数，用Range从断点重连，继续写入同一个缓冲区，解码器看不到中断
+// 完整下载的歌曲同时写入本地缓存，下次播放时不再需要网络
+bool Esp32Music::DownloadTrack(const TrackSource &source, AudioRingBuffer *ring, size_t start_offset)
+{
+    std::string music_url = source.url;
+    ESP_LOGD(TAG, "Starting audio stream download from: %s", music_url.c_str());
+
+    if (music_url.rfind(CACHE_URL_PREFIX, 0) == 0)
+    {
+        return StreamFromCache(music_url.substr(strlen(CACHE_URL_PREFIX)), ring, start_offset);
+    }
+
+    // 验证URL有效性
+    if (music_url.empty() || music_url.find("http") != 0)
+    {
+        ESP_LOGE(TAG, "Invalid URL format: %s", music_url.c_str());
+        ring->SetEndOfStream();
+        return false;
+    }
+
+    // 分块读取音频数据，直接写入环形缓冲区，不再为每块单独分配内存
+    const size_t chunk_size = 4096; // 每次最多读取4KB
+    size_t total_downloaded = start_offset;
+    int retry_count = 0;
+    RangeReader reader = CreateRangeReader();
+    std::unique_ptr<TrackCache::Writer> cache_writer;
+    // 播放中降档时换成另一个文件，记录写入缓冲区的总量判断是否下载到了数据
+    size_t bytes_written = 0;
+    int variant = source.variant;
+    // 正在下载的文件的跳转索引，用于把切换点换算成播放时间
+    // 从中间开始下载时就是当前曲目，沿用播放线程建立的索引
+    Mp3SeekTable table;
+    size_t audio_start = 0;  // ID3标签之后音频数据的偏移，没有索引时用来按标称码率换算
+    if (start_offset > 0)
+    {
+        std::lock_guard<std::mutex> lock(seek_mutex_);
+        table = seek_table_;
+        audio_start = table.audio_start();
+    }
+    int64_t next_variant_check_us = 0;
+    // 决定降档后先把当前这一帧下载完整，在帧边界切换
+    int switch_variant = -1;
+    std::string switch_url;
+    size_t switch_remaining = 0;
+    bool reached_end = false;  // 服务器回复416，没有剩余数据但本曲已经完整
+    bitrate_.ResetMidTrack();
+
+    while (is_downloading_ && is_playing_)
+    {
+        if (!reader.is_open())
+        {
+            if (!reader.Open(music_url, total_downloaded))
             {
-                ESP_LOGI(TAG, "Detected FLAC file");
+                int status_code = reader.status_code();
+                if (status_code == 416 && total_downloaded > 0)
+                {
+                    // Range起点已经在文件末尾（跳转到结尾或续传时刚好下载完），地址仍然有效，按下载完成处理
+                    ESP_LOGI(TAG, "Range starts at the end of the file, %u bytes", (unsigned int)total_downloaded);
+                    reached_end = true;
+                    break;
+                }
+                // 4xx说明地址失效或请求本身有问题，重试也没有意义
+                bool retryable = status_code < 400 || status_code >= 500;
+                if (!retryable && !source.song_id.empty() && variant >= 0)
+                {
+                    // 播放地址已失效，下次重新获取
+                    resolve_cache_.InvalidateUrl(source.song_id + ":" + BitratePolicy::GetVariant(variant).br);
+                }
+                if (!retryable || ++retry_count > DOWNLOAD_MAX_RETRIES || !WaitForRetry(retry_count))
+                {
+                    break;
+                }
+                continue;
             }
-            else if (memcmp(buffer, "OggS", 4) == 0)
+            track_lengths_[RingIndex(ring)] = reader.content_length();
+            // 从头开始的完整下载才写入缓存，文件长度未知时无法确认完整性，不缓存
+            TrackCache *cache = GetTrackCache();
+            if (cache && !source.song_id.empty() && start_offset == 0 && total_downloaded == 0 && !cache_writer)
             {
-                ESP_LOGI(TAG, "Detected OGG file");
+                cache_writer = cache->OpenWriter(source.song_id, reader.content_length(), source.song_name, source.artist);
             }
-            else
+        }
+
+        uint8_t *write_ptr = nullptr;
+        size_t span = ring->GetWriteSpan(&write_ptr);
+        if (span == 0)
+        {
+            // 缓冲区已满，等待播放线程消费
+            ring->WaitForSpace(chunk_size, pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        int64_t read_start_us = esp_timer_get_time();
+        size_t read_size = std::min(span, chunk_size);
+        if (switch_variant >= 0)
+        {
+            read_size = std::min(read_size, switch_remaining);
+        }
+        int bytes_read = reader.Read((char *)write_ptr, read_size);
+        if (bytes_read > 0)
+        {
+            // 只统计等待网络的时间，缓冲区满时的等待不计入下载速度
+            prebuffer_.AddDownloadSample(bytes_read, esp_timer_get_time() - read_start_us);
+        }
+        if (bytes_read < 0)
+        {
+            // 连接中断或提前结束，连接已经关闭，下一轮从断点重新打开
+            if (++retry_count > DOWNLOAD_MAX_RETRIES || !WaitForRetry(retry_count))
             {
-                ESP_LOGI(TAG, "Unknown audio format, first 4 bytes: %02X %02X %02X %02X",
-                         (unsigned char)buffer[0], (unsigned char)buffer[1],
-                         (unsigned char)buffer[2], (unsigned char)buffer[3]);
+                break;
             }
+            continue;
         }
-
-        // 创建音频数据块
-        uint8_t *chunk_data = (uint8_t *)heap_caps_malloc(bytes_read, MALLOC_CAP_SPIRAM);
-        if (!chunk_data)
+        if (bytes_read == 0)
         {
-            ESP_LOGE(TAG, "Failed to allocate memory for audio chunk");
+            ESP_LOGI(TAG, "Audio stream download completed, total: %d bytes", total_downloaded);
+            if (cache_writer)
+            {
+                cache_writer->Commit();
+                cache_writer.reset();
+            }
             break;
         }
-        memcpy(chunk_data, buffer, bytes_read);
-
-        // 等待缓冲区有空间
+        retry_count = 0;
+        ring->CommitWrite(bytes_read);
+        if (startup_pending_ && startup_first_byte_us_ == 0)
         {
-            std::unique_lock<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.wait(lock, [this]
-                            { return buffer_size_ < MAX_BUFFER_SIZE || !is_downloading_; });
-
-            if (is_downloading_)
+            startup_first_byte_us_ = esp_timer_get_time();
+        }
+        if (cache_writer && !cache_writer->Append(write_ptr, bytes_read))
+        {
+            cache_writer.reset();
+        }
+        if (total_downloaded == 0)
+        {
+            // 第一块数据包含第一帧时建立索引，ID3标签里的封面过大时没有索引，按标称码率换算
+            audio_start = GetId3TagSize(write_ptr, bytes_read);
+            int sync = audio_start < (size_t)bytes_read ? Mp3SeekTable::FindSync(write_ptr + audio_start, bytes_read - audio_start) : -1;
+            if (sync >= 0)
             {
-                audio_buffer_.push(AudioChunk(chunk_data, bytes_read));
-                buffer_size_ += bytes_read;
-                total_downloaded += bytes_read;
-
-                // 通知播放线程有新数据
-                buffer_cv_.notify_one();
+                table.Parse(write_ptr + audio_start + sync, bytes_read - audio_start - sync,
+                            audio_start + sync, reader.content_length());
+            }
+        }
+        size_t previous_total = total_downloaded;
+        total_downloaded += bytes_read;
+        bytes_written += bytes_read;
+        if (switch_variant >= 0)
+        {
+            switch_remaining -= bytes_read;
+        }
 
-                if (total_downloaded % (256 * 1024) == 0)
-                { // 每256KB打印一次进度
-                    ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, buffer_size_);
-                }
+        // 下载速度持续低于当前码率时换到低码率档位，上一次切换还没播放到时不再切换
+        int64_t now_us = esp_timer_get_time();
+        if (switch_variant < 0 && variant >= 0 && !source.song_id.empty() && now_us >= next_variant_check_us &&
+            !variant_switch_pending_)
+        {
+            next_variant_check_us = now_us + 500 * 1000;
+            int kbps = BitratePolicy::GetVariant(variant).kbps;
+            int buffered_ms = ring->Size() * 8 / kbps;
+            int lower = bitrate_.CheckMidTrack(variant, prebuffer_.throughput_kbps(), buffered_ms, now_us / 1000);
+            std::string lower_url = lower >= 0 ? ResolveVariantUrl(source.song_id, lower) : "";
+            // 本块数据中最后一帧的结尾，下载到这里再切换，旧文件的数据不会停在半帧
+            size_t frame_end = 0;
+            if (!lower_url.empty() && Mp3SeekTable::FindFrameEnd(write_ptr, bytes_read, frame_end))
+            {
+                switch_variant = lower;
+                switch_url = lower_url;
+                switch_remaining = frame_end - bytes_read;
             }
-            else
+        }
+        if (switch_variant >= 0 && switch_remaining == 0)
+        {
+            // 旧文件已在帧边界结束，从新文件对应时间的帧头继续下载
+            int kbps = BitratePolicy::GetVariant(variant).kbps;
+            int64_t position_ms = table.valid() ? table.PositionOf(total_downloaded)
+                                                : (int64_t)(total_downloaded - std::min(audio_start, total_downloaded)) * 8 / kbps;
+            Mp3SeekTable next_table;
+            size_t frame_offset = 0;
+            int lower = switch_variant;
+            switch_variant = -1;
+            if (!PrepareVariantSwitch(switch_url, position_ms, next_table, frame_offset))
             {
-                heap_caps_free(chunk_data);
-                break;
+                ESP_LOGW(TAG, "Failed to read the %s index, staying on %s",
+                         BitratePolicy::GetVariant(lower).br, BitratePolicy::GetVariant(variant).br);
+                continue;
+            }
+            ESP_LOGW(TAG, "Download at %d kbps, switching %s -> %s at %lldms (offset %u -> %u)",
+                     prebuffer_.throughput_kbps(), BitratePolicy::GetVariant(variant).br,
+                     BitratePolicy::GetVariant(lower).br, position_ms,
+                     (unsigned int)total_downloaded, (unsigned int)frame_offset);
+            {
+                std::lock_guard<std::mutex> lock(variant_switch_mutex_);
+                variant_switch_ = {ring, total_downloaded, frame_offset, switch_url, lower, next_table};
+                variant_switch_pending_ = true;
             }
+            reader.Close();
+            // 换了文件，缓存里不能混入两种码率的数据
+            cache_writer.reset();
+            music_url = switch_url;
+            variant = lower;
+            table = next_table;
+            total_downloaded = frame_offset;
+            continue;
         }
-    }
 
-    http->Close();
-    is_downloading_ = false;
+        if (previous_total / (256 * 1024) != total_downloaded / (256 * 1024))
+        { // 每256KB打印一次进度
+            ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, ring->Size());
+        }
+    }
 
-    // 通知播放线程下载完成
+    reader.Close();
+    if (retry_count > DOWNLOAD_MAX_RETRIES)
     {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
+        ESP_LOGE(TAG, "Giving up after %d reconnect attempts at %u bytes",
+                 DOWNLOAD_MAX_RETRIES, (unsigned int)total_downloaded);
     }
 
-    ESP_LOGI(TAG, "Audio stream download thread finished");
+    // 通知播放线程本曲下载完成
+    ring->SetEndOfStream();
+    return bytes_written > 0 || reached_end;
 }
 
 // 流式播放音频数据
-void Esp32Music::PlayAudioStream()
+// start_offset不为0表示从跳转位置继续播放当前曲目
+void Esp32Music::PlayAudioStream(size_t start_offset, int64_t start_ms, bool quick_start)
 {
     ESP_LOGI(TAG, "Starting audio stream playback");
 
     // 初始化时间跟踪变量
-    current_play_time_ms_ = 0;
+    current_play_time_ms_ = start_ms;
     last_frame_time_ms_ = 0;
     total_frames_decoded_ = 0;
 
@@ -787,286 +1578,348 @@ void Esp32Music::PlayAudioStream()
     {
         ESP_LOGE(TAG, "Audio codec not available or not enabled");
         is_playing_ = false;
+        xEventGroupSetBits(prefetch_events_, PREFETCH_SWITCHED_EVENT);
         return;
     }
 
-    if (!mp3_decoder_initialized_)
-    {
-        ESP_LOGE(TAG, "MP3 decoder not initialized");
-        is_playing_ = false;
-        return;
-    }
+    AudioRingBuffer *ring = active_ring_.load();
+    // 环形缓冲区读指针在文件中的偏移，用于建立跳转索引
+    size_t stream_offset = start_offset;
 
-    // 等待缓冲区有足够数据开始播放
+    // 当前曲目的码率，开始播放前从帧头识别，播放一段时间后改用实际的平均码率
+    int bitrate_kbps = 0;
+    size_t track_start_offset = start_offset;
+    int64_t track_start_ms = start_ms;
+    auto consume = [&](size_t bytes)
     {
-        std::unique_lock<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.wait(lock, [this]
-                        { return buffer_size_ >= MIN_BUFFER_SIZE || (!is_downloading_ && !audio_buffer_.empty()); });
-    }
-    ESP_LOGI(TAG, "Starting playback with buffer size: %d", buffer_size_);
-
-    size_t total_played = 0;
-    uint8_t *mp3_input_buffer = nullptr;
-    int bytes_left = 0;
-    uint8_t *read_ptr = nullptr;
+        ring->Consume(bytes);
+        stream_offset += bytes;
+        // 下载线程换了码率档位，读到切换点后偏移按新文件计算，码率重新统计
+        if (variant_switch_pending_ && ApplyVariantSwitch(ring, stream_offset))
+        {
+            bitrate_kbps = 0;
+            track_start_offset = stream_offset;
+            track_start_ms = current_play_time_ms_;
+        }
+    };
+    // 播放时间按已送出的采样数累计，只在发布时换算成毫秒，避免每帧截断的误差累积
+    // （44.1kHz 的 MP3 帧是 26.12ms，按整毫秒累加每分钟会慢约 280ms）
+    // 采样率变化时把已累计的部分折算进基准时间，从新的采样率重新计数
+    int64_t played_base_ms = start_ms;
+    int64_t played_samples = 0;
+    int played_sample_rate = 0;
+    auto advance_play_time = [&](int samples, int sample_rate)
+    {
+        if (sample_rate != played_sample_rate)
+        {
+            if (played_sample_rate > 0)
+            {
+                played_base_ms += played_samples * 1000 / played_sample_rate;
+            }
+            played_samples = 0;
+            played_sample_rate = sample_rate;
+        }
+        played_samples += samples;
+        current_play_time_ms_ = played_base_ms + played_samples * 1000 / played_sample_rate;
+    };
+    int track_underruns = 0;
+    // 等待缓冲区攒够预缓冲目标对应的数据量，下载速度在等待期间不断更新，目标也随之调整
+    auto wait_for_prebuffer = [&](const char *reason)
+    {
+        int64_t wait_start_us = esp_timer_get_time();
+        size_t target = 0;
+        while (is_playing_ && !ring->IsEndOfStream() && !ring->IsAborted())
+        {
+            if (bitrate_kbps == 0 && ring->Size() >= DECODE_PEEK_SIZE)
+            {
+                uint8_t *data = nullptr;
+                size_t size = ring->Peek(&data, DECODE_PEEK_SIZE);
+                bitrate_kbps = PrebufferPolicy::DetectBitrateKbps(data, size);
+                if (bitrate_kbps == 0)
+                {
+                    bitrate_kbps = PrebufferPolicy::kDefaultBitrateKbps;
+                }
+            }
+            // 留出一部分空间给下载线程，避免缓冲区满后两边互相等待
+            target = std::min(prebuffer_.TargetBytes(bitrate_kbps, quick_start), ring->capacity() * 3 / 4);
+            target = std::max(target, DECODE_PEEK_SIZE);
+            if (ring->WaitForData(target, pdMS_TO_TICKS(100)))
+            {
+                break;
+            }
+        }
+        ESP_LOGI(TAG, "Prebuffer (%s): %u/%u bytes in %lldms, %d kbps stream, %d kbps download",
+                 reason, (unsigned int)ring->Size(), (unsigned int)target,
+                 (esp_timer_get_time() - wait_start_us) / 1000, bitrate_kbps, prebuffer_.throughput_kbps());
+    };
+    // 一首歌结束时汇报断流次数，并让预缓冲策略根据结果调整
+    auto finish_track = [&]()
+    {
+        prebuffer_.OnTrackFinished(track_underruns > 0);
+        if (track_underruns > 0)
+        {
+            ESP_LOGW(TAG, "Track had %d underruns (%d total)", track_underruns, prebuffer_.underrun_count());
+        }
+    };
 
-    // 分配MP3输入缓冲区
-    mp3_input_buffer = (uint8_t *)heap_caps_malloc(8192, MALLOC_CAP_SPIRAM);
-    if (!mp3_input_buffer)
-    {
-        ESP_LOGE(TAG, "Failed to allocate MP3 input buffer");
-        is_playing_ = false;
-        return;
-    }
+    wait_for_prebuffer("start");
+    // 歌词由定时器在每句的时间点更新，解码循环只更新播放时间
+    ScheduleLyricUpdate(0);
 
-    // 标记是否已经处理过ID3标签
-    bool id3_processed = false;
+    size_t total_played = 0;
+    output_stage_.Reset();
+    // ID3标签或WAV的附加块可能比单次Peek的长度还大，记录剩余需要跳过的字节数
+    size_t bytes_to_skip = 0;
+    // 标记是否已经处理过ID3标签，跳转后的数据位于音频中间，无需处理
+    bool id3_processed = start_offset > 0;
+    // 跳转后的数据没有文件头，只有MP3支持跳转，直接使用MP3解码器
+    bool mid_stream = start_offset > 0;
+    bool decoder_selected = false;
+    // 标记是否已经尝试从第一帧建立跳转索引
+    // 电台直播流没有文件长度，不支持跳转
+    bool seek_table_checked = start_offset > 0 || current_is_radio_;
 
     while (is_playing_)
     {
-        // 检查设备状态，只有在空闲状态才播放音乐
-        auto &app = Application::GetInstance();
-        DeviceState current_state = app.GetDeviceState();
-
-        // 等小智把话说完了，变成聆听状态之后，马上转成待机状态，进入音乐播放
-        if (current_state == kDeviceStateListening)
+        // 对话期间暂停时在这里等待，解码器和缓冲区的状态都保持不变
+        if (suspended_)
         {
-            ESP_LOGI(TAG, "Device is in listening state, switching to idle state for music playback");
-            // 切换状态
-            app.ToggleChatState(); // 变成待机状态
-            vTaskDelay(pdMS_TO_TICKS(300));
-            continue;
-        }
-        else if (current_state != kDeviceStateIdle)
-        { // 不是待机状态，就一直卡在这里，不让播放音乐
-            ESP_LOGD(TAG, "Device state is %d, pausing music playback", current_state);
-            // 如果不是空闲状态，暂停播放
-            vTaskDelay(pdMS_TO_TICKS(50));
+            WaitWhileSuspended();
             continue;
         }
+        auto &app = Application::GetInstance();
 
-        // 设备状态检查通过，显示当前播放的歌名
-        if (!song_name_displayed_ && !current_song_name_.empty())
+        // 显示当前播放的歌名
+        std::string song_name;
+        if (!song_name_displayed_)
+        {
+            std::lock_guard<std::mutex> lock(track_mutex_);
+            song_name = current_song_name_;
+        }
+        if (!song_name.empty())
         {
             auto &board = Board::GetInstance();
             auto display = board.GetDisplay();
             if (display)
             {
                 // 格式化歌名显示为《歌名》播放中...
-                std::string formatted_song_name = "《" + current_song_name_ + "》播放中...";
+                std::string formatted_song_name = "《" + song_name + "》播放中...";
                 display->SetMusicInfo(formatted_song_name.c_str());
                 ESP_LOGI(TAG, "Displaying song name: %s", formatted_song_name.c_str());
                 song_name_displayed_ = true;
             }
         }
 
-        // 如果需要更多MP3数据，从缓冲区读取
-        if (bytes_left < 4096)
-        { // 保持至少4KB数据用于解码
-            AudioChunk chunk;
-
-            // 从缓冲区获取音频数据
+        // 保持至少DECODE_PEEK_SIZE的数据用于解码，下载结束后把剩余数据解码完
+        if (ring->Size() < DECODE_PEEK_SIZE && !ring->IsEndOfStream())
+        {
+            if (ring->IsAborted())
+            {
+                break;
+            }
+            if (total_frames_decoded_ > 0)
+            {
+                // 已经开始输出后数据耗尽就是断流，重新攒够预缓冲再继续，避免断断续续
+                track_underruns++;
+                prebuffer_.OnUnderrun();
+                wait_for_prebuffer("underrun");
+            }
+            else
+            {
+                ring->WaitForData(DECODE_PEEK_SIZE, pdMS_TO_TICKS(100));
+            }
+            continue;
+        }
+
+        // 直接从环形缓冲区取连续数据交给解码器，无需额外拷贝
+        uint8_t *read_ptr = nullptr;
+        size_t available = ring->Peek(&read_ptr, DECODE_PEEK_SIZE);
+        if (available == 0)
+        {
+            // 下载完成且缓冲区为空，有预取的下一首就直接切换过去
+            ESP_LOGI(TAG, "Track finished, total played: %d bytes", total_played);
+            finish_track();
+            track_underruns = 0;
+            if (!SwitchToPrefetchedTrack())
+            {
+                break;
+            }
+            ring = active_ring_.load();
+            stream_offset = 0;
+            {
+                // 上一首没有播放到的切换点不再有效
+                std::lock_guard<std::mutex> lock(variant_switch_mutex_);
+                if (variant_switch_.ring != ring)
+                {
+                    variant_switch_ = {};
+                    variant_switch_pending_ = false;
+                }
+            }
+            bitrate_kbps = 0;
+            track_start_offset = 0;
+            track_start_ms = 0;
+            seek_table_checked = current_is_radio_;
+            {
+                std::lock_guard<std::mutex> lock(seek_mutex_);
+                seek_table_.Reset();
+            }
+            current_play_time_ms_ = 0;
+            played_base_ms = 0;
+            played_samples = 0;
+            played_sample_rate = 0;
+            last_frame_time_ms_ = 0;
+            total_frames_decoded_ = 0;
+            bytes_to_skip = 0;
+            id3_processed = false;
+            mid_stream = false;
+            decoder_selected = false;
+            output_stage_.Reset();
+            track_transition_pending_ = true;
+            continue;
+        }
+
+        // 检查并跳过ID3标签（仅在开始时处理一次）
+        if (!id3_processed && available >= 10)
+        {
+            bytes_to_skip = GetId3TagSize(read_ptr, available);
+            if (bytes_to_skip > 0)
+            {
+                ESP_LOGI(TAG, "Skipping ID3 tag: %u bytes", (unsigned int)bytes_to_skip);
+            }
+            id3_processed = true;
+        }
+        if (bytes_to_skip > 0)
+        {
+            size_t skip = std::min(bytes_to_skip, available);
+            consume(skip);
+            bytes_to_skip -= skip;
+            continue;
+        }
+
+        // 根据文件头选择解码器，格式和上一首相同时复用
+        if (!decoder_selected)
+        {
+            AudioStreamFormat format = mid_stream ? AudioStreamFormat::kMp3
+                                                  : AudioStreamDecoder::Detect(read_ptr, available);
+            if (decoder_ && decoder_->format() == format)
+            {
+                decoder_->Reset();
+            }
+            else
+            {
+                decoder_.reset();
+                decoder_ = AudioStreamDecoder::Create(format);
+            }
+            ESP_LOGI(TAG, "Audio stream format: %s", AudioStreamDecoder::FormatName(format));
+            decoder_selected = true;
+        }
+        if (!decoder_)
+        {
+            // 不支持的格式，丢弃本曲数据，有预取的下一首时照常切换
+            consume(available);
+            continue;
+        }
+
+        // 用MP3第一帧的Xing/Info/VBRI头或码率建立跳转索引，其他格式不支持跳转
+        if (!seek_table_checked)
+        {
+            int sync_offset = -1;
+            if (decoder_->format() == AudioStreamFormat::kMp3)
             {
-                std::unique_lock<std::mutex> lock(buffer_mutex_);
-                if (audio_buffer_.empty())
-                {
-                    if (!is_downloading_)
-                    {
-                        // 下载完成且缓冲区为空，播放结束
-                        ESP_LOGI(TAG, "Playback finished, total played: %d bytes", total_played);
-                        break;
-                    }
-                    // 等待新数据
-                    buffer_cv_.wait(lock, [this]
-                                    { return !audio_buffer_.empty() || !is_downloading_; });
-                    if (audio_buffer_.empty())
-                    {
-                        continue;
-                    }
-                }
-
-                chunk = audio_buffer_.front();
-                audio_buffer_.pop();
-                buffer_size_ -= chunk.size;
-
-                // 通知下载线程缓冲区有空间
-                buffer_cv_.notify_one();
+                sync_offset = MP3FindSyncWord(read_ptr, available);
             }
-
-            // 将新数据添加到MP3输入缓冲区
-            if (chunk.data && chunk.size > 0)
+            if (sync_offset >= 0)
             {
-                // 移动剩余数据到缓冲区开头
-                if (bytes_left > 0 && read_ptr != mp3_input_buffer)
-                {
-                    memmove(mp3_input_buffer, read_ptr, bytes_left);
-                }
-
-                // 检查缓冲区空间
-                size_t space_available = 8192 - bytes_left;
-                size_t copy_size = std::min(chunk.size, space_available);
-
-                // 复制新数据
-                memcpy(mp3_input_buffer + bytes_left, chunk.data, copy_size);
-                bytes_left += copy_size;
-                read_ptr = mp3_input_buffer;
-
-                // 检查并跳过ID3标签（仅在开始时处理一次）
-                if (!id3_processed && bytes_left >= 10)
-                {
-                    size_t id3_skip = SkipId3Tag(read_ptr, bytes_left);
-                    if (id3_skip > 0)
-                    {
-                        read_ptr += id3_skip;
-                        bytes_left -= id3_skip;
-                        ESP_LOGI(TAG, "Skipped ID3 tag: %u bytes", (unsigned int)id3_skip);
-                    }
-                    id3_processed = true;
-                }
-
-                // 释放chunk内存
-                heap_caps_free(chunk.data);
+                std::lock_guard<std::mutex> lock(seek_mutex_);
+                seek_table_.Parse(read_ptr + sync_offset, available - sync_offset,
+                                  stream_offset + sync_offset, track_lengths_[RingIndex(ring)]);
             }
+            seek_table_checked = sync_offset >= 0 || decoder_->format() != AudioStreamFormat::kMp3;
         }
 
-        // 尝试找到MP3帧同步
-        int sync_offset = MP3FindSyncWord(read_ptr, bytes_left);
-        if (sync_offset < 0)
+        // 解码一帧，未取满Peek长度且下载未结束时解码器可以要求等待更多数据
+        bool more_available = available < DECODE_PEEK_SIZE && !ring->IsEndOfStream();
+        size_t consumed = 0;
+        AudioFrame frame;
+        auto status = decoder_->Decode(read_ptr, available, more_available, consumed, frame);
+        if (status == AudioStreamDecoder::Status::kNeedMoreData)
         {
-            ESP_LOGW(TAG, "No MP3 sync word found, skipping %d bytes", bytes_left);
-            bytes_left = 0;
+            // 帧不完整，保留数据等待下载线程补充
+            ring->WaitForData(available + 1, pdMS_TO_TICKS(100));
             continue;
         }
 
-        // 跳过到同步位置
-        if (sync_offset > 0)
+        // 解码器前进了多少就从环形缓冲区消费多少，超出当前数据的部分留到之后跳过
+        if (consumed > available)
+        {
+            bytes_to_skip = consumed - available;
+            consumed = available;
+        }
+        consume(std::max(consumed, (size_t)1));
+        if (status != AudioStreamDecoder::Status::kFrame)
         {
-            read_ptr += sync_offset;
-            bytes_left -= sync_offset;
+            continue;
         }
 
-        // 解码MP3帧
-        int16_t pcm_buffer[2304];
-        int decode_result = MP3Decode(mp3_decoder_, &read_ptr, &bytes_left, pcm_buffer, 0);
+        // 解码成功，PCM位于解码器自己的缓冲区，消费环形缓冲区后仍然有效
+        total_frames_decoded_++;
+        if (track_transition_pending_)
+        {
+            RecordTrackGap();
+        }
 
-        if (decode_result == 0)
+        // VBR和没有帧头的格式用实际消耗的字节数估算码率，断流后的重新缓冲更准确
+        int64_t track_played_ms = current_play_time_ms_ - track_start_ms;
+        if (track_played_ms >= 10000 && total_frames_decoded_ % 256 == 0)
         {
-            // 解码成功，获取帧信息
-            MP3GetLastFrameInfo(mp3_decoder_, &mp3_frame_info_);
-            total_frames_decoded_++;
+            bitrate_kbps = std::max(8, (int)((stream_offset - track_start_offset) * 8 / track_played_ms));
+        }
 
-            // 基本的帧信息有效性检查，防止除零错误
-            if (mp3_frame_info_.samprate == 0 || mp3_frame_info_.nChans == 0)
+        ESP_LOGD(TAG, "Frame %d: time=%lldms, samples=%d, rate=%d, ch=%d",
+                 total_frames_decoded_, current_play_time_ms_.load(), frame.samples,
+                 frame.sample_rate, frame.channels);
+
+        // 声道合并、重采样到编解码器的原始采样率和增益一次完成，不再切换I2S时钟
+        const int16_t *output = nullptr;
+        size_t output_samples = output_stage_.Process(frame.pcm, frame.samples, frame.channels, frame.sample_rate,
+                                                      codec->output_channels(), codec->output_sample_rate(), output);
+        // 混音队列满时在这里等待，相当于按实际播放速度解码
+        size_t queued = 0;
+        while (queued < output_samples && is_playing_)
+        {
+            size_t count = app.AddAudioData(output + queued, output_samples - queued);
+            if (count == 0 && !codec->output_enabled())
             {
-                ESP_LOGW(TAG, "Invalid frame info: rate=%d, channels=%d, skipping",
-                         mp3_frame_info_.samprate, mp3_frame_info_.nChans);
-                continue;
+                break;
             }
-
-            // 计算当前帧的持续时间(毫秒)
-            int frame_duration_ms = (mp3_frame_info_.outputSamps * 1000) /
-                                    (mp3_frame_info_.samprate * mp3_frame_info_.nChans);
-
-            // 更新当前播放时间
-            current_play_time_ms_ += frame_duration_ms;
-
-            ESP_LOGD(TAG, "Frame %d: time=%lldms, duration=%dms, rate=%d, ch=%d",
-                     total_frames_decoded_, current_play_time_ms_, frame_duration_ms,
-                     mp3_frame_info_.samprate, mp3_frame_info_.nChans);
-
-            // 更新歌词显示
-            int buffer_latency_ms = 600; // 实测调整值
-            UpdateLyricDisplay(current_play_time_ms_ + buffer_latency_ms);
-
-            // 将PCM数据发送到Application的音频解码队列
-            if (mp3_frame_info_.outputSamps > 0)
+            if (count == 0 && suspended_)
             {
-                int16_t *final_pcm_data = pcm_buffer;
-                int final_sample_count = mp3_frame_info_.outputSamps;
-                std::vector<int16_t> mono_buffer;
-
-                // 如果是双通道，转换为单通道混合
-                if (mp3_frame_info_.nChans == 2)
-                {
-                    // 双通道转单通道：将左右声道混合
-                    int stereo_samples = mp3_frame_info_.outputSamps; // 包含左右声道的总样本数
-                    int mono_samples = stereo_samples / 2;            // 实际的单声道样本数
-
-                    mono_buffer.resize(mono_samples);
-
-                    for (int i = 0; i < mono_samples; ++i)
-                    {
-                        // 混合左右声道 (L + R) / 2
-                        int left = pcm_buffer[i * 2];      // 左声道
-                        int right = pcm_buffer[i * 2 + 1]; // 右声道
-                        mono_buffer[i] = (int16_t)((left + right) / 2);
-                    }
-
-                    final_pcm_data = mono_buffer.data();
-                    final_sample_count = mono_samples;
-
-                    ESP_LOGD(TAG, "Converted stereo to mono: %d -> %d samples",
-                             stereo_samples, mono_samples);
-                }
-                else if (mp3_frame_info_.nChans == 1)
-                {
-                    // 已经是单声道，无需转换
-                    ESP_LOGD(TAG, "Already mono audio: %d samples", final_sample_count);
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "Unsupported channel count: %d, treating as mono",
-                             mp3_frame_info_.nChans);
-                }
-
-                // 创建AudioStreamPacket
-                AudioStreamPacket packet;
-                packet.sample_rate = mp3_frame_info_.samprate;
-                packet.frame_duration = 60; // 使用Application默认的帧时长
-                packet.timestamp = 0;
-
-                // 将int16_t PCM数据转换为uint8_t字节数组
-                size_t pcm_size_bytes = final_sample_count * sizeof(int16_t);
-                packet.payload.resize(pcm_size_bytes);
-                memcpy(packet.payload.data(), final_pcm_data, pcm_size_bytes);
-
-                ESP_LOGD(TAG, "Sending %d PCM samples (%d bytes, rate=%d, channels=%d->1) to Application",
-                         final_sample_count, pcm_size_bytes, mp3_frame_info_.samprate, mp3_frame_info_.nChans);
-
-                // 发送到Application的音频解码队列
-                app.AddAudioData(std::move(packet));
-                total_played += pcm_size_bytes;
-
-                // 打印播放进度
-                if (total_played % (128 * 1024) == 0)
-                {
-                    ESP_LOGI(TAG, "Played %d bytes, buffer size: %d", total_played, buffer_size_);
-                }
+                // 混音队列暂停后写满，等恢复后再把这一帧剩下的部分送出去
+                WaitWhileSuspended();
             }
+            queued += count;
         }
-        else
+        // 这一帧进入混音队列后才计入播放时间，GetPlaybackPositionMs 再减去队列和编解码器中未播放的部分
+        advance_play_time(frame.samples, frame.sample_rate);
+        total_played += output_samples * sizeof(int16_t);
+        last_pcm_output_us_ = esp_timer_get_time();
+        if (startup_pending_)
         {
-            // 解码失败
-            ESP_LOGW(TAG, "MP3 decode failed with error: %d", decode_result);
+            FinishStartupTrace();
+        }
 
-            // 跳过一些字节继续尝试
-            if (bytes_left > 1)
-            {
-                read_ptr++;
-                bytes_left--;
-            }
-            else
-            {
-                bytes_left = 0;
-            }
+        // 打印播放进度
+        if (total_played % (128 * 1024) == 0)
+        {
+            ESP_LOGI(TAG, "Played %d bytes, buffer size: %d", total_played, ring->Size());
         }
     }
 
-    // 清理
-    if (mp3_input_buffer)
+    if (track_underruns > 0)
     {
-        heap_caps_free(mp3_input_buffer);
+        finish_track();
     }
+    esp_timer_stop(lyric_timer_);
 
     // 播放结束时清空歌名显示
     auto &board = Board::GetInstance();
@@ -1077,93 +1930,235 @@ void Esp32Music::PlayAudioStream()
         ESP_LOGI(TAG, "Cleared song name display on playback end");
     }
 
-    // 重置采样率到原始值
-    ResetSampleRate();
-
     // 播放结束时保持音频输出启用状态，让Application管理
     // 不在这里禁用音频输出，避免干扰其他音频功能
     ESP_LOGI(TAG, "Audio stream playback finished, total played: %d bytes", total_played);
 
     is_playing_ = false;
-    if (!force_stop_)
-    {
-        need_to_play_next_ = true;
-        std::lock_guard<std::mutex> lock(next_mutex_);
-        play_next_cv_.notify_all();
+    // 下载线程可能在等待切换到预取的缓冲区
+    xEventGroupSetBits(prefetch_events_, PREFETCH_SWITCHED_EVENT);
+    // 电台断线重连失败后停止，不切到播放队列
+    bool play_next = !force_stop_.exchange(false) && !current_is_radio_;
+    if (play_next)
+    {
+        // 没有预取到下一首，在任务池中重新开始下一首，切歌间隔同样计入统计
+        // 点歌、切歌和停止打断当前曲目时已设置 force_stop_，不会走到这里
+        // 任务排队期间用户点了别的歌时，当前曲目的标记已被取消，不再自动切歌
+        track_transition_pending_ = true;
+        WorkerPool::TokenPtr token;
+        {
+            std::lock_guard<std::mutex> lock(token_mutex_);
+            token = track_token_;
+        }
+        workers_.Submit([this]()
+                        { playNextSong(); },
+                        token);
     }
-    force_stop_ = false;
 }
 
-// 清空音频缓冲区
+// 清空音频缓冲区，调用前需确保下载和播放线程都已退出
 void Esp32Music::ClearAudioBuffer()
 {
-    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    for (auto &ring : rings_)
+    {
+        ring->Reset();
+    }
+    for (auto &length : track_lengths_)
+    {
+        length = 0;
+    }
+    active_ring_ = rings_[0].get();
+    {
+        // 预取的歌曲还没有移动队列位置，直接丢弃即可
+        std::lock_guard<std::mutex> lock(prefetch_mutex_);
+        prefetch_ring_ = nullptr;
+        prefetch_entry_ = {};
+        prefetch_url_.clear();
+    }
+    prefetch_resolving_ = false;
+    if (prefetch_events_ != nullptr)
+    {
+        xEventGroupClearBits(prefetch_events_, PREFETCH_READY_EVENT | PREFETCH_SWITCHED_EVENT);
+    }
+    ESP_LOGI(TAG, "Audio buffer cleared");
+}
 
-    while (!audio_buffer_.empty())
+// 按当前剩余的PSRAM决定每个环形缓冲区的容量，已经分配给环形缓冲区的部分也算作可用
+size_t Esp32Music::ChooseBufferCapacity() const
+{
+    size_t owned = 0;
+    for (auto &ring : rings_)
     {
-        AudioChunk chunk = audio_buffer_.front();
-        audio_buffer_.pop();
-        if (chunk.data)
+        if (ring && ring->valid())
         {
-            heap_caps_free(chunk.data);
+            owned += ring->capacity() + ring->max_peek();
         }
     }
-
-    buffer_size_ = 0;
-    ESP_LOGI(TAG, "Audio buffer cleared");
+    size_t available = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) + owned;
+    size_t budget = available > PSRAM_RESERVE_SIZE ? (available - PSRAM_RESERVE_SIZE) / (sizeof(rings_) / sizeof(rings_[0])) : 0;
+    size_t capacity = MAX_BUFFER_SIZE;
+    while (capacity > MIN_BUFFER_SIZE && capacity + DECODE_PEEK_SIZE > budget)
+    {
+        capacity /= 2;
+    }
+    return capacity;
 }
 
-// 初始化MP3解码器
-bool Esp32Music::InitializeMp3Decoder()
+// 预取缓冲区的容量：能放下预缓冲策略对这个码率可能要求的最大预缓冲量（播放线程最多等到容量的3/4），
+// 不超过当前缓冲区的容量上限。本地缓存的歌曲从flash读取，不会断流，最小容量就够了
+size_t Esp32Music::ChoosePrefetchCapacity(int variant) const
 {
-    mp3_decoder_ = MP3InitDecoder();
-    if (mp3_decoder_ == nullptr)
+    if (variant < 0)
     {
-        ESP_LOGE(TAG, "Failed to initialize MP3 decoder");
-        mp3_decoder_initialized_ = false;
-        return false;
+        return MIN_BUFFER_SIZE;
+    }
+    size_t need = PrebufferPolicy::MaxTargetBytes(BitratePolicy::GetVariant(variant).kbps) * 4 / 3;
+    size_t limit = ChooseBufferCapacity();
+    size_t capacity = MIN_BUFFER_SIZE;
+    while (capacity < need && capacity < limit)
+    {
+        capacity *= 2;
     }
+    return capacity;
+}
 
-    mp3_decoder_initialized_ = true;
-    ESP_LOGI(TAG, "MP3 decoder initialized successfully");
-    return true;
+// 其他模块占用较多PSRAM时缩小环形缓冲区，释放后再恢复，调用前需确保下载和播放线程都已退出
+// 播放从第一个缓冲区开始，第二个缩回最小容量，等到预取时再按需要扩大
+void Esp32Music::ResizeAudioBuffers()
+{
+    const size_t capacities[] = {ChooseBufferCapacity(), MIN_BUFFER_SIZE};
+    for (int i = 0; i < 2; i++)
+    {
+        auto &ring = rings_[i];
+        if (ring->capacity() != capacities[i])
+        {
+            ESP_LOGI(TAG, "Resizing audio buffer %d: %u -> %u bytes", i, (unsigned int)ring->capacity(),
+                     (unsigned int)capacities[i]);
+            ring->Resize(capacities[i]);
+        }
+    }
 }
 
-// 清理MP3解码器
-void Esp32Music::CleanupMp3Decoder()
+// 唤醒所有阻塞在两个缓冲区上的线程
+void Esp32Music::AbortAudioBuffers()
 {
-    if (mp3_decoder_ != nullptr)
+    for (auto &ring : rings_)
+    {
+        ring->Abort();
+    }
+    // 唤醒等待预取结果和等待切换缓冲区的线程
+    if (prefetch_events_ != nullptr)
     {
-        MP3FreeDecoder(mp3_decoder_);
-        mp3_decoder_ = nullptr;
+        xEventGroupSetBits(prefetch_events_, PREFETCH_READY_EVENT | PREFETCH_SWITCHED_EVENT);
     }
-    mp3_decoder_initialized_ = false;
-    ESP_LOGI(TAG, "MP3 decoder cleaned up");
+    // 暂停中的播放线程也要唤醒，让它看到停止标志
+    std::lock_guard<std::mutex> lock(suspend_mutex_);
+    suspend_cv_.notify_all();
 }
 
-// 重置采样率到原始值
-void Esp32Music::ResetSampleRate()
+// 暂停期间阻塞播放线程，恢复或停止时由条件变量唤醒
+void Esp32Music::WaitWhileSuspended()
 {
-    auto &board = Board::GetInstance();
-    auto codec = board.GetAudioCodec();
-    if (codec && codec->original_output_sample_rate() > 0 &&
-        codec->output_sample_rate() != codec->original_output_sample_rate())
+    std::unique_lock<std::mutex> lock(suspend_mutex_);
+    suspend_cv_.wait(lock, [this]
+                     { return !suspended_ || !is_playing_; });
+}
+
+// 切换到已预取的下一首，下载线程还在解析下一首时等待其结果
+bool Esp32Music::SwitchToPrefetchedTrack()
+{
+    while (is_playing_)
     {
-        ESP_LOGI(TAG, "重置采样率：从 %d Hz 重置到原始值 %d Hz",
-                 codec->output_sample_rate(), codec->original_output_sample_rate());
-        if (codec->SetOutputSampleRate(-1))
-        { // -1 表示重置到原始值
-            ESP_LOGI(TAG, "成功重置采样率到原始值: %d Hz", codec->output_sample_rate());
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex_);
+            if (prefetch_ring_ != nullptr)
+            {
+                active_ring_ = prefetch_ring_;
+                prefetch_ring_ = nullptr;
+                play_next_ = prefetch_entry_.song_id;
+                SetCurrentTrack({prefetch_url_, prefetch_entry_.song_id, prefetch_entry_.name,
+                                 prefetch_entry_.artist, prefetch_variant_});
+                // 下一次预取前重新等待，下载线程可以复用上一首的缓冲区了
+                xEventGroupClearBits(prefetch_events_, PREFETCH_READY_EVENT);
+                xEventGroupSetBits(prefetch_events_, PREFETCH_SWITCHED_EVENT);
+                break;
+            }
         }
-        else
+        if (!prefetch_resolving_)
         {
-            ESP_LOGW(TAG, "无法重置采样率到原始值");
+            return false;
         }
+        xEventGroupWaitBits(prefetch_events_, PREFETCH_READY_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+    }
+    if (!is_playing_)
+    {
+        return false;
+    }
+
+    // 预取的就是队列中的下一首，开始播放时才移动队列位置
+    if (!play_queue_.MoveToNext(false, play_next_))
+    {
+        ESP_LOGW(TAG, "Play queue changed while prefetching %s", play_next_.c_str());
+    }
+    ESP_LOGI(TAG, "Switching to prefetched song: %s", play_next_.c_str());
+    LoadLyrics(play_next_);
+    SaveQueue();
+    RequestPreResolve();
+    return true;
+}
+
+// 点歌后第一帧PCM送出，汇总各阶段耗时
+void Esp32Music::FinishStartupTrace()
+{
+    std::lock_guard<std::mutex> lock(startup_mutex_);
+    if (!startup_pending_)
+    {
+        return;
+    }
+    startup_pending_ = false;
+
+    int64_t now = esp_timer_get_time();
+    const StartupTrace &trace = startup_trace_;
+    int64_t stream_started_us = trace.stream_started_us ? trace.stream_started_us : trace.url_done_us;
+    int64_t first_byte_us = startup_first_byte_us_ ? startup_first_byte_us_.load() : now;
+
+    int64_t search_ms = (trace.search_done_us - trace.request_us) / 1000;
+    int64_t resolve_ms = (trace.url_done_us - trace.search_done_us) / 1000;
+    int64_t start_ms = (stream_started_us - trace.url_done_us) / 1000;
+    int64_t connect_ms = (first_byte_us - stream_started_us) / 1000;
+    int64_t buffer_ms = (now - first_byte_us) / 1000;
+    int64_t total_ms = (now - trace.request_us) / 1000;
+
+    startup_histograms_[kStartupSearch].Record(search_ms);
+    startup_histograms_[kStartupResolve].Record(resolve_ms);
+    startup_histograms_[kStartupStart].Record(start_ms);
+    startup_histograms_[kStartupConnect].Record(connect_ms);
+    startup_histograms_[kStartupBuffer].Record(buffer_ms);
+    startup_histograms_[kStartupTotal].Record(total_ms);
+
+    ESP_LOGI(TAG, "Time to first audio: %lldms (search %lld, resolve %lld, start %lld, first byte %lld, buffering %lld)",
+             total_ms, search_ms, resolve_ms, start_ms, connect_ms, buffer_ms);
+    ESP_LOGI(TAG, "Time to first audio histogram: %s", startup_histograms_[kStartupTotal].ToString().c_str());
+}
+
+// 记录上一首最后一帧输出到下一首第一帧之间的间隔
+void Esp32Music::RecordTrackGap()
+{
+    track_transition_pending_ = false;
+    if (last_pcm_output_us_ == 0)
+    {
+        return;
     }
+    last_track_gap_ms_ = (esp_timer_get_time() - last_pcm_output_us_) / 1000;
+    max_track_gap_ms_ = std::max(max_track_gap_ms_, last_track_gap_ms_);
+    total_track_gap_ms_ += last_track_gap_ms_;
+    track_gap_count_++;
+    ESP_LOGI(TAG, "Track gap: %lldms (avg %lldms, max %lldms, %d transitions)",
+             last_track_gap_ms_, total_track_gap_ms_ / track_gap_count_, max_track_gap_ms_, track_gap_count_);
 }
 
-// 跳过MP3文件开头的ID3标签
-size_t Esp32Music::SkipId3Tag(uint8_t *data, size_t size)
+// 计算MP3文件开头ID3标签的总长度，不是ID3标签时返回0
+size_t Esp32Music::GetId3TagSize(const uint8_t *data, size_t size)
 {
     if (!data || size < 10)
     {
@@ -1182,20 +2177,69 @@ size_t Esp32Music::SkipId3Tag(uint8_t *data, size_t size)
                         ((uint32_t)(data[8] & 0x7F) << 7) |
                         ((uint32_t)(data[9] & 0x7F));
 
-    // ID3v2头部(10字节) + 标签内容
+    // ID3v2头部(10字节) + 标签内容，可能超过当前可用数据，由调用方分批跳过
     size_t total_skip = 10 + tag_size;
+    ESP_LOGI(TAG, "Found ID3v2 tag, %u bytes", (unsigned int)total_skip);
+    return total_skip;
+}
+
+// 下载歌词
+// 流式请求：每收到一块数据就交给on_data处理，on_data返回false时提前结束
+// 还没有收到任何数据时才会重试
+bool Esp32Music::RequestStream(const std::string &url, const std::function<bool(const char *, size_t)> &on_data)
+{
+    ESP_LOGI(TAG, "requesting from: %s", url.c_str());
 
-    // 确保不超过可用数据大小
-    if (total_skip > size)
+    const int max_retries = 3;
+    for (int attempt = 0; attempt < max_retries; attempt++)
     {
-        total_skip = size;
-    }
+        if (attempt > 0)
+        {
+            ESP_LOGI(TAG, "Retrying request attempts (attempt %d of %d)", attempt + 1, max_retries);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
 
-    ESP_LOGI(TAG, "Found ID3v2 tag, skipping %u bytes", (unsigned int)total_skip);
-    return total_skip;
+        auto http = Board::GetInstance().CreateHttp();
+        if (!http->Open("GET", url))
+        {
+            ESP_LOGE(TAG, "Failed to open HTTP connection for request");
+            delete http;
+            continue;
+        }
+        int status_code = http->GetStatusCode();
+        if (status_code < 200 || status_code >= 300)
+        {
+            ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
+            http->Close();
+            delete http;
+            continue;
+        }
+
+        char buffer[512];
+        int total_read = 0;
+        int bytes_read;
+        while ((bytes_read = http->Read(buffer, sizeof(buffer))) > 0)
+        {
+            total_read += bytes_read;
+            if (!on_data(buffer, bytes_read))
+            {
+                break;
+            }
+        }
+        http->Close();
+        delete http;
+
+        if (total_read > 0)
+        {
+            ESP_LOGD(TAG, "stream request finished after %d bytes", total_read);
+            return true;
+        }
+        ESP_LOGE(TAG, "Failed to read data: error code %d", bytes_read);
+    }
+    ESP_LOGE(TAG, "Failed to request after %d attempts", max_retries);
+    return false;
 }
 
-// 下载歌词
 bool Esp32Music::Request(const std::string &url, std::string &response)
 {
     ESP_LOGI(TAG, "requesting from: %s", url.c_str());
@@ -1361,8 +2405,8 @@ bool Esp32Music::Request(const std::string &url, std::string &response)
     return true;
 }
 
-// 解析歌词
-bool Esp32Music::ParseLyrics(const std::string &lyric_content)
+// 解析歌词，生成按时间排序的歌词时间轴
+std::shared_ptr<const LyricTimeline> Esp32Music::ParseLyrics(const std::string &lyric_content)
 {
     ESP_LOGD(TAG, "Parsing lyrics content");
 
@@ -1371,7 +2415,7 @@ bool Esp32Music::ParseLyrics(const std::string &lyric_content)
     if (!rsp)
     {
         ESP_LOGE(TAG, "Failed to parse JSON response");
-        return false;
+        return nullptr;
     }
 
     // 获取"data"对象
@@ -1380,7 +2424,7 @@ bool Esp32Music::ParseLyrics(const std::string &lyric_content)
     {
         ESP_LOGE(TAG, "Invalid JSON structure - 'data' object not found");
         cJSON_Delete(rsp);
-        return false;
+        return nullptr;
     }
 
     // 获取"lrclist"数组
@@ -1389,218 +2433,248 @@ bool Esp32Music::ParseLyrics(const std::string &lyric_content)
     {
         ESP_LOGE(TAG, "Cannot get 'lrclist' from JSON!");
         cJSON_Delete(rsp);
-        return false;
+        return nullptr;
     }
 
-    // 预先分配内存以减少内存分配开销
-    lyrics_.reserve(cJSON_GetArraySize(lrclist));
+    // 所有歌词文本拼接到一块内存中，预留的大小按每行平均长度估算
+    int line_count = cJSON_GetArraySize(lrclist);
+    LyricTimeline::Builder builder;
+    builder.Reserve(line_count, line_count * 32);
 
-    for (int i = 0; i < cJSON_GetArraySize(lrclist); i++)
+    int index = 0;
+    cJSON *lyric = nullptr;
+    cJSON_ArrayForEach(lyric, lrclist)
     {
-        cJSON *lyric = cJSON_GetArrayItem(lrclist, i);
         cJSON *content = cJSON_GetObjectItem(lyric, "lineLyric");
         cJSON *timeStr = cJSON_GetObjectItem(lyric, "time");
-
         if (!content || !content->valuestring || !timeStr || !timeStr->valuestring)
         {
-            ESP_LOGW(TAG, "Incomplete lyric data at index %d", i);
-            continue;
+            ESP_LOGW(TAG, "Incomplete lyric data at index %d", index);
         }
-
-        float time = atof(timeStr->valuestring);
-        int time_ms = static_cast<int>(time * 1000);
-        std::string content_str = content->valuestring;
-        lyrics_.emplace_back(time_ms, content_str);
+        else
+        {
+            float time = atof(timeStr->valuestring);
+            builder.Add(static_cast<int64_t>(time * 1000), content->valuestring);
+        }
+        index++;
     }
+    cJSON_Delete(rsp);
 
-    if (lyrics_.empty())
+    auto timeline = builder.Build();
+    if (!timeline)
     {
         ESP_LOGE(TAG, "Parsed lyrics are empty");
-        cJSON_Delete(rsp);
-        return false;
+        return nullptr;
     }
-
-    // 排序歌词以确保按时间顺序显示
-    std::sort(lyrics_.begin(), lyrics_.end(), [](const std::pair<int, std::string> &a, const std::pair<int, std::string> &b)
-              { return a.first < b.first; });
-
-    ESP_LOGI(TAG, "Parsed %d lyric lines", lyrics_.size());
-    cJSON_Delete(rsp);
-    return true;
+    ESP_LOGI(TAG, "Parsed %d lyric lines", (int)timeline->size());
+    return timeline;
 }
 
-bool Esp32Music::ParseRecommondSong(const std::string &keyword, const std::string &songId)
+// 按歌手搜索歌单，把歌曲最多的歌单作为新的播放队列，点播的歌曲排在队首
+bool Esp32Music::ParseRecommondSong(PlayQueue::Entry current, WorkerPool::TokenPtr token)
 {
+    // 推荐列表返回前队列里只有当前歌曲，不会再预取上一个歌单的歌
+    if (token->cancelled())
     {
-        std::lock_guard<std::mutex> lock(next_mutex_);
-        song_played_map_.clear();
-    }
-    std::string url = "https://search.kuwo.cn/r.s?pn=0&rn=10&all=" + url_encode(keyword) + "&ft=playlist&rformat=json&encoding=utf8&pcjson=1";
-    std::string rsp1;
-    if (!Request(url, rsp1))
-    {
-        ESP_LOGE(TAG, "Failed to request recommond song, keyword: [%s]", keyword.c_str());
-        return false;
-    }
-
-    cJSON *rsp = cJSON_Parse(rsp1.c_str());
-    if (!rsp)
-    {
-        ESP_LOGE(TAG, "Failed to parse JSON response");
         return false;
     }
+    play_queue_.Replace(current, {});
+    SaveQueue();
+    const std::string &keyword = current.artist;
 
-    cJSON *abslist = cJSON_GetObjectItem(rsp, "abslist");
-    if(!cJSON_IsArray(abslist) || cJSON_GetArraySize(abslist) == 0)
-    {
-        ESP_LOGE(TAG, "Cannot get 'abslist' from JSON!");
-        cJSON_Delete(rsp);
-        return false;
-    }
-   
+    // 找出歌曲数最多的歌单，逐个歌单比较，无需保存整个响应
+    enum { kSongNum, kPlaylistId };
     int maxSongNum = 0;
     std::string markPlayListId;
-    for (int i = 0; i < cJSON_GetArraySize(abslist); i++)
+    int item_index = -1;
+    int item_song_num = -1;
+    std::string item_playlist_id;
+    auto finish_item = [&]()
     {
-        cJSON *list = cJSON_GetArrayItem(abslist, i);
-        cJSON *songnum = cJSON_GetObjectItem(list, "songnum");
-        if (!songnum || !songnum->valuestring)
-        {
-            ESP_LOGE(TAG, "Invalid JSON structure - 'songnum' object not found");
-            continue;
-        }
-        cJSON *playlistid = cJSON_GetObjectItem(list, "playlistid");
-        if (!playlistid || !playlistid->valuestring)
-        {
-            ESP_LOGE(TAG, "Invalid JSON structure - 'playlistid' object not found");
-            continue;
-        }
-        int songNum = atoi(songnum->valuestring);
-        if (songNum > maxSongNum)
+        if (item_song_num > maxSongNum && !item_playlist_id.empty())
         {
-            maxSongNum = songNum;
-            markPlayListId = std::string(playlistid->valuestring);
+            maxSongNum = item_song_num;
+            markPlayListId = item_playlist_id;
         }
+        item_song_num = -1;
+        item_playlist_id.clear();
+    };
+    JsonStreamExtractor playlists({"abslist[].songnum", "abslist[].playlistid"},
+                                  [&](int field, int index, const std::string &value)
+                                  {
+                                      if (index != item_index)
+                                      {
+                                          finish_item();
+                                          item_index = index;
+                                      }
+                                      if (field == kSongNum)
+                                      {
+                                          item_song_num = atoi(value.c_str());
+                                      }
+                                      else
+                                      {
+                                          item_playlist_id = value;
+                                      }
+                                      return true;
+                                  });
+    std::string url = "https://search.kuwo.cn/r.s?pn=0&rn=10&all=" + url_encode(keyword) + "&ft=playlist&rformat=json&encoding=utf8&pcjson=1";
+    if (!RequestStream(url, [&playlists](const char *data, size_t size)
+                       { return playlists.Feed(data, size); }))
+    {
+        ESP_LOGE(TAG, "Failed to request recommond song, keyword: [%s]", keyword.c_str());
+        return false;
+    }
+    finish_item();
+    if (token->cancelled())
+    {
+        return false;
     }
-    cJSON_Delete(rsp);
     if (0 == maxSongNum)
     {
         ESP_LOGE(TAG, "Cannot find recommond song, keyword: [%s]", keyword.c_str());
         return false;
     }
 
-    std::string rsp2;
+    enum { kMusicId, kMusicName, kMusicArtist };
+    std::vector<PlayQueue::Entry> entries;
+    JsonStreamExtractor musiclist({"musiclist[].id", "musiclist[].name", "musiclist[].artist"},
+                                  [&entries](int field, int index, const std::string &value)
+                                  {
+                                      if (index >= (int)entries.size())
+                                      {
+                                          entries.resize(index + 1);
+                                      }
+                                      auto &entry = entries[index];
+                                      switch (field)
+                                      {
+                                      case kMusicId:
+                                          entry.song_id = value;
+                                          break;
+                                      case kMusicName:
+                                          entry.name = value;
+                                          break;
+                                      case kMusicArtist:
+                                          entry.artist = value;
+                                          break;
+                                      }
+                                      return true;
+                                  });
     url = "http://nplserver.kuwo.cn/pl.svc?op=getlistinfo&pid=" + markPlayListId + "&pn=0&rn=100&encode=utf8&keyset=pl2012&vipver=MUSIC_9.1.1.2_BCS2&newver=1";
-    if (!Request(url, rsp2))
+    if (!RequestStream(url, [&musiclist](const char *data, size_t size)
+                       { return musiclist.Feed(data, size); }))
     {
         ESP_LOGE(TAG, "Failed to request playlist, keyword: [%s]", keyword.c_str());
         return false;
     }
-
-    rsp = cJSON_Parse(rsp2.c_str());
-    if (!rsp)
+    if (entries.empty())
     {
-        ESP_LOGE(TAG, "Failed to parse JSON response");
+        ESP_LOGE(TAG, "Cannot get 'musiclist' from JSON!");
         return false;
     }
 
-    cJSON *musiclist = cJSON_GetObjectItem(rsp, "musiclist");
-    if (!cJSON_IsArray(musiclist) || cJSON_GetArraySize(musiclist) == 0)
+    // 请求期间用户又点了别的歌，丢弃这个歌单
+    if (token->cancelled())
     {
-        ESP_LOGE(TAG, "Cannot get 'musiclist' from JSON!");
-        cJSON_Delete(rsp);
+        ESP_LOGW(TAG, "Song changed, drop playlist for %s", current.song_id.c_str());
         return false;
     }
+    play_queue_.Replace(current, entries);
+    SaveQueue();
+    RequestPreResolve();
+    return true;
+}
 
+// 换歌时清空旧歌词并在任务池中获取新歌词
+// 每次换歌都经过这里，同时取消上一首还没完成的歌词和自动切歌任务
+void Esp32Music::LoadLyrics(const std::string &song_id)
+{
+    current_lyric_url_ = "https://www.kuwo.cn/openapi/v1/www/lyric/getlyric?musicId=" + song_id;
+    auto token = RenewToken(track_token_);
     {
-        std::lock_guard<std::mutex> lock(next_mutex_);
-        for (int i = 0; i < cJSON_GetArraySize(musiclist); i++)
-        {
-            cJSON *list = cJSON_GetArrayItem(musiclist, i);
-            cJSON *musicrId = cJSON_GetObjectItem(list, "id");
-            if (!musicrId || !musicrId->valuestring)
-            {
-                ESP_LOGE(TAG, "Invalid JSON structure - 'id' object not found");
-                continue;
-            }
-            std::string id = std::string(musicrId->valuestring);
-            song_played_map_[id] = false;
-        }
-        song_played_map_[songId] = true;
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        lyrics_.reset();
     }
-    cJSON_Delete(rsp);
-    return true;
+    current_lyric_index_ = -1;
+    std::string url = current_lyric_url_;
+    workers_.Submit([this, url, token]()
+                    { FetchLyrics(url, token); },
+                    token);
 }
 
-// 歌词显示线程
-void Esp32Music::LyricDisplayThread()
+// 下载并解析歌词，完成后整体发布，期间已经换歌则丢弃结果
+void Esp32Music::FetchLyrics(const std::string &url, WorkerPool::TokenPtr token)
 {
-    ESP_LOGI(TAG, "Lyric display thread started");
     std::string lyric_content;
-    if (!Request(current_lyric_url_, lyric_content))
+    if (!Request(url, lyric_content))
     {
         ESP_LOGE(TAG, "Failed to download lrics");
     }
-    ParseLyrics(lyric_content);
-    ESP_LOGI(TAG, "Lyric display thread finished");
-}
-
-void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms)
-{
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-
-    if (lyrics_.empty())
+    if (token->cancelled())
     {
         return;
     }
-
-    // 查找当前应该显示的歌词
-    int new_lyric_index = -1;
-
-    // 从当前歌词索引开始查找，提高效率
-    int start_index = (current_lyric_index_.load() >= 0) ? current_lyric_index_.load() : 0;
-
-    // 正向查找：找到最后一个时间戳小于等于当前时间的歌词
-    for (int i = start_index; i < (int)lyrics_.size(); i++)
+    auto timeline = ParseLyrics(lyric_content);
+    if (timeline)
     {
-        if (lyrics_[i].first <= current_time_ms)
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        if (!token->cancelled())
         {
-            new_lyric_index = i;
-        }
-        else
-        {
-            break; // 时间戳已超过当前时间
+            lyrics_ = std::move(timeline);
         }
     }
-
-    // 如果没有找到(可能当前时间比第一句歌词还早)，显示空
-    if (new_lyric_index == -1)
+    if (is_playing_)
     {
-        new_lyric_index = -1;
+        ScheduleLyricUpdate(0);
     }
+}
+
+// 解码进度减去混音队列和编解码器DMA中还没播放的部分，就是扬声器正在播放的位置
+int64_t Esp32Music::GetPlaybackPositionMs() const
+{
+    int64_t position_ms = current_play_time_ms_ - Application::GetInstance().GetOutputLatencyMs(kAudioSourceMusic);
+    return std::max<int64_t>(0, position_ms);
+}
 
-    // 如果歌词索引发生变化，更新显示
-    if (new_lyric_index != current_lyric_index_)
+void Esp32Music::ScheduleLyricUpdate(int64_t delay_ms)
+{
+    esp_timer_stop(lyric_timer_);
+    esp_timer_start_once(lyric_timer_, std::max<int64_t>(delay_ms, 1) * 1000);
+}
+
+// 显示当前时间对应的歌词，并把定时器设到下一句开始的时间
+// 跳转或断流后播放时间不再连续，定时器最长每秒检查一次
+void Esp32Music::OnLyricTimer()
+{
+    // 暂停期间播放位置不变，恢复时重新启动定时器
+    if (!is_playing_ || suspended_)
     {
-        current_lyric_index_ = new_lyric_index;
+        return;
+    }
 
-        auto &board = Board::GetInstance();
-        auto display = board.GetDisplay();
-        if (display)
+    std::shared_ptr<const LyricTimeline> lyrics;
+    {
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        lyrics = lyrics_;
+    }
+    int64_t delay_ms = LYRIC_MAX_INTERVAL_MS;
+    if (lyrics)
+    {
+        int64_t position_ms = GetPlaybackPositionMs();
+        int index = lyrics->Find(position_ms);
+        if (index != current_lyric_index_.exchange(index))
         {
-            std::string lyric_text;
-
-            if (current_lyric_index_ >= 0 && current_lyric_index_ < (int)lyrics_.size())
+            const char *lyric_text = index >= 0 ? lyrics->text(index) : "";
+            auto display = Board::GetInstance().GetDisplay();
+            if (display)
             {
-                lyric_text = lyrics_[current_lyric_index_].second;
+                display->SetChatMessage("lyric", lyric_text);
             }
-
-            // 显示歌词
-            display->SetChatMessage("lyric", lyric_text.c_str());
-
-            ESP_LOGD(TAG, "Lyric update at %lldms: %s",
-                     current_time_ms,
-                     lyric_text.empty() ? "(no lyric)" : lyric_text.c_str());
+            ESP_LOGD(TAG, "Lyric update at %lldms: %s", position_ms, index >= 0 ? lyric_text : "(no lyric)");
+        }
+        if (index + 1 < (int)lyrics->size())
+        {
+            delay_ms = std::min(delay_ms, lyrics->time_ms(index + 1) - position_ms);
         }
     }
-}
\ No newline at end of file
+    ScheduleLyricUpdate(delay_ms);
+}
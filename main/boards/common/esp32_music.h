@@ -4,87 +4,240 @@
 #include <string>
 #include <thread>
 #include <atomic>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <vector>
 #include <map>
+#include <memory>
+#include <functional>
 
-#include "music.h"
+#include <esp_timer.h>
 
-// MP3解码器支持
-extern "C" {
-#include "mp3dec.h"
-}
+#include "music.h"
+#include "audio_ring_buffer.h"
+#include "mp3_seek_table.h"
+#include "audio_stream_decoder.h"
+#include "pcm_output_stage.h"
+#include "prebuffer_policy.h"
+#include "bitrate_policy.h"
+#include "lyric_timeline.h"
+#include "track_cache.h"
+#include "resolve_cache.h"
+#include "play_queue.h"
+#include "icy_metadata_parser.h"
+#include "range_reader.h"
+#include "worker_pool.h"
+#include "latency_histogram.h"
 
-// 音频数据块结构
-struct AudioChunk {
-    uint8_t* data;
-    size_t size;
-    
-    AudioChunk() : data(nullptr), size(0) {}
-    AudioChunk(uint8_t* d, size_t s) : data(d), size(s) {}
-};
+class Http;
 
 class Esp32Music : public Music {
 private:
     std::string last_downloaded_data_;
+    // 开始、停止和跳转都要先结束上一次的线程，MCP工具各自在独立线程中调用，自动下一首在任务池中调用，
+    // 用这把锁串行执行，避免两个调用同时join或重新创建同一个线程
+    std::mutex stream_mutex_;
+    // 当前曲目的信息，播放线程切换到预取的歌曲时也会写入，不能用上面的锁（持锁时会join播放线程）
+    std::mutex track_mutex_;
     std::string current_music_url_;
+    int current_variant_ = -1;  // current_music_url_ 对应的码率档位，本地缓存为 -1
     std::string current_song_name_;
-    bool song_name_displayed_;
+    std::string current_song_id_;
+    std::string current_artist_;
+    std::atomic<bool> song_name_displayed_;
+    std::atomic<bool> current_is_radio_{false};  // 当前播放的是电台直播流
     
     // 歌词相关
     std::string current_lyric_url_;
-    std::vector<std::pair<int, std::string>> lyrics_;  // 时间戳和歌词文本
-    std::mutex lyrics_mutex_;  // 保护lyrics_数组的互斥锁
+    // 当前歌曲的歌词时间轴，构建完成后整体替换，锁只保护指针本身
+    std::shared_ptr<const LyricTimeline> lyrics_;
+    std::mutex lyrics_mutex_;
     std::atomic<int> current_lyric_index_;
+    esp_timer_handle_t lyric_timer_;  // 在下一句歌词的时间点更新显示，不占用解码循环
     std::atomic<bool> is_playing_;
+    // 暂停期间播放线程阻塞在条件变量上，下载线程写满缓冲区后自然停下
+    std::atomic<bool> suspended_;
+    std::mutex suspend_mutex_;
+    std::condition_variable suspend_cv_;
     std::atomic<bool> is_downloading_;
     std::thread play_thread_;
     std::thread download_thread_;
-    int64_t current_play_time_ms_;  // 当前播放时间(毫秒)
+    std::atomic<int64_t> current_play_time_ms_;  // 已送入混音队列的播放时间(毫秒)，由累计的采样数换算
     int64_t last_frame_time_ms_;    // 上一帧的时间戳
     int total_frames_decoded_;      // 已解码的帧数
 
     // 歌曲推荐相关
     std::string play_next_;
-    std::map<std::string, bool> song_played_map_;  // 保存歌曲ID和歌曲名的映射关系
-
-    // 音频缓冲区
-    std::queue<AudioChunk> audio_buffer_;
-    std::mutex buffer_mutex_;
-    std::condition_variable buffer_cv_;
-    std::condition_variable play_next_cv_;
-    std::mutex next_mutex_;
-    bool need_to_play_next_;
-    bool force_stop_;
-    size_t buffer_size_;
-    static constexpr size_t MAX_BUFFER_SIZE = 512 * 1024;  // 512KB缓冲区
-    static constexpr size_t MIN_BUFFER_SIZE = 64 * 1024;   // 64KB最小播放缓冲
+    // 按歌单顺序排列的播放队列，保存到NVS
+    PlayQueue play_queue_;
+    // 提前获取队列中接下来几首的播放地址，切歌时不用再等接口
+    std::atomic<bool> preresolve_pending_{false};
+
+    // 音频缓冲区（PSRAM中的单生产者/单消费者环形缓冲）
+    // 两个缓冲区轮流使用：一个供当前歌曲播放，另一个预取下一首
+    // 预取用的缓冲区平时只保留最小容量，开始预取时再按下一首的预缓冲需要调整大小
+    std::unique_ptr<AudioRingBuffer> rings_[2];
+    std::atomic<AudioRingBuffer*> active_ring_;
+    std::atomic<size_t> track_lengths_[2];  // 每个缓冲区对应曲目的文件总长度，未知时为0
+
+    // 点歌到第一帧PCM送出的各阶段耗时
+    struct StartupTrace {
+        int64_t request_us;         // 收到点歌请求
+        int64_t search_done_us;     // 得到歌曲ID
+        int64_t url_done_us;        // 得到播放地址
+        int64_t stream_started_us;  // 下载和播放线程启动
+    };
+    enum StartupStage {
+        kStartupSearch,
+        kStartupResolve,
+        kStartupStart,
+        kStartupConnect,
+        kStartupBuffer,
+        kStartupTotal,
+        kStartupStageCount,
+    };
+    std::mutex startup_mutex_;
+    StartupTrace startup_trace_;
+    std::atomic<bool> startup_pending_;
+    std::atomic<int64_t> startup_first_byte_us_;  // 第一块音频数据写入缓冲区
+    LatencyHistogram startup_histograms_[kStartupStageCount];
+
+    // 本地歌曲缓存，在后台线程挂载分区并加载索引，完成前和没有music分区时为空
+    std::unique_ptr<TrackCache> track_cache_;
+    std::atomic<bool> track_cache_ready_;
+    std::thread track_cache_thread_;
+    // 搜索结果和播放地址缓存
+    ResolveCache resolve_cache_;
+
+    // 当前曲目的跳转索引，由播放线程在第一帧建立
+    std::mutex seek_mutex_;
+    Mp3SeekTable seek_table_;
+
+    // 播放中换到低码率档位：下载线程在帧边界切换文件并记录切换点，
+    // 播放线程读到切换点时换用新文件的偏移、跳转索引和播放地址
+    struct VariantSwitch {
+        AudioRingBuffer* ring = nullptr;
+        size_t switch_at = 0;   // 旧文件中切换点的偏移
+        size_t new_offset = 0;  // 新文件从这一帧开始写入缓冲区
+        std::string url;
+        int variant = -1;
+        Mp3SeekTable table;
+    };
+    std::mutex variant_switch_mutex_;
+    VariantSwitch variant_switch_;
+    std::atomic<bool> variant_switch_pending_;
+
+    // 下一首预取相关
+    std::mutex prefetch_mutex_;
+    AudioRingBuffer* prefetch_ring_;   // 已开始预取的缓冲区，为空表示没有预取
+    PlayQueue::Entry prefetch_entry_;
+    std::string prefetch_url_;
+    int prefetch_variant_ = -1;
+    std::atomic<bool> prefetch_resolving_;  // 下载线程正在解析下一首的播放地址
+    // PREFETCH_READY_EVENT：预取的缓冲区已就绪，或下载线程不会再预取
+    // PREFETCH_SWITCHED_EVENT：播放线程切换了当前缓冲区或已退出，上一首的缓冲区可以复用
+    // 停止时两个都会设置，等待的一方重新检查状态后退出
+    EventGroupHandle_t prefetch_events_;
+
+    // 歌曲切换间隙统计
+    int64_t last_pcm_output_us_;     // 上一次输出PCM的时间
+    std::atomic<bool> track_transition_pending_;  // 上一首自然结束，等待下一首的第一帧
+    int64_t last_track_gap_ms_;
+    int64_t max_track_gap_ms_;
+    int64_t total_track_gap_ms_;
+    int track_gap_count_;
+
+    std::atomic<bool> force_stop_;  // 当前曲目被用户打断，播完后不自动播放下一首
+    static constexpr size_t MAX_BUFFER_SIZE = 512 * 1024;  // 每个环形缓冲区的上限
+    static constexpr size_t MIN_BUFFER_SIZE = 64 * 1024;   // PSRAM紧张时每个环形缓冲区的下限
+    static constexpr size_t PSRAM_RESERVE_SIZE = 512 * 1024;  // 留给AFE、摄像头和LVGL的PSRAM
+    static constexpr size_t DECODE_PEEK_SIZE = 4096;       // 解码时保持的连续数据量
+    static constexpr EventBits_t PREFETCH_READY_EVENT = (1 << 0);
+    static constexpr EventBits_t PREFETCH_SWITCHED_EVENT = (1 << 1);
+    static constexpr int LYRIC_MAX_INTERVAL_MS = 1000;  // 歌词定时器最长的检查间隔
+    static constexpr int DOWNLOAD_MAX_RETRIES = 6;         // 连续重连的最大次数
+    static constexpr int DOWNLOAD_RETRY_BASE_MS = 500;     // 首次重连前的等待时间，之后逐次翻倍
+    static constexpr int DOWNLOAD_RETRY_MAX_MS = 8000;     // 重连等待时间上限
+    static constexpr size_t PRERESOLVE_COUNT = 3;          // 提前获取播放地址的歌曲数
+    static constexpr int MUSIC_WORKER_COUNT = 2;           // 歌词和推荐歌单可以同时请求
+    static constexpr uint32_t MUSIC_WORKER_STACK_SIZE = 8192;  // HTTPS请求和歌词解析需要的栈
     
-    // MP3解码器相关
-    HMP3Decoder mp3_decoder_;
-    MP3FrameInfo mp3_frame_info_;
-    bool mp3_decoder_initialized_;
+    // 当前曲目的解码器，只由播放线程使用，格式相同的下一首直接复用
+    std::unique_ptr<AudioStreamDecoder> decoder_;
+    // 解码输出到编解码器之间的声道、采样率和增益转换，只由播放线程使用
+    PcmOutputStage output_stage_;
+    // 按码率和下载速度计算预缓冲量，并统计断流次数
+    PrebufferPolicy prebuffer_;
+    // 按下载速度选择酷我播放地址的码率档位
+    BitratePolicy bitrate_;
+    // 任务池的取消标记
+    std::mutex token_mutex_;
+    WorkerPool::TokenPtr track_token_;    // 换歌时取消，丢弃上一首的歌词和自动切歌任务
+    WorkerPool::TokenPtr request_token_;  // 点歌时取消，丢弃上一次点歌的推荐歌单任务
+    // 歌词、推荐歌单、提前获取播放地址和自动下一首都在固定数量的工作任务中执行，任务栈在PSRAM中
+    // 放在最后，析构时最先等待正在执行的任务结束
+    WorkerPool workers_;
     
     // 私有方法
-    void DownloadAudioStream(const std::string& music_url);
-    void PlayAudioStream();
+    // 下载线程需要的曲目信息，启动线程时按值传入，避免和点歌线程竞争
+    struct TrackSource {
+        std::string url;
+        std::string song_id;
+        std::string song_name;
+        std::string artist;
+        int variant = -1;  // 酷我码率档位，-1 表示不支持切换（本地缓存或其他来源）
+        bool live = false;  // 电台直播流，没有文件长度，断开后从最新的位置继续
+    };
+
+    // 调用前需持有stream_mutex_
+    bool StartStreamingAt(const std::string& music_url, size_t start_offset, int64_t start_ms);
+    TrackSource CurrentTrack();
+    void SetCurrentTrack(const TrackSource& source);
+    void DownloadAudioStream(TrackSource source, size_t start_offset);
+    bool DownloadTrack(const TrackSource& source, AudioRingBuffer* ring, size_t start_offset);
+    void StreamRadio(const TrackSource& source, AudioRingBuffer* ring);
+    Http* OpenRadioStream(const std::string& url, size_t& metaint, std::string& station);
+    bool StreamFromCache(const std::string& song_id, AudioRingBuffer* ring, size_t start_offset);
+    void InitializeTrackCache();
+    TrackCache* GetTrackCache();
+    bool SearchSong(const std::string& song_name, std::string& song_id, std::string& artist);
+    std::string ResolvePlayUrl(const std::string& song_id, int& variant);
+    std::string ResolveVariantUrl(const std::string& song_id, int variant);
+    RangeReader CreateRangeReader();
+    size_t ReadRange(const std::string& url, size_t offset, uint8_t* data, size_t size, size_t& file_length);
+    bool PrepareVariantSwitch(const std::string& url, int64_t position_ms, Mp3SeekTable& table, size_t& frame_offset);
+    bool ApplyVariantSwitch(AudioRingBuffer* ring, size_t& stream_offset);
+    bool WaitForRetry(int attempt);
+    void PlayAudioStream(size_t start_offset, int64_t start_ms, bool quick_start);
     void ClearAudioBuffer();
-    bool InitializeMp3Decoder();
-    void CleanupMp3Decoder();
-    void ResetSampleRate();  // 重置采样率到原始值
-    void PlayNextDetect();
+    void WaitWhileSuspended();
+    size_t ChooseBufferCapacity() const;
+    size_t ChoosePrefetchCapacity(int variant) const;
+    void ResizeAudioBuffers();
+    void AbortAudioBuffers();
+    int RingIndex(const AudioRingBuffer* ring) const { return ring == rings_[1].get() ? 1 : 0; }
+    bool ResolveNextSong(PlayQueue::Entry& entry, std::string& play_url, int& variant);
+    bool PlayEntry(const PlayQueue::Entry& entry, const std::function<bool()>& move_to);
+    void RequestPreResolve();
+    void PreResolveUpcoming();
+    void SaveQueue();
+    WorkerPool::TokenPtr RenewToken(WorkerPool::TokenPtr& token);
+    bool SwitchToPrefetchedTrack();
+    void RecordTrackGap();
+    void FinishStartupTrace();
 
     // 歌词相关私有方法
     bool Request(const std::string &url, std::string &response);
-    bool ParseLyrics(const std::string& lyric_content);
-    bool ParseRecommondSong(const std::string &keyword, const std::string &songId);
-    void LyricDisplayThread();
-    void UpdateLyricDisplay(int64_t current_time_ms);
+    bool RequestStream(const std::string &url, const std::function<bool(const char *, size_t)> &on_data);
+    std::shared_ptr<const LyricTimeline> ParseLyrics(const std::string& lyric_content);
+    bool ParseRecommondSong(PlayQueue::Entry current, WorkerPool::TokenPtr token);
+    void LoadLyrics(const std::string& song_id);
+    void FetchLyrics(const std::string& url, WorkerPool::TokenPtr token);
+    void ScheduleLyricUpdate(int64_t delay_ms);
+    void OnLyricTimer();
     
     // ID3标签处理
-    size_t SkipId3Tag(uint8_t* data, size_t size);
+    size_t GetId3TagSize(const uint8_t* data, size_t size);
 
     std::string getSongPlayUrl(const std::string& req);
 
@@ -101,7 +254,16 @@ public:
     // 新增方法
     virtual bool StartStreaming(const std::string& music_url) override;
     virtual bool StopStreaming() override;  // 停止流式播放
-    virtual size_t GetBufferSize() const override { return buffer_size_; }
+    virtual bool Seek(int64_t position_ms) override;  // 跳转到当前歌曲的指定位置
+    virtual int64_t GetPlaybackPositionMs() const override;
+    virtual bool NextSong() override;
+    virtual bool PreviousSong() override;
+    virtual std::string GetPlayQueue() override;
+    virtual bool SetPlayMode(const std::string& mode) override;
+    virtual bool PlayRadio(const std::string& url, const std::string& name) override;
+    virtual void Suspend() override;
+    virtual void Resume() override;
+    virtual size_t GetBufferSize() const override { return active_ring_.load()->Size(); }
     virtual bool IsDownloading() const override { return is_downloading_; }
 };
 
@@ -0,0 +1,731 @@
+#include "flac_stream_decoder.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "FlacStreamDecoder"
+
+namespace {
+
+constexpr size_t kStreamInfoSize = 34;
+constexpr size_t kMaxHeaderSize = 16;  // 帧头最长：同步码 4 + UTF-8 编号 7 + 块长度 2 + 采样率 2 + CRC 1
+
+enum ChannelAssignment {
+    kIndependent = 0,  // 0-7：各声道独立编码
+    kLeftSide = 8,
+    kSideRight = 9,
+    kMidSide = 10,
+};
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+};
+
+const CrcTables& GetCrcTables() {
+    static const CrcTables tables = [] {
+        CrcTables t;
+        for (int i = 0; i < 256; i++) {
+            uint8_t c8 = i;
+            uint16_t c16 = i << 8;
+            for (int k = 0; k < 8; k++) {
+                c8 = (c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1;
+                c16 = (c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1;
+            }
+            t.crc8[i] = c8;
+            t.crc16[i] = c16;
+        }
+        return t;
+    }();
+    return tables;
+}
+
+uint8_t Crc8(const uint8_t* data, size_t size) {
+    auto& table = GetCrcTables().crc8;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint16_t Crc16(const uint8_t* data, size_t size) {
+    auto& table = GetCrcTables().crc16;
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc << 8) ^ table[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+// 高位在前的位读取器，越过数据末尾时读到全 1（一元码会立即结束），由调用方检查 overrun()
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    uint32_t Read(int bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        if (bits_ < bits) {
+            Refill();
+        }
+        uint32_t value = (uint32_t)(cache_ >> (64 - bits));
+        cache_ <<= bits;
+        bits_ -= bits;
+        return value;
+    }
+
+    int32_t ReadSigned(int bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        return (int32_t)(Read(bits) << (32 - bits)) >> (32 - bits);
+    }
+
+    // 统计第一个 1 之前 0 的个数
+    uint32_t ReadUnary() {
+        uint32_t zeros = 0;
+        while (true) {
+            if (bits_ == 0) {
+                Refill();
+            }
+            if (cache_ == 0) {
+                // 缓存中有效位之外都是 0，整段都是 0
+                zeros += bits_;
+                bits_ = 0;
+                continue;
+            }
+            int leading = __builtin_clzll(cache_);
+            zeros += leading;
+            cache_ <<= leading;
+            cache_ <<= 1;
+            bits_ -= leading + 1;
+            return zeros;
+        }
+    }
+
+    int32_t ReadRice(int parameter) {
+        uint32_t value = (ReadUnary() << parameter) | Read(parameter);
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+    }
+
+    void AlignToByte() {
+        int drop = bits_ % 8;
+        cache_ <<= drop;
+        bits_ -= drop;
+    }
+
+    size_t consumed_bits() const { return position_ * 8 - bits_; }
+    bool overrun() const { return consumed_bits() > size_ * 8; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+    uint64_t cache_ = 0;  // 左对齐，有效位之后都是 0
+    int bits_ = 0;
+
+    void Refill() {
+        while (bits_ <= 56) {
+            uint8_t byte = position_ < size_ ? data_[position_] : 0xFF;
+            position_++;
+            cache_ |= (uint64_t)byte << (56 - bits_);
+            bits_ += 8;
+        }
+    }
+};
+
+struct FrameHeader {
+    int block_size;
+    int sample_rate;
+    int channel_assignment;
+    int channels;
+    int bits_per_sample;
+    size_t length;
+};
+
+enum class HeaderResult {
+    kOk,
+    kTruncated,
+    kInvalid,
+};
+
+HeaderResult ParseFrameHeader(const uint8_t* data, size_t size, int stream_rate, int stream_bits, FrameHeader& header) {
+    if (size < 4) {
+        return size >= 2 && (data[0] != 0xFF || (data[1] & 0xFE) != 0xF8) ? HeaderResult::kInvalid
+                                                                          : HeaderResult::kTruncated;
+    }
+    if (data[0] != 0xFF || (data[1] & 0xFE) != 0xF8 || (data[3] & 0x01) != 0) {
+        return HeaderResult::kInvalid;
+    }
+    int block_code = data[2] >> 4;
+    int rate_code = data[2] & 0x0F;
+    int channel_code = data[3] >> 4;
+    int size_code = (data[3] >> 1) & 0x07;
+
+    // 帧号或样本号，UTF-8 方式编码，1-7 字节
+    size_t pos = 4;
+    if (pos >= size) {
+        return HeaderResult::kTruncated;
+    }
+    uint8_t first = data[pos];
+    int extra;
+    if ((first & 0x80) == 0) {
+        extra = 0;
+    } else if ((first & 0xE0) == 0xC0) {
+        extra = 1;
+    } else if ((first & 0xF0) == 0xE0) {
+        extra = 2;
+    } else if ((first & 0xF8) == 0xF0) {
+        extra = 3;
+    } else if ((first & 0xFC) == 0xF8) {
+        extra = 4;
+    } else if ((first & 0xFE) == 0xFC) {
+        extra = 5;
+    } else if (first == 0xFE) {
+        extra = 6;
+    } else {
+        return HeaderResult::kInvalid;
+    }
+    pos++;
+    for (int i = 0; i < extra; i++, pos++) {
+        if (pos >= size) {
+            return HeaderResult::kTruncated;
+        }
+        if ((data[pos] & 0xC0) != 0x80) {
+            return HeaderResult::kInvalid;
+        }
+    }
+
+    size_t block_bytes = block_code == 6 ? 1 : (block_code == 7 ? 2 : 0);
+    size_t rate_bytes = rate_code == 12 ? 1 : (rate_code == 13 || rate_code == 14 ? 2 : 0);
+    if (pos + block_bytes + rate_bytes + 1 > size) {
+        return HeaderResult::kTruncated;
+    }
+
+    if (block_code == 0) {
+        return HeaderResult::kInvalid;
+    } else if (block_code == 1) {
+        header.block_size = 192;
+    } else if (block_code <= 5) {
+        header.block_size = 576 << (block_code - 2);
+    } else if (block_code == 6) {
+        header.block_size = data[pos] + 1;
+    } else if (block_code == 7) {
+        header.block_size = ((data[pos] << 8) | data[pos + 1]) + 1;
+    } else {
+        header.block_size = 256 << (block_code - 8);
+    }
+    pos += block_bytes;
+
+    static const int kRates[12] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    if (rate_code == 0) {
+        header.sample_rate = stream_rate;
+    } else if (rate_code < 12) {
+        header.sample_rate = kRates[rate_code];
+    } else if (rate_code == 12) {
+        header.sample_rate = data[pos] * 1000;
+    } else if (rate_code == 13) {
+        header.sample_rate = (data[pos] << 8) | data[pos + 1];
+    } else if (rate_code == 14) {
+        header.sample_rate = ((data[pos] << 8) | data[pos + 1]) * 10;
+    } else {
+        return HeaderResult::kInvalid;
+    }
+    pos += rate_bytes;
+
+    if (channel_code < 8) {
+        header.channels = channel_code + 1;
+    } else if (channel_code <= kMidSide) {
+        header.channels = 2;
+    } else {
+        return HeaderResult::kInvalid;
+    }
+    header.channel_assignment = channel_code;
+
+    static const int kSampleSizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+    if (size_code == 3) {
+        return HeaderResult::kInvalid;
+    }
+    header.bits_per_sample = size_code == 0 ? stream_bits : kSampleSizes[size_code];
+
+    if (Crc8(data, pos) != data[pos]) {
+        return HeaderResult::kInvalid;
+    }
+    header.length = pos + 1;
+    return header.sample_rate > 0 ? HeaderResult::kOk : HeaderResult::kInvalid;
+}
+
+bool DecodeResidual(BitReader& reader, int32_t* output, int block_size, int order) {
+    int method = reader.Read(2);
+    if (method > 1) {
+        return false;
+    }
+    int parameter_bits = method == 0 ? 4 : 5;
+    int escape = method == 0 ? 15 : 31;
+    int partition_order = reader.Read(4);
+    int partitions = 1 << partition_order;
+    int partition_size = block_size >> partition_order;
+    if ((block_size & (partitions - 1)) != 0 || partition_size < order) {
+        return false;
+    }
+
+    int32_t* out = output + order;
+    for (int p = 0; p < partitions; p++) {
+        int count = partition_size - (p == 0 ? order : 0);
+        int parameter = reader.Read(parameter_bits);
+        if (parameter == escape) {
+            int bits = reader.Read(5);
+            for (int i = 0; i < count; i++) {
+                out[i] = reader.ReadSigned(bits);
+            }
+        } else {
+            for (int i = 0; i < count; i++) {
+                out[i] = reader.ReadRice(parameter);
+            }
+        }
+        out += count;
+        if (reader.overrun()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RestoreFixed(int32_t* s, int block_size, int order) {
+    switch (order) {
+    case 1:
+        for (int i = 1; i < block_size; i++) {
+            s[i] += s[i - 1];
+        }
+        break;
+    case 2:
+        for (int i = 2; i < block_size; i++) {
+            s[i] += 2 * s[i - 1] - s[i - 2];
+        }
+        break;
+    case 3:
+        for (int i = 3; i < block_size; i++) {
+            s[i] += 3 * s[i - 1] - 3 * s[i - 2] + s[i - 3];
+        }
+        break;
+    case 4:
+        for (int i = 4; i < block_size; i++) {
+            s[i] += 4 * s[i - 1] - 6 * s[i - 2] + 4 * s[i - 3] - s[i - 4];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void RestoreLpc(int32_t* s, int block_size, const int32_t* coefs, int order, int shift) {
+    for (int i = order; i < block_size; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) {
+            sum += (int64_t)coefs[j] * s[i - 1 - j];
+        }
+        s[i] += (int32_t)(sum >> shift);
+    }
+}
+
+bool DecodeSubframe(BitReader& reader, int32_t* output, int block_size, int bits) {
+    if (reader.Read(1) != 0) {
+        return false;
+    }
+    int type = reader.Read(6);
+    int wasted = 0;
+    if (reader.Read(1)) {
+        wasted = reader.ReadUnary() + 1;
+        if (wasted >= bits) {
+            return false;
+        }
+        bits -= wasted;
+    }
+
+    if (type == 0) {
+        // CONSTANT
+        int32_t value = reader.ReadSigned(bits);
+        std::fill(output, output + block_size, value);
+    } else if (type == 1) {
+        // VERBATIM
+        for (int i = 0; i < block_size; i++) {
+            output[i] = reader.ReadSigned(bits);
+        }
+    } else if (type >= 8 && type <= 12) {
+        // FIXED，阶数 0-4
+        int order = type - 8;
+        if (order > block_size) {
+            return false;
+        }
+        for (int i = 0; i < order; i++) {
+            output[i] = reader.ReadSigned(bits);
+        }
+        if (!DecodeResidual(reader, output, block_size, order)) {
+            return false;
+        }
+        RestoreFixed(output, block_size, order);
+    } else if (type >= 32) {
+        // LPC，阶数 1-32
+        int order = type - 31;
+        if (order > block_size) {
+            return false;
+        }
+        for (int i = 0; i < order; i++) {
+            output[i] = reader.ReadSigned(bits);
+        }
+        int precision = reader.Read(4) + 1;
+        int shift = reader.ReadSigned(5);
+        if (precision == 16 || shift < 0) {
+            return false;
+        }
+        int32_t coefs[32];
+        for (int i = 0; i < order; i++) {
+            coefs[i] = reader.ReadSigned(precision);
+        }
+        if (!DecodeResidual(reader, output, block_size, order)) {
+            return false;
+        }
+        RestoreLpc(output, block_size, coefs, order, shift);
+    } else {
+        return false;
+    }
+
+    if (wasted > 0) {
+        for (int i = 0; i < block_size; i++) {
+            output[i] = (int32_t)((uint32_t)output[i] << wasted);
+        }
+    }
+    return !reader.overrun();
+}
+
+} // namespace
+
+FlacStreamDecoder::~FlacStreamDecoder() {
+    Free();
+}
+
+void FlacStreamDecoder::Free() {
+    for (auto& samples : samples_) {
+        if (samples != nullptr) {
+            heap_caps_free(samples);
+            samples = nullptr;
+        }
+    }
+    if (pcm_ != nullptr) {
+        heap_caps_free(pcm_);
+        pcm_ = nullptr;
+    }
+    allocated_block_size_ = 0;
+}
+
+bool FlacStreamDecoder::Allocate(int block_size) {
+    if (block_size <= allocated_block_size_) {
+        return true;
+    }
+    Free();
+    for (auto& samples : samples_) {
+        samples = (int32_t*)heap_caps_malloc(block_size * sizeof(int32_t), MALLOC_CAP_SPIRAM);
+    }
+    pcm_ = (int16_t*)heap_caps_malloc(block_size * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (samples_[0] == nullptr || samples_[1] == nullptr || pcm_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate buffers for %d samples", block_size);
+        Free();
+        return false;
+    }
+    allocated_block_size_ = block_size;
+    return true;
+}
+
+void FlacStreamDecoder::Reset() {
+    // 缓冲区保留给下一首，块长度不超过时直接复用
+    state_ = State::kMarker;
+    has_stream_info_ = false;
+    sample_rate_ = 0;
+    channels_ = 0;
+    bits_per_sample_ = 0;
+    max_block_size_ = 0;
+    window_limit_ = 0;
+    window_.clear();
+}
+
+AudioStreamDecoder::Status FlacStreamDecoder::Decode(const uint8_t* data, size_t size, bool more_available,
+                                                     size_t& consumed, AudioFrame& frame) {
+    consumed = 0;
+    switch (state_) {
+    case State::kMarker:
+        if (size < 4) {
+            if (more_available) {
+                return Status::kNeedMoreData;
+            }
+            state_ = State::kInvalid;
+            break;
+        }
+        if (memcmp(data, "fLaC", 4) != 0) {
+            ESP_LOGE(TAG, "Not a FLAC stream");
+            state_ = State::kInvalid;
+            break;
+        }
+        consumed = 4;
+        state_ = State::kMetadata;
+        return Status::kSkipped;
+
+    case State::kMetadata:
+        return ParseMetadata(data, size, more_available, consumed);
+
+    case State::kFrames:
+        if (!window_.empty()) {
+            return DecodeWindow(data, size, more_available, consumed, frame);
+        }
+        return DecodeInPlace(data, size, more_available, consumed, frame);
+
+    default:
+        break;
+    }
+
+    // 格式错误或不支持，丢弃剩余数据
+    consumed = size;
+    return Status::kSkipped;
+}
+
+AudioStreamDecoder::Status FlacStreamDecoder::ParseMetadata(const uint8_t* data, size_t size, bool more_available,
+                                                            size_t& consumed) {
+    if (size < 4) {
+        if (more_available) {
+            return Status::kNeedMoreData;
+        }
+        state_ = State::kInvalid;
+        consumed = size;
+        return Status::kSkipped;
+    }
+    bool last = (data[0] & 0x80) != 0;
+    int type = data[0] & 0x7F;
+    size_t length = (data[1] << 16) | (data[2] << 8) | data[3];
+
+    if (type == 0) {
+        if (length < kStreamInfoSize) {
+            state_ = State::kInvalid;
+            consumed = size;
+            return Status::kSkipped;
+        }
+        if (size < 4 + kStreamInfoSize) {
+            if (more_available) {
+                return Status::kNeedMoreData;
+            }
+            state_ = State::kInvalid;
+            consumed = size;
+            return Status::kSkipped;
+        }
+        if (!ParseStreamInfo(data + 4)) {
+            state_ = State::kInvalid;
+            consumed = size;
+            return Status::kSkipped;
+        }
+    } else if (type == 127 || !has_stream_info_) {
+        // STREAMINFO 必须是第一个元数据块
+        ESP_LOGE(TAG, "Invalid FLAC metadata block: type=%d", type);
+        state_ = State::kInvalid;
+        consumed = size;
+        return Status::kSkipped;
+    }
+
+    // 其他块（封面、标签、SEEKTABLE 等）直接跳过，可能超出本次数据，由调用方继续跳过
+    consumed = 4 + length;
+    if (last) {
+        state_ = State::kFrames;
+    }
+    return Status::kSkipped;
+}
+
+bool FlacStreamDecoder::ParseStreamInfo(const uint8_t* data) {
+    int min_block = (data[0] << 8) | data[1];
+    int max_block = (data[2] << 8) | data[3];
+    size_t max_frame = (data[7] << 16) | (data[8] << 8) | data[9];
+    int sample_rate = (data[10] << 12) | (data[11] << 4) | (data[12] >> 4);
+    int channels = ((data[12] >> 1) & 0x07) + 1;
+    int bits = (((data[12] & 0x01) << 4) | (data[13] >> 4)) + 1;
+
+    if (sample_rate == 0 || channels > 2 || bits < 8 || bits > 24 ||
+        max_block < 16 || max_block > kMaxBlockSize || min_block > max_block) {
+        ESP_LOGE(TAG, "Unsupported FLAC stream: %d Hz, %d channels, %d bits, block size %d",
+                 sample_rate, channels, bits, max_block);
+        return false;
+    }
+    if (!Allocate(max_block)) {
+        return false;
+    }
+
+    sample_rate_ = sample_rate;
+    channels_ = channels;
+    bits_per_sample_ = bits;
+    max_block_size_ = max_block;
+    // 没有记录最大帧长时按不压缩的帧估算
+    size_t estimate = (size_t)max_block * channels * (bits + 1) / 8 + kMaxHeaderSize + channels * 8 + 2;
+    window_limit_ = std::min(max_frame > 0 ? max_frame : estimate, kMaxWindowSize);
+    window_.reserve(window_limit_);
+    has_stream_info_ = true;
+    ESP_LOGI(TAG, "FLAC format: %d Hz, %d channels, %d bits, max block %d, max frame %u",
+             sample_rate, channels, bits, max_block, (unsigned int)max_frame);
+    return true;
+}
+
+bool FlacStreamDecoder::IsFrameHeader(const uint8_t* data, size_t size, bool& truncated) const {
+    FrameHeader header;
+    HeaderResult result = ParseFrameHeader(data, size, sample_rate_, bits_per_sample_, header);
+    truncated = result == HeaderResult::kTruncated;
+    return result == HeaderResult::kOk;
+}
+
+AudioStreamDecoder::Status FlacStreamDecoder::DecodeInPlace(const uint8_t* data, size_t size, bool more_available,
+                                                            size_t& consumed, AudioFrame& frame) {
+    bool truncated = false;
+    if (!IsFrameHeader(data, size, truncated)) {
+        if (truncated && more_available) {
+            return Status::kNeedMoreData;
+        }
+        // 不是帧头，找下一个同步码；最后一个字节可能是同步码的开头，留到下一次
+        size_t offset = 1;
+        while (offset + 1 < size) {
+            if (data[offset] == 0xFF && (data[offset + 1] & 0xFE) == 0xF8 &&
+                (IsFrameHeader(data + offset, size - offset, truncated) || truncated)) {
+                break;
+            }
+            offset++;
+        }
+        ESP_LOGD(TAG, "Skipped %u bytes to the next frame", (unsigned int)offset);
+        consumed = offset;
+        return Status::kSkipped;
+    }
+
+    size_t length = 0;
+    switch (DecodeFrame(data, size, length, frame)) {
+    case FrameResult::kOk:
+        consumed = length;
+        return Status::kFrame;
+    case FrameResult::kTruncated:
+        if (more_available) {
+            return Status::kNeedMoreData;
+        }
+        // 帧比一次能取到的数据长，先拷贝出来
+        window_.assign(data, data + std::min(size, window_limit_));
+        consumed = window_.size();
+        return Status::kSkipped;
+    default:
+        // 误判的同步码或损坏的帧，从下一个字节开始重新同步
+        ESP_LOGW(TAG, "Corrupt FLAC frame, resyncing");
+        consumed = 1;
+        return Status::kSkipped;
+    }
+}
+
+AudioStreamDecoder::Status FlacStreamDecoder::DecodeWindow(const uint8_t* data, size_t size, bool more_available,
+                                                           size_t& consumed, AudioFrame& frame) {
+    size_t previous = window_.size();
+    size_t take = std::min(size, window_limit_ - previous);
+    window_.insert(window_.end(), data, data + take);
+
+    size_t length = 0;
+    FrameResult result = DecodeFrame(window_.data(), window_.size(), length, frame);
+    if (result == FrameResult::kOk) {
+        // 上一次数据不足，帧尾一定落在这次的数据里
+        consumed = length - previous;
+        window_.clear();
+        return Status::kFrame;
+    }
+    if (result == FrameResult::kTruncated && take > 0) {
+        if (more_available) {
+            window_.resize(previous);
+            return Status::kNeedMoreData;
+        }
+        consumed = take;
+        return Status::kSkipped;
+    }
+
+    // 超过最大帧长仍不完整，或者 CRC 错误：丢弃已经拷贝的数据，从本次数据开头重新同步
+    ESP_LOGW(TAG, "Dropping %u bytes of a corrupt FLAC frame", (unsigned int)previous);
+    window_.clear();
+    return DecodeInPlace(data, size, more_available, consumed, frame);
+}
+
+FlacStreamDecoder::FrameResult FlacStreamDecoder::DecodeFrame(const uint8_t* data, size_t size, size_t& length,
+                                                              AudioFrame& frame) {
+    FrameHeader header;
+    switch (ParseFrameHeader(data, size, sample_rate_, bits_per_sample_, header)) {
+    case HeaderResult::kTruncated:
+        return FrameResult::kTruncated;
+    case HeaderResult::kInvalid:
+        return FrameResult::kCorrupt;
+    default:
+        break;
+    }
+    if (header.channels != channels_ || header.block_size > max_block_size_ ||
+        header.bits_per_sample < 8 || header.bits_per_sample > 24) {
+        return FrameResult::kCorrupt;
+    }
+
+    BitReader reader(data + header.length, size - header.length);
+    for (int channel = 0; channel < header.channels; channel++) {
+        // 差分声道（side）比原始样本多一位
+        bool side = (header.channel_assignment == kLeftSide && channel == 1) ||
+                    (header.channel_assignment == kSideRight && channel == 0) ||
+                    (header.channel_assignment == kMidSide && channel == 1);
+        int bits = header.bits_per_sample + (side ? 1 : 0);
+        if (!DecodeSubframe(reader, samples_[channel], header.block_size, bits)) {
+            return reader.overrun() ? FrameResult::kTruncated : FrameResult::kCorrupt;
+        }
+    }
+    reader.AlignToByte();
+    size_t end = header.length + reader.consumed_bits() / 8;
+    if (end + 2 > size) {
+        return FrameResult::kTruncated;
+    }
+    if (Crc16(data, end) != ((data[end] << 8) | data[end + 1])) {
+        return FrameResult::kCorrupt;
+    }
+    length = end + 2;
+
+    int n = header.block_size;
+    int32_t* a = samples_[0];
+    int32_t* b = samples_[1];
+    switch (header.channel_assignment) {
+    case kLeftSide:
+        for (int i = 0; i < n; i++) {
+            b[i] = a[i] - b[i];
+        }
+        break;
+    case kSideRight:
+        for (int i = 0; i < n; i++) {
+            a[i] += b[i];
+        }
+        break;
+    case kMidSide:
+        for (int i = 0; i < n; i++) {
+            int32_t mid = (int32_t)((uint32_t)a[i] << 1) | (b[i] & 1);
+            int32_t side = b[i];
+            a[i] = (mid + side) >> 1;
+            b[i] = (mid - side) >> 1;
+        }
+        break;
+    default:
+        break;
+    }
+
+    // 转换为 16 位交错输出
+    int shift = header.bits_per_sample - 16;
+    int16_t* out = pcm_;
+    for (int i = 0; i < n; i++) {
+        for (int channel = 0; channel < header.channels; channel++) {
+            int32_t value = samples_[channel][i];
+            *out++ = (int16_t)(shift >= 0 ? value >> shift : (int32_t)((uint32_t)value << -shift));
+        }
+    }
+
+    frame.pcm = pcm_;
+    frame.samples = n;
+    frame.channels = header.channels;
+    frame.sample_rate = header.sample_rate;
+    return FrameResult::kOk;
+}
@@ -0,0 +1,66 @@
+#ifndef FLAC_STREAM_DECODER_H
+#define FLAC_STREAM_DECODER_H
+
+#include "audio_stream_decoder.h"
+
+#include <vector>
+
+// 原生 FLAC 解码器（RFC 9639），支持 1-2 声道、8-24 位、块长度不超过 kMaxBlockSize 的流
+// FLAC 帧没有长度字段，直接在 Peek 到的数据上解码，解码到帧尾的 CRC-16 才知道帧长。
+// 帧比一次能 Peek 到的数据还长时（高码率或 24 位常见），先把数据拷贝到 window_ 中凑齐整帧，
+// 相当于把 FLAC 的 Peek 窗口扩大到 STREAMINFO 中的最大帧长，环形缓冲区的保护区不用跟着变大。
+class FlacStreamDecoder : public AudioStreamDecoder {
+public:
+    FlacStreamDecoder() = default;
+    ~FlacStreamDecoder() override;
+
+    AudioStreamFormat format() const override { return AudioStreamFormat::kFlac; }
+    Status Decode(const uint8_t* data, size_t size, bool more_available,
+                  size_t& consumed, AudioFrame& frame) override;
+    void Reset() override;
+
+    static constexpr int kMaxBlockSize = 16384;    // 可流式播放子集的上限
+    static constexpr size_t kMaxWindowSize = 128 * 1024;
+
+private:
+    enum class State {
+        kMarker,
+        kMetadata,
+        kFrames,
+        kInvalid,
+    };
+
+    enum class FrameResult {
+        kOk,
+        kTruncated,  // 数据不足一帧
+        kCorrupt,    // 帧头或 CRC 错误，需要重新同步
+    };
+
+    State state_ = State::kMarker;
+    bool has_stream_info_ = false;
+    int sample_rate_ = 0;
+    int channels_ = 0;
+    int bits_per_sample_ = 0;
+    int max_block_size_ = 0;
+    size_t window_limit_ = 0;
+
+    // 每个声道的解码结果和交错的 16 位输出，按 STREAMINFO 的最大块长度分配在 PSRAM 中
+    int32_t* samples_[2] = {};
+    int16_t* pcm_ = nullptr;
+    int allocated_block_size_ = 0;
+
+    std::vector<uint8_t> window_;
+
+    Status ParseMetadata(const uint8_t* data, size_t size, bool more_available, size_t& consumed);
+    bool ParseStreamInfo(const uint8_t* data);
+    bool Allocate(int block_size);
+    void Free();
+
+    Status DecodeInPlace(const uint8_t* data, size_t size, bool more_available, size_t& consumed, AudioFrame& frame);
+    Status DecodeWindow(const uint8_t* data, size_t size, bool more_available, size_t& consumed, AudioFrame& frame);
+    FrameResult DecodeFrame(const uint8_t* data, size_t size, size_t& length, AudioFrame& frame);
+    // 以 data 开头的帧头有效（同步码、保留位和 CRC-8 都正确）时返回 true，数据不足时 truncated 为 true
+    bool IsFrameHeader(const uint8_t* data, size_t size, bool& truncated) const;
+};
+
+#endif // FLAC_STREAM_DECODER_H
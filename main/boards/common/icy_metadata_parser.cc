@@ -0,0 +1,102 @@
+#include "icy_metadata_parser.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "IcyMetadata"
+
+void IcyMetadataParser::Reset(size_t metaint) {
+    metaint_ = metaint;
+    state_ = kAudio;
+    remaining_ = metaint;
+    metadata_.clear();
+}
+
+size_t IcyMetadataParser::Feed(uint8_t* data, size_t size) {
+    if (metaint_ == 0) {
+        return size;
+    }
+
+    size_t output = 0;
+    size_t input = 0;
+    while (input < size) {
+        switch (state_) {
+        case kAudio: {
+            size_t count = std::min(remaining_, size - input);
+            if (output != input) {
+                memmove(data + output, data + input, count);
+            }
+            output += count;
+            input += count;
+            remaining_ -= count;
+            if (remaining_ == 0) {
+                state_ = kLength;
+            }
+            break;
+        }
+        case kLength:
+            remaining_ = data[input++] * 16;
+            metadata_.clear();
+            if (remaining_ == 0) {
+                // 标题没有变化时服务器只发一个 0
+                state_ = kAudio;
+                remaining_ = metaint_;
+            } else {
+                state_ = kMetadata;
+            }
+            break;
+        case kMetadata: {
+            size_t count = std::min(remaining_, size - input);
+            metadata_.append(reinterpret_cast<const char*>(data + input), count);
+            input += count;
+            remaining_ -= count;
+            if (remaining_ == 0) {
+                OnMetadata();
+                state_ = kAudio;
+                remaining_ = metaint_;
+            }
+            break;
+        }
+        }
+    }
+    return output;
+}
+
+void IcyMetadataParser::OnMetadata() {
+    // 元数据按 16 字节对齐，末尾用 0 填充
+    metadata_.resize(strnlen(metadata_.c_str(), metadata_.size()));
+    ESP_LOGD(TAG, "Metadata: %s", metadata_.c_str());
+    std::string title = ParseStreamTitle(metadata_);
+    if (!title.empty() && title != title_) {
+        title_ = title;
+        title_changed_ = true;
+    }
+}
+
+bool IcyMetadataParser::TakeTitle(std::string& title) {
+    if (!title_changed_) {
+        return false;
+    }
+    title_changed_ = false;
+    title = title_;
+    return true;
+}
+
+std::string IcyMetadataParser::ParseStreamTitle(const std::string& metadata) {
+    static const char kKey[] = "StreamTitle='";
+    size_t start = metadata.find(kKey);
+    if (start == std::string::npos) {
+        return "";
+    }
+    start += sizeof(kKey) - 1;
+    // 标题里可能有单引号，以 '; 作为结尾，最后一个字段没有分号
+    size_t end = metadata.find("';", start);
+    if (end == std::string::npos) {
+        end = metadata.rfind('\'');
+        if (end == std::string::npos || end < start) {
+            end = metadata.size();
+        }
+    }
+    return metadata.substr(start, end - start);
+}
@@ -0,0 +1,43 @@
+#ifndef ICY_METADATA_PARSER_H
+#define ICY_METADATA_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ICY（SHOUTcast/Icecast）电台流的元数据分离
+// 请求头带 Icy-MetaData: 1 时，服务器在响应头 icy-metaint 中给出间隔，每隔这么多字节音频插入一段元数据：
+// 1 字节长度（乘以 16）加上文本，如 StreamTitle='歌手 - 歌名';StreamUrl='';
+// Feed 在原地去掉元数据，只留下连续的音频数据，元数据可以跨越多次读取。
+class IcyMetadataParser {
+public:
+    // metaint 为 0 表示服务器不插入元数据，数据原样通过
+    void Reset(size_t metaint);
+
+    // 去掉 data 中的元数据，音频数据移到前面，返回音频字节数
+    size_t Feed(uint8_t* data, size_t size);
+
+    // 标题变化后返回 true 并取出新标题，每次变化只返回一次
+    bool TakeTitle(std::string& title);
+
+    // 从一段元数据中取出 StreamTitle，没有时返回空字符串
+    static std::string ParseStreamTitle(const std::string& metadata);
+
+private:
+    enum State {
+        kAudio,
+        kLength,
+        kMetadata,
+    };
+
+    size_t metaint_ = 0;
+    State state_ = kAudio;
+    size_t remaining_ = 0;  // 当前阶段还剩的字节数：音频阶段为距下一段元数据的字节数，元数据阶段为未读的元数据长度
+    std::string metadata_;
+    std::string title_;
+    bool title_changed_ = false;
+
+    void OnMetadata();
+};
+
+#endif // ICY_METADATA_PARSER_H
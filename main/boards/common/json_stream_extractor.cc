@@ -0,0 +1,293 @@
+#include "json_stream_extractor.h"
+
+#include <esp_log.h>
+
+#define TAG "JsonStreamExtractor"
+
+JsonStreamExtractor::JsonStreamExtractor(std::vector<std::string> paths, Callback callback)
+    : paths_(std::move(paths)), callback_(std::move(callback)) {
+    stack_.reserve(kMaxDepth);
+    value_.reserve(kMaxKeyLength + 1);
+}
+
+bool JsonStreamExtractor::Feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !stopped_; i++) {
+        if (!ProcessChar(data[i])) {
+            break;
+        }
+    }
+    return !stopped_;
+}
+
+bool JsonStreamExtractor::Fail() {
+    ESP_LOGW(TAG, "Malformed JSON at depth %u", (unsigned int)stack_.size());
+    failed_ = true;
+    stopped_ = true;
+    return false;
+}
+
+bool JsonStreamExtractor::ProcessChar(char c) {
+    bool whitespace = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+
+    switch (state_) {
+    case State::kString:
+        if (unicode_digits_ > 0) {
+            int digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return Fail();
+            }
+            unicode_value_ = (unicode_value_ << 4) | digit;
+            if (--unicode_digits_ == 0) {
+                AppendCodePoint(unicode_value_);
+            }
+            return true;
+        }
+        if (escape_) {
+            escape_ = false;
+            switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                AppendChar(c);
+                break;
+            case 'b': AppendChar('\b'); break;
+            case 'f': AppendChar('\f'); break;
+            case 'n': AppendChar('\n'); break;
+            case 'r': AppendChar('\r'); break;
+            case 't': AppendChar('\t'); break;
+            case 'u':
+                unicode_digits_ = 4;
+                unicode_value_ = 0;
+                break;
+            default:
+                return Fail();
+            }
+            return true;
+        }
+        if (c == '\\') {
+            escape_ = true;
+        } else if (c == '"') {
+            if (string_is_key_) {
+                stack_.back().key = value_;
+                value_.clear();
+                state_ = State::kColon;
+            } else {
+                return EndValue();
+            }
+        } else {
+            AppendChar(c);
+        }
+        return true;
+
+    case State::kLiteral:
+        if (whitespace || c == ',' || c == '}' || c == ']') {
+            if (!EndValue()) {
+                return false;
+            }
+            return ProcessChar(c);
+        }
+        AppendChar(c);
+        return true;
+
+    default:
+        break;
+    }
+
+    if (whitespace) {
+        return true;
+    }
+
+    switch (state_) {
+    case State::kValue:
+        if (c == '{' || c == '[') {
+            if (stack_.size() >= kMaxDepth) {
+                return Fail();
+            }
+            stack_.push_back({c == '[', 0, std::string()});
+            state_ = c == '[' ? State::kValue : State::kObjectFirst;
+        } else if (c == ']' && !stack_.empty() && stack_.back().is_array) {
+            // 空数组
+            EndContainer();
+        } else if (c == '"') {
+            BeginValue();
+            string_is_key_ = false;
+            state_ = State::kString;
+        } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+            BeginValue();
+            state_ = State::kLiteral;
+            AppendChar(c);
+        } else {
+            return Fail();
+        }
+        return true;
+
+    case State::kObjectFirst:
+    case State::kKey:
+        if (c == '"') {
+            string_is_key_ = true;
+            escape_ = false;
+            unicode_digits_ = 0;
+            high_surrogate_ = 0;
+            value_.clear();
+            state_ = State::kString;
+        } else if (c == '}' && state_ == State::kObjectFirst) {
+            EndContainer();
+        } else {
+            return Fail();
+        }
+        return true;
+
+    case State::kColon:
+        if (c != ':') {
+            return Fail();
+        }
+        state_ = State::kValue;
+        return true;
+
+    case State::kAfterValue:
+        if (stack_.empty()) {
+            return Fail();
+        }
+        if (c == ',') {
+            if (stack_.back().is_array) {
+                stack_.back().index++;
+                state_ = State::kValue;
+            } else {
+                state_ = State::kKey;
+            }
+        } else if ((c == '}' && !stack_.back().is_array) || (c == ']' && stack_.back().is_array)) {
+            EndContainer();
+        } else {
+            return Fail();
+        }
+        return true;
+
+    case State::kDone:
+        // 根值之后的非空白内容不再关心
+        stopped_ = true;
+        return false;
+
+    default:
+        return Fail();
+    }
+}
+
+void JsonStreamExtractor::BeginValue() {
+    capture_field_ = MatchCurrentPath();
+    escape_ = false;
+    unicode_digits_ = 0;
+    high_surrogate_ = 0;
+    value_.clear();
+}
+
+bool JsonStreamExtractor::EndValue() {
+    state_ = stack_.empty() ? State::kDone : State::kAfterValue;
+    if (capture_field_ >= 0) {
+        int index = 0;
+        for (auto it = stack_.rbegin(); it != stack_.rend(); ++it) {
+            if (it->is_array) {
+                index = it->index;
+                break;
+            }
+        }
+        if (!callback_(capture_field_, index, value_)) {
+            stopped_ = true;
+        }
+        capture_field_ = -1;
+    }
+    value_.clear();
+    if (state_ == State::kDone) {
+        stopped_ = true;
+    }
+    return !stopped_;
+}
+
+void JsonStreamExtractor::EndContainer() {
+    stack_.pop_back();
+    if (stack_.empty()) {
+        state_ = State::kDone;
+        stopped_ = true;
+    } else {
+        state_ = State::kAfterValue;
+    }
+}
+
+void JsonStreamExtractor::AppendChar(char c) {
+    if (string_is_key_ && state_ == State::kString) {
+        // 超长的键名多保留一个字符，保证不会误匹配
+        if (value_.size() <= kMaxKeyLength) {
+            value_.push_back(c);
+        }
+    } else if (capture_field_ >= 0 && value_.size() < kMaxValueLength) {
+        value_.push_back(c);
+    }
+}
+
+void JsonStreamExtractor::AppendCodePoint(uint32_t code_point) {
+    if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+        high_surrogate_ = code_point;
+        return;
+    }
+    if (code_point >= 0xDC00 && code_point <= 0xDFFF && high_surrogate_ != 0) {
+        code_point = 0x10000 + ((high_surrogate_ - 0xD800) << 10) + (code_point - 0xDC00);
+    }
+    high_surrogate_ = 0;
+
+    // 编码为 UTF-8
+    if (code_point < 0x80) {
+        AppendChar(code_point);
+    } else if (code_point < 0x800) {
+        AppendChar(0xC0 | (code_point >> 6));
+        AppendChar(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        AppendChar(0xE0 | (code_point >> 12));
+        AppendChar(0x80 | ((code_point >> 6) & 0x3F));
+        AppendChar(0x80 | (code_point & 0x3F));
+    } else {
+        AppendChar(0xF0 | (code_point >> 18));
+        AppendChar(0x80 | ((code_point >> 12) & 0x3F));
+        AppendChar(0x80 | ((code_point >> 6) & 0x3F));
+        AppendChar(0x80 | (code_point & 0x3F));
+    }
+}
+
+int JsonStreamExtractor::MatchCurrentPath() const {
+    // 逐层比较路径，不拼接字符串，避免每个值都分配内存
+    for (size_t i = 0; i < paths_.size(); i++) {
+        const std::string& path = paths_[i];
+        size_t pos = 0;
+        bool matched = true;
+        for (auto& frame : stack_) {
+            if (frame.is_array) {
+                if (path.compare(pos, 2, "[]") != 0) {
+                    matched = false;
+                    break;
+                }
+                pos += 2;
+            } else {
+                if (pos > 0) {
+                    if (pos >= path.size() || path[pos] != '.') {
+                        matched = false;
+                        break;
+                    }
+                    pos++;
+                }
+                if (path.compare(pos, frame.key.size(), frame.key) != 0) {
+                    matched = false;
+                    break;
+                }
+                pos += frame.key.size();
+            }
+        }
+        if (matched && pos == path.size()) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,78 @@
+#ifndef JSON_STREAM_EXTRACTOR_H
+#define JSON_STREAM_EXTRACTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 增量式 JSON 字段提取器
+// 数据可以分块喂入（例如直接来自 HTTP Read），只保留需要的字段值，
+// 不构建整棵 JSON 树，内存占用只和嵌套深度与单个字段长度有关。
+//
+// 字段用路径描述：对象成员用 "." 分隔，数组元素用 "[]"，
+// 例如 "abslist[].DC_TARGETID" 匹配 abslist 数组中每个对象的 DC_TARGETID。
+// 字符串、数字、布尔值都以文本形式回调，index 为最内层数组中的元素序号。
+class JsonStreamExtractor {
+public:
+    // field 为匹配到的路径在构造参数中的序号，返回 false 表示不再需要更多数据
+    using Callback = std::function<bool(int field, int index, const std::string& value)>;
+
+    static constexpr size_t kMaxDepth = 16;
+    static constexpr size_t kMaxKeyLength = 32;     // 更长的键名会被截断，不会匹配任何路径
+    static constexpr size_t kMaxValueLength = 256;  // 更长的值会被截断
+
+    JsonStreamExtractor(std::vector<std::string> paths, Callback callback);
+
+    // 返回 false 表示已经停止（回调要求停止、解析完成或格式错误），调用方可以关闭连接
+    bool Feed(const char* data, size_t size);
+
+    bool stopped() const { return stopped_; }
+    bool failed() const { return failed_; }
+
+private:
+    enum class State {
+        kValue,        // 期待一个值
+        kObjectFirst,  // '{' 之后，期待键或 '}'
+        kKey,          // ',' 之后，期待键
+        kColon,
+        kAfterValue,   // 期待 ',' 或结束符
+        kString,
+        kLiteral,      // 数字、true、false、null
+        kDone,
+    };
+
+    struct Frame {
+        bool is_array;
+        int index;
+        std::string key;
+    };
+
+    std::vector<std::string> paths_;
+    Callback callback_;
+    std::vector<Frame> stack_;
+    State state_ = State::kValue;
+    bool stopped_ = false;
+    bool failed_ = false;
+
+    // 当前字符串/字面量的状态
+    bool string_is_key_ = false;
+    bool escape_ = false;
+    int unicode_digits_ = 0;
+    uint32_t unicode_value_ = 0;
+    uint32_t high_surrogate_ = 0;
+    int capture_field_ = -1;  // 当前值匹配的路径序号，-1 表示不保存
+    std::string value_;
+
+    bool ProcessChar(char c);
+    void BeginValue();
+    bool EndValue();
+    void EndContainer();
+    void AppendChar(char c);
+    void AppendCodePoint(uint32_t code_point);
+    int MatchCurrentPath() const;
+    bool Fail();
+};
+
+#endif // JSON_STREAM_EXTRACTOR_H
@@ -0,0 +1,42 @@
+#include "lyric_timeline.h"
+
+#include <algorithm>
+#include <cstring>
+
+void LyricTimeline::Builder::Reserve(size_t lines, size_t text_bytes) {
+    lines_.reserve(lines);
+    text_.reserve(text_bytes);
+}
+
+void LyricTimeline::Builder::Add(int64_t time_ms, const char* text) {
+    lines_.emplace_back(time_ms, (uint32_t)text_.size());
+    text_.append(text);
+    text_.push_back('\0');
+}
+
+std::shared_ptr<const LyricTimeline> LyricTimeline::Builder::Build() {
+    if (lines_.empty()) {
+        return nullptr;
+    }
+    // 同一时间的多行保持原来的顺序
+    std::stable_sort(lines_.begin(), lines_.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    auto timeline = std::make_shared<LyricTimeline>();
+    timeline->lines_.reserve(lines_.size());
+    for (auto& line : lines_) {
+        timeline->lines_.push_back({line.first, line.second});
+    }
+    timeline->text_ = std::move(text_);
+    timeline->text_.shrink_to_fit();
+    lines_.clear();
+    return timeline;
+}
+
+int LyricTimeline::Find(int64_t time_ms) const {
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), time_ms, [](int64_t value, const Line& line) {
+        return value < line.time_ms;
+    });
+    return (int)(it - lines_.begin()) - 1;
+}
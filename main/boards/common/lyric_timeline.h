@@ -0,0 +1,43 @@
+#ifndef LYRIC_TIMELINE_H
+#define LYRIC_TIMELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 一首歌的歌词时间轴，构建完成后不再修改，可以被多个线程同时读取
+// 所有歌词文本连续存放在一块内存中，每行只保存时间戳和文本偏移，按时间二分查找。
+class LyricTimeline {
+public:
+    class Builder {
+    public:
+        void Reserve(size_t lines, size_t text_bytes);
+        void Add(int64_t time_ms, const char* text);
+        // 按时间排序后生成时间轴，没有任何歌词时返回空指针
+        std::shared_ptr<const LyricTimeline> Build();
+
+    private:
+        std::vector<std::pair<int64_t, uint32_t>> lines_;
+        std::string text_;
+    };
+
+    size_t size() const { return lines_.size(); }
+    int64_t time_ms(int index) const { return lines_[index].time_ms; }
+    const char* text(int index) const { return text_.c_str() + lines_[index].offset; }
+
+    // 返回 time_ms 时应显示的歌词行，还没到第一行时返回 -1
+    int Find(int64_t time_ms) const;
+
+private:
+    struct Line {
+        int64_t time_ms;
+        uint32_t offset;  // 文本在 text_ 中的偏移，以 '\0' 结尾
+    };
+
+    std::vector<Line> lines_;
+    std::string text_;
+};
+
+#endif // LYRIC_TIMELINE_H
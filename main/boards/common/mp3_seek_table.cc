@@ -0,0 +1,267 @@
+#include "mp3_seek_table.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "Mp3SeekTable"
+
+namespace {
+
+const int kBitratesV1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+const int kBitratesV2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+const int kSampleRatesV1[3] = {44100, 48000, 32000};
+
+uint32_t ReadBigEndian(const uint8_t* data, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+} // namespace
+
+void Mp3SeekTable::Reset() {
+    type_ = Type::kNone;
+    audio_start_ = 0;
+    audio_bytes_ = 0;
+    duration_ms_ = 0;
+    frame_ms_ = 0;
+    bitrate_kbps_ = 0;
+    vbri_offsets_.clear();
+    vbri_entry_ms_ = 0;
+}
+
+bool Mp3SeekTable::Parse(const uint8_t* frame, size_t size, size_t audio_start, size_t file_size) {
+    Reset();
+    if (size < 4 || frame[0] != 0xFF || (frame[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+
+    // 帧头：版本 2 位，层 2 位，码率索引 4 位，采样率索引 2 位，声道模式 2 位
+    int version = (frame[1] >> 3) & 0x03;  // 0: MPEG2.5, 2: MPEG2, 3: MPEG1
+    int layer = (frame[1] >> 1) & 0x03;    // 1: Layer III
+    int bitrate_index = (frame[2] >> 4) & 0x0F;
+    int sample_rate_index = (frame[2] >> 2) & 0x03;
+    bool mono = ((frame[3] >> 6) & 0x03) == 0x03;
+    if (version == 1 || layer != 1 || sample_rate_index == 3) {
+        return false;
+    }
+
+    bool mpeg1 = version == 3;
+    int sample_rate = kSampleRatesV1[sample_rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    int samples_per_frame = mpeg1 ? 1152 : 576;
+    size_t side_info_size = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+
+    audio_start_ = audio_start;
+    frame_ms_ = (int64_t)samples_per_frame * 1000 / sample_rate;
+    audio_bytes_ = file_size > audio_start ? file_size - audio_start : 0;
+    bitrate_kbps_ = mpeg1 ? kBitratesV1[bitrate_index] : kBitratesV2[bitrate_index];
+
+    if (ParseXing(frame, size, side_info_size, samples_per_frame, sample_rate)) {
+        type_ = Type::kXing;
+    } else if (ParseVbri(frame, size, samples_per_frame, sample_rate)) {
+        type_ = Type::kVbri;
+    } else if (bitrate_kbps_ > 0 && audio_bytes_ > 0) {
+        // 没有 VBR 头，按固定码率估算
+        type_ = Type::kCbr;
+        duration_ms_ = (int64_t)audio_bytes_ * 8 / bitrate_kbps_;
+    }
+
+    if (!valid()) {
+        Reset();
+        return false;
+    }
+    ESP_LOGI(TAG, "Seek table ready: type=%d, duration=%lldms, audio bytes=%u",
+             (int)type_, duration_ms_, (unsigned int)audio_bytes_);
+    return true;
+}
+
+bool Mp3SeekTable::ParseXing(const uint8_t* frame, size_t size, size_t side_info_size, int samples_per_frame, int sample_rate) {
+    size_t pos = 4 + side_info_size;
+    if (size < pos + 8 || (memcmp(frame + pos, "Xing", 4) != 0 && memcmp(frame + pos, "Info", 4) != 0)) {
+        return false;
+    }
+    uint32_t flags = ReadBigEndian(frame + pos + 4, 4);
+    pos += 8;
+
+    uint32_t frames = 0;
+    if (flags & 0x01) {
+        if (size < pos + 4) {
+            return false;
+        }
+        frames = ReadBigEndian(frame + pos, 4);
+        pos += 4;
+    }
+    if (flags & 0x02) {
+        if (size < pos + 4) {
+            return false;
+        }
+        audio_bytes_ = ReadBigEndian(frame + pos, 4);
+        pos += 4;
+    }
+    if ((flags & 0x04) == 0 || size < pos + sizeof(xing_toc_) || frames == 0 || audio_bytes_ == 0) {
+        return false;
+    }
+    memcpy(xing_toc_, frame + pos, sizeof(xing_toc_));
+    duration_ms_ = (int64_t)frames * samples_per_frame * 1000 / sample_rate;
+    return true;
+}
+
+bool Mp3SeekTable::ParseVbri(const uint8_t* frame, size_t size, int samples_per_frame, int sample_rate) {
+    // VBRI 头固定在帧头后 32 字节处
+    const size_t pos = 4 + 32;
+    if (size < pos + 26 || memcmp(frame + pos, "VBRI", 4) != 0) {
+        return false;
+    }
+    uint32_t bytes = ReadBigEndian(frame + pos + 10, 4);
+    uint32_t frames = ReadBigEndian(frame + pos + 14, 4);
+    int entries = ReadBigEndian(frame + pos + 18, 2);
+    int scale = ReadBigEndian(frame + pos + 20, 2);
+    int entry_size = ReadBigEndian(frame + pos + 22, 2);
+    int frames_per_entry = ReadBigEndian(frame + pos + 24, 2);
+    if (frames == 0 || bytes == 0 || entries == 0 || entry_size < 1 || entry_size > 4 ||
+        size < pos + 26 + (size_t)entries * entry_size) {
+        return false;
+    }
+
+    vbri_offsets_.resize(entries);
+    uint32_t offset = 0;
+    const uint8_t* entry = frame + pos + 26;
+    for (int i = 0; i < entries; i++) {
+        offset += ReadBigEndian(entry, entry_size) * scale;
+        vbri_offsets_[i] = offset;
+        entry += entry_size;
+    }
+    audio_bytes_ = bytes;
+    vbri_entry_ms_ = (int64_t)frames_per_entry * samples_per_frame * 1000 / sample_rate;
+    duration_ms_ = (int64_t)frames * samples_per_frame * 1000 / sample_rate;
+    return vbri_entry_ms_ > 0;
+}
+
+int64_t Mp3SeekTable::PositionOf(size_t offset) const {
+    if (!valid()) {
+        return -1;
+    }
+    size_t relative = offset > audio_start_ ? offset - audio_start_ : 0;
+    int64_t position_ms = 0;
+
+    switch (type_) {
+    case Type::kXing: {
+        // 在 TOC 中找到字节比例所在的区间，区间内按线性插值
+        float fraction = audio_bytes_ > 0 ? (float)relative * 256.0f / audio_bytes_ : 0.0f;
+        int index = 0;
+        while (index < 99 && xing_toc_[index + 1] <= fraction) {
+            index++;
+        }
+        float begin = xing_toc_[index];
+        float end = index < 99 ? xing_toc_[index + 1] : 256.0f;
+        float percent = index + (end > begin ? (fraction - begin) / (end - begin) : 0.0f);
+        position_ms = (int64_t)(percent * duration_ms_ / 100.0f);
+        break;
+    }
+    case Type::kVbri: {
+        size_t index = 0;
+        while (index + 1 < vbri_offsets_.size() && vbri_offsets_[index] <= relative) {
+            index++;
+        }
+        size_t begin = index == 0 ? 0 : vbri_offsets_[index - 1];
+        size_t end = vbri_offsets_[index];
+        position_ms = index * vbri_entry_ms_;
+        if (end > begin && relative > begin) {
+            position_ms += (int64_t)std::min(relative - begin, end - begin) * vbri_entry_ms_ / (end - begin);
+        }
+        break;
+    }
+    case Type::kCbr:
+        position_ms = (int64_t)relative * 8 / bitrate_kbps_;
+        break;
+    default:
+        return -1;
+    }
+    return std::max<int64_t>(0, std::min(position_ms, duration_ms_));
+}
+
+size_t Mp3SeekTable::FrameLength(const uint8_t* header) {
+    if (header[0] != 0xFF || (header[1] & 0xE0) != 0xE0) {
+        return 0;
+    }
+    int version = (header[1] >> 3) & 0x03;
+    int layer = (header[1] >> 1) & 0x03;
+    int bitrate_index = (header[2] >> 4) & 0x0F;
+    int sample_rate_index = (header[2] >> 2) & 0x03;
+    int padding = (header[2] >> 1) & 0x01;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || sample_rate_index == 3) {
+        return 0;
+    }
+    bool mpeg1 = version == 3;
+    int sample_rate = kSampleRatesV1[sample_rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    int bitrate_kbps = mpeg1 ? kBitratesV1[bitrate_index] : kBitratesV2[bitrate_index];
+    return (mpeg1 ? 144000 : 72000) * bitrate_kbps / sample_rate + padding;
+}
+
+int Mp3SeekTable::FindSync(const uint8_t* data, size_t size) {
+    for (size_t offset = 0; offset + 4 <= size; offset++) {
+        size_t length = FrameLength(data + offset);
+        if (length > 0 && offset + length + 4 <= size && FrameLength(data + offset + length) > 0) {
+            return (int)offset;
+        }
+    }
+    return -1;
+}
+
+bool Mp3SeekTable::FindFrameEnd(const uint8_t* data, size_t size, size_t& end) {
+    int sync = FindSync(data, size);
+    if (sync < 0) {
+        return false;
+    }
+    size_t position = sync;
+    while (position < size) {
+        if (position + 4 > size) {
+            return false;
+        }
+        size_t length = FrameLength(data + position);
+        if (length == 0) {
+            return false;
+        }
+        position += length;
+    }
+    end = position;
+    return true;
+}
+
+bool Mp3SeekTable::Lookup(int64_t position_ms, size_t& offset, int64_t& actual_ms) const {
+    if (!valid()) {
+        return false;
+    }
+    // 定位到结尾时Range起点等于文件长度，服务器会返回416，最多跳到最后一帧
+    position_ms = std::max<int64_t>(0, std::min(position_ms, duration_ms_ - frame_ms_));
+    actual_ms = position_ms;
+
+    switch (type_) {
+    case Type::kXing: {
+        // TOC 把时长等分为 100 份，每项是对应位置占总字节数的比例（0-255）
+        float percent = (float)position_ms * 100.0f / duration_ms_;
+        int index = std::min((int)percent, 99);
+        float begin = xing_toc_[index];
+        float end = index < 99 ? xing_toc_[index + 1] : 256.0f;
+        float fraction = begin + (end - begin) * (percent - index);
+        offset = audio_start_ + (size_t)(fraction / 256.0f * audio_bytes_);
+        break;
+    }
+    case Type::kVbri: {
+        // 定位到条目边界，返回该边界实际对应的时间
+        size_t index = std::min((size_t)(position_ms / vbri_entry_ms_), vbri_offsets_.size() - 1);
+        offset = audio_start_ + (index == 0 ? 0 : vbri_offsets_[index - 1]);
+        actual_ms = index * vbri_entry_ms_;
+        break;
+    }
+    case Type::kCbr:
+        offset = audio_start_ + (size_t)(position_ms * bitrate_kbps_ / 8);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
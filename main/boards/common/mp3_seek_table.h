@@ -0,0 +1,61 @@
+#ifndef MP3_SEEK_TABLE_H
+#define MP3_SEEK_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// MP3 时间到字节偏移的索引
+// 从第一帧解析 Xing/Info 或 VBRI 头中的 TOC；都没有时按第一帧的码率当作 CBR 估算。
+// 偏移量都是相对整个文件的，可以直接用于 HTTP Range 请求。
+class Mp3SeekTable {
+public:
+    Mp3SeekTable() = default;
+
+    void Reset();
+
+    // frame 指向第一帧的帧头，audio_start 是该帧在文件中的偏移，
+    // file_size 为整个文件长度（未知时传 0，此时 CBR 无法计算时长）
+    bool Parse(const uint8_t* frame, size_t size, size_t audio_start, size_t file_size);
+
+    inline bool valid() const { return duration_ms_ > 0; }
+    inline int64_t duration_ms() const { return duration_ms_; }
+    inline size_t audio_start() const { return audio_start_; }
+
+    // 查找 position_ms 对应的文件偏移，actual_ms 返回该偏移实际对应的播放时间
+    // 超过时长时定位到最后一帧，偏移总在文件范围内
+    bool Lookup(int64_t position_ms, size_t& offset, int64_t& actual_ms) const;
+    // Lookup 的反向换算：文件偏移对应的播放时间，索引无效时返回 -1
+    int64_t PositionOf(size_t offset) const;
+
+    // 解析 Layer III 帧头，返回整帧长度，不是有效帧头时返回 0
+    static size_t FrameLength(const uint8_t* header);
+    // 找到连续两个有效帧头作为同步点，避免把音频数据误认为帧头，找不到时返回 -1
+    static int FindSync(const uint8_t* data, size_t size);
+    // 从同步点开始按帧长度前进，end 返回跨过 data 末尾的那一帧的结尾（相对 data 开头）
+    // 数据正好在帧边界结束时 end 等于 size；找不到同步点或末尾的帧头不完整时返回 false
+    static bool FindFrameEnd(const uint8_t* data, size_t size, size_t& end);
+
+private:
+    enum class Type {
+        kNone,
+        kXing,
+        kVbri,
+        kCbr,
+    };
+
+    bool ParseXing(const uint8_t* frame, size_t size, size_t side_info_size, int samples_per_frame, int sample_rate);
+    bool ParseVbri(const uint8_t* frame, size_t size, int samples_per_frame, int sample_rate);
+
+    Type type_ = Type::kNone;
+    size_t audio_start_ = 0;
+    size_t audio_bytes_ = 0;
+    int64_t duration_ms_ = 0;
+    int64_t frame_ms_ = 0;
+    int bitrate_kbps_ = 0;
+    uint8_t xing_toc_[100] = {};
+    std::vector<uint32_t> vbri_offsets_;  // 每个 TOC 条目结束处的累计字节数
+    int64_t vbri_entry_ms_ = 0;           // 每个 TOC 条目覆盖的时长
+};
+
+#endif // MP3_SEEK_TABLE_H
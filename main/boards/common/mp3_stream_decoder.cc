@@ -0,0 +1,74 @@
+#include "mp3_stream_decoder.h"
+
+#include <esp_log.h>
+
+#define TAG "Mp3StreamDecoder"
+
+Mp3StreamDecoder::Mp3StreamDecoder() {
+    decoder_ = MP3InitDecoder();
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to initialize MP3 decoder");
+    }
+}
+
+Mp3StreamDecoder::~Mp3StreamDecoder() {
+    if (decoder_ != nullptr) {
+        MP3FreeDecoder(decoder_);
+    }
+}
+
+void Mp3StreamDecoder::Reset() {
+    // libhelix 没有重置接口，跳转后第一帧缺少比特储备时返回 MAINDATA_UNDERFLOW，跳过即可
+}
+
+AudioStreamDecoder::Status Mp3StreamDecoder::Decode(const uint8_t* data, size_t size, bool more_available,
+                                                    size_t& consumed, AudioFrame& frame) {
+    uint8_t* read_ptr = const_cast<uint8_t*>(data);
+    int sync_offset = MP3FindSyncWord(read_ptr, size);
+    if (sync_offset < 0) {
+        ESP_LOGW(TAG, "No MP3 sync word found, skipping %u bytes", (unsigned int)size);
+        consumed = size;
+        return Status::kSkipped;
+    }
+
+    uint8_t* frame_ptr = read_ptr + sync_offset;
+    int bytes_left = size - sync_offset;
+    int result = MP3Decode(decoder_, &frame_ptr, &bytes_left, pcm_, 0);
+
+    if (result == ERR_MP3_INDATA_UNDERFLOW) {
+        if (more_available) {
+            // 帧不完整，先丢掉同步字之前的数据，等待下载线程补充
+            consumed = sync_offset;
+            return sync_offset > 0 ? Status::kSkipped : Status::kNeedMoreData;
+        }
+        // 流末尾的残帧
+        consumed = size;
+        return Status::kSkipped;
+    }
+
+    if (result == ERR_MP3_MAINDATA_UNDERFLOW) {
+        // 比特储备不足（跳转后的前几帧），解码器已经越过这一帧
+        consumed = frame_ptr - read_ptr;
+        return Status::kSkipped;
+    }
+
+    if (result != ERR_MP3_NONE) {
+        ESP_LOGW(TAG, "MP3 decode failed with error: %d", result);
+        consumed = sync_offset + 1;
+        return Status::kSkipped;
+    }
+
+    consumed = frame_ptr - read_ptr;
+    MP3FrameInfo info;
+    MP3GetLastFrameInfo(decoder_, &info);
+    if (info.samprate == 0 || info.nChans == 0 || info.outputSamps == 0) {
+        ESP_LOGW(TAG, "Invalid frame info: rate=%d, channels=%d", info.samprate, info.nChans);
+        return Status::kSkipped;
+    }
+
+    frame.pcm = pcm_;
+    frame.channels = info.nChans;
+    frame.samples = info.outputSamps / info.nChans;
+    frame.sample_rate = info.samprate;
+    return Status::kFrame;
+}
@@ -0,0 +1,29 @@
+#ifndef MP3_STREAM_DECODER_H
+#define MP3_STREAM_DECODER_H
+
+#include "audio_stream_decoder.h"
+
+extern "C" {
+#include "mp3dec.h"
+}
+
+// 基于 libhelix 的 MP3 解码器
+class Mp3StreamDecoder : public AudioStreamDecoder {
+public:
+    Mp3StreamDecoder();
+    ~Mp3StreamDecoder() override;
+
+    AudioStreamFormat format() const override { return AudioStreamFormat::kMp3; }
+    bool valid() const override { return decoder_ != nullptr; }
+    Status Decode(const uint8_t* data, size_t size, bool more_available,
+                  size_t& consumed, AudioFrame& frame) override;
+    void Reset() override;
+
+private:
+    static constexpr int kMaxOutputSamples = 1152 * 2;
+
+    HMP3Decoder decoder_;
+    int16_t pcm_[kMaxOutputSamples];
+};
+
+#endif // MP3_STREAM_DECODER_H
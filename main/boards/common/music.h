@@ -2,6 +2,7 @@
 #define MUSIC_H
 
 #include <string>
+#include <cstdint>
 
 class Music {
 public:
@@ -16,6 +17,21 @@ public:
     // 新增流式播放相关方法
     virtual bool StartStreaming(const std::string& music_url) = 0;
     virtual bool StopStreaming() = 0;  // 停止流式播放
+    virtual bool Seek(int64_t position_ms) = 0;  // 跳转到当前歌曲的指定位置
+    virtual int64_t GetPlaybackPositionMs() const = 0;  // 当前歌曲实际播放到的位置
+
+    // 播放队列相关方法
+    virtual bool NextSong() = 0;      // 用户切到下一首
+    virtual bool PreviousSong() = 0;  // 回到上一首
+    virtual std::string GetPlayQueue() = 0;  // 当前歌曲、播放模式和接下来的歌曲，JSON格式
+    virtual bool SetPlayMode(const std::string& mode) = 0;  // sequential/repeat_all/repeat_one/shuffle
+
+    // 播放网络电台的直播流，没有结尾，断开后自动重连，不支持跳转和切歌
+    virtual bool PlayRadio(const std::string& url, const std::string& name) = 0;
+
+    // 对话期间暂停播放，下载连接和已缓冲的数据都保留，Resume 后从暂停处继续
+    virtual void Suspend() = 0;
+    virtual void Resume() = 0;
     virtual size_t GetBufferSize() const = 0;
     virtual bool IsDownloading() const = 0;
 };
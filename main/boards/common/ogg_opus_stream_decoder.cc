@@ -0,0 +1,262 @@
+#include "ogg_opus_stream_decoder.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <opus.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "OggOpusStreamDecoder"
+
+static constexpr size_t kPageHeaderSize = 27;
+static constexpr uint8_t kPageContinued = 0x01;
+static constexpr uint8_t kPageBeginOfStream = 0x02;
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+OggOpusStreamDecoder::OggOpusStreamDecoder() {
+    pcm_ = (int16_t*)heap_caps_malloc(kMaxFrameSamples * 2 * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (pcm_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate PCM buffer");
+    }
+}
+
+OggOpusStreamDecoder::~OggOpusStreamDecoder() {
+    if (decoder_ != nullptr) {
+        opus_decoder_destroy(decoder_);
+    }
+    if (pcm_ != nullptr) {
+        heap_caps_free(pcm_);
+    }
+}
+
+void OggOpusStreamDecoder::Reset() {
+    // 解码器实例保留，收到下一个 OpusHead 时按声道数复用或重建
+    in_page_ = false;
+    serial_locked_ = false;
+    segment_count_ = 0;
+    segment_index_ = 0;
+    partial_packet_.clear();
+    partial_overflow_ = false;
+    packet_count_ = 0;
+    pre_skip_ = 0;
+}
+
+AudioStreamDecoder::Status OggOpusStreamDecoder::Decode(const uint8_t* data, size_t size, bool more_available,
+                                                        size_t& consumed, AudioFrame& frame) {
+    consumed = 0;
+    if (!in_page_) {
+        return ParsePageHeader(data, size, more_available, consumed);
+    }
+
+    // 连续的 255 段拼成一个包，遇到小于 255 的段表示包结束
+    size_t length = 0;
+    int end = segment_index_;
+    bool complete = false;
+    while (end < segment_count_) {
+        length += segments_[end];
+        if (segments_[end++] < 255) {
+            complete = true;
+            break;
+        }
+    }
+
+    if (size < length) {
+        if (more_available) {
+            return Status::kNeedMoreData;
+        }
+        // 包比一次能取到的数据还长，丢弃本页剩余内容
+        ESP_LOGW(TAG, "Ogg packet too large: %u bytes", (unsigned int)length);
+        consumed = size;
+        in_page_ = false;
+        partial_packet_.clear();
+        partial_overflow_ = true;
+        return Status::kSkipped;
+    }
+
+    consumed = length;
+    segment_index_ = end;
+    if (segment_index_ >= segment_count_) {
+        in_page_ = false;
+    }
+
+    if (!complete || !partial_packet_.empty() || partial_overflow_) {
+        // 跨页的包先拼接起来
+        if (!partial_overflow_ && partial_packet_.size() + length <= kMaxPacketSize) {
+            partial_packet_.insert(partial_packet_.end(), data, data + length);
+        } else {
+            partial_packet_.clear();
+            partial_overflow_ = true;
+        }
+        if (!complete) {
+            return Status::kSkipped;
+        }
+        Status status = Status::kSkipped;
+        if (!partial_overflow_) {
+            status = ProcessPacket(partial_packet_.data(), partial_packet_.size(), frame);
+        }
+        partial_packet_.clear();
+        partial_overflow_ = false;
+        return status;
+    }
+
+    if (length == 0) {
+        // 长度为 0 的包没有数据可消费，直接处理下一个
+        return Decode(data, size, more_available, consumed, frame);
+    }
+    return ProcessPacket(data, length, frame);
+}
+
+AudioStreamDecoder::Status OggOpusStreamDecoder::ParsePageHeader(const uint8_t* data, size_t size,
+                                                                 bool more_available, size_t& consumed) {
+    if (size < kPageHeaderSize) {
+        if (more_available) {
+            return Status::kNeedMoreData;
+        }
+        consumed = size;
+        return Status::kSkipped;
+    }
+
+    if (memcmp(data, "OggS", 4) != 0) {
+        // 失去同步，找下一个页头
+        const uint8_t* found = nullptr;
+        for (size_t i = 1; i + 4 <= size; i++) {
+            if (memcmp(data + i, "OggS", 4) == 0) {
+                found = data + i;
+                break;
+            }
+        }
+        consumed = found ? found - data : std::max(size - 3, (size_t)1);
+        ESP_LOGW(TAG, "Lost Ogg sync, skipping %u bytes", (unsigned int)consumed);
+        return Status::kSkipped;
+    }
+
+    int segment_count = data[26];
+    size_t header_size = kPageHeaderSize + segment_count;
+    if (size < header_size) {
+        if (more_available) {
+            return Status::kNeedMoreData;
+        }
+        consumed = size;
+        return Status::kSkipped;
+    }
+
+    uint8_t header_type = data[5];
+    uint32_t serial = ReadLe32(data + 14);
+    if (serial_locked_ && serial != serial_ && (header_type & kPageBeginOfStream)) {
+        // 串联的下一个逻辑流（例如网络电台换曲），重新解析 OpusHead
+        ESP_LOGI(TAG, "New chained Ogg stream");
+        Reset();
+    }
+    if (!serial_locked_) {
+        serial_ = serial;
+        serial_locked_ = true;
+    }
+
+    if (serial != serial_) {
+        // 复用在一起的其他逻辑流，整页跳过
+        size_t body_size = 0;
+        for (int i = 0; i < segment_count; i++) {
+            body_size += data[kPageHeaderSize + i];
+        }
+        consumed = header_size + body_size;
+        return Status::kSkipped;
+    }
+
+    if (header_type & kPageContinued) {
+        // 上一页的包没有接上（例如从页中间开始播放），这一段只能丢弃
+        if (partial_packet_.empty()) {
+            partial_overflow_ = true;
+        }
+    } else if (!partial_packet_.empty() || partial_overflow_) {
+        partial_packet_.clear();
+        partial_overflow_ = false;
+    }
+
+    memcpy(segments_, data + kPageHeaderSize, segment_count);
+    segment_count_ = segment_count;
+    segment_index_ = 0;
+    in_page_ = segment_count > 0;
+    consumed = header_size;
+    return Status::kSkipped;
+}
+
+AudioStreamDecoder::Status OggOpusStreamDecoder::ProcessPacket(const uint8_t* packet, size_t size, AudioFrame& frame) {
+    int index = packet_count_++;
+    if (index == 0) {
+        ParseOpusHead(packet, size);
+        return Status::kSkipped;
+    }
+    if (index == 1 || decoder_ == nullptr) {
+        // OpusTags 不需要
+        return Status::kSkipped;
+    }
+
+    int samples = opus_decode(decoder_, packet, size, pcm_, kMaxFrameSamples, 0);
+    if (samples < 0) {
+        ESP_LOGW(TAG, "Opus decode failed with error: %d", samples);
+        return Status::kSkipped;
+    }
+
+    int offset = 0;
+    if (pre_skip_ > 0) {
+        offset = std::min(pre_skip_, samples);
+        pre_skip_ -= offset;
+    }
+    if (samples - offset <= 0) {
+        return Status::kSkipped;
+    }
+
+    frame.pcm = pcm_ + offset * channels_;
+    frame.samples = samples - offset;
+    frame.channels = channels_;
+    frame.sample_rate = kSampleRate;
+    return Status::kFrame;
+}
+
+bool OggOpusStreamDecoder::ParseOpusHead(const uint8_t* packet, size_t size) {
+    // 头部无效时不能沿用上一个流的解码器，后续的包全部跳过
+    auto fail = [this]() {
+        if (decoder_ != nullptr) {
+            opus_decoder_destroy(decoder_);
+            decoder_ = nullptr;
+        }
+        return false;
+    };
+
+    if (size < 19 || memcmp(packet, "OpusHead", 8) != 0) {
+        ESP_LOGE(TAG, "Ogg stream is not Opus");
+        return fail();
+    }
+    int version = packet[8];
+    int channels = packet[9];
+    int pre_skip = packet[10] | (packet[11] << 8);
+    uint32_t input_rate = ReadLe32(packet + 12);
+    int mapping_family = packet[18];
+    if ((version >> 4) != 0 || mapping_family != 0 || channels < 1 || channels > 2) {
+        ESP_LOGE(TAG, "Unsupported Opus stream: version=%d, channels=%d, mapping=%d",
+                 version, channels, mapping_family);
+        return fail();
+    }
+
+    if (decoder_ != nullptr && channels == channels_) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    } else {
+        if (decoder_ != nullptr) {
+            opus_decoder_destroy(decoder_);
+        }
+        int error = OPUS_OK;
+        decoder_ = opus_decoder_create(kSampleRate, channels, &error);
+        if (decoder_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create Opus decoder: %d", error);
+            return false;
+        }
+    }
+    channels_ = channels;
+    pre_skip_ = pre_skip;
+    ESP_LOGI(TAG, "Opus stream: %d channels, pre-skip %d, input rate %lu Hz",
+             channels, pre_skip, (unsigned long)input_rate);
+    return true;
+}
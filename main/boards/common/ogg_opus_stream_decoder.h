@@ -0,0 +1,51 @@
+#ifndef OGG_OPUS_STREAM_DECODER_H
+#define OGG_OPUS_STREAM_DECODER_H
+
+#include "audio_stream_decoder.h"
+
+#include <vector>
+
+struct OpusDecoder;
+
+// Ogg 封装的 Opus 解码器（RFC 7845），只支持映射族 0（单声道/双声道）
+// 逐个页头、逐个包地消费数据，单次需要的连续数据只有一个 Opus 包的大小
+class OggOpusStreamDecoder : public AudioStreamDecoder {
+public:
+    OggOpusStreamDecoder();
+    ~OggOpusStreamDecoder() override;
+
+    AudioStreamFormat format() const override { return AudioStreamFormat::kOggOpus; }
+    bool valid() const override { return pcm_ != nullptr; }
+    Status Decode(const uint8_t* data, size_t size, bool more_available,
+                  size_t& consumed, AudioFrame& frame) override;
+    void Reset() override;
+
+private:
+    static constexpr int kSampleRate = 48000;        // Opus 的原生采样率，避免解码器内部重采样
+    static constexpr int kMaxFrameSamples = 5760;    // 单个包最长 120ms
+    static constexpr size_t kMaxPacketSize = 8192;   // 跨页拼接的包长度上限
+
+    OpusDecoder* decoder_ = nullptr;
+    int16_t* pcm_ = nullptr;
+    int channels_ = 0;
+    int pre_skip_ = 0;  // 流开头需要丢弃的样本数
+
+    // 当前页
+    bool in_page_ = false;
+    uint32_t serial_ = 0;
+    bool serial_locked_ = false;
+    uint8_t segments_[255];
+    int segment_count_ = 0;
+    int segment_index_ = 0;
+
+    // 跨页的包先拼接到这里
+    std::vector<uint8_t> partial_packet_;
+    bool partial_overflow_ = false;
+    int packet_count_ = 0;
+
+    Status ParsePageHeader(const uint8_t* data, size_t size, bool more_available, size_t& consumed);
+    Status ProcessPacket(const uint8_t* packet, size_t size, AudioFrame& frame);
+    bool ParseOpusHead(const uint8_t* packet, size_t size);
+};
+
+#endif // OGG_OPUS_STREAM_DECODER_H
@@ -0,0 +1,83 @@
+#include "pcm_output_stage.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "PcmOutputStage"
+
+PcmOutputStage::PcmOutputStage() {
+    // 一个 MP3 帧的双声道输出，大多数情况下不需要再增长
+    buffer_.resize(1152 * 2);
+}
+
+void PcmOutputStage::Reset() {
+    resampler_.Reset();
+}
+
+size_t PcmOutputStage::Process(const int16_t* input, int frames, int input_channels, int input_rate,
+                               int output_channels, int output_rate, const int16_t*& output) {
+    output = buffer_.data();
+    if (frames <= 0 || input_channels <= 0 || input_rate <= 0 || output_rate <= 0) {
+        return 0;
+    }
+    output_channels = output_channels >= 2 ? 2 : 1;
+    if (input_rate != last_input_rate_ || output_rate != last_output_rate_ ||
+        output_channels != last_output_channels_) {
+        ESP_LOGI(TAG, "Output stage: %d Hz x%d -> %d Hz x%d", input_rate, input_channels, output_rate, output_channels);
+        last_input_rate_ = input_rate;
+        last_output_rate_ = output_rate;
+        last_output_channels_ = output_channels;
+        if (input_rate != output_rate) {
+            resampler_.Configure(input_rate, output_rate, output_channels);
+        }
+    }
+
+    if (input_rate != output_rate) {
+        size_t capacity = resampler_.MaxOutputFrames(frames) * output_channels;
+        if (buffer_.size() < capacity) {
+            buffer_.resize(capacity);
+        }
+        output = buffer_.data();
+        return resampler_.Process(input, frames, input_channels, gain_q15_, buffer_.data()) * output_channels;
+    }
+
+    // 采样率相同，只做声道转换和增益；每种声道组合单独一个循环，便于编译器向量化
+    if (buffer_.size() < (size_t)frames * output_channels) {
+        buffer_.resize(frames * output_channels);
+    }
+    int16_t* out = buffer_.data();
+    output = out;
+    const int32_t gain = gain_q15_;
+    auto scale = [gain](int32_t value) -> int16_t {
+        value = ((int64_t)value * gain) >> 15;
+        return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+    };
+    if (input_channels >= 2 && output_channels == 1) {
+        for (int i = 0; i < frames; i++) {
+            const int16_t* p = input + i * input_channels;
+            out[i] = scale((p[0] + p[1]) >> 1);
+        }
+    } else if (input_channels == 1 && output_channels == 2) {
+        for (int i = 0; i < frames; i++) {
+            int16_t value = scale(input[i]);
+            out[i * 2] = value;
+            out[i * 2 + 1] = value;
+        }
+    } else if (input_channels == output_channels) {
+        int samples = frames * output_channels;
+        if (gain == kUnityGain) {
+            memcpy(out, input, samples * sizeof(int16_t));
+        } else {
+            for (int i = 0; i < samples; i++) {
+                out[i] = scale(input[i]);
+            }
+        }
+    } else {
+        // 多于两个声道时取前两个
+        for (int i = 0; i < frames; i++) {
+            out[i * 2] = scale(input[i * input_channels]);
+            out[i * 2 + 1] = scale(input[i * input_channels + 1]);
+        }
+    }
+    return (size_t)frames * output_channels;
+}
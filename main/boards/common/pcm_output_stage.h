@@ -0,0 +1,39 @@
+#ifndef PCM_OUTPUT_STAGE_H
+#define PCM_OUTPUT_STAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "polyphase_resampler.h"
+
+// 解码输出到音频编解码器之间的处理级
+// 完成声道转换（双声道合并或单声道复制）、变采样率和增益，编解码器始终保持原始采样率。
+// 采样率相同时一次遍历直接输出；不同时由多相重采样器在缓存输入时转换声道、在滤波时乘增益。
+// 结果写入内部缓冲区，缓冲区只在需要更大容量时增长，稳定播放时不分配内存。
+// 滤波状态跨帧保留，帧边界处不会出现跳变；切歌或跳转后调用 Reset。
+class PcmOutputStage {
+public:
+    static constexpr int kUnityGain = 1 << 15;  // Q15
+
+    PcmOutputStage();
+
+    // input 为交错排列的 PCM，frames 为每声道样本数
+    // 返回输出的总样本数（输出帧数 * output_channels），output 指向内部缓冲区，下一次调用前有效
+    size_t Process(const int16_t* input, int frames, int input_channels, int input_rate,
+                   int output_channels, int output_rate, const int16_t*& output);
+    void Reset();
+
+    void SetGain(int gain_q15) { gain_q15_ = gain_q15; }
+    int gain() const { return gain_q15_; }
+
+private:
+    std::vector<int16_t> buffer_;
+    int gain_q15_ = kUnityGain;
+    PolyphaseResampler resampler_;
+    int last_input_rate_ = 0;
+    int last_output_rate_ = 0;
+    int last_output_channels_ = 0;
+};
+
+#endif // PCM_OUTPUT_STAGE_H
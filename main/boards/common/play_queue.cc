@@ -0,0 +1,395 @@
+#include "play_queue.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_random.h>
+#include <cJSON.h>
+#include <algorithm>
+#include <random>
+
+#define TAG "PlayQueue"
+
+static const char* const kModeNames[PlayQueue::kModeCount] = {
+    "sequential",
+    "repeat_all",
+    "repeat_one",
+    "shuffle",
+};
+
+PlayQueue::PlayQueue() {
+}
+
+const char* PlayQueue::ModeName(Mode mode) {
+    return mode >= 0 && mode < kModeCount ? kModeNames[mode] : "unknown";
+}
+
+PlayQueue::Mode PlayQueue::ParseMode(const std::string& name) {
+    for (int i = 0; i < kModeCount; i++) {
+        if (name == kModeNames[i]) {
+            return (Mode)i;
+        }
+    }
+    return kModeCount;
+}
+
+void PlayQueue::Load() {
+    Settings settings("music_queue");
+    std::string content = settings.GetString("entries");
+    int current = settings.GetInt("pos", 0);
+    cJSON* root = cJSON_Parse(content.c_str());
+    if (root == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    cJSON* mode = cJSON_GetObjectItem(root, "m");
+    if (cJSON_IsNumber(mode) && mode->valueint >= 0 && mode->valueint < kModeCount) {
+        mode_ = (Mode)mode->valueint;
+    }
+    cJSON* items = cJSON_GetObjectItem(root, "e");
+    cJSON* item;
+    cJSON_ArrayForEach(item, items) {
+        cJSON* id = cJSON_GetArrayItem(item, 0);
+        cJSON* name = cJSON_GetArrayItem(item, 1);
+        cJSON* artist = cJSON_GetArrayItem(item, 2);
+        if (!cJSON_IsString(id) || entries_.size() >= MAX_ENTRIES) {
+            continue;
+        }
+        entries_.push_back({id->valuestring, cJSON_IsString(name) ? name->valuestring : "",
+                            cJSON_IsString(artist) ? artist->valuestring : ""});
+    }
+    cJSON_Delete(root);
+
+    history_.clear();
+    order_.clear();
+    position_ = 0;
+    RebuildOrderLocked(mode_ == kShuffle);
+    // 保存的是当前歌曲在 entries_ 中的下标
+    if (current > 0 && current < (int)entries_.size()) {
+        auto it = std::find(order_.begin(), order_.end(), current);
+        if (mode_ == kShuffle) {
+            std::iter_swap(order_.begin(), it);
+        } else {
+            position_ = it - order_.begin();
+        }
+    }
+    ESP_LOGI(TAG, "Loaded %u queued songs, mode %s", (unsigned int)entries_.size(), ModeName(mode_));
+}
+
+void PlayQueue::Replace(const Entry& current, const std::vector<Entry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    entries_.reserve(std::min(entries.size() + 1, MAX_ENTRIES));
+    entries_.push_back(current);
+    for (auto& entry : entries) {
+        if (entries_.size() >= MAX_ENTRIES) {
+            break;
+        }
+        if (entry.song_id.empty() || entry.song_id == current.song_id) {
+            continue;
+        }
+        entries_.push_back(entry);
+    }
+    history_.clear();
+    order_.clear();
+    position_ = 0;
+    RebuildOrderLocked(mode_ == kShuffle);
+    ESP_LOGI(TAG, "Queue replaced: %u songs", (unsigned int)entries_.size());
+    entries_dirty_ = true;
+}
+
+void PlayQueue::RebuildOrderLocked(bool shuffle) {
+    next_round_.clear();
+    // 当前歌曲保持在第一位，其余歌曲按模式排列
+    uint16_t current = order_.empty() || position_ >= order_.size() ? 0 : order_[position_];
+    if (current >= entries_.size()) {
+        current = 0;
+    }
+    order_.clear();
+    order_.reserve(entries_.size());
+    if (!entries_.empty()) {
+        order_.push_back(current);
+    }
+    for (uint16_t i = 0; i < entries_.size(); i++) {
+        if (i != current) {
+            order_.push_back(i);
+        }
+    }
+    if (shuffle && order_.size() > 2) {
+        std::minstd_rand rng(esp_random());
+        std::shuffle(order_.begin() + 1, order_.end(), rng);
+    } else if (!shuffle) {
+        // 顺序模式下恢复歌单原来的顺序
+        std::sort(order_.begin(), order_.end());
+        position_ = current;
+        return;
+    }
+    position_ = 0;
+}
+
+bool PlayQueue::NextPositionLocked(bool user_skip, size_t& position, bool& reshuffle) const {
+    reshuffle = false;
+    if (order_.empty()) {
+        return false;
+    }
+    if (mode_ == kRepeatOne && !user_skip) {
+        position = position_;
+        return true;
+    }
+    if (position_ + 1 < order_.size()) {
+        position = position_ + 1;
+        return true;
+    }
+    // 已经是最后一首
+    if (mode_ == kSequential || order_.size() < 2) {
+        return false;
+    }
+    reshuffle = mode_ == kShuffle;
+    position = 0;
+    return true;
+}
+
+bool PlayQueue::PeekNextLocked(bool user_skip, uint16_t& index) {
+    size_t position;
+    bool reshuffle;
+    if (!NextPositionLocked(user_skip, position, reshuffle)) {
+        return false;
+    }
+    if (!reshuffle) {
+        index = order_[position];
+        return true;
+    }
+    if (next_round_.empty()) {
+        // 新一轮随机顺序，避免刚播完的歌曲紧接着再播一次
+        next_round_ = order_;
+        std::minstd_rand rng(esp_random());
+        std::shuffle(next_round_.begin(), next_round_.end(), rng);
+        if (next_round_[0] == order_[position_]) {
+            std::swap(next_round_[0], next_round_.back());
+        }
+    }
+    index = next_round_[0];
+    return true;
+}
+
+// 调用前需先用 PeekNextLocked 确认有下一首，随机播放的下一轮顺序在其中确定
+void PlayQueue::MoveToNextLocked(bool user_skip) {
+    size_t position;
+    bool reshuffle;
+    if (!NextPositionLocked(user_skip, position, reshuffle)) {
+        return;
+    }
+
+    uint16_t previous = order_[position_];
+    if (reshuffle) {
+        order_.swap(next_round_);
+        next_round_.clear();
+    }
+    if (position != position_ || reshuffle) {
+        history_.push_back(previous);
+        if (history_.size() > MAX_HISTORY) {
+            history_.erase(history_.begin());
+        }
+    }
+    position_ = position;
+    position_dirty_ = true;
+}
+
+bool PlayQueue::PeekNext(bool user_skip, Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint16_t index;
+    if (!PeekNextLocked(user_skip, index)) {
+        return false;
+    }
+    entry = entries_[index];
+    return true;
+}
+
+bool PlayQueue::MoveToNext(bool user_skip, const std::string& song_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint16_t index;
+    if (!PeekNextLocked(user_skip, index) || entries_[index].song_id != song_id) {
+        return false;
+    }
+    MoveToNextLocked(user_skip);
+    return true;
+}
+
+bool PlayQueue::PeekPreviousLocked(uint16_t& index, size_t& position) const {
+    if (history_.empty()) {
+        return false;
+    }
+    index = history_.back();
+    auto it = std::find(order_.begin(), order_.end(), index);
+    if (it == order_.end()) {
+        return false;
+    }
+    position = it - order_.begin();
+    return true;
+}
+
+bool PlayQueue::PeekPrevious(Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint16_t index;
+    size_t position;
+    if (!PeekPreviousLocked(index, position)) {
+        return false;
+    }
+    entry = entries_[index];
+    return true;
+}
+
+bool PlayQueue::MoveToPrevious(const std::string& song_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint16_t index;
+    size_t position;
+    if (!PeekPreviousLocked(index, position) || entries_[index].song_id != song_id) {
+        return false;
+    }
+    history_.pop_back();
+    position_ = position;
+    position_dirty_ = true;
+    return true;
+}
+
+std::vector<PlayQueue::Entry> PlayQueue::Upcoming(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Entry> result;
+    if (order_.empty()) {
+        return result;
+    }
+    if (mode_ == kRepeatOne) {
+        if (count > 0) {
+            result.push_back(entries_[order_[position_]]);
+        }
+        return result;
+    }
+    // 随机播放的下一轮顺序还没有确定，只返回本轮剩下的歌曲
+    bool wrap = mode_ == kRepeatAll;
+    for (size_t i = 1; i < order_.size() && result.size() < count; i++) {
+        size_t position = position_ + i;
+        if (position >= order_.size()) {
+            if (!wrap) {
+                break;
+            }
+            position -= order_.size();
+        }
+        result.push_back(entries_[order_[position]]);
+    }
+    return result;
+}
+
+bool PlayQueue::Current(Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (order_.empty()) {
+        return false;
+    }
+    entry = entries_[order_[position_]];
+    return true;
+}
+
+void PlayQueue::SetMode(Mode mode) {
+    if (mode < 0 || mode >= kModeCount) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode == mode_) {
+        return;
+    }
+    bool was_shuffle = mode_ == kShuffle;
+    mode_ = mode;
+    if (was_shuffle != (mode == kShuffle)) {
+        RebuildOrderLocked(mode == kShuffle);
+    }
+    ESP_LOGI(TAG, "Play mode: %s", ModeName(mode));
+    entries_dirty_ = true;
+}
+
+PlayQueue::Mode PlayQueue::mode() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mode_;
+}
+
+size_t PlayQueue::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::string PlayQueue::ToJson(size_t max_upcoming) {
+    auto upcoming = Upcoming(max_upcoming);
+    auto add_entry = [](cJSON* object, const Entry& entry) {
+        cJSON_AddStringToObject(object, "id", entry.song_id.c_str());
+        cJSON_AddStringToObject(object, "name", entry.name.c_str());
+        cJSON_AddStringToObject(object, "artist", entry.artist.c_str());
+    };
+
+    cJSON* root = cJSON_CreateObject();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cJSON_AddStringToObject(root, "mode", ModeName(mode_));
+        cJSON_AddNumberToObject(root, "size", entries_.size());
+        cJSON_AddNumberToObject(root, "history", history_.size());
+        if (!order_.empty()) {
+            cJSON* current = cJSON_CreateObject();
+            add_entry(current, entries_[order_[position_]]);
+            cJSON_AddItemToObject(root, "current", current);
+        }
+    }
+    cJSON* next = cJSON_CreateArray();
+    for (auto& entry : upcoming) {
+        cJSON* item = cJSON_CreateObject();
+        add_entry(item, entry);
+        cJSON_AddItemToArray(next, item);
+    }
+    cJSON_AddItemToObject(root, "upcoming", next);
+
+    std::string result;
+    char* json = cJSON_PrintUnformatted(root);
+    if (json != nullptr) {
+        result = json;
+        cJSON_free(json);
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+void PlayQueue::Save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!entries_dirty_ && !position_dirty_) {
+        return;
+    }
+
+    Settings settings("music_queue", true);
+    settings.SetInt("pos", order_.empty() ? 0 : order_[position_]);
+    position_dirty_ = false;
+    if (!entries_dirty_) {
+        return;
+    }
+    entries_dirty_ = false;
+
+    // 按歌单顺序保存，超出 NVS 长度上限时丢弃末尾的歌曲
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "m", mode_);
+    cJSON* items = cJSON_AddArrayToObject(root, "e");
+    size_t length = 16;
+    for (auto& entry : entries_) {
+        size_t item_length = entry.song_id.size() + entry.name.size() + entry.artist.size() + 12;
+        if (length + item_length > MAX_PERSIST_BYTES) {
+            break;
+        }
+        length += item_length;
+        cJSON* item = cJSON_CreateArray();
+        cJSON_AddItemToArray(item, cJSON_CreateString(entry.song_id.c_str()));
+        cJSON_AddItemToArray(item, cJSON_CreateString(entry.name.c_str()));
+        cJSON_AddItemToArray(item, cJSON_CreateString(entry.artist.c_str()));
+        cJSON_AddItemToArray(items, item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (json == nullptr) {
+        return;
+    }
+    settings.SetString("entries", json);
+    cJSON_free(json);
+}
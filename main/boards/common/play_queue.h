@@ -0,0 +1,88 @@
+#ifndef PLAY_QUEUE_H
+#define PLAY_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 播放队列
+// 按歌单顺序保存歌曲，支持顺序播放、列表循环、单曲循环和随机播放，并记录播放历史用于上一首。
+// 队列内容、当前位置和播放模式保存到 NVS，重启后可以直接继续播放下一首。
+// 修改队列只标记为待保存，由调用方在栈位于内部 RAM 的任务中调用 Save 写入 NVS。
+// 所有接口都可以在不同线程中调用。
+class PlayQueue {
+public:
+    struct Entry {
+        std::string song_id;
+        std::string name;
+        std::string artist;
+    };
+
+    enum Mode {
+        kSequential,  // 顺序播放，播完最后一首停止
+        kRepeatAll,   // 列表循环
+        kRepeatOne,   // 单曲循环，用户切歌时仍然按顺序切换
+        kShuffle,     // 随机播放，每轮重新打乱
+        kModeCount,
+    };
+
+    PlayQueue();
+
+    // 从 NVS 加载上次的队列
+    void Load();
+    // 把待保存的修改写入 NVS，只换歌时只更新当前位置
+    void Save();
+
+    // 换成新的歌单，current 为正在播放的歌曲，放在队首，entries 中与它相同的条目会被去掉
+    void Replace(const Entry& current, const std::vector<Entry>& entries);
+
+    // 查看下一首或历史中的上一首，不移动当前位置
+    // user_skip 为 true 时表示用户主动切歌，不受单曲循环影响
+    bool PeekNext(bool user_skip, Entry& entry);
+    bool PeekPrevious(Entry& entry);
+    // 下一首或上一首仍然是 song_id 时才移过去，没有移动时返回 false
+    // 先用 Peek 获取播放地址，成功后再移动位置，期间换了歌单或播放模式时位置保持不变
+    bool MoveToNext(bool user_skip, const std::string& song_id);
+    bool MoveToPrevious(const std::string& song_id);
+    // 按当前模式查看接下来要自动播放的歌曲，不移动当前位置
+    std::vector<Entry> Upcoming(size_t count);
+    bool Current(Entry& entry);
+
+    void SetMode(Mode mode);
+    Mode mode();
+    size_t size();
+
+    // 当前歌曲、播放模式和接下来的 max_upcoming 首，JSON 格式
+    std::string ToJson(size_t max_upcoming);
+
+    static const char* ModeName(Mode mode);
+    // 无法识别时返回 kModeCount
+    static Mode ParseMode(const std::string& name);
+
+private:
+    static constexpr size_t MAX_ENTRIES = 100;
+    static constexpr size_t MAX_HISTORY = 50;
+    static constexpr size_t MAX_PERSIST_BYTES = 3800;  // NVS 字符串上限约 4000 字节
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    std::vector<uint16_t> order_;    // 播放顺序，元素为 entries_ 的下标，随机播放时被打乱
+    std::vector<uint16_t> next_round_;  // 随机播放查看下一首时提前打乱的下一轮顺序，为空表示还没有确定
+    size_t position_ = 0;            // 当前歌曲在 order_ 中的位置
+    std::vector<uint16_t> history_;  // 已播放歌曲在 entries_ 中的下标，最近的在末尾
+    Mode mode_ = kSequential;
+    bool entries_dirty_ = false;
+    bool position_dirty_ = false;
+
+    void RebuildOrderLocked(bool shuffle);
+    // 计算下一首在 order_ 中的位置，没有下一首时返回 false；随机播放需要开始新一轮时 reshuffle 为 true
+    bool NextPositionLocked(bool user_skip, size_t& position, bool& reshuffle) const;
+    // 下一首在 entries_ 中的下标，需要开始新一轮时先确定下一轮的顺序
+    bool PeekNextLocked(bool user_skip, uint16_t& index);
+    void MoveToNextLocked(bool user_skip);
+    bool PeekPreviousLocked(uint16_t& index, size_t& position) const;
+};
+
+#endif // PLAY_QUEUE_H
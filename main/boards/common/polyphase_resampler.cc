@@ -0,0 +1,192 @@
+#include "polyphase_resampler.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#define TAG "PolyphaseResampler"
+
+static constexpr double kKaiserBeta = 7.0;      // 阻带约 -70dB
+static constexpr double kCutoffRatio = 0.92;    // 截止频率相对奈奎斯特频率的比例
+
+// 第一类零阶修正贝塞尔函数，用于 Kaiser 窗
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static uint32_t Gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+std::shared_ptr<PolyphaseResampler::Table> PolyphaseResampler::BuildTable(uint32_t up, uint32_t down) {
+    auto table = std::make_shared<Table>();
+    table->phases = std::min<uint32_t>(up, kMaxPhases);
+
+    // 下采样时滤波器在输入域变宽，按比例增加抽头数，保持过渡带宽度
+    double ratio = std::min(1.0, (double)up / down);
+    int taps = (int)std::ceil(kBaseTaps / ratio);
+    table->taps = (taps + 3) & ~3;
+    table->coefs.resize(table->phases * table->taps);
+
+    double fc = 0.5 * ratio * kCutoffRatio;  // 每个输入样本的周期数
+    double half = table->taps / 2.0;
+    double center = half - 1;
+    double i0_beta = BesselI0(kKaiserBeta);
+    std::vector<double> h(table->taps);
+    for (int p = 0; p < table->phases; p++) {
+        double offset = (double)p / table->phases;
+        double sum = 0;
+        for (int k = 0; k < table->taps; k++) {
+            double x = k - center - offset;
+            double y = 2 * fc * x;
+            double sinc = std::fabs(y) < 1e-9 ? 1.0 : std::sin(M_PI * y) / (M_PI * y);
+            double r = x / half;
+            double window = std::fabs(r) >= 1.0 ? 0.0 : BesselI0(kKaiserBeta * std::sqrt(1 - r * r)) / i0_beta;
+            h[k] = 2 * fc * sinc * window;
+            sum += h[k];
+        }
+        // 每个相位单独归一化，直流增益严格为 1
+        int16_t* coefs = &table->coefs[p * table->taps];
+        for (int k = 0; k < table->taps; k++) {
+            long value = std::lround(h[k] / sum * 32768.0);
+            coefs[k] = (int16_t)std::max(-32768L, std::min(32767L, value));
+        }
+    }
+    ESP_LOGI(TAG, "Built filter table %lu/%lu: %d phases x %d taps", (unsigned long)up, (unsigned long)down,
+             table->phases, table->taps);
+    return table;
+}
+
+std::shared_ptr<const PolyphaseResampler::Table> PolyphaseResampler::GetTable(uint32_t up, uint32_t down) {
+    // 系数表按比例缓存，没有实例使用时自动释放
+    static std::mutex mutex;
+    static std::map<std::pair<uint32_t, uint32_t>, std::weak_ptr<const Table>> tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = tables[{up, down}];
+    auto table = entry.lock();
+    if (!table) {
+        table = BuildTable(up, down);
+        entry = table;
+    }
+    return table;
+}
+
+bool PolyphaseResampler::Configure(int input_rate, int output_rate, int channels) {
+    if (input_rate <= 0 || output_rate <= 0) {
+        table_.reset();
+        return false;
+    }
+    uint32_t gcd = Gcd(input_rate, output_rate);
+    up_ = output_rate / gcd;
+    down_ = input_rate / gcd;
+    step_whole_ = down_ / up_;
+    step_frac_ = down_ % up_;
+    channels_ = channels >= 2 ? 2 : 1;
+    table_ = GetTable(up_, down_);
+    Reset();
+    return true;
+}
+
+void PolyphaseResampler::Reset() {
+    // 历史缓冲先填充 taps-1 个静音样本，第一个输出点对应第一个输入样本附近
+    pending_ = table_ ? table_->taps - 1 : 0;
+    index_ = 0;
+    frac_ = 0;
+    for (auto& history : history_) {
+        std::fill(history.begin(), history.end(), 0);
+        if (history.size() < pending_) {
+            history.resize(pending_);
+        }
+    }
+}
+
+size_t PolyphaseResampler::MaxOutputFrames(int frames) const {
+    if (!table_) {
+        return 0;
+    }
+    return ((uint64_t)(pending_ + frames) * up_) / down_ + 2;
+}
+
+size_t PolyphaseResampler::Process(const int16_t* input, int frames, int input_channels, int gain_q15,
+                                   int16_t* output) {
+    if (!table_ || frames <= 0) {
+        return 0;
+    }
+
+    // 追加到各声道的历史缓冲，同时完成声道转换
+    for (int c = 0; c < channels_; c++) {
+        auto& history = history_[c];
+        if (history.size() < pending_ + frames) {
+            history.resize(pending_ + frames);
+        }
+        int16_t* dest = history.data() + pending_;
+        for (int i = 0; i < frames; i++) {
+            const int16_t* p = input + i * input_channels;
+            if (input_channels == 1) {
+                dest[i] = p[0];
+            } else if (channels_ == 1) {
+                dest[i] = (p[0] + p[1]) >> 1;
+            } else {
+                dest[i] = p[c];
+            }
+        }
+    }
+    pending_ += frames;
+
+    const int taps = table_->taps;
+    const int phases = table_->phases;
+    const int16_t* coef_base = table_->coefs.data();
+    size_t produced = 0;
+    while (index_ + taps <= pending_) {
+        uint32_t phase = phases == (int)up_ ? frac_ : (uint32_t)(((uint64_t)frac_ * phases) / up_);
+        const int16_t* coefs = coef_base + phase * taps;
+        for (int c = 0; c < channels_; c++) {
+            const int16_t* x = history_[c].data() + index_;
+            // 系数绝对值之和小于 2，32 位累加不会溢出
+            int32_t acc = 0;
+            for (int k = 0; k < taps; k++) {
+                acc += (int32_t)coefs[k] * x[k];
+            }
+            int32_t value = (acc + (1 << 14)) >> 15;
+            if (gain_q15 != (1 << 15)) {
+                value = ((int64_t)value * gain_q15) >> 15;
+            }
+            output[produced * channels_ + c] = value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+        }
+        produced++;
+
+        index_ += step_whole_;
+        frac_ += step_frac_;
+        if (frac_ >= up_) {
+            frac_ -= up_;
+            index_++;
+        }
+    }
+
+    // 丢弃已经不会再用到的样本，只保留下一个滤波窗口需要的部分
+    size_t keep_from = std::min(index_, pending_);
+    for (int c = 0; c < channels_; c++) {
+        memmove(history_[c].data(), history_[c].data() + keep_from, (pending_ - keep_from) * sizeof(int16_t));
+    }
+    pending_ -= keep_from;
+    index_ -= keep_from;
+    return produced;
+}
@@ -0,0 +1,51 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 定点多相 FIR 重采样器，支持任意有理数比例（输出/输入 = L/M，已约分）
+// 滤波器为 Kaiser 窗 sinc，截止频率取两侧奈奎斯特频率的较小者，系数为 Q15。
+// 相同比例的实例共享同一张系数表；每个声道的历史数据连续存放，抽头数是 4 的倍数，
+// 内积循环便于编译器展开或替换为 SIMD 实现。
+class PolyphaseResampler {
+public:
+    bool Configure(int input_rate, int output_rate, int channels);
+    void Reset();
+    bool configured() const { return table_ != nullptr; }
+
+    // 处理 frames 帧后最多能输出的帧数
+    size_t MaxOutputFrames(int frames) const;
+
+    // input 为交错排列的 PCM，缓存时一并转换成 channels 个声道（双声道合并或单声道复制）
+    // 输出同样交错排列并乘以增益（Q15），返回输出帧数
+    size_t Process(const int16_t* input, int frames, int input_channels, int gain_q15, int16_t* output);
+
+private:
+    struct Table {
+        int phases;
+        int taps;
+        std::vector<int16_t> coefs;  // phases * taps，每个相位连续存放
+    };
+
+    static constexpr int kMaxPhases = 256;  // 相位更多时量化到最近的相位
+    static constexpr int kBaseTaps = 16;    // 上采样时每个相位的抽头数，下采样按比例加长
+
+    std::shared_ptr<const Table> table_;
+    int channels_ = 1;
+    uint32_t up_ = 1;    // L
+    uint32_t down_ = 1;  // M
+    uint32_t step_whole_ = 0;  // M / L
+    uint32_t step_frac_ = 0;   // M % L
+    uint32_t frac_ = 0;        // 当前输出点在两个输入样本之间的位置，单位 1/L
+    size_t index_ = 0;         // 当前滤波窗口在历史缓冲中的起点
+    size_t pending_ = 0;       // 历史缓冲中的有效样本数（每声道）
+    std::vector<int16_t> history_[2];
+
+    static std::shared_ptr<const Table> GetTable(uint32_t up, uint32_t down);
+    static std::shared_ptr<Table> BuildTable(uint32_t up, uint32_t down);
+};
+
+#endif // POLYPHASE_RESAMPLER_H
@@ -0,0 +1,148 @@
+#include "prebuffer_policy.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "PrebufferPolicy"
+
+namespace {
+
+const int kBitratesV1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+const int kBitratesV2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+const int kSampleRatesV1[3] = {44100, 48000, 32000};
+
+constexpr size_t kThroughputWindow = 256 * 1024;
+
+// 解析 MP3 Layer III 帧头，返回帧长度，不是有效帧头时返回0
+size_t ParseMp3Header(const uint8_t* p, int& bitrate_kbps) {
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+        return 0;
+    }
+    int version = (p[1] >> 3) & 0x03;
+    int layer = (p[1] >> 1) & 0x03;
+    int bitrate_index = (p[2] >> 4) & 0x0F;
+    int sample_rate_index = (p[2] >> 2) & 0x03;
+    int padding = (p[2] >> 1) & 0x01;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || sample_rate_index == 3) {
+        return 0;
+    }
+    bool mpeg1 = version == 3;
+    int sample_rate = kSampleRatesV1[sample_rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    bitrate_kbps = mpeg1 ? kBitratesV1[bitrate_index] : kBitratesV2[bitrate_index];
+    return (mpeg1 ? 144000 : 72000) * bitrate_kbps / sample_rate + padding;
+}
+
+uint32_t ReadLittleEndian32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+} // namespace
+
+void PrebufferPolicy::AddDownloadSample(size_t bytes, int64_t elapsed_us) {
+    sample_bytes_ += bytes;
+    sample_us_ += elapsed_us;
+    if (sample_bytes_ > kThroughputWindow) {
+        sample_bytes_ /= 2;
+        sample_us_ /= 2;
+    }
+    // 至少积累几十KB再给出结果，避免第一块数据的偶然速度影响判断
+    if (sample_us_ > 0 && sample_bytes_ >= 32 * 1024) {
+        throughput_kbps_.store((int)((uint64_t)sample_bytes_ * 8000 / sample_us_), std::memory_order_relaxed);
+    }
+}
+
+int PrebufferPolicy::DetectBitrateKbps(const uint8_t* data, size_t size) {
+    if (data == nullptr || size < 12) {
+        return 0;
+    }
+
+    if (memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) {
+        // fmt 块几乎总是紧跟在文件头后面，byte rate 位于块内偏移 8
+        size_t offset = 12;
+        while (offset + 8 <= size) {
+            uint32_t chunk_size = ReadLittleEndian32(data + offset + 4);
+            if (memcmp(data + offset, "fmt ", 4) == 0) {
+                if (offset + 20 > size) {
+                    return 0;
+                }
+                return ReadLittleEndian32(data + offset + 16) * 8 / 1000;
+            }
+            offset += 8 + chunk_size + (chunk_size & 1);
+        }
+        return 0;
+    }
+
+    size_t offset = 0;
+    if (memcmp(data, "ID3", 3) == 0 && size >= 10) {
+        // 封面较大时标签超出可见数据，按默认码率处理
+        offset = 10 + (((data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) | ((data[8] & 0x7F) << 7) | (data[9] & 0x7F));
+    }
+    // 找到连续两个有效帧头才认为同步成功，避免把音频数据误认为帧头
+    for (; offset + 4 <= size; offset++) {
+        int bitrate_kbps = 0;
+        size_t frame_size = ParseMp3Header(data + offset, bitrate_kbps);
+        if (frame_size == 0) {
+            continue;
+        }
+        int next_bitrate = 0;
+        if (offset + frame_size + 4 <= size && ParseMp3Header(data + offset + frame_size, next_bitrate) == 0) {
+            continue;
+        }
+        return bitrate_kbps;
+    }
+    return 0;
+}
+
+int PrebufferPolicy::TargetMs(int bitrate_kbps, bool quick_start) const {
+    if (quick_start) {
+        return kCacheMs;
+    }
+    if (bitrate_kbps <= 0) {
+        bitrate_kbps = kDefaultBitrateKbps;
+    }
+
+    int throughput = throughput_kbps();
+    int target;
+    if (throughput <= 0) {
+        target = kUnknownMs;
+    } else {
+        // 下载速度达到码率的3倍以上时只需最小预缓冲，1倍以下时缓冲到上限，中间线性过渡
+        int ratio_x100 = throughput * 100 / bitrate_kbps;
+        if (ratio_x100 >= 300) {
+            target = kMinMs;
+        } else if (ratio_x100 <= 100) {
+            target = kMaxMs;
+        } else {
+            target = kMaxMs - (kMaxMs - kMinMs) * (ratio_x100 - 100) / 200;
+        }
+    }
+    return std::min(kMaxMs, target + penalty_ms_);
+}
+
+size_t PrebufferPolicy::TargetBytes(int bitrate_kbps, bool quick_start) const {
+    if (bitrate_kbps <= 0) {
+        bitrate_kbps = kDefaultBitrateKbps;
+    }
+    return (size_t)TargetMs(bitrate_kbps, quick_start) * bitrate_kbps / 8;
+}
+
+size_t PrebufferPolicy::MaxTargetBytes(int bitrate_kbps) {
+    if (bitrate_kbps <= 0) {
+        bitrate_kbps = kDefaultBitrateKbps;
+    }
+    return (size_t)kMaxMs * bitrate_kbps / 8;
+}
+
+void PrebufferPolicy::OnUnderrun() {
+    underrun_count_++;
+    penalty_ms_ = std::min(kMaxMs, penalty_ms_ + kUnderrunPenaltyMs);
+    ESP_LOGW(TAG, "Playback underrun #%d at %d kbps download, prebuffer penalty %dms",
+             underrun_count_, throughput_kbps(), penalty_ms_);
+}
+
+void PrebufferPolicy::OnTrackFinished(bool had_underrun) {
+    if (!had_underrun) {
+        penalty_ms_ = std::max(0, penalty_ms_ - kRecoverMs);
+    }
+}
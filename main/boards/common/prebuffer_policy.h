@@ -0,0 +1,50 @@
+#ifndef PREBUFFER_POLICY_H
+#define PREBUFFER_POLICY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 播放前预缓冲量的计算
+// 目标以毫秒音频表示，再按音源码率换算成字节：下载速度远高于码率时只缓冲几百毫秒就开始播放，
+// 接近或低于码率时逐步加长；发生断流后临时加长，之后每首顺利播完的歌曲逐步恢复。
+// 下载速度由下载线程更新，其余接口只由播放线程调用。
+class PrebufferPolicy {
+public:
+    static constexpr int kDefaultBitrateKbps = 128;  // 无法识别码率时的估计值
+
+    // 记录一次网络读取，elapsed_us 只包含实际等待网络的时间
+    void AddDownloadSample(size_t bytes, int64_t elapsed_us);
+    int throughput_kbps() const { return throughput_kbps_.load(std::memory_order_relaxed); }
+
+    // 从文件开头（或跳转后的数据）识别码率，支持MP3帧头和WAV的fmt块，无法识别时返回0
+    static int DetectBitrateKbps(const uint8_t* data, size_t size);
+
+    // quick_start 用于本地缓存，数据几乎立即可用
+    int TargetMs(int bitrate_kbps, bool quick_start) const;
+    size_t TargetBytes(int bitrate_kbps, bool quick_start) const;
+    // 任何下载速度和断流惩罚下 TargetBytes 的上限，可以在任意线程调用，用于给还没开始播放的曲目分配缓冲区
+    static size_t MaxTargetBytes(int bitrate_kbps);
+
+    void OnUnderrun();
+    void OnTrackFinished(bool had_underrun);
+    int underrun_count() const { return underrun_count_; }
+
+private:
+    static constexpr int kMinMs = 400;       // 网络很快时的预缓冲
+    static constexpr int kUnknownMs = 1500;  // 还没有测得下载速度时的预缓冲
+    static constexpr int kMaxMs = 6000;
+    static constexpr int kCacheMs = 200;
+    static constexpr int kUnderrunPenaltyMs = 1000;
+    static constexpr int kRecoverMs = 250;
+
+    // 下载速度按字节数和耗时累计，超过窗口后减半，相当于指数衰减的平均值
+    size_t sample_bytes_ = 0;
+    int64_t sample_us_ = 0;
+    std::atomic<int> throughput_kbps_{0};
+
+    int penalty_ms_ = 0;
+    int underrun_count_ = 0;
+};
+
+#endif // PREBUFFER_POLICY_H
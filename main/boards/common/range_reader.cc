@@ -0,0 +1,122 @@
+#include "range_reader.h"
+
+#include <http.h>
+#include <esp_log.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "RangeReader"
+
+RangeReader::RangeReader(HttpFactory factory, KeepGoing keep_going)
+    : factory_(std::move(factory)), keep_going_(std::move(keep_going)) {
+}
+
+RangeReader::~RangeReader() {
+    Close();
+}
+
+size_t RangeReader::ParseContentRangeTotal(const std::string& content_range) {
+    size_t slash = content_range.find('/');
+    if (slash == std::string::npos || slash + 1 >= content_range.size() || content_range[slash + 1] == '*') {
+        return 0;
+    }
+    return strtoul(content_range.c_str() + slash + 1, nullptr, 10);
+}
+
+bool RangeReader::Open(const std::string& url, size_t offset) {
+    Close();
+    status_code_ = 0;
+    if (url != url_) {
+        url_ = url;
+        content_length_ = 0;
+    }
+    offset_ = offset;
+
+    http_ = factory_();
+    if (http_ == nullptr) {
+        return false;
+    }
+    http_->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+    http_->SetHeader("Accept", "*/*");
+    http_->SetHeader("Range", "bytes=" + std::to_string(offset) + "-"); // 支持断点续传
+
+    if (!http_->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to connect to music stream URL");
+        Close();
+        return false;
+    }
+
+    status_code_ = http_->GetStatusCode();
+    if (status_code_ != 200 && status_code_ != 206) { // 206 for partial content
+        ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code_);
+        Close();
+        return false;
+    }
+
+    // 记录完整文件长度，用于判断连接是否提前断开
+    if (content_length_ == 0) {
+        if (status_code_ == 206) {
+            content_length_ = ParseContentRangeTotal(http_->GetResponseHeader("Content-Range"));
+        } else {
+            content_length_ = http_->GetBodyLength();
+        }
+    }
+
+    if (offset > 0 && status_code_ == 200) {
+        ESP_LOGW(TAG, "Server ignored Range request, discarding %u bytes", (unsigned int)offset);
+        if (!Discard(offset)) {
+            Close();
+            return false;
+        }
+    }
+
+    ESP_LOGI(TAG, "Started downloading audio stream, status: %d, offset: %u, length: %u",
+             status_code_, (unsigned int)offset, (unsigned int)content_length_);
+    return true;
+}
+
+bool RangeReader::Discard(size_t bytes) {
+    char discard[512];
+    while (bytes > 0) {
+        if (keep_going_ && !keep_going_()) {
+            return false;
+        }
+        int bytes_read = http_->Read(discard, std::min(bytes, sizeof(discard)));
+        if (bytes_read <= 0) {
+            return false;
+        }
+        bytes -= bytes_read;
+    }
+    return true;
+}
+
+int RangeReader::Read(char* buffer, size_t size) {
+    if (http_ == nullptr) {
+        return -1;
+    }
+    int bytes_read = http_->Read(buffer, size);
+    if (bytes_read > 0) {
+        offset_ += bytes_read;
+        return bytes_read;
+    }
+    if (bytes_read < 0) {
+        ESP_LOGE(TAG, "Failed to read audio data: error code %d", bytes_read);
+        Close();
+        return -1;
+    }
+    if (content_length_ > 0 && offset_ < content_length_) {
+        ESP_LOGW(TAG, "Connection closed early at %u/%u bytes",
+                 (unsigned int)offset_, (unsigned int)content_length_);
+        Close();
+        return -1;
+    }
+    return 0;
+}
+
+void RangeReader::Close() {
+    if (http_ != nullptr) {
+        http_->Close();
+        delete http_;
+        http_ = nullptr;
+    }
+}
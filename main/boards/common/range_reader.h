@@ -0,0 +1,56 @@
+#ifndef RANGE_READER_H
+#define RANGE_READER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+class Http;
+
+// 支持断点续传的 HTTP 下载连接
+// Open 用 Range 请求从 offset 开始读取，第一次打开某个地址时记录完整文件长度；
+// 服务器忽略 Range 返回 200 时丢弃已经下载过的部分。
+// Read 在连接出错或提前结束（已读总量小于文件长度）时关闭连接并返回 -1，
+// 调用方按自己的重试策略再次 Open(url, offset()) 即可从断点继续。
+class RangeReader {
+public:
+    using HttpFactory = std::function<Http*()>;
+    // 丢弃数据期间返回 false 时放弃打开，例如停止播放
+    using KeepGoing = std::function<bool()>;
+
+    RangeReader(HttpFactory factory, KeepGoing keep_going = nullptr);
+    ~RangeReader();
+
+    RangeReader(const RangeReader&) = delete;
+    RangeReader& operator=(const RangeReader&) = delete;
+
+    // 地址和上一次不同时重新获取文件长度，失败时原因见 status_code()
+    bool Open(const std::string& url, size_t offset);
+    // 返回读到的字节数；0 表示文件已经读完；-1 表示连接中断，连接已关闭
+    int Read(char* buffer, size_t size);
+    void Close();
+
+    bool is_open() const { return http_ != nullptr; }
+    // 最近一次 Open 的 HTTP 状态码，连接没有建立时为 0
+    int status_code() const { return status_code_; }
+    // 下一个读取的字节在文件中的偏移
+    size_t offset() const { return offset_; }
+    // 完整文件长度，未知时为 0
+    size_t content_length() const { return content_length_; }
+
+    // 从 "bytes <start>-<end>/<total>" 中取出 total，未知（"*"）或格式不对时返回 0
+    static size_t ParseContentRangeTotal(const std::string& content_range);
+
+private:
+    HttpFactory factory_;
+    KeepGoing keep_going_;
+    Http* http_ = nullptr;
+    std::string url_;
+    int status_code_ = 0;
+    size_t offset_ = 0;
+    size_t content_length_ = 0;
+
+    bool Discard(size_t bytes);
+};
+
+#endif // RANGE_READER_H
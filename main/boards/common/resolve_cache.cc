@@ -0,0 +1,160 @@
+#include "resolve_cache.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+#include <cctype>
+#include <functional>
+
+#define TAG "ResolveCache"
+
+ResolveCache::ResolveCache() {
+}
+
+std::string ResolveCache::Normalize(const std::string& query) {
+    std::string result;
+    result.reserve(query.size());
+    bool pending_space = false;
+    for (unsigned char c : query) {
+        if (std::isspace(c)) {
+            pending_space = !result.empty();
+            continue;
+        }
+        if (pending_space) {
+            result.push_back(' ');
+            pending_space = false;
+        }
+        // 只处理 ASCII，UTF-8 多字节字符原样保留
+        result.push_back(c < 0x80 ? std::tolower(c) : c);
+    }
+    return result;
+}
+
+void ResolveCache::Load() {
+    Settings settings("music_cache");
+    std::string content = settings.GetString("queries");
+    cJSON* root = cJSON_Parse(content.c_str());
+    if (root == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 保存时按最近使用排序，第一个条目最新
+    int64_t expire_at = esp_timer_get_time() + QUERY_TTL_US;
+    use_counter_ = cJSON_GetArraySize(root);
+    uint32_t last_used = use_counter_;
+    cJSON* item;
+    cJSON_ArrayForEach(item, root) {
+        cJSON* query = cJSON_GetObjectItem(item, "q");
+        cJSON* id = cJSON_GetObjectItem(item, "id");
+        cJSON* artist = cJSON_GetObjectItem(item, "a");
+        if (!cJSON_IsString(query) || !cJSON_IsString(id) || queries_.size() >= MAX_QUERIES) {
+            continue;
+        }
+        SongInfo info = {id->valuestring, cJSON_IsString(artist) ? artist->valuestring : ""};
+        queries_[query->valuestring] = {info, expire_at, last_used--};
+    }
+    cJSON_Delete(root);
+    ESP_LOGI(TAG, "Loaded %u cached queries", (unsigned int)queries_.size());
+}
+
+bool ResolveCache::LookupQuery(const std::string& query, SongInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool hit = LookupLocked(queries_, Normalize(query), info);
+    hit ? query_hits_++ : query_misses_++;
+    return hit;
+}
+
+void ResolveCache::PutQuery(const std::string& query, const SongInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PutLocked(queries_, MAX_QUERIES, Normalize(query), info, QUERY_TTL_US);
+    SaveQueriesLocked();
+}
+
+bool ResolveCache::LookupUrl(const std::string& song_id, std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool hit = LookupLocked(urls_, song_id, url);
+    hit ? url_hits_++ : url_misses_++;
+    return hit;
+}
+
+void ResolveCache::PutUrl(const std::string& song_id, const std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PutLocked(urls_, MAX_URLS, song_id, url, URL_TTL_US);
+}
+
+void ResolveCache::InvalidateUrl(const std::string& song_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    urls_.erase(song_id);
+}
+
+void ResolveCache::LogStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ESP_LOGI(TAG, "Query cache: %u entries, %lu hits, %lu misses; URL cache: %u entries, %lu hits, %lu misses",
+             (unsigned int)queries_.size(), (unsigned long)query_hits_, (unsigned long)query_misses_,
+             (unsigned int)urls_.size(), (unsigned long)url_hits_, (unsigned long)url_misses_);
+}
+
+template <typename T>
+bool ResolveCache::LookupLocked(std::map<std::string, Entry<T>>& table, const std::string& key, T& value) {
+    auto it = table.find(key);
+    if (it == table.end()) {
+        return false;
+    }
+    if (esp_timer_get_time() >= it->second.expire_at_us) {
+        table.erase(it);
+        return false;
+    }
+    it->second.last_used = ++use_counter_;
+    value = it->second.value;
+    return true;
+}
+
+template <typename T>
+void ResolveCache::PutLocked(std::map<std::string, Entry<T>>& table, size_t limit, const std::string& key,
+                             const T& value, int64_t ttl_us) {
+    if (table.find(key) == table.end() && table.size() >= limit) {
+        auto oldest = table.begin();
+        for (auto it = table.begin(); it != table.end(); ++it) {
+            if (it->second.last_used < oldest->second.last_used) {
+                oldest = it;
+            }
+        }
+        table.erase(oldest);
+    }
+    table[key] = {value, esp_timer_get_time() + ttl_us, ++use_counter_};
+}
+
+void ResolveCache::SaveQueriesLocked() {
+    // 按最近使用排序，超出 NVS 长度上限时丢弃最旧的条目
+    std::multimap<uint32_t, const std::string*, std::greater<uint32_t>> order;
+    for (auto& it : queries_) {
+        order.emplace(it.second.last_used, &it.first);
+    }
+
+    cJSON* root = cJSON_CreateArray();
+    size_t length = 2;
+    for (auto& it : order) {
+        auto& info = queries_[*it.second].value;
+        size_t item_length = it.second->size() + info.song_id.size() + info.artist.size() + 24;
+        if (length + item_length > MAX_PERSIST_BYTES) {
+            break;
+        }
+        length += item_length;
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "q", it.second->c_str());
+        cJSON_AddStringToObject(item, "id", info.song_id.c_str());
+        cJSON_AddStringToObject(item, "a", info.artist.c_str());
+        cJSON_AddItemToArray(root, item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (json == nullptr) {
+        return;
+    }
+
+    Settings settings("music_cache", true);
+    settings.SetString("queries", json);
+    cJSON_free(json);
+}
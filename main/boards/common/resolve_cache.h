@@ -0,0 +1,70 @@
+#ifndef RESOLVE_CACHE_H
+#define RESOLVE_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// 搜索结果和播放地址的内存缓存
+// 点歌关键词 -> 歌曲ID/歌手，保存到 NVS，重启后仍然有效；
+// 歌曲ID -> 播放地址，播放地址会过期，只保存在内存中。
+// 两张表都有条目上限，超出时淘汰最久未使用的条目。
+class ResolveCache {
+public:
+    struct SongInfo {
+        std::string song_id;
+        std::string artist;
+    };
+
+    ResolveCache();
+
+    // 从 NVS 加载关键词表
+    void Load();
+
+    bool LookupQuery(const std::string& query, SongInfo& info);
+    void PutQuery(const std::string& query, const SongInfo& info);
+
+    bool LookupUrl(const std::string& song_id, std::string& url);
+    void PutUrl(const std::string& song_id, const std::string& url);
+    // 播放地址被服务器拒绝时调用，下次重新获取
+    void InvalidateUrl(const std::string& song_id);
+
+    void LogStats();
+
+    // 去掉首尾空白、合并连续空白、ASCII 转小写
+    static std::string Normalize(const std::string& query);
+
+private:
+    template <typename T>
+    struct Entry {
+        T value;
+        int64_t expire_at_us;
+        uint32_t last_used;
+    };
+
+    static constexpr size_t MAX_QUERIES = 32;
+    static constexpr size_t MAX_URLS = 16;
+    static constexpr int64_t QUERY_TTL_US = 24LL * 3600 * 1000 * 1000;  // 歌曲ID基本不变
+    static constexpr int64_t URL_TTL_US = 20LL * 60 * 1000 * 1000;      // 播放地址带有时效签名
+    static constexpr size_t MAX_PERSIST_BYTES = 3800;                  // NVS 字符串上限约 4000 字节
+
+    std::mutex mutex_;
+    std::map<std::string, Entry<SongInfo>> queries_;
+    std::map<std::string, Entry<std::string>> urls_;
+    uint32_t use_counter_ = 0;
+
+    uint32_t query_hits_ = 0;
+    uint32_t query_misses_ = 0;
+    uint32_t url_hits_ = 0;
+    uint32_t url_misses_ = 0;
+
+    template <typename T>
+    bool LookupLocked(std::map<std::string, Entry<T>>& table, const std::string& key, T& value);
+    template <typename T>
+    void PutLocked(std::map<std::string, Entry<T>>& table, size_t limit, const std::string& key,
+                   const T& value, int64_t ttl_us);
+    void SaveQueriesLocked();
+};
+
+#endif // RESOLVE_CACHE_H
@@ -0,0 +1,335 @@
+#include "track_cache.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+#include <array>
+#include <cstring>
+
+#define TAG "TrackCache"
+
+#define INDEX_FILE_NAME "index.json"
+#define INDEX_TEMP_NAME "index.tmp"
+
+namespace {
+
+const std::array<uint32_t, 256>& Crc32Table() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+} // namespace
+
+uint32_t TrackCache::Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    auto& table = Crc32Table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+TrackCache::Reader::Reader(TrackCache* cache, const std::string& song_id, std::unique_ptr<TrackStorage::File> file,
+                           size_t size, uint32_t crc, size_t offset)
+    : cache_(cache), song_id_(song_id), file_(std::move(file)), size_(size), expected_crc_(crc),
+      position_(offset), check_crc_(offset == 0) {
+}
+
+size_t TrackCache::Reader::Read(void* data, size_t size) {
+    size_t bytes = file_->Read(data, size);
+    if (check_crc_) {
+        crc_ = Crc32(crc_, (const uint8_t*)data, bytes);
+    }
+    position_ += bytes;
+    return bytes;
+}
+
+bool TrackCache::Reader::Verify() {
+    if (!check_crc_ || position_ != size_) {
+        // 从中间开始读或者没有读完，无法校验
+        return true;
+    }
+    if (crc_ != expected_crc_) {
+        ESP_LOGE(TAG, "CRC mismatch for %s: expected %08lx, got %08lx, evicting",
+                 song_id_.c_str(), (unsigned long)expected_crc_, (unsigned long)crc_);
+        cache_->Remove(song_id_);
+        return false;
+    }
+    return true;
+}
+
+TrackCache::Writer::Writer(TrackCache* cache, const std::string& song_id, std::unique_ptr<TrackStorage::File> file,
+                           size_t expected_size, const std::string& name, const std::string& artist)
+    : cache_(cache), song_id_(song_id), file_(std::move(file)), expected_size_(expected_size),
+      name_(name), artist_(artist) {
+}
+
+TrackCache::Writer::~Writer() {
+    if (!committed_) {
+        file_.reset();
+        cache_->Finish(song_id_, expected_size_, false, Entry());
+    }
+}
+
+bool TrackCache::Writer::Append(const void* data, size_t size) {
+    if (failed_) {
+        return false;
+    }
+    if (written_ + size > expected_size_ || file_->Write(data, size) != size) {
+        ESP_LOGW(TAG, "Failed to write cache file for %s at %u bytes", song_id_.c_str(), (unsigned int)written_);
+        failed_ = true;
+        return false;
+    }
+    crc_ = Crc32(crc_, (const uint8_t*)data, size);
+    written_ += size;
+    return true;
+}
+
+bool TrackCache::Writer::Commit() {
+    file_.reset();
+    committed_ = true;
+    bool success = !failed_ && written_ == expected_size_;
+    Entry entry = {written_, crc_, 0, name_, artist_};
+    cache_->Finish(song_id_, expected_size_, success, entry);
+    return success;
+}
+
+TrackCache::TrackCache(std::unique_ptr<TrackStorage> storage, size_t budget)
+    : storage_(std::move(storage)), budget_(budget) {
+}
+
+void TrackCache::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+
+    // 替换索引时先删除旧索引再重命名，中间断电时只剩下完整的临时索引
+    bool dirty = false;
+    cJSON* root = cJSON_Parse(ReadFileLocked(INDEX_FILE_NAME).c_str());
+    if (root == nullptr) {
+        root = cJSON_Parse(ReadFileLocked(INDEX_TEMP_NAME).c_str());
+        if (root != nullptr) {
+            ESP_LOGW(TAG, "Cache index missing, recovered from " INDEX_TEMP_NAME);
+            dirty = true;
+        }
+    }
+    if (root != nullptr) {
+        cJSON* counter = cJSON_GetObjectItem(root, "counter");
+        if (cJSON_IsNumber(counter)) {
+            use_counter_ = counter->valuedouble;
+        }
+        cJSON* entries = cJSON_GetObjectItem(root, "entries");
+        cJSON* item;
+        cJSON_ArrayForEach(item, entries) {
+            cJSON* id = cJSON_GetObjectItem(item, "id");
+            cJSON* size = cJSON_GetObjectItem(item, "size");
+            cJSON* crc = cJSON_GetObjectItem(item, "crc");
+            cJSON* used = cJSON_GetObjectItem(item, "used");
+            cJSON* name = cJSON_GetObjectItem(item, "name");
+            cJSON* artist = cJSON_GetObjectItem(item, "artist");
+            if (!cJSON_IsString(id) || !cJSON_IsNumber(size) || !cJSON_IsNumber(crc) || !cJSON_IsNumber(used)) {
+                continue;
+            }
+            // 文件缺失或长度不一致说明写入过程中断电，丢弃该条目
+            size_t actual_size = 0;
+            if (!storage_->GetSize(FileNameOf(id->valuestring), actual_size) || actual_size != (size_t)size->valuedouble) {
+                ESP_LOGW(TAG, "Dropping broken cache entry: %s", id->valuestring);
+                storage_->Remove(FileNameOf(id->valuestring));
+                dirty = true;
+                continue;
+            }
+            Entry entry = {
+                actual_size,
+                (uint32_t)crc->valuedouble,
+                (uint32_t)used->valuedouble,
+                cJSON_IsString(name) ? name->valuestring : "",
+                cJSON_IsString(artist) ? artist->valuestring : "",
+            };
+            entries_[id->valuestring] = entry;
+        }
+        cJSON_Delete(root);
+    }
+
+    if (RemoveUnindexedLocked() || dirty) {
+        SaveIndexLocked();
+    }
+    ESP_LOGI(TAG, "Loaded %u cached tracks, %u/%u bytes used",
+             (unsigned int)entries_.size(), (unsigned int)UsedBytesLocked(), (unsigned int)budget_);
+}
+
+std::string TrackCache::ReadFileLocked(const std::string& name) {
+    std::string content;
+    auto file = storage_->Open(name, false);
+    if (file) {
+        char buffer[512];
+        size_t bytes;
+        while ((bytes = file->Read(buffer, sizeof(buffer))) > 0) {
+            content.append(buffer, bytes);
+        }
+    }
+    return content;
+}
+
+// 删除写入中断留下的临时文件，以及提交后还没写进索引就断电的歌曲文件
+// 预算只统计索引中的条目，这些文件不删除会一直占用分区，之后的缓存写入失败
+bool TrackCache::RemoveUnindexedLocked() {
+    bool removed = false;
+    for (auto& name : storage_->List()) {
+        if (name == INDEX_FILE_NAME) {
+            continue;
+        }
+        auto it = entries_.find(name.substr(0, name.rfind('.')));
+        if (it != entries_.end() && name == FileNameOf(it->first)) {
+            continue;
+        }
+        ESP_LOGW(TAG, "Removing unindexed cache file: %s", name.c_str());
+        storage_->Remove(name);
+        removed = true;
+    }
+    return removed;
+}
+
+bool TrackCache::Contains(const std::string& song_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.find(song_id) != entries_.end();
+}
+
+bool TrackCache::FindByName(const std::string& name, std::string& song_id, std::string& artist) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& it : entries_) {
+        if (!name.empty() && it.second.name == name) {
+            song_id = it.first;
+            artist = it.second.artist;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::unique_ptr<TrackCache::Reader> TrackCache::OpenReader(const std::string& song_id, size_t offset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(song_id);
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    auto file = storage_->Open(FileNameOf(song_id), false);
+    if (!file || (offset > 0 && !file->Seek(offset))) {
+        ESP_LOGW(TAG, "Failed to open cached track %s", song_id.c_str());
+        RemoveLocked(song_id);
+        SaveIndexLocked();
+        return nullptr;
+    }
+    it->second.last_used = ++use_counter_;
+    SaveIndexLocked();
+    return std::make_unique<Reader>(this, song_id, std::move(file), it->second.size, it->second.crc, offset);
+}
+
+std::unique_ptr<TrackCache::Writer> TrackCache::OpenWriter(const std::string& song_id, size_t expected_size,
+                                                           const std::string& name, const std::string& artist) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (expected_size == 0 || expected_size + reserved_bytes_ > budget_ || entries_.find(song_id) != entries_.end()) {
+        return nullptr;
+    }
+    EvictLocked(expected_size);
+    auto file = storage_->Open(TempNameOf(song_id), true);
+    if (!file) {
+        ESP_LOGW(TAG, "Failed to create cache file for %s", song_id.c_str());
+        return nullptr;
+    }
+    reserved_bytes_ += expected_size;
+    return std::make_unique<Writer>(this, song_id, std::move(file), expected_size, name, artist);
+}
+
+void TrackCache::Remove(const std::string& song_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RemoveLocked(song_id);
+    SaveIndexLocked();
+}
+
+size_t TrackCache::used_bytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return UsedBytesLocked();
+}
+
+size_t TrackCache::UsedBytesLocked() const {
+    size_t used = 0;
+    for (auto& it : entries_) {
+        used += it.second.size;
+    }
+    return used;
+}
+
+void TrackCache::EvictLocked(size_t needed) {
+    bool evicted = false;
+    while (!entries_.empty() && UsedBytesLocked() + reserved_bytes_ + needed > budget_) {
+        auto oldest = entries_.begin();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->second.last_used < oldest->second.last_used) {
+                oldest = it;
+            }
+        }
+        ESP_LOGI(TAG, "Evicting cached track %s (%u bytes)", oldest->first.c_str(), (unsigned int)oldest->second.size);
+        RemoveLocked(oldest->first);
+        evicted = true;
+    }
+    if (evicted) {
+        SaveIndexLocked();
+    }
+}
+
+void TrackCache::RemoveLocked(const std::string& song_id) {
+    entries_.erase(song_id);
+    storage_->Remove(FileNameOf(song_id));
+}
+
+void TrackCache::SaveIndexLocked() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "counter", use_counter_);
+    cJSON* entries = cJSON_AddArrayToObject(root, "entries");
+    for (auto& it : entries_) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "id", it.first.c_str());
+        cJSON_AddNumberToObject(item, "size", it.second.size);
+        cJSON_AddNumberToObject(item, "crc", it.second.crc);
+        cJSON_AddNumberToObject(item, "used", it.second.last_used);
+        cJSON_AddStringToObject(item, "name", it.second.name.c_str());
+        cJSON_AddStringToObject(item, "artist", it.second.artist.c_str());
+        cJSON_AddItemToArray(entries, item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (json == nullptr) {
+        return;
+    }
+
+    // 先写临时文件再替换，避免写到一半断电导致索引损坏
+    size_t length = strlen(json);
+    auto file = storage_->Open(INDEX_TEMP_NAME, true);
+    bool written = file && file->Write(json, length) == length;
+    file.reset();
+    cJSON_free(json);
+    if (!written || !storage_->Rename(INDEX_TEMP_NAME, INDEX_FILE_NAME)) {
+        ESP_LOGE(TAG, "Failed to save cache index");
+    }
+}
+
+void TrackCache::Finish(const std::string& song_id, size_t expected_size, bool success, const Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_bytes_ -= expected_size;
+    if (!success || !storage_->Rename(TempNameOf(song_id), FileNameOf(song_id))) {
+        storage_->Remove(TempNameOf(song_id));
+        return;
+    }
+    entries_[song_id] = entry;
+    entries_[song_id].last_used = ++use_counter_;
+    SaveIndexLocked();
+    ESP_LOGI(TAG, "Cached track %s (%u bytes, crc %08lx)", song_id.c_str(), (unsigned int)entry.size, (unsigned long)entry.crc);
+}
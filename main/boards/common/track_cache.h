@@ -0,0 +1,109 @@
+#ifndef TRACK_CACHE_H
+#define TRACK_CACHE_H
+
+#include "track_storage.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// 按歌曲 ID 缓存完整的音频文件
+// 下载线程边播放边写入，只有完整下载且长度一致的文件才会加入索引；
+// 总大小超过预算时按最近最少使用淘汰，读取时校验 CRC32，损坏的条目会被删除。
+class TrackCache {
+public:
+    class Reader {
+    public:
+        Reader(TrackCache* cache, const std::string& song_id, std::unique_ptr<TrackStorage::File> file,
+               size_t size, uint32_t crc, size_t offset);
+
+        size_t size() const { return size_; }
+        size_t Read(void* data, size_t size);
+        // 从头完整读完后校验 CRC，失败时从缓存中删除该条目
+        bool Verify();
+
+    private:
+        TrackCache* cache_;
+        std::string song_id_;
+        std::unique_ptr<TrackStorage::File> file_;
+        size_t size_;
+        uint32_t expected_crc_;
+        uint32_t crc_ = 0;
+        size_t position_;
+        bool check_crc_;
+    };
+
+    class Writer {
+    public:
+        Writer(TrackCache* cache, const std::string& song_id, std::unique_ptr<TrackStorage::File> file,
+               size_t expected_size, const std::string& name, const std::string& artist);
+        ~Writer();  // 未提交的写入会被丢弃
+
+        bool Append(const void* data, size_t size);
+        bool Commit();
+
+    private:
+        TrackCache* cache_;
+        std::string song_id_;
+        std::unique_ptr<TrackStorage::File> file_;
+        size_t expected_size_;
+        size_t written_ = 0;
+        uint32_t crc_ = 0;
+        std::string name_;
+        std::string artist_;
+        bool failed_ = false;
+        bool committed_ = false;
+    };
+
+    TrackCache(std::unique_ptr<TrackStorage> storage, size_t budget);
+
+    // 加载索引，丢弃文件缺失或长度不一致的条目
+    // 索引替换到一半断电时从临时索引恢复，并删除索引之外的文件，避免它们一直占用分区空间
+    void Load();
+
+    bool Contains(const std::string& song_id);
+    // 按点歌时的歌名查找，命中时可以跳过搜索接口
+    bool FindByName(const std::string& name, std::string& song_id, std::string& artist);
+
+    std::unique_ptr<Reader> OpenReader(const std::string& song_id, size_t offset);
+    // expected_size 超过预算时返回空，否则先淘汰旧条目腾出空间
+    std::unique_ptr<Writer> OpenWriter(const std::string& song_id, size_t expected_size,
+                                       const std::string& name, const std::string& artist);
+    void Remove(const std::string& song_id);
+
+    size_t used_bytes();
+    size_t budget() const { return budget_; }
+
+    static uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size);
+
+private:
+    struct Entry {
+        size_t size;
+        uint32_t crc;
+        uint32_t last_used;
+        std::string name;
+        std::string artist;
+    };
+
+    std::unique_ptr<TrackStorage> storage_;
+    size_t budget_;
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    uint32_t use_counter_ = 0;
+    size_t reserved_bytes_ = 0;  // 正在写入的文件预留的空间
+
+    static std::string FileNameOf(const std::string& song_id) { return song_id + ".mp3"; }
+    static std::string TempNameOf(const std::string& song_id) { return song_id + ".tmp"; }
+
+    std::string ReadFileLocked(const std::string& name);
+    bool RemoveUnindexedLocked();
+    size_t UsedBytesLocked() const;
+    void EvictLocked(size_t needed);
+    void RemoveLocked(const std::string& song_id);
+    void SaveIndexLocked();
+    void Finish(const std::string& song_id, size_t expected_size, bool success, const Entry& entry);
+};
+
+#endif // TRACK_CACHE_H
@@ -0,0 +1,68 @@
+#include "track_storage.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+
+class StdioFile : public TrackStorage::File {
+public:
+    explicit StdioFile(FILE* file) : file_(file) {}
+    virtual ~StdioFile() { fclose(file_); }
+
+    virtual size_t Read(void* data, size_t size) override { return fread(data, 1, size, file_); }
+    virtual size_t Write(const void* data, size_t size) override { return fwrite(data, 1, size, file_); }
+    virtual bool Seek(size_t offset) override { return fseek(file_, (long)offset, SEEK_SET) == 0; }
+
+private:
+    FILE* file_;
+};
+
+} // namespace
+
+StdioTrackStorage::StdioTrackStorage(const std::string& base_path) : base_path_(base_path) {
+}
+
+std::unique_ptr<TrackStorage::File> StdioTrackStorage::Open(const std::string& name, bool write) {
+    FILE* file = fopen(PathOf(name).c_str(), write ? "wb" : "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    return std::make_unique<StdioFile>(file);
+}
+
+bool StdioTrackStorage::Remove(const std::string& name) {
+    return remove(PathOf(name).c_str()) == 0;
+}
+
+bool StdioTrackStorage::Rename(const std::string& from, const std::string& to) {
+    // 有些文件系统（如 SPIFFS）不允许覆盖已存在的文件
+    remove(PathOf(to).c_str());
+    return rename(PathOf(from).c_str(), PathOf(to).c_str()) == 0;
+}
+
+bool StdioTrackStorage::GetSize(const std::string& name, size_t& size) {
+    struct stat st;
+    if (stat(PathOf(name).c_str(), &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    return true;
+}
+
+std::vector<std::string> StdioTrackStorage::List() {
+    std::vector<std::string> names;
+    DIR* dir = opendir(base_path_.c_str());
+    if (dir == nullptr) {
+        return names;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_type == DT_DIR) {
+            continue;
+        }
+        names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    return names;
+}
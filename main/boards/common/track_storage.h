@@ -0,0 +1,52 @@
+#ifndef TRACK_STORAGE_H
+#define TRACK_STORAGE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 歌曲缓存的存储后端
+// TrackCache 只通过这个接口访问存储，设备上挂载在 SPIFFS 分区上，
+// 在 Linux 上可以直接指向一个普通目录运行和测量。
+class TrackStorage {
+public:
+    class File {
+    public:
+        virtual ~File() = default;
+        virtual size_t Read(void* data, size_t size) = 0;
+        virtual size_t Write(const void* data, size_t size) = 0;
+        virtual bool Seek(size_t offset) = 0;
+    };
+
+    virtual ~TrackStorage() = default;
+
+    // 文件不存在或无法创建时返回空
+    virtual std::unique_ptr<File> Open(const std::string& name, bool write) = 0;
+    virtual bool Remove(const std::string& name) = 0;
+    virtual bool Rename(const std::string& from, const std::string& to) = 0;
+    // 返回文件大小，不存在时返回 false
+    virtual bool GetSize(const std::string& name, size_t& size) = 0;
+    // 列出存储中的所有文件名
+    virtual std::vector<std::string> List() = 0;
+};
+
+// 基于标准 C 文件接口的存储后端，适用于 ESP-IDF VFS 挂载的文件系统和主机文件系统
+class StdioTrackStorage : public TrackStorage {
+public:
+    explicit StdioTrackStorage(const std::string& base_path);
+
+    virtual std::unique_ptr<File> Open(const std::string& name, bool write) override;
+    virtual bool Remove(const std::string& name) override;
+    virtual bool Rename(const std::string& from, const std::string& to) override;
+    virtual bool GetSize(const std::string& name, size_t& size) override;
+    virtual std::vector<std::string> List() override;
+
+private:
+    std::string base_path_;
+
+    std::string PathOf(const std::string& name) const { return base_path_ + "/" + name; }
+};
+
+#endif // TRACK_STORAGE_H
@@ -0,0 +1,173 @@
+#include "wav_stream_decoder.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "WavStreamDecoder"
+
+static uint16_t ReadLe16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void WavStreamDecoder::Reset() {
+    state_ = State::kRiffHeader;
+    channels_ = 0;
+    sample_rate_ = 0;
+    bytes_per_sample_ = 0;
+    data_remaining_ = 0;
+}
+
+AudioStreamDecoder::Status WavStreamDecoder::Decode(const uint8_t* data, size_t size, bool more_available,
+                                                    size_t& consumed, AudioFrame& frame) {
+    consumed = 0;
+    switch (state_) {
+    case State::kRiffHeader:
+        if (size < 12) {
+            if (more_available) {
+                return Status::kNeedMoreData;
+            }
+            state_ = State::kInvalid;
+            break;
+        }
+        if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+            ESP_LOGE(TAG, "Not a RIFF/WAVE stream");
+            state_ = State::kInvalid;
+            break;
+        }
+        consumed = 12;
+        state_ = State::kChunkHeader;
+        return Status::kSkipped;
+
+    case State::kChunkHeader:
+        return ParseChunkHeader(data, size, more_available, consumed);
+
+    case State::kData: {
+        if (data_remaining_ == 0) {
+            // data 块之后可能还有 LIST 等块
+            state_ = State::kChunkHeader;
+            return ParseChunkHeader(data, size, more_available, consumed);
+        }
+        size_t block_align = channels_ * bytes_per_sample_;
+        size_t usable = std::min(size, data_remaining_);
+        size_t frames = std::min(usable / block_align, (size_t)kFramesPerDecode);
+        if (frames == 0) {
+            if (more_available && data_remaining_ >= block_align) {
+                return Status::kNeedMoreData;
+            }
+            // 流末尾不足一个采样块
+            consumed = usable;
+            data_remaining_ -= usable;
+            return Status::kSkipped;
+        }
+
+        int count = frames * channels_;
+        const uint8_t* src = data;
+        for (int i = 0; i < count; i++) {
+            switch (bytes_per_sample_) {
+            case 1:
+                pcm_[i] = (int16_t)((src[0] - 128) * 256);
+                break;
+            case 2:
+                pcm_[i] = (int16_t)ReadLe16(src);
+                break;
+            default:
+                // 24 位只保留高 16 位
+                pcm_[i] = (int16_t)ReadLe16(src + 1);
+                break;
+            }
+            src += bytes_per_sample_;
+        }
+        consumed = frames * block_align;
+        data_remaining_ -= consumed;
+        frame.pcm = pcm_;
+        frame.samples = frames;
+        frame.channels = channels_;
+        frame.sample_rate = sample_rate_;
+        return Status::kFrame;
+    }
+
+    default:
+        break;
+    }
+
+    // 格式错误，丢弃剩余数据
+    consumed = size;
+    return Status::kSkipped;
+}
+
+AudioStreamDecoder::Status WavStreamDecoder::ParseChunkHeader(const uint8_t* data, size_t size, bool more_available,
+                                                              size_t& consumed) {
+    if (size < 8) {
+        if (more_available) {
+            return Status::kNeedMoreData;
+        }
+        consumed = size;
+        return Status::kSkipped;
+    }
+
+    uint32_t chunk_size = ReadLe32(data + 4);
+    // 块长度为奇数时后面有一个填充字节
+    size_t padded_size = chunk_size + (chunk_size & 1);
+
+    if (memcmp(data, "fmt ", 4) == 0) {
+        if (size < 8 + std::min(chunk_size, (uint32_t)16) && more_available) {
+            return Status::kNeedMoreData;
+        }
+        if (!ParseFormat(data + 8, std::min((size_t)chunk_size, size - 8))) {
+            state_ = State::kInvalid;
+            consumed = size;
+            return Status::kSkipped;
+        }
+        consumed = 8 + padded_size;
+        return Status::kSkipped;
+    }
+
+    if (memcmp(data, "data", 4) == 0) {
+        if (channels_ == 0) {
+            ESP_LOGE(TAG, "WAV data chunk before fmt chunk");
+            state_ = State::kInvalid;
+            consumed = size;
+            return Status::kSkipped;
+        }
+        // 边下边写的文件长度字段可能为 0 或 0xFFFFFFFF，当作一直到流结束
+        data_remaining_ = (chunk_size == 0 || chunk_size == 0xFFFFFFFF) ? SIZE_MAX : chunk_size;
+        state_ = State::kData;
+        consumed = 8;
+        return Status::kSkipped;
+    }
+
+    // 其他块（LIST、fact 等）直接跳过，可能超出本次数据，由调用方继续跳过
+    consumed = 8 + padded_size;
+    return Status::kSkipped;
+}
+
+bool WavStreamDecoder::ParseFormat(const uint8_t* data, size_t size) {
+    if (size < 16) {
+        ESP_LOGE(TAG, "WAV fmt chunk too short: %u", (unsigned int)size);
+        return false;
+    }
+    uint16_t audio_format = ReadLe16(data);
+    int channels = ReadLe16(data + 2);
+    int sample_rate = ReadLe32(data + 4);
+    int bits = ReadLe16(data + 14);
+
+    // 1 为 PCM，0xFFFE 为 WAVE_FORMAT_EXTENSIBLE，这里只支持其中的整数 PCM
+    if ((audio_format != 1 && audio_format != 0xFFFE) ||
+        (bits != 8 && bits != 16 && bits != 24) ||
+        channels < 1 || channels > 2 || sample_rate <= 0) {
+        ESP_LOGE(TAG, "Unsupported WAV format: format=%d, channels=%d, rate=%d, bits=%d",
+                 audio_format, channels, sample_rate, bits);
+        return false;
+    }
+
+    channels_ = channels;
+    sample_rate_ = sample_rate;
+    bytes_per_sample_ = bits / 8;
+    ESP_LOGI(TAG, "WAV format: %d Hz, %d channels, %d bits", sample_rate, channels, bits);
+    return true;
+}
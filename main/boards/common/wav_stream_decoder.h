@@ -0,0 +1,35 @@
+#ifndef WAV_STREAM_DECODER_H
+#define WAV_STREAM_DECODER_H
+
+#include "audio_stream_decoder.h"
+
+// RIFF/WAVE 线性 PCM 解码器，支持 8/16/24 位单声道和双声道
+class WavStreamDecoder : public AudioStreamDecoder {
+public:
+    AudioStreamFormat format() const override { return AudioStreamFormat::kWav; }
+    Status Decode(const uint8_t* data, size_t size, bool more_available,
+                  size_t& consumed, AudioFrame& frame) override;
+    void Reset() override;
+
+private:
+    static constexpr int kFramesPerDecode = 1024;  // 每次输出的样本数（每声道）
+
+    enum class State {
+        kRiffHeader,
+        kChunkHeader,
+        kData,
+        kInvalid,
+    };
+
+    State state_ = State::kRiffHeader;
+    int channels_ = 0;
+    int sample_rate_ = 0;
+    int bytes_per_sample_ = 0;
+    size_t data_remaining_ = 0;
+    int16_t pcm_[kFramesPerDecode * 2];
+
+    Status ParseChunkHeader(const uint8_t* data, size_t size, bool more_available, size_t& consumed);
+    bool ParseFormat(const uint8_t* data, size_t size);
+};
+
+#endif // WAV_STREAM_DECODER_H
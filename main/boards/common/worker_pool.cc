@@ -0,0 +1,91 @@
+#include "worker_pool.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <freertos/idf_additions.h>
+
+#define TAG "WorkerPool"
+
+WorkerPool::WorkerPool(const char* name, int worker_count, uint32_t stack_size, UBaseType_t priority) {
+    auto entry = [](void* arg) {
+        static_cast<WorkerPool*>(arg)->WorkerLoop();
+        // 由析构函数删除任务并释放任务栈
+        vTaskSuspend(nullptr);
+    };
+
+    workers_.resize(worker_count);
+    int external = 0;
+    for (auto& worker : workers_) {
+        if (xTaskCreateWithCaps(entry, name, stack_size, this, priority, &worker.handle, MALLOC_CAP_SPIRAM) == pdPASS) {
+            worker.external_stack = true;
+            external++;
+        } else if (xTaskCreate(entry, name, stack_size, this, priority, &worker.handle) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create worker %s", name);
+            worker.handle = nullptr;
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_workers_++;
+    }
+    ESP_LOGI(TAG, "%s: %d workers, %d with PSRAM stacks of %lu bytes", name, running_workers_, external,
+             (unsigned long)stack_size);
+}
+
+WorkerPool::~WorkerPool() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopping_ = true;
+    jobs_.clear();
+    condition_variable_.notify_all();
+    // 等待正在执行的任务完成
+    condition_variable_.wait(lock, [this]() { return running_workers_ == 0; });
+    lock.unlock();
+
+    for (auto& worker : workers_) {
+        if (worker.handle == nullptr) {
+            continue;
+        }
+        if (worker.external_stack) {
+            vTaskDeleteWithCaps(worker.handle);
+        } else {
+            vTaskDelete(worker.handle);
+        }
+    }
+}
+
+void WorkerPool::Submit(std::function<void()> job, TokenPtr token) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return;
+    }
+    jobs_.push_back({std::move(job), std::move(token)});
+    condition_variable_.notify_one();
+}
+
+size_t WorkerPool::pending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+}
+
+void WorkerPool::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        condition_variable_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+        if (stopping_) {
+            break;
+        }
+
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        if (job.token && job.token->cancelled()) {
+            dropped_count_++;
+            continue;
+        }
+        lock.unlock();
+        job.callback();
+        // 在锁外释放任务捕获的对象
+        job = {};
+        lock.lock();
+    }
+    running_workers_--;
+    condition_variable_.notify_all();
+}
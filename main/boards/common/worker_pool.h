@@ -0,0 +1,60 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 固定数量工作任务的任务池
+// 任务栈优先分配在 PSRAM 中，分配失败时退回内部 RAM。PSRAM 栈的任务在 flash 操作期间不能运行，
+// 所以提交的任务不能写 NVS 或 flash 分区，需要持久化的数据交给其他任务保存。
+// 提交任务时可以附带取消标记，标记被取消后，还没开始执行的任务直接丢弃，正在执行的任务自行检查后提前结束。
+class WorkerPool {
+public:
+    class Token {
+    public:
+        bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+        void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<bool> cancelled_{false};
+    };
+    using TokenPtr = std::shared_ptr<Token>;
+
+    WorkerPool(const char* name, int worker_count, uint32_t stack_size, UBaseType_t priority);
+    ~WorkerPool();
+
+    void Submit(std::function<void()> job, TokenPtr token = nullptr);
+
+    // 排队中的任务数，以及被取消而没有执行的任务总数
+    size_t pending();
+    uint32_t dropped_count() const { return dropped_count_; }
+
+private:
+    struct Job {
+        std::function<void()> callback;
+        TokenPtr token;
+    };
+    struct Worker {
+        TaskHandle_t handle = nullptr;
+        bool external_stack = false;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable condition_variable_;
+    std::deque<Job> jobs_;
+    std::vector<Worker> workers_;
+    bool stopping_ = false;
+    int running_workers_ = 0;
+    std::atomic<uint32_t> dropped_count_{0};
+
+    void WorkerLoop();
+};
+
+#endif // WORKER_POOL_H
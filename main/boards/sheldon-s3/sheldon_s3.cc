@@ -25,10 +25,6 @@
 #include "i2c_device.h"
 #include <driver/rtc_io.h>
 
-#include "mp3dec.h"
-#include "mp3common.h"
-#include <opus_resampler.h>
-
 #define TAG "SheldonS3"
 
 LV_FONT_DECLARE(font_puhui_20_4);
@@ -117,7 +113,6 @@ private:
     PowerManager *power_manager_;
     esp_lcd_panel_handle_t panel_handle = NULL;
     esp_timer_handle_t touchpad_timer_;
-    OpusResampler output_resampler_;
 
     void InitializeI2c()
     {
@@ -296,14 +291,7 @@ private:
                                           volume = 100;
                                       }
                                       codec->SetOutputVolume(volume);
-                                      GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume));
-
-                                      xTaskCreate([](void *arg)
-                                                  {
-                    SheldonS3* app = (SheldonS3*)arg;
-                    app->PlayHttpMp3("http://lw.sycdn.kuwo.cn/49fece36e30fc99bf2a5533cfaf50159/687f3dbe/resource/30106/trackmedia/M500002dOqLZ3Effbw.mp3");
-                    vTaskDelete(NULL); },
-                                                  "PlayHttpMp3", 4096 * 10, this, 8, NULL); });
+                                      GetDisplay()->ShowNotification(Lang::Strings::VOLUME + std::to_string(volume)); });
 
         volume_up_button_.OnLongPress([this]()
                                       {
@@ -338,243 +326,6 @@ private:
         thing_manager.AddThing(iot::CreateThing("Battery"));
     }
 
-    bool SkipID3Tag(unsigned char *buffer, int *size)
-    {
-        if (*size >= 3 && buffer[0] == 'I' && buffer[1] == 'D' && buffer[2] == '3')
-        {
-            if (*size < 10)
-                return false;
-
-            int tag_size = ((buffer[6] << 21) | (buffer[7] << 14) | (buffer[8] << 7) | buffer[9]) + 10;
-            if (*size >= tag_size)
-            {
-                memmove(buffer, buffer + tag_size, *size - tag_size);
-                *size -= tag_size;
-                return true;
-            }
-            return false;
-        }
-        return true;
-    }
-
-#define MAX_NCHAN 2
-#define MAX_NGRAN 2
-#define MAX_NSAMP 576
-#define INPUT_BUFFER_SIZE (16 * 1024)
-#define OUTPUT_BUFFER_SIZE (16 * 1024)
-
-    void PlayHttpMp3(const std::string &url)
-    {
-        auto codec = Board::GetInstance().GetAudioCodec();
-        output_resampler_.Configure(2304, codec->output_sample_rate());
-        HMP3Decoder decoder = MP3InitDecoder();
-        if (!decoder)
-        {
-            ESP_LOGE(TAG, "Failed to initialize MP3 decoder");
-            return;
-        }
-
-        // 使用智能指针管理HTTP对象
-        auto http = Board::GetInstance().CreateHttp();
-        if (!http)
-        {
-            ESP_LOGE(TAG, "Failed to create HTTP client");
-            MP3FreeDecoder(decoder);
-            return;
-        }
-
-        // 设置ICY元数据相关头
-        http->SetHeader("Icy-MetaData", "1");
-        http->SetHeader("Accept-Encoding", "identity;q=1,*;q=0");
-        http->SetHeader("Connection", "keep-alive");
-
-        if (!http->Open("GET", url))
-        {
-            ESP_LOGE(TAG, "Failed to open URL: %s", url.c_str());
-            MP3FreeDecoder(decoder);
-            return;
-        }
-
-        int status_code = http->GetStatusCode();
-        if (status_code != 200)
-        {
-            ESP_LOGE(TAG, "HTTP request failed, status code: %d", status_code);
-            MP3FreeDecoder(decoder);
-            return;
-        }
-
-        // 获取ICY metadata间隔
-        int icy_metaint = 0;
-        std::string icy_header = http->GetResponseHeader("icy-metaint");
-        if (!icy_header.empty())
-        {
-            icy_metaint = atoi(icy_header.c_str());
-            ESP_LOGI(TAG, "ICY metadata interval: %d", icy_metaint);
-        }
-
-        unsigned char inputBuffer[INPUT_BUFFER_SIZE];
-        int bytesLeft = 0;
-        unsigned char *decodePtr = inputBuffer;
-        int bytesProcessed = 0; // 用于跟踪ICY元数据
-
-        MP3FrameInfo mp3FrameInfo;
-        short outputBuffer[MAX_NCHAN * MAX_NGRAN * MAX_NSAMP];
-
-        bool is_audio_started = false;
-
-        while (true)
-        {
-            // 移动剩余数据到buffer开头
-            if (decodePtr > inputBuffer && bytesLeft > 0)
-            {
-                memmove(inputBuffer, decodePtr, bytesLeft);
-                decodePtr = inputBuffer;
-            }
-
-            // 检查是否需要读取ICY元数据
-            if (icy_metaint > 0 && bytesProcessed >= icy_metaint)
-            {
-                // 读取元数据大小(1字节，实际大小 = 值 * 16)
-                unsigned char metaSizeByte = 0;
-                int read = http->Read((char *)&metaSizeByte, 1);
-                if (read != 1)
-                {
-                    ESP_LOGE(TAG, "Failed to read metadata size");
-                    break;
-                }
-
-                int metaDataSize = metaSizeByte * 16;
-                bytesProcessed = 0; // 重置处理字节计数
-
-                if (metaDataSize > 0)
-                {
-                    std::vector<char> metaData(metaDataSize);
-                    int totalRead = 0;
-
-                    // 读取完整的元数据
-                    while (totalRead < metaDataSize)
-                    {
-                        int readBytes = http->Read(metaData.data() + totalRead, metaDataSize - totalRead);
-                        if (readBytes <= 0)
-                        {
-                            ESP_LOGE(TAG, "Failed to read complete metadata");
-                            break;
-                        }
-                        totalRead += readBytes;
-                    }
-
-                    // 处理元数据 (这里只是简单打印，实际应用中可以解析艺术家/歌曲信息等)
-                    if (totalRead == metaDataSize)
-                    {
-                        std::string metaString(metaData.data(), metaDataSize);
-                        ESP_LOGI(TAG, "Metadata: %s", metaString.c_str());
-                    }
-                }
-            }
-
-            // 读取更多数据
-            if (bytesLeft < INPUT_BUFFER_SIZE)
-            {
-                int readBytes = http->Read((char *)(inputBuffer + bytesLeft), INPUT_BUFFER_SIZE - bytesLeft);
-                if (readBytes > 0)
-                {
-                    bytesLeft += readBytes;
-                    bytesProcessed += readBytes; // 更新已处理字节数
-                }
-                else if (readBytes == 0)
-                {
-                    ESP_LOGI(TAG, "End of stream");
-                    break;
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "HTTP read error");
-                    break;
-                }
-            }
-
-            // 跳过ID3标签
-            if (!SkipID3Tag(decodePtr, &bytesLeft))
-            {
-                ESP_LOGW(TAG, "ID3 tag too big, increase buffer size");
-                continue;
-            }
-
-            // 查找同步头
-            int offset = MP3FindSyncWord(decodePtr, bytesLeft);
-            if (offset == -1)
-            {
-                ESP_LOGW(TAG, "No sync word found, dropping %d bytes", bytesLeft);
-                bytesLeft = 0;
-                continue;
-            }
-
-            decodePtr += offset;
-            bytesLeft -= offset;
-
-            // 解码循环
-            while (bytesLeft > 0)
-            {
-                int samples = MP3Decode(decoder, &decodePtr, &bytesLeft, outputBuffer, 0);
-
-                if (samples == 0)
-                {
-                    MP3GetLastFrameInfo(decoder, &mp3FrameInfo);
-
-                    if (!is_audio_started)
-                    {
-                        is_audio_started = true;
-                    }
-
-                    ESP_LOGI(TAG, "Frame bitrate: %d, nChans: %d, samprate: %d, bitsPerSample: %d, outputSamps: %d, layer: %d, version: %d",
-                             mp3FrameInfo.bitrate, mp3FrameInfo.nChans, mp3FrameInfo.samprate,
-                             mp3FrameInfo.bitsPerSample, mp3FrameInfo.outputSamps,
-                             mp3FrameInfo.layer, mp3FrameInfo.version);
-
-                    
-                    codec->EnableOutput(true);
-                    std::vector<int16_t> pcm;
-                    pcm.resize(mp3FrameInfo.outputSamps * mp3FrameInfo.nChans);
-                    memcpy(pcm.data(), outputBuffer, mp3FrameInfo.outputSamps * mp3FrameInfo.nChans * sizeof(short));
-                    // Resample if the sample rate is different
-                    // if (mp3FrameInfo.outputSamps != codec->output_sample_rate())
-                    // {
-                    //     int target_size = output_resampler_.GetOutputSamples(pcm.size());
-                    //     std::vector<int16_t> resampled(target_size);
-                    //     output_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
-                    //     pcm = std::move(resampled);
-                    // }
-                    codec->OutputData(pcm);
-                }
-                else if (samples == ERR_MP3_INDATA_UNDERFLOW)
-                {
-                    break; // 需要更多数据
-                }
-                else if (samples == ERR_MP3_INVALID_FRAMEHEADER)
-                {
-                    decodePtr += 1;
-                    bytesLeft -= 1;
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "MP3 decode error: %d", samples);
-                    break;
-                }
-            }
-
-            // 移动剩余数据到buffer开头
-            if (bytesLeft > 0 && decodePtr > inputBuffer)
-            {
-                memmove(inputBuffer, decodePtr, bytesLeft);
-                decodePtr = inputBuffer;
-            }
-        }
-
-        // 确保资源释放
-        MP3FreeDecoder(decoder);
-        http->Close();
-    }
-
 public:
     SheldonS3() : boot_button_(BOOT_BUTTON_GPIO), volume_up_button_(VOLUME_UP_BUTTON_GPIO),
                   volume_down_button_(VOLUME_DOWN_BUTTON_GPIO)
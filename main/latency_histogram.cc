@@ -0,0 +1,79 @@
+#include "latency_histogram.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+void LatencyHistogram::Record(int64_t ms) {
+    if (ms < 0) {
+        ms = 0;
+    }
+    int bucket = 0;
+    while (bucket < kBucketCount - 1 && ms >= (1LL << bucket)) {
+        bucket++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    buckets_[bucket]++;
+    if (count_ == 0 || ms < min_) {
+        min_ = ms;
+    }
+    if (ms > max_) {
+        max_ = ms;
+    }
+    sum_ += ms;
+    count_++;
+}
+
+void LatencyHistogram::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& bucket : buckets_) {
+        bucket = 0;
+    }
+    count_ = 0;
+    sum_ = 0;
+    min_ = 0;
+    max_ = 0;
+}
+
+uint32_t LatencyHistogram::count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+int64_t LatencyHistogram::average() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_ ? sum_ / count_ : 0;
+}
+
+int64_t LatencyHistogram::Percentile(int percentile) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return PercentileLocked(percentile);
+}
+
+int64_t LatencyHistogram::PercentileLocked(int percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint32_t target = (count_ * percentile + 99) / 100;
+    if (target == 0) {
+        // p0 is the bucket of the smallest sample, not the first bucket
+        target = 1;
+    }
+    uint32_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i];
+        if (seen >= target) {
+            // The last bucket is open-ended, report the observed maximum instead
+            return i < kBucketCount - 1 ? (1LL << i) : max_;
+        }
+    }
+    return max_;
+}
+
+std::string LatencyHistogram::ToString() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "n=%" PRIu32 " avg=%" PRId64 " min=%" PRId64 " p50=%" PRId64 " p90=%" PRId64 " max=%" PRId64,
+             count_, count_ ? sum_ / count_ : 0, min_, PercentileLocked(50), PercentileLocked(90), max_);
+    return buffer;
+}
@@ -0,0 +1,36 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Fixed-size latency histogram with power-of-two millisecond buckets.
+// Recording is O(1) and allocation-free, so it can be used on hot paths.
+class LatencyHistogram {
+public:
+    static constexpr int kBucketCount = 16;  // [0,1) [1,2) [2,4) ... [16384, inf) ms
+
+    void Record(int64_t ms);
+    void Reset();
+
+    uint32_t count() const;
+    int64_t average() const;
+    // Upper bound of the bucket containing the given percentile (0-100)
+    int64_t Percentile(int percentile) const;
+
+    // e.g. "n=12 avg=812 min=430 p50=1024 p90=2048 max=1870"
+    std::string ToString() const;
+
+private:
+    mutable std::mutex mutex_;
+    uint32_t buckets_[kBucketCount] = {};
+    uint32_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t min_ = 0;
+    int64_t max_ = 0;
+
+    int64_t PercentileLocked(int percentile) const;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -13,6 +13,7 @@
 #include "application.h"
 #include "display.h"
 #include "board.h"
+#include "voice_latency_tracer.h"
 
 #define TAG "MCP"
 
@@ -45,6 +46,15 @@ void McpServer::AddCommonTools() {
             return board.GetDeviceStatusJson();
         });
 
+    AddTool("self.get_voice_latency",
+        "Provides the response latency of recent conversation turns, from the wake word to the first sound of the reply, "
+        "split into connect, first_send, stt, llm, tts and playout stages in milliseconds.\n"
+        "Use this tool when the user asks why the device responds slowly.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return VoiceLatencyTracer::GetInstance().ToJson();
+        });
+
     AddTool("self.audio_speaker.set_volume", 
         "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
         PropertyList({
@@ -123,6 +133,93 @@ void McpServer::AddCommonTools() {
                 ESP_LOGD(TAG, "Music details result: %s", download_result.c_str());
                 return true;
             });
+
+        AddTool("self.music.seek",
+            "跳转到当前正在播放的歌曲的指定位置。当用户要求快进、快退或从某个时间开始播放时使用此工具。\n"
+            "参数:\n"
+            "  `position_seconds`: 目标位置，单位为秒，从歌曲开头算起。\n"
+            "返回:\n"
+            "  跳转是否成功。",
+            PropertyList({
+                Property("position_seconds", kPropertyTypeInteger, 0, 7200)
+            }),
+            [music](const PropertyList& properties) -> ReturnValue {
+                int64_t position_ms = (int64_t)properties["position_seconds"].value<int>() * 1000;
+                if (!music->Seek(position_ms)) {
+                    return "{\"success\": false, \"message\": \"当前歌曲不支持跳转\"}";
+                }
+                return true;
+            });
+
+        AddTool("self.music.next",
+            "切换到播放队列中的下一首歌曲。当用户要求下一首、切歌或换一首时使用此工具。\n"
+            "返回:\n"
+            "  切换是否成功。",
+            PropertyList(),
+            [music](const PropertyList& properties) -> ReturnValue {
+                if (!music->NextSong()) {
+                    return "{\"success\": false, \"message\": \"播放队列中没有下一首\"}";
+                }
+                return true;
+            });
+
+        AddTool("self.music.previous",
+            "回到上一首播放过的歌曲。当用户要求上一首或重新播放刚才那首歌时使用此工具。\n"
+            "返回:\n"
+            "  切换是否成功。",
+            PropertyList(),
+            [music](const PropertyList& properties) -> ReturnValue {
+                if (!music->PreviousSong()) {
+                    return "{\"success\": false, \"message\": \"没有上一首\"}";
+                }
+                return true;
+            });
+
+        AddTool("self.music.get_queue",
+            "查看播放队列：当前歌曲、播放模式和接下来要播放的歌曲。当用户询问下一首是什么或播放列表时使用此工具。\n"
+            "返回:\n"
+            "  播放队列信息，JSON格式。",
+            PropertyList(),
+            [music](const PropertyList& properties) -> ReturnValue {
+                return music->GetPlayQueue();
+            });
+
+        AddTool("self.music.set_play_mode",
+            "设置播放模式。当用户要求顺序播放、列表循环、单曲循环或随机播放时使用此工具。\n"
+            "参数:\n"
+            "  `mode`: sequential（顺序播放）、repeat_all（列表循环）、repeat_one（单曲循环）或 shuffle（随机播放）。\n"
+            "返回:\n"
+            "  设置是否成功。",
+            PropertyList({
+                Property("mode", kPropertyTypeString)
+            }),
+            [music](const PropertyList& properties) -> ReturnValue {
+                auto mode = properties["mode"].value<std::string>();
+                if (!music->SetPlayMode(mode)) {
+                    return "{\"success\": false, \"message\": \"不支持的播放模式\"}";
+                }
+                return true;
+            });
+
+        AddTool("self.music.play_radio",
+            "播放网络电台的直播流。当用户提供电台地址或要求收听某个网络电台时使用此工具，电台正在播放的节目名称会显示在屏幕上。\n"
+            "参数:\n"
+            "  `url`: 电台的 http/https 流地址，支持 SHOUTcast/Icecast 的 MP3 流。\n"
+            "  `name`: 电台名称，用于显示，可以为空。\n"
+            "返回:\n"
+            "  播放状态信息，不需确认，立刻开始播放。",
+            PropertyList({
+                Property("url", kPropertyTypeString),
+                Property("name", kPropertyTypeString, std::string(""))
+            }),
+            [music](const PropertyList& properties) -> ReturnValue {
+                auto url = properties["url"].value<std::string>();
+                auto name = properties["name"].value<std::string>();
+                if (!music->PlayRadio(url, name)) {
+                    return "{\"success\": false, \"message\": \"无效的电台地址\"}";
+                }
+                return true;
+            });
     }
 
     // Restore the original tools list to the end of the tools list
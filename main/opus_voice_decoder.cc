@@ -0,0 +1,58 @@
+#include "opus_voice_decoder.h"
+
+#include <esp_log.h>
+#include <opus.h>
+
+#define TAG "OpusVoiceDecoder"
+
+// Longest Opus packet is 120ms
+#define MAX_PACKET_DURATION_MS 120
+
+OpusVoiceDecoder::OpusVoiceDecoder(int sample_rate, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms), frame_samples_(sample_rate * duration_ms / 1000) {
+    int error = OPUS_OK;
+    decoder_ = opus_decoder_create(sample_rate, 1, &error);
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create decoder: %d", error);
+    }
+}
+
+OpusVoiceDecoder::~OpusVoiceDecoder() {
+    if (decoder_ != nullptr) {
+        opus_decoder_destroy(decoder_);
+    }
+}
+
+bool OpusVoiceDecoder::Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) {
+    return Run(data, size, sample_rate_ * MAX_PACKET_DURATION_MS / 1000, false, pcm);
+}
+
+bool OpusVoiceDecoder::DecodeFec(const uint8_t* data, size_t size, std::vector<int16_t>& pcm) {
+    // The FEC frame size must be exactly the duration of the lost frame
+    return Run(data, size, frame_samples_, true, pcm);
+}
+
+bool OpusVoiceDecoder::Conceal(std::vector<int16_t>& pcm) {
+    return Run(nullptr, 0, frame_samples_, false, pcm);
+}
+
+void OpusVoiceDecoder::ResetState() {
+    if (decoder_ != nullptr) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    }
+}
+
+bool OpusVoiceDecoder::Run(const uint8_t* data, size_t size, int max_samples, bool fec, std::vector<int16_t>& pcm) {
+    if (decoder_ == nullptr) {
+        return false;
+    }
+    pcm.resize(max_samples);
+    int samples = opus_decode(decoder_, data, size, pcm.data(), max_samples, fec ? 1 : 0);
+    if (samples < 0) {
+        ESP_LOGW(TAG, "Failed to decode audio, error code: %d", samples);
+        pcm.clear();
+        return false;
+    }
+    pcm.resize(samples);
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef OPUS_VOICE_DECODER_H
+#define OPUS_VOICE_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct OpusDecoder;
+
+// Mono Opus decoder for the downlink voice stream. Unlike OpusDecoderWrapper
+// it decodes straight from a packet slot and can fill in a lost frame, either
+// from the in-band FEC carried by the packet after it or by concealment.
+class OpusVoiceDecoder {
+public:
+    OpusVoiceDecoder(int sample_rate, int duration_ms);
+    ~OpusVoiceDecoder();
+    OpusVoiceDecoder(const OpusVoiceDecoder&) = delete;
+    OpusVoiceDecoder& operator=(const OpusVoiceDecoder&) = delete;
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+    bool Decode(const uint8_t* data, size_t size, std::vector<int16_t>& pcm);
+    // Rebuild the frame before the given packet from its FEC data. The decoder
+    // conceals the frame instead when the encoder did not include any.
+    bool DecodeFec(const uint8_t* data, size_t size, std::vector<int16_t>& pcm);
+    // Extrapolate one frame from the previous ones
+    bool Conceal(std::vector<int16_t>& pcm);
+    void ResetState();
+
+private:
+    OpusDecoder* decoder_ = nullptr;
+    int sample_rate_;
+    int duration_ms_;
+    int frame_samples_;
+
+    bool Run(const uint8_t* data, size_t size, int max_samples, bool fec, std::vector<int16_t>& pcm);
+};
+
+#endif // OPUS_VOICE_DECODER_H
@@ -0,0 +1,54 @@
+#include "p3_sound.h"
+#include "protocol.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <arpa/inet.h>
+
+#define TAG "P3Sound"
+
+P3Sound::P3Sound(std::string_view data) : data_(data) {
+    for (auto& index : Lang::Sounds::FRAME_INDEXES) {
+        if (index.data != nullptr && index.data == data.data()) {
+            offsets_ = index.offsets;
+            frame_count_ = index.count;
+            break;
+        }
+    }
+}
+
+bool P3Sound::NextPacket(AudioStreamPacket& packet) {
+    size_t offset;
+    size_t size;
+    if (offsets_ != nullptr) {
+        if (next_ >= frame_count_) {
+            return false;
+        }
+        offset = offsets_[next_];
+        // The next frame's header follows this payload
+        size_t end = next_ + 1 < frame_count_ ? offsets_[next_ + 1] - sizeof(BinaryProtocol3) : data_.size();
+        size = end - offset;
+        next_++;
+    } else {
+        if (next_ + sizeof(BinaryProtocol3) > data_.size()) {
+            return false;
+        }
+        auto p3 = (const BinaryProtocol3*)(data_.data() + next_);
+        offset = next_ + sizeof(BinaryProtocol3);
+        size = ntohs(p3->payload_size);
+        if (offset + size > data_.size()) {
+            ESP_LOGW(TAG, "Truncated frame at offset %u", (unsigned int)next_);
+            next_ = data_.size();
+            return false;
+        }
+        next_ = offset + size;
+    }
+
+    // Sounds are converted at 16kHz with 60ms frames
+    packet.sample_rate = 16000;
+    packet.frame_duration = 60;
+    packet.timestamp = 0;
+    packet.sequence = 0;
+    packet.payload = AudioPayload::View((const uint8_t*)data_.data() + offset, size);
+    return true;
+}
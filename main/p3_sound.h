@@ -0,0 +1,28 @@
+#ifndef P3_SOUND_H
+#define P3_SOUND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "audio_packet_pool.h"
+
+// Plays back a P3 sound embedded in flash one Opus frame at a time. Packets
+// are views into the sound, nothing is copied. The frame offsets come from
+// the index generated with lang_config.h; sounds without one are parsed
+// header by header.
+class P3Sound {
+public:
+    explicit P3Sound(std::string_view data);
+
+    // Fails at the end of the sound
+    bool NextPacket(AudioStreamPacket& packet);
+
+private:
+    std::string_view data_;
+    const uint16_t* offsets_ = nullptr;
+    size_t frame_count_ = 0;
+    size_t next_ = 0;  // Next frame with an index, byte offset of the next header without
+};
+
+#endif // P3_SOUND_H
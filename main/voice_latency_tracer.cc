@@ -0,0 +1,148 @@
+#include "voice_latency_tracer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+#include <cinttypes>
+
+#define TAG "VoiceLatency"
+
+// Stage ending at each event, the first entry is the whole turn
+static const char* const kStageNames[VoiceLatencyTracer::kEventCount] = {
+    "total",
+    "connect",
+    "first_send",
+    "stt",
+    "llm",
+    "tts",
+    "playout",
+};
+
+void VoiceLatencyTracer::Begin(const char* trigger, bool restart) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_ && !restart) {
+        return;
+    }
+    // An unfinished turn is dropped, the user gave up or interrupted it
+    current_ = Turn();
+    current_.trigger = trigger;
+    current_.times_us[kTrigger] = esp_timer_get_time();
+    active_ = true;
+}
+
+void VoiceLatencyTracer::Mark(Event event) {
+    if (!active_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_ || current_.times_us[event] != 0) {
+        return;
+    }
+    // Local sounds reach the codec too, only TTS ends the turn
+    if (event == kFirstOutput && current_.times_us[kFirstPacketQueued] == 0) {
+        return;
+    }
+    current_.times_us[event] = esp_timer_get_time();
+    if (event == kFirstOutput) {
+        Finish();
+    }
+}
+
+int64_t VoiceLatencyTracer::StageMs(const Turn& turn, int event) {
+    if (turn.times_us[event] == 0) {
+        return -1;
+    }
+    if (event == kTrigger) {
+        return (turn.times_us[kFirstOutput] - turn.times_us[kTrigger]) / 1000;
+    }
+    // From the latest earlier event, skipped events merge into this stage
+    for (int i = event - 1; i >= 0; i--) {
+        if (turn.times_us[i] != 0) {
+            return (turn.times_us[event] - turn.times_us[i]) / 1000;
+        }
+    }
+    return -1;
+}
+
+void VoiceLatencyTracer::Finish() {
+    active_ = false;
+    int64_t stages[kEventCount];
+    for (int i = 0; i < kEventCount; i++) {
+        stages[i] = StageMs(current_, i);
+        if (stages[i] >= 0) {
+            histograms_[i].Record(stages[i]);
+        }
+    }
+    history_[history_head_] = current_;
+    history_head_ = (history_head_ + 1) % kHistorySize;
+    if (history_count_ < kHistorySize) {
+        history_count_++;
+    }
+    finished_count_++;
+
+    ESP_LOGI(TAG, "%s to first TTS sample: %" PRId64 "ms (connect %" PRId64 ", first send %" PRId64 ", stt %" PRId64
+             ", llm %" PRId64 ", tts %" PRId64 ", playout %" PRId64 ")", current_.trigger, stages[kTrigger],
+             stages[kChannelOpened], stages[kFirstAudioSent], stages[kSttReceived], stages[kTtsStarted],
+             stages[kFirstPacketQueued], stages[kFirstOutput]);
+}
+
+std::string VoiceLatencyTracer::ToJson() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON* stages = cJSON_CreateObject();
+    for (int i = 0; i < kEventCount; i++) {
+        auto& histogram = histograms_[i];
+        if (histogram.count() == 0) {
+            continue;
+        }
+        cJSON* stage = cJSON_CreateObject();
+        cJSON_AddNumberToObject(stage, "count", histogram.count());
+        cJSON_AddNumberToObject(stage, "avg", histogram.average());
+        cJSON_AddNumberToObject(stage, "p50", histogram.Percentile(50));
+        cJSON_AddNumberToObject(stage, "p90", histogram.Percentile(90));
+        cJSON_AddItemToObject(stages, kStageNames[i], stage);
+    }
+    cJSON_AddItemToObject(root, "stages", stages);
+
+    cJSON* recent = cJSON_CreateArray();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Newest first
+        for (int n = 0; n < history_count_; n++) {
+            const Turn& turn = history_[(history_head_ - 1 - n + kHistorySize) % kHistorySize];
+            cJSON* item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "trigger", turn.trigger);
+            for (int i = 0; i < kEventCount; i++) {
+                int64_t ms = StageMs(turn, i);
+                if (ms >= 0) {
+                    cJSON_AddNumberToObject(item, kStageNames[i], ms);
+                }
+            }
+            cJSON_AddItemToArray(recent, item);
+        }
+    }
+    cJSON_AddItemToObject(root, "recent", recent);
+
+    std::string result;
+    char* json = cJSON_PrintUnformatted(root);
+    if (json != nullptr) {
+        result = json;
+        cJSON_free(json);
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+void VoiceLatencyTracer::PrintStats() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_count_ == printed_count_) {
+            return;
+        }
+        printed_count_ = finished_count_;
+    }
+    for (int i = 0; i < kEventCount; i++) {
+        if (histograms_[i].count() > 0) {
+            ESP_LOGI(TAG, "%-10s %s", kStageNames[i], histograms_[i].ToString().c_str());
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef VOICE_LATENCY_TRACER_H
+#define VOICE_LATENCY_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "latency_histogram.h"
+
+// Traces one conversation turn from the wake word (or button) to the first
+// TTS sample reaching the codec, split into the stages in between. Finished
+// turns go into a small ring buffer and every stage into its own histogram,
+// so a slow response can be pinned on the connection, the server or playback.
+class VoiceLatencyTracer {
+public:
+    // In the order they happen during a turn
+    enum Event {
+        kTrigger,            // Wake word detected or chat started with the button
+        kChannelOpened,      // Only when the audio channel had to be opened: TLS connect and hello
+        kFirstAudioSent,
+        kSttReceived,
+        kTtsStarted,
+        kFirstPacketQueued,  // First TTS packet in the decode queue
+        kFirstOutput,        // First TTS sample written to the codec, ends the turn
+        kEventCount,
+    };
+    static constexpr int kHistorySize = 8;
+
+    static VoiceLatencyTracer& GetInstance() {
+        static VoiceLatencyTracer instance;
+        return instance;
+    }
+    VoiceLatencyTracer(const VoiceLatencyTracer&) = delete;
+    VoiceLatencyTracer& operator=(const VoiceLatencyTracer&) = delete;
+
+    // Start a turn. With restart false a turn already in progress is kept,
+    // for listening that resumes on its own after the device has spoken.
+    void Begin(const char* trigger, bool restart = true);
+    // Only the first mark of each event in a turn counts
+    void Mark(Event event);
+    // Cheap check for hot paths before calling Mark
+    bool active() const { return active_; }
+
+    // Stage histograms and the recent turns, in milliseconds
+    std::string ToJson();
+    // Log the stage histograms if turns have finished since the last call
+    void PrintStats();
+
+private:
+    VoiceLatencyTracer() = default;
+
+    struct Turn {
+        const char* trigger = nullptr;
+        int64_t times_us[kEventCount] = {};  // 0 when the event did not happen
+    };
+
+    std::mutex mutex_;
+    std::atomic<bool> active_{false};
+    Turn current_;
+    Turn history_[kHistorySize];
+    int history_head_ = 0;
+    int history_count_ = 0;
+    // Indexed by the event ending the stage, kTrigger holds the whole turn
+    LatencyHistogram histograms_[kEventCount];
+    uint32_t finished_count_ = 0;
+    uint32_t printed_count_ = 0;
+
+    void Finish();
+    static int64_t StageMs(const Turn& turn, int event);
+};
+
+#endif // VOICE_LATENCY_TRACER_H
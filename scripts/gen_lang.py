@@ -2,10 +2,16 @@
 import argparse
 import json
 import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), 'p3_tools'))
+from p3_index import build_index
 
 HEADER_TEMPLATE = """// Auto-generated language config
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 #ifndef {lang_code_for_font}
@@ -24,6 +30,18 @@ namespace Lang {{
     // 音效资源
     namespace Sounds {{
 {sounds}
+
+        // 构建时生成的帧索引：每帧 Opus 数据在音效中的偏移，播放时不用再逐帧解析头部
+        struct FrameIndex {{
+            const char* data;
+            const uint16_t* offsets;
+            size_t count;
+        }};
+{frame_offsets}
+        inline const FrameIndex FRAME_INDEXES[] = {{
+{frame_indexes}
+            {{nullptr, nullptr, 0}},
+        }};
     }}
 }}
 """
@@ -45,23 +63,14 @@ def generate_header(input_path, output_path):
         value = value.replace('"', '\\"')
         strings.append(f'        constexpr const char* {key.upper()} = "{value}";')
 
-    # 生成音效常量
-    for file in os.listdir(os.path.dirname(input_path)):
-        if file.endswith('.p3'):
-            base_name = os.path.splitext(file)[0]
-            sounds.append(f'''
-        extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
-        extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
-        static const std::string_view P3_{base_name.upper()} {{
-        static_cast<const char*>(p3_{base_name}_start),
-        static_cast<size_t>(p3_{base_name}_end - p3_{base_name}_start)
-        }};''')
-    
-    # 生成公共音效
-    for file in os.listdir(os.path.join(os.path.dirname(output_path), 'common')):
-        if file.endswith('.p3'):
-            base_name = os.path.splitext(file)[0]
-            sounds.append(f'''
+    # 生成音效常量和帧索引
+    frame_offsets = []
+    frame_indexes = []
+    for directory in (os.path.dirname(input_path), os.path.join(os.path.dirname(output_path), 'common')):
+        for file in os.listdir(directory):
+            if file.endswith('.p3'):
+                base_name = os.path.splitext(file)[0]
+                sounds.append(f'''
         extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
         extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
         static const std::string_view P3_{base_name.upper()} {{
@@ -69,12 +78,21 @@ def generate_header(input_path, output_path):
         static_cast<size_t>(p3_{base_name}_end - p3_{base_name}_start)
         }};''')
 
+                # 无法建立索引的音效在运行时解析
+                offsets = build_index(os.path.join(directory, file))
+                if offsets:
+                    frame_offsets.append(f'''
+        inline constexpr uint16_t P3_{base_name.upper()}_FRAMES[] = {{{", ".join(str(offset) for offset in offsets)}}};''')
+                    frame_indexes.append(f'            {{p3_{base_name}_start, P3_{base_name.upper()}_FRAMES, {len(offsets)}}},')
+
     # 填充模板
     content = HEADER_TEMPLATE.format(
         lang_code=lang_code,
         lang_code_for_font=lang_code.replace('-', '_').lower(),
         strings="\n".join(sorted(strings)),
-        sounds="\n".join(sorted(sounds))
+        sounds="\n".join(sorted(sounds)),
+        frame_offsets="\n".join(sorted(frame_offsets)),
+        frame_indexes="\n".join(sorted(frame_indexes))
     )
 
     # 写入文件
@@ -0,0 +1,57 @@
+# build a frame index for P3 files, used by gen_lang.py for the embedded sounds
+import argparse
+import struct
+import sys
+
+HEADER_SIZE = 4
+FRAME_DURATION_MS = 60
+# Offsets are stored as uint16_t, larger files are parsed at run time instead
+MAX_INDEXED_SIZE = 0x10000
+
+
+def read_frame_offsets(data):
+    """Return the offset of every Opus payload in P3 data, raise ValueError if it is malformed"""
+    offsets = []
+    pos = 0
+    while pos < len(data):
+        if pos + HEADER_SIZE > len(data):
+            raise ValueError(f'truncated frame header at offset {pos}')
+        _, _, size = struct.unpack_from('>BBH', data, pos)
+        pos += HEADER_SIZE
+        if pos + size > len(data):
+            raise ValueError(f'frame at offset {pos} needs {size} bytes, only {len(data) - pos} left')
+        offsets.append(pos)
+        pos += size
+    return offsets
+
+
+def build_index(path):
+    """Return the payload offsets of a P3 file, or None if it cannot be indexed"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) >= MAX_INDEXED_SIZE:
+        print(f'{path}: {len(data)} bytes is too large to index, parsed at run time', file=sys.stderr)
+        return None
+    try:
+        return read_frame_offsets(data)
+    except ValueError as e:
+        print(f'{path}: {e}, parsed at run time', file=sys.stderr)
+        return None
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Check P3 files and print their frame index')
+    parser.add_argument('files', nargs='+', help='P3 files')
+    parser.add_argument('-v', '--verbose', action='store_true', help='Print every payload offset')
+    args = parser.parse_args()
+
+    failed = False
+    for path in args.files:
+        offsets = build_index(path)
+        if offsets is None:
+            failed = True
+            continue
+        print(f'{path}: {len(offsets)} frames, {len(offsets) * FRAME_DURATION_MS} ms')
+        if args.verbose:
+            print('  ' + ', '.join(str(offset) for offset in offsets))
+    sys.exit(1 if failed else 0)
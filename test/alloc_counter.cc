@@ -0,0 +1,83 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// 每块前面保存长度，保持 16 字节对齐
+constexpr size_t kHeader = 16;
+
+std::atomic<size_t> current{0};
+std::atomic<size_t> peak{0};
+std::atomic<size_t> count{0};
+
+} // namespace
+
+size_t AllocCurrent() {
+    return current.load();
+}
+
+size_t AllocPeak() {
+    return peak.load();
+}
+
+void AllocResetPeak() {
+    peak.store(current.load());
+}
+
+size_t AllocCount() {
+    return count.load();
+}
+
+void* CountedMalloc(size_t size) {
+    char* block = (char*)malloc(size + kHeader);
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *(size_t*)block = size;
+    count.fetch_add(1);
+    size_t now = current.fetch_add(size) + size;
+    size_t previous = peak.load();
+    while (now > previous && !peak.compare_exchange_weak(previous, now)) {
+    }
+    return block + kHeader;
+}
+
+void CountedFree(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    char* block = (char*)ptr - kHeader;
+    current.fetch_sub(*(size_t*)block);
+    free(block);
+}
+
+void* operator new(size_t size) {
+    void* ptr = CountedMalloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    CountedFree(ptr);
+}
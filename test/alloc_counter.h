@@ -0,0 +1,18 @@
+#ifndef HOST_ALLOC_COUNTER_H
+#define HOST_ALLOC_COUNTER_H
+
+#include <cstddef>
+
+// 统计堆内存的当前用量和峰值，链接 alloc_counter.cc 后 operator new/delete 都会计入，
+// C 库（如 cJSON）可以通过 CountedMalloc/CountedFree 接入
+size_t AllocCurrent();
+size_t AllocPeak();
+// 把峰值重置为当前用量，之后的 AllocPeak() - 基准 即为这段代码的额外峰值
+void AllocResetPeak();
+// 累计分配次数，两次读数之差即为一段代码的分配次数
+size_t AllocCount();
+
+void* CountedMalloc(size_t size);
+void CountedFree(void* ptr);
+
+#endif // HOST_ALLOC_COUNTER_H
@@ -0,0 +1,381 @@
+// AudioJitterBuffer：按可配置的丢包、抖动、乱序和突发到达轨迹模拟下行播放，
+// 和旧的按到达顺序直接解码对比乱序播放、无补偿的断点、欠载和延迟；另外测试序号回绕、重复包和新流
+#include "audio_jitter_buffer.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kFrameMs = 60;
+// AUDIO_MIXER_QUEUE_SAMPLES 在 24kHz 下约两帧，解码线程在混音队列满时阻塞
+constexpr int kMixerFrames = 2;
+
+struct Trace {
+    const char* name;
+    int frames = 1000;
+    uint32_t first_sequence = 1;
+    int base_delay_ms = 40;
+    int jitter_ms = 0;          // 每个包额外延迟 0..jitter_ms，均匀分布
+    bool fifo = false;          // 链路先进先出：包不会超过前一个包，只有 swap 造成乱序
+    int stall_every = 0;        // 每隔这么多帧链路停顿一次（WiFi 省电或重传），0 为没有
+    int stall_ms = 0;           // 停顿期间发出的包在停顿结束时一起到达
+    double loss = 0;            // 独立丢包率
+    int burst_loss_every = 0;   // 每隔这么多帧连续丢 burst_loss_length 个包
+    int burst_loss_length = 0;
+    double swap = 0;            // 相邻两个包交换到达顺序的概率
+    double duplicate = 0;
+    int send_ahead = 0;         // 开头这么多帧服务器一次发出
+};
+
+struct Arrival {
+    int64_t time_ms;
+    uint32_t sequence;
+    int64_t send_ms;
+};
+
+std::vector<Arrival> MakeArrivals(const Trace& trace, uint32_t seed, int& lost) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<Arrival> arrivals;
+    lost = 0;
+    for (int i = 0; i < trace.frames; i++) {
+        bool drop = uniform(rng) < trace.loss;
+        if (trace.burst_loss_every > 0 && i % trace.burst_loss_every >= trace.burst_loss_every - trace.burst_loss_length) {
+            drop = true;
+        }
+        if (i == 0 || i == trace.frames - 1) {
+            drop = false;  // 开头和结尾的丢包无法察觉
+        }
+        if (drop) {
+            lost++;
+            continue;
+        }
+        int64_t send_ms = i < trace.send_ahead ? 0 : (int64_t)(i - trace.send_ahead) * kFrameMs;
+        int64_t delay = trace.base_delay_ms + (trace.jitter_ms > 0 ? rng() % (trace.jitter_ms + 1) : 0);
+        if (trace.stall_every > 0) {
+            int64_t period_ms = (int64_t)trace.stall_every * kFrameMs;
+            int64_t stall_start = send_ms / period_ms * period_ms + period_ms / 2;
+            if (send_ms >= stall_start && send_ms < stall_start + trace.stall_ms) {
+                delay = std::max(delay, stall_start + trace.stall_ms - send_ms);
+            }
+        }
+        int64_t time_ms = send_ms + delay;
+        if (trace.fifo && !arrivals.empty()) {
+            time_ms = std::max(time_ms, arrivals.back().time_ms);
+        }
+        arrivals.push_back({time_ms, trace.first_sequence + i, send_ms});
+        if (uniform(rng) < trace.duplicate) {
+            arrivals.push_back({time_ms + 5, trace.first_sequence + i, send_ms});
+        }
+    }
+    for (size_t i = 1; i < arrivals.size(); i++) {
+        if (uniform(rng) < trace.swap) {
+            // 只交换相邻的两个，交换过的包不再参与下一次交换
+            std::swap(arrivals[i - 1].time_ms, arrivals[i].time_ms);
+            i++;
+        }
+    }
+    std::stable_sort(arrivals.begin(), arrivals.end(), [](const Arrival& a, const Arrival& b) {
+        return a.time_ms < b.time_ms;
+    });
+    return arrivals;
+}
+
+struct PlayResult {
+    int played = 0;
+    int reordered = 0;       // 序号比上一个播放的小
+    int discontinuities = 0; // 序号跳过且没有补偿，听得到的咔嗒声
+    int fec = 0;
+    int concealed = 0;
+    int skipped = 0;
+    int late = 0;
+    int expanded = 0;
+    int underruns = 0;       // 流中间扬声器没有数据
+    double latency_ms = 0;   // 发送到开始播放的平均时间
+    int max_depth = 0;
+};
+
+// 扬声器每毫秒消耗 1ms 音频；解码线程在混音队列不满时取下一帧，和 AudioDecodeLoop 一样
+PlayResult Play(const Trace& trace, uint32_t seed, bool use_jitter_buffer, AudioJitterBuffer& buffer,
+                int& injected_loss) {
+    auto arrivals = MakeArrivals(trace, seed, injected_loss);
+    std::deque<AudioStreamPacket> queue;
+    std::vector<int64_t> send_ms(trace.frames + 1, 0);
+    for (auto& a : arrivals) {
+        send_ms[a.sequence - trace.first_sequence] = a.send_ms;
+    }
+    PlayResult result;
+    size_t next_arrival = 0;
+    int64_t queued_ms = 0;   // 混音队列里的音频
+    bool started = false;
+    bool starving = false;
+    bool has_last = false;
+    uint32_t last_sequence = 0;
+    int64_t latency_sum = 0;
+    int latency_count = 0;
+    int64_t end_ms = arrivals.back().time_ms + 2000;
+
+    auto output = [&](int64_t now_ms, uint32_t sequence, bool real) {
+        if (real) {
+            if (has_last && (int32_t)(sequence - last_sequence) < 0) {
+                result.reordered++;
+            } else if (has_last && sequence != last_sequence + 1) {
+                result.discontinuities++;
+            }
+            // 播放开始时间 = 现在 + 前面排队的音频
+            latency_sum += now_ms + queued_ms - send_ms[sequence - trace.first_sequence];
+            latency_count++;
+            result.played++;
+        }
+        last_sequence = sequence;
+        has_last = true;
+        queued_ms += kFrameMs;
+        started = true;
+    };
+
+    for (int64_t now_ms = 0; now_ms < end_ms; now_ms++) {
+        while (next_arrival < arrivals.size() && arrivals[next_arrival].time_ms <= now_ms) {
+            AudioStreamPacket packet;
+            packet.sequence = arrivals[next_arrival].sequence;
+            packet.frame_duration = kFrameMs;
+            if (use_jitter_buffer) {
+                buffer.OnArrival(packet.sequence, packet.frame_duration, now_ms);
+            }
+            queue.push_back(std::move(packet));
+            next_arrival++;
+        }
+
+        // 混音队列满时解码线程阻塞
+        while (queued_ms <= (kMixerFrames - 1) * kFrameMs) {
+            if (!use_jitter_buffer) {
+                if (queue.empty()) {
+                    break;
+                }
+                output(now_ms, queue.front().sequence, true);
+                queue.pop_front();
+                continue;
+            }
+            while (!queue.empty() && buffer.Fits(queue.front().sequence)) {
+                buffer.Put(std::move(queue.front()), now_ms);
+                queue.pop_front();
+            }
+            result.max_depth = std::max(result.max_depth, buffer.target_depth());
+            AudioStreamPacket packet;
+            bool urgent = queued_ms < kFrameMs;
+            uint32_t expanded = buffer.stats().expanded;
+            auto action = buffer.Next(now_ms, urgent, packet);
+            if (action == AudioJitterBuffer::Action::kNone) {
+                break;
+            }
+            if (action == AudioJitterBuffer::Action::kPacket) {
+                output(now_ms, packet.sequence, true);
+            } else if (buffer.stats().expanded != expanded) {
+                // 等待迟到包时插入的补偿帧不占序号
+                output(now_ms, last_sequence, false);
+            } else {
+                CHECK(action != AudioJitterBuffer::Action::kFec || buffer.PeekNext() != nullptr);
+                // 补出来的帧占用丢失的序号
+                output(now_ms, last_sequence + 1, false);
+            }
+        }
+
+        // 流中间扬声器没有数据，连续的欠载只在开始时计一次
+        if (queued_ms > 0) {
+            queued_ms--;
+            starving = false;
+        } else if (started && next_arrival < arrivals.size()) {
+            result.underruns += starving ? 0 : 1;
+            starving = true;
+        }
+    }
+    if (use_jitter_buffer) {
+        auto& stats = buffer.stats();
+        result.late = stats.late;
+        result.fec = stats.fec;
+        result.concealed = stats.lost - stats.fec;
+        result.skipped = stats.skipped;
+        result.expanded = stats.expanded;
+        CHECK(buffer.empty());
+    }
+    result.latency_ms = latency_count > 0 ? (double)latency_sum / latency_count : 0;
+    return result;
+}
+
+void TestTraces() {
+    Trace clean{"clean"};
+    Trace loss{"5% loss"};
+    loss.loss = 0.05;
+    Trace burst{"burst loss 8/200"};
+    burst.burst_loss_every = 200;
+    burst.burst_loss_length = 8;
+    Trace reorder{"10% swapped"};
+    reorder.swap = 0.1;
+    Trace jitter{"jitter 0-150ms"};
+    jitter.jitter_ms = 150;
+    Trace stalls{"300ms stall / 3s"};
+    stalls.stall_every = 50;
+    stalls.stall_ms = 300;
+    Trace mixed{"mixed 4G"};
+    mixed.jitter_ms = 100;
+    mixed.fifo = true;
+    mixed.loss = 0.03;
+    mixed.swap = 0.05;
+    mixed.duplicate = 0.01;
+    mixed.send_ahead = 20;
+    mixed.first_sequence = 0xFFFFFF00;  // 序号中途回绕
+
+    printf("%-18s %-8s %6s %5s %6s %5s %5s %5s %5s %5s %6s %8s %6s %6s\n", "trace", "path", "played", "lost",
+           "order", "gaps", "fec", "plc", "skip", "late", "expand", "underrun", "lat ms", "depth");
+    for (const Trace* trace : {&clean, &loss, &burst, &reorder, &jitter, &stalls, &mixed}) {
+        PlayResult results[2];
+        int injected = 0;
+        for (int j = 0; j < 2; j++) {
+            AudioJitterBuffer buffer;
+            results[j] = Play(*trace, 11, j == 1, buffer, injected);
+            const PlayResult& r = results[j];
+            printf("%-18s %-8s %6d %5d %6d %5d %5d %5d %5d %5d %6d %8d %6.0f %6d\n", trace->name,
+                   j == 0 ? "arrival" : "jitter", r.played, injected, r.reordered, r.discontinuities, r.fec,
+                   r.concealed, r.skipped, r.late, r.expanded, r.underruns, r.latency_ms, r.max_depth);
+        }
+        const PlayResult& legacy = results[0];
+        const PlayResult& jb = results[1];
+        // 缓冲后严格按序号播放：每个序号要么播放，要么恢复或补偿，要么作为长空洞跳过，只出现一次
+        CHECK(jb.reordered == 0);
+        CHECK(jb.played + jb.fec + jb.concealed + jb.skipped == trace->frames);
+        // 到达的包要么播放，要么因为来得太晚被丢弃
+        CHECK(jb.played + jb.late + injected == trace->frames);
+        CHECK(jb.underruns <= legacy.underruns);
+        CHECK(jb.discontinuities <= legacy.discontinuities);
+        if (trace == &clean) {
+            CHECK(legacy.reordered == 0 && legacy.discontinuities == 0);
+            CHECK(jb.fec + jb.concealed == 0 && jb.underruns == 0);
+            // 没有抖动时只多缓冲一帧左右
+            CHECK(jb.latency_ms < legacy.latency_ms + 2 * kFrameMs);
+            CHECK(jb.max_depth <= 2);
+        }
+        if (trace == &loss) {
+            // 单个丢包等下一个包到达后用 FEC 恢复，旧路径每个丢包都欠载一次
+            CHECK(jb.discontinuities == 0);
+            CHECK(jb.fec * 10 >= injected * 8);
+            CHECK(jb.underruns * 10 <= legacy.underruns);
+        }
+        if (trace == &burst) {
+            CHECK(jb.skipped > 0);
+        }
+        if (trace == &reorder || trace == &jitter) {
+            // 只有深度跟上抖动之前的一两个包来不及，之后都按序播放
+            CHECK(legacy.reordered > 0);
+            CHECK(jb.late <= 2);
+        }
+        if (trace == &jitter || trace == &stalls) {
+            // 深度跟随抖动增加
+            CHECK(jb.max_depth > 2);
+        }
+        if (trace == &mixed) {
+            // 服务器开头超前发送的包不算抖动
+            CHECK(jb.max_depth <= 4);
+            CHECK(jb.late == 0 && jb.discontinuities == 0);
+        }
+    }
+}
+
+void TestSequenceEdges() {
+    AudioJitterBuffer buffer;
+    auto put = [&](uint32_t sequence, int64_t now_ms) {
+        AudioStreamPacket packet;
+        packet.sequence = sequence;
+        packet.frame_duration = kFrameMs;
+        buffer.OnArrival(sequence, kFrameMs, now_ms);
+        buffer.Put(std::move(packet), now_ms);
+    };
+    AudioStreamPacket packet;
+    using Action = AudioJitterBuffer::Action;
+
+    // 准时到达：序号 n 在 n * 60ms 到达，深度为 1
+    put(100, 6000);
+    CHECK(buffer.Next(6000, false, packet) == Action::kPacket && packet.sequence == 100);
+    put(101, 6060);
+    put(101, 6061);
+    CHECK(buffer.size() == 1 && buffer.stats().duplicate == 1);
+    CHECK(buffer.Next(6061, false, packet) == Action::kPacket && packet.sequence == 101);
+
+    // 102 丢失：输出还有数据时等待，快用完时用 103 的 FEC 恢复
+    put(103, 6180);
+    CHECK(buffer.Next(6180, false, packet) == Action::kNone);
+    CHECK(buffer.Next(6181, true, packet) == Action::kFec);
+    CHECK(buffer.PeekNext() != nullptr && buffer.PeekNext()->sequence == 103);
+    CHECK(buffer.Next(6182, false, packet) == Action::kPacket && packet.sequence == 103);
+
+    // 104、105 都丢：第一个只能 PLC，第二个用 FEC
+    put(106, 6360);
+    CHECK(buffer.Next(6360, true, packet) == Action::kConceal);
+    CHECK(buffer.Next(6361, true, packet) == Action::kFec);
+    CHECK(buffer.Next(6362, true, packet) == Action::kPacket && packet.sequence == 106);
+    CHECK(buffer.stats().lost == 3 && buffer.stats().fec == 2);
+
+    // 超过 3 帧的空洞直接跳过
+    put(111, 6660);
+    CHECK(buffer.Next(6660, true, packet) == Action::kPacket && packet.sequence == 111);
+    CHECK(buffer.stats().skipped == 4);
+
+    // 窗口外的包留在调用方队列里
+    put(112, 6720);
+    CHECK(buffer.Fits(112 + AudioJitterBuffer::kCapacity - 1));
+    CHECK(!buffer.Fits(112 + AudioJitterBuffer::kCapacity));
+    CHECK(buffer.Next(6720, false, packet) == Action::kPacket && packet.sequence == 112);
+    CHECK(buffer.target_depth() == 1);
+
+    // 113 晚到 60ms：深度还是 1，只能用 FEC，113 到达时丢弃；它的延迟让深度增加
+    put(114, 6840);
+    CHECK(buffer.Next(6841, true, packet) == Action::kFec);
+    CHECK(buffer.Next(6842, true, packet) == Action::kPacket && packet.sequence == 114);
+    put(113, 6840);
+    CHECK(buffer.stats().late == 1 && buffer.empty());
+    CHECK(buffer.target_depth() == 2);
+
+    // 再有包晚到时先插入一帧补偿继续等，包到了照常播放，不算丢包
+    put(116, 6960);
+    CHECK(buffer.Next(6961, true, packet) == Action::kConceal);
+    CHECK(buffer.stats().expanded == 1);
+    put(115, 7000);
+    CHECK(buffer.Next(7001, true, packet) == Action::kPacket && packet.sequence == 115);
+    CHECK(buffer.Next(7002, true, packet) == Action::kPacket && packet.sequence == 116);
+    CHECK(buffer.stats().lost == 4 && buffer.stats().late == 1);
+
+    // 流动中远远落后的旧包也是迟到，不会清空缓冲重新开始
+    put(117, 7020);
+    put(90, 7021);
+    CHECK(buffer.size() == 1 && buffer.stats().late == 2);
+    CHECK(buffer.Next(7022, true, packet) == Action::kPacket && packet.sequence == 117);
+
+    // 序号回绕
+    buffer.Reset();
+    buffer.ResetStats();
+    put(0xFFFFFFFF, 10000);
+    put(0, 10060);
+    CHECK(buffer.Next(10060, false, packet) == Action::kPacket && packet.sequence == 0xFFFFFFFF);
+    CHECK(buffer.Next(10061, false, packet) == Action::kPacket && packet.sequence == 0);
+
+    // 停了一秒以上之后的包开始新的一段：预缓冲不满时最多等深度对应的时间
+    put(500, 12000);
+    int depth = buffer.target_depth();
+    CHECK(depth > 1 || buffer.Next(12000, false, packet) == Action::kPacket);
+    if (depth > 1) {
+        CHECK(buffer.Next(12000, false, packet) == Action::kNone);
+        CHECK(buffer.Next(12000 + depth * kFrameMs, false, packet) == Action::kPacket && packet.sequence == 500);
+    }
+    CHECK(buffer.stats().lost == 0 && buffer.stats().skipped == 0 && buffer.stats().late == 0);
+}
+
+} // namespace
+
+int main() {
+    TestTraces();
+    TestSequenceEdges();
+    return TestResult();
+}
@@ -0,0 +1,558 @@
+// AudioPacketPool / AudioPacketQueue：槽位的获取和归还、耗尽时丢包不分配、队列环绕和多线程收发；
+// 之后对比旧的 std::list + std::vector 队列每个包的分配次数和耗时，
+// 并在模拟的内部 RAM 堆上跑一小时对话流量，比较两种方式下的堆碎片
+#include "audio_packet_pool.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kOpusFrameMs = 60;
+constexpr size_t kQueueCapacity = 2400 / kOpusFrameMs;  // MAX_AUDIO_PACKETS_IN_QUEUE
+
+AudioStreamPacket MakePacket(AudioPacketPool& pool, uint32_t sequence, size_t size) {
+    AudioStreamPacket packet;
+    packet.sequence = sequence;
+    packet.payload = pool.Acquire(size);
+    if (packet.payload.valid()) {
+        memset(packet.payload.data(), (uint8_t)sequence, size);
+    }
+    return packet;
+}
+
+void TestPool() {
+    auto& pool = AudioPacketPool::GetInstance();
+    CHECK(pool.slot_size() == CONFIG_AUDIO_PACKET_MAX_PAYLOAD);
+    CHECK(pool.slot_count() == CONFIG_AUDIO_PACKET_POOL_SLOTS);
+    CHECK(pool.available() == pool.slot_count());
+
+    const uint8_t data[] = {1, 2, 3, 4, 5};
+    AudioPayload payload = pool.Acquire(data, sizeof(data));
+    CHECK(payload.valid() && payload.size() == sizeof(data));
+    CHECK(memcmp(payload.data(), data, sizeof(data)) == 0);
+    CHECK(pool.available() == pool.slot_count() - 1);
+
+    // 移动后只有一个句柄持有槽位
+    AudioPayload moved = std::move(payload);
+    CHECK(!payload.valid() && moved.valid());
+    CHECK(pool.available() == pool.slot_count() - 1);
+    CHECK(moved.Resize(pool.slot_size()));
+    CHECK(!moved.Resize(pool.slot_size() + 1));
+    moved = AudioPayload();
+    CHECK(pool.available() == pool.slot_count());
+
+    // 超过槽位大小的包直接丢弃
+    uint32_t dropped = pool.dropped_count();
+    CHECK(!pool.Acquire(pool.slot_size() + 1).valid());
+    CHECK(pool.dropped_count() == dropped + 1);
+
+    // 全部占满后 Acquire 失败而不是分配，归还后可以再用
+    std::vector<AudioPayload> held;
+    held.reserve(pool.slot_count());
+    size_t allocs = AllocCount();
+    for (size_t i = 0; i < pool.slot_count(); i++) {
+        held.push_back(pool.Acquire(100));
+        CHECK(held.back().valid());
+    }
+    CHECK(!pool.Acquire(1).valid());
+    CHECK(pool.dropped_count() == dropped + 2);
+    CHECK(AllocCount() == allocs);
+    CHECK(pool.available() == 0 && pool.min_available() == 0);
+    // 每个槽位互不重叠
+    std::vector<const uint8_t*> addresses;
+    for (auto& p : held) {
+        addresses.push_back(p.data());
+    }
+    std::sort(addresses.begin(), addresses.end());
+    bool disjoint = true;
+    for (size_t i = 1; i < addresses.size(); i++) {
+        disjoint &= addresses[i] - addresses[i - 1] >= (ptrdiff_t)pool.slot_size();
+    }
+    CHECK(disjoint);
+    held.pop_back();
+    CHECK(pool.Acquire(1).valid());
+    held.clear();
+    CHECK(pool.available() == pool.slot_count());
+
+    // 只读视图不占槽位，不能改长度
+    AudioPayload view = AudioPayload::View(data, sizeof(data));
+    CHECK(view.valid() && view.data() == data && !view.Resize(1));
+    view.Release();
+    CHECK(pool.available() == pool.slot_count());
+}
+
+void TestQueue() {
+    auto& pool = AudioPacketPool::GetInstance();
+    AudioPacketQueue queue(8);
+    AudioPacketQueue other(8);
+    size_t allocs = AllocCount();
+    uint32_t next_in = 1;
+    uint32_t next_out = 1;
+    bool in_order = true;
+    // 反复绕过环的末尾
+    for (int round = 0; round < 20; round++) {
+        while (!queue.full()) {
+            CHECK(queue.Push(MakePacket(pool, next_in++, 50)));
+        }
+        AudioStreamPacket extra = MakePacket(pool, 0, 50);
+        CHECK(!queue.Push(std::move(extra)));
+        CHECK(queue.front().sequence == next_out);
+        for (int i = 0; i < 5; i++) {
+            AudioStreamPacket packet;
+            CHECK(queue.Pop(packet));
+            in_order &= packet.sequence == next_out && packet.payload.data()[0] == (uint8_t)next_out;
+            next_out++;
+        }
+    }
+    CHECK(in_order);
+    CHECK(AllocCount() == allocs);
+    CHECK(pool.available() == pool.slot_count() - queue.size());
+
+    queue.Swap(other);
+    CHECK(queue.empty() && other.size() == 3 && other.front().sequence == next_out);
+    other.Clear();
+    CHECK(other.empty());
+    CHECK(pool.available() == pool.slot_count());
+    AudioStreamPacket packet;
+    CHECK(!other.Pop(packet));
+}
+
+void TestThreads() {
+    // 协议回调、编码输出和 PlaySound 三个生产者共用一个队列，解码线程消费；和 Application 一样由外部加锁
+    auto& pool = AudioPacketPool::GetInstance();
+    AudioPacketQueue queue(kQueueCapacity);
+    std::mutex mutex;
+    constexpr int kPerProducer = 20000;
+    std::atomic<int> producers_done{0};
+    std::atomic<int> queued{0};
+    std::vector<uint32_t> last(3, 0);
+    bool ordered = true;
+    bool intact = true;
+    size_t consumed = 0;
+
+    std::thread consumer([&]() {
+        while (true) {
+            AudioStreamPacket packet;
+            bool got = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                got = queue.Pop(packet);
+            }
+            if (!got) {
+                if (producers_done.load() == 3) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (queue.empty()) {
+                        break;
+                    }
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t producer = packet.sequence >> 24;
+            uint32_t sequence = packet.sequence & 0xFFFFFF;
+            ordered &= sequence > last[producer];
+            last[producer] = sequence;
+            for (size_t i = 0; i < packet.payload.size(); i++) {
+                intact &= packet.payload.data()[i] == (uint8_t)(packet.sequence * 31);
+            }
+            consumed++;
+        }
+    });
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < 3; p++) {
+        producers.emplace_back([&, p]() {
+            std::mt19937 rng(p);
+            for (uint32_t i = 1; i <= kPerProducer; i++) {
+                AudioStreamPacket packet;
+                packet.sequence = (p << 24) | i;
+                // 和 PlaySound 一样，槽位或队列满时等解码线程腾出空间
+                while (!(packet.payload = pool.Acquire(20 + rng() % 300)).valid()) {
+                    std::this_thread::yield();
+                }
+                memset(packet.payload.data(), (uint8_t)(packet.sequence * 31), packet.payload.size());
+                while (true) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (queue.Push(std::move(packet))) {
+                            break;
+                        }
+                    }
+                    std::this_thread::yield();
+                }
+                queued++;
+            }
+            producers_done++;
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    consumer.join();
+    CHECK(ordered && intact);
+    CHECK(consumed == 3 * (size_t)kPerProducer && queued.load() == 3 * kPerProducer);
+    CHECK(pool.available() == pool.slot_count());
+}
+
+// 旧实现：每个包一个 list 节点和一个 payload vector
+struct LegacyPacket {
+    int sample_rate = 0;
+    int frame_duration = 0;
+    uint32_t timestamp = 0;
+    std::vector<uint8_t> payload;
+};
+
+void Benchmark() {
+    std::vector<uint8_t> opus(160, 0x5A);
+    const int kPackets = 200000;
+    const int kDepth = 20;  // 网络抖动时队列里积压的包数
+
+    // 两种队列都在 Application 的锁里操作，锁也算进去
+    std::mutex mutex;
+    std::list<LegacyPacket> legacy;
+    size_t allocs = AllocCount();
+    uint64_t start = BenchCycles();
+    double seconds = BenchSeconds();
+    for (int i = 0; i < kPackets; i++) {
+        LegacyPacket packet;
+        packet.payload = std::vector<uint8_t>(opus.begin(), opus.end());
+        std::lock_guard<std::mutex> lock(mutex);
+        legacy.push_back(std::move(packet));
+        if (legacy.size() > (size_t)kDepth) {
+            LegacyPacket out = std::move(legacy.front());
+            legacy.pop_front();
+            BenchKeep(out);
+        }
+    }
+    uint64_t legacy_cycles = BenchCycles() - start;
+    double legacy_seconds = BenchSeconds() - seconds;
+    size_t legacy_allocs = AllocCount() - allocs;
+    legacy.clear();
+
+    auto& pool = AudioPacketPool::GetInstance();
+    AudioPacketQueue queue(kQueueCapacity);
+    allocs = AllocCount();
+    start = BenchCycles();
+    seconds = BenchSeconds();
+    for (int i = 0; i < kPackets; i++) {
+        AudioStreamPacket packet;
+        packet.payload = pool.Acquire(opus.data(), opus.size());
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.Push(std::move(packet));
+        if (queue.size() > (size_t)kDepth) {
+            AudioStreamPacket out;
+            queue.Pop(out);
+            BenchKeep(out);
+        }
+    }
+    uint64_t pool_cycles = BenchCycles() - start;
+    double pool_seconds = BenchSeconds() - seconds;
+    size_t pool_allocs = AllocCount() - allocs;
+    queue.Clear();
+
+    printf("%-22s %12s %14s %10s\n", "160-byte packets", "allocs/pkt", "cycles/pkt", "ns/pkt");
+    printf("%-22s %12.2f %14.1f %10.1f\n", "list + vector", (double)legacy_allocs / kPackets,
+           (double)legacy_cycles / kPackets, legacy_seconds * 1e9 / kPackets);
+    printf("%-22s %12.2f %14.1f %10.1f\n", "pool + ring", (double)pool_allocs / kPackets,
+           (double)pool_cycles / kPackets, pool_seconds * 1e9 / kPackets);
+    printf("cycles are %s on this host; on the ESP32-S3 measure with esp_cpu_get_cycle_count()\n", BenchCycleUnit());
+    CHECK(legacy_allocs == 2 * (size_t)kPackets);
+    CHECK(pool_allocs == 0);
+}
+
+// 按地址排序的首次适配堆，块头 8 字节、8 字节对齐，只用于统计碎片，不真正存数据。
+// ESP-IDF 的 multi_heap 用 TLSF，分配位置和这里不同，但空闲区被小块切碎的趋势相同
+class ArenaModel {
+public:
+    explicit ArenaModel(size_t size) : size_(size) { free_[0] = size; }
+
+    // 返回偏移，失败返回 SIZE_MAX
+    size_t Alloc(size_t size) {
+        size = (size + 7) / 8 * 8 + kHeader;
+        for (auto it = free_.begin(); it != free_.end(); ++it) {
+            if (it->second >= size) {
+                size_t offset = it->first;
+                size_t remaining = it->second - size;
+                free_.erase(it);
+                if (remaining > 0) {
+                    free_[offset + size] = remaining;
+                }
+                used_[offset] = size;
+                used_bytes_ += size;
+                return offset;
+            }
+        }
+        failures_++;
+        return SIZE_MAX;
+    }
+
+    void Free(size_t offset) {
+        if (offset == SIZE_MAX) {
+            return;
+        }
+        auto used = used_.find(offset);
+        size_t size = used->second;
+        used_.erase(used);
+        used_bytes_ -= size;
+        auto next = free_.lower_bound(offset);
+        if (next != free_.end() && offset + size == next->first) {
+            size += next->second;
+            next = free_.erase(next);
+        }
+        if (next != free_.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+        free_[offset] = size;
+    }
+
+    size_t free_bytes() const { return size_ - used_bytes_; }
+    size_t largest_free() const {
+        size_t largest = 0;
+        for (auto& block : free_) {
+            largest = std::max(largest, block.second);
+        }
+        return largest;
+    }
+    size_t free_blocks() const { return free_.size(); }
+    size_t failures() const { return failures_; }
+
+private:
+    static constexpr size_t kHeader = 8;
+    size_t size_;
+    std::map<size_t, size_t> free_;
+    std::map<size_t, size_t> used_;
+    size_t used_bytes_ = 0;
+    size_t failures_ = 0;
+};
+
+enum class SoakMode {
+    kLegacy,        // std::list 节点和 payload vector 都在内部 RAM
+    kPoolInternal,  // 没有 PSRAM：槽位在启动时从内部 RAM 一次分配
+    kPoolPsram,     // 有 PSRAM：槽位不占内部 RAM
+};
+
+struct SoakResult {
+    size_t min_largest_free = SIZE_MAX;
+    double max_fragmentation = 0;  // 1 - 最大空闲块 / 空闲字节
+    size_t final_free = 0;
+    size_t final_largest_free = 0;
+    size_t final_free_blocks = 0;
+    size_t failures = 0;       // 分配失败次数（空闲字节足够但没有足够大的连续块时也会失败）
+    size_t packet_allocs = 0;  // 数据包路径在堆上的分配次数
+    size_t dropped = 0;
+};
+
+// 内部 RAM 上一小时的对话，每 60ms 一帧。上行一直在编码发送，网络抖动时发送队列积压；
+// 下行 TTS 在网络卡顿后成批到达，解码队列时满时空。同时其他模块（JSON、显示、日志缓冲）按随机大小和寿命分配
+SoakResult Soak(SoakMode mode) {
+    constexpr size_t kArenaSize = 96 * 1024;
+    constexpr int kTicks = 3600 * 1000 / kOpusFrameMs;
+    ArenaModel arena(kArenaSize);
+    std::mt19937 rng(2024);
+    SoakResult result;
+
+    // 新实现在启动时一次分配全部槽位，之后数据包不再碰这块堆
+    auto& pool = AudioPacketPool::GetInstance();
+    bool use_pool = mode != SoakMode::kLegacy;
+    size_t pool_block = SIZE_MAX;
+    if (mode == SoakMode::kPoolInternal) {
+        pool_block = arena.Alloc(pool.slot_count() * pool.slot_size());
+        CHECK(pool_block != SIZE_MAX);
+    }
+    AudioPacketQueue send_queue(kQueueCapacity);
+    AudioPacketQueue decode_queue(pool.slot_count());
+
+    // 旧实现：每个包一个 list 节点（约 32 字节）和一个 payload
+    struct LegacyEntry {
+        size_t node;
+        size_t payload;
+    };
+    std::list<LegacyEntry> legacy_send;
+    std::list<LegacyEntry> legacy_decode;
+    auto legacy_push = [&](std::list<LegacyEntry>& queue, size_t size) {
+        LegacyEntry entry{arena.Alloc(32), arena.Alloc(size)};
+        result.packet_allocs += 2;
+        queue.push_back(entry);
+    };
+    auto legacy_pop = [&](std::list<LegacyEntry>& queue) {
+        arena.Free(queue.front().payload);
+        arena.Free(queue.front().node);
+        queue.pop_front();
+    };
+    auto pool_push = [&](AudioPacketQueue& queue, size_t size) {
+        size_t allocs = AllocCount();
+        AudioStreamPacket packet;
+        packet.payload = pool.Acquire(size);
+        if (!packet.payload.valid() || !queue.Push(std::move(packet))) {
+            result.dropped++;
+        }
+        result.packet_allocs += AllocCount() - allocs;
+    };
+    auto pool_pop = [&](AudioPacketQueue& queue) {
+        size_t allocs = AllocCount();
+        AudioStreamPacket packet;
+        queue.Pop(packet);
+        packet.payload.Release();
+        result.packet_allocs += AllocCount() - allocs;
+    };
+    auto send = [&](size_t size) {
+        if (use_pool) {
+            pool_push(send_queue, size);
+        } else if (legacy_send.size() < kQueueCapacity) {
+            legacy_push(legacy_send, size);
+        }
+    };
+    auto receive = [&](size_t size) {
+        if (use_pool) {
+            pool_push(decode_queue, size);
+        } else if (legacy_decode.size() < kQueueCapacity) {
+            legacy_push(legacy_decode, size);
+        }
+    };
+
+    std::multimap<int, size_t> others;  // 到期时间 -> 偏移
+    int uplink_stall = 0;
+    int downlink_stall = 0;
+    int downlink_backlog = 0;
+    int tts_remaining = 0;
+    for (int tick = 0; tick < kTicks; tick++) {
+        // 上行：Opus 16kHz 60ms 约 100-240 字节，网络卡顿时在发送队列积压，恢复后一次发完
+        send(100 + rng() % 140);
+        if (uplink_stall == 0 && rng() % 200 == 0) {
+            uplink_stall = 2 + rng() % 15;
+        }
+        if (uplink_stall > 0) {
+            uplink_stall--;
+        } else {
+            while (use_pool ? !send_queue.empty() : !legacy_send.empty()) {
+                if (use_pool) {
+                    pool_pop(send_queue);
+                } else {
+                    legacy_pop(legacy_send);
+                }
+            }
+        }
+
+        // 下行：每隔几秒一段 TTS，服务器按实时速度推送；卡顿时包堆在网络里，恢复后成批到达，解码每帧消费一个
+        if (tts_remaining == 0 && rng() % 60 == 0) {
+            tts_remaining = 30 + rng() % 150;
+        }
+        if (tts_remaining > 0) {
+            tts_remaining--;
+            downlink_backlog++;
+        }
+        if (downlink_stall == 0 && rng() % 150 == 0) {
+            downlink_stall = 2 + rng() % 15;
+        }
+        if (downlink_stall > 0) {
+            downlink_stall--;
+        } else {
+            for (; downlink_backlog > 0; downlink_backlog--) {
+                receive(60 + rng() % 260);
+            }
+        }
+        if (use_pool) {
+            if (!decode_queue.empty()) {
+                pool_pop(decode_queue);
+            }
+        } else if (!legacy_decode.empty()) {
+            legacy_pop(legacy_decode);
+        }
+
+        // 其他模块：多数是短命的小块，少数是几 KB 的 JSON 缓冲，还有少量存活几分钟的对象
+        uint32_t kind = rng() % 100;
+        size_t size;
+        int lifetime;
+        if (kind < 95) {
+            size = 16 + rng() % 240;
+            lifetime = 1 + rng() % 30;
+        } else if (kind < 99) {
+            size = 1024 + rng() % 4096;
+            lifetime = 1 + rng() % 20;
+        } else {
+            size = 64 + rng() % 960;
+            lifetime = 500 + rng() % 4500;
+        }
+        size_t offset = arena.Alloc(size);
+        if (offset != SIZE_MAX) {
+            others.emplace(tick + lifetime, offset);
+        }
+        while (!others.empty() && others.begin()->first <= tick) {
+            arena.Free(others.begin()->second);
+            others.erase(others.begin());
+        }
+
+        if (tick % 100 == 0) {
+            size_t largest = arena.largest_free();
+            result.min_largest_free = std::min(result.min_largest_free, largest);
+            result.max_fragmentation = std::max(result.max_fragmentation, 1.0 - (double)largest / arena.free_bytes());
+        }
+    }
+    result.final_free = arena.free_bytes();
+    result.final_largest_free = arena.largest_free();
+    result.final_free_blocks = arena.free_blocks();
+    result.failures = arena.failures();
+
+    send_queue.Clear();
+    decode_queue.Clear();
+    while (!legacy_send.empty()) {
+        legacy_pop(legacy_send);
+    }
+    while (!legacy_decode.empty()) {
+        legacy_pop(legacy_decode);
+    }
+    for (auto& other : others) {
+        arena.Free(other.second);
+    }
+    arena.Free(pool_block);
+    CHECK(arena.free_bytes() == kArenaSize && arena.free_blocks() == 1);
+    return result;
+}
+
+void TestSoak() {
+    SoakResult results[] = {Soak(SoakMode::kLegacy), Soak(SoakMode::kPoolInternal), Soak(SoakMode::kPoolPsram)};
+    const char* names[] = {"list + vector", "pool in SRAM", "pool in PSRAM"};
+    auto& pool = AudioPacketPool::GetInstance();
+    printf("1 hour soak on a 96 KB internal heap, pool of %zu x %zu bytes\n", pool.slot_count(), pool.slot_size());
+    printf("%-14s %13s %8s %13s %12s %9s %8s %9s\n", "", "packet allocs", "free", "largest free", "min largest",
+           "max frag", "blocks", "failures");
+    for (int i = 0; i < 3; i++) {
+        const SoakResult& r = results[i];
+        printf("%-14s %13zu %8zu %13zu %12zu %8.1f%% %8zu %9zu\n", names[i], r.packet_allocs, r.final_free,
+               r.final_largest_free, r.min_largest_free, r.max_fragmentation * 100, r.final_free_blocks, r.failures);
+    }
+    const SoakResult& legacy = results[0];
+    for (int i = 1; i < 3; i++) {
+        CHECK(results[i].packet_allocs == 0);
+        CHECK(results[i].dropped == 0);
+        CHECK(results[i].failures == 0);
+    }
+    // 槽位放在 PSRAM 时数据包完全不经过内部 RAM，最大连续空闲块不再被包流量切碎
+    CHECK(results[2].min_largest_free > legacy.min_largest_free);
+    CHECK(pool.available() == pool.slot_count());
+}
+
+} // namespace
+
+int main() {
+    TestPool();
+    TestQueue();
+    TestThreads();
+    Benchmark();
+    TestSoak();
+    return TestResult();
+}
@@ -0,0 +1,184 @@
+// AudioRingBuffer：回绕时的连续 Peek、单生产者/单消费者并发读写、Abort 唤醒，
+// 以及 PSRAM 不足时退到更小容量或内部 RAM、全部失败时 valid() 为 false
+#include "audio_ring_buffer.h"
+#include "test_util.h"
+
+#include <esp_heap_caps.h>
+
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+uint8_t Pattern(size_t index) {
+    return (uint8_t)(index * 131 + (index >> 8));
+}
+
+void Write(AudioRingBuffer& ring, size_t& next, size_t bytes) {
+    while (bytes > 0) {
+        uint8_t* ptr = nullptr;
+        size_t span = std::min(ring.GetWriteSpan(&ptr), bytes);
+        for (size_t i = 0; i < span; i++) {
+            ptr[i] = Pattern(next + i);
+        }
+        ring.CommitWrite(span);
+        next += span;
+        bytes -= span;
+    }
+}
+
+void TestWrapAroundPeek() {
+    AudioRingBuffer ring(16 * 1024, 4096);
+    CHECK(ring.valid());
+    CHECK(ring.capacity() == 16 * 1024);
+
+    size_t written = 0;
+    size_t read = 0;
+    // 把读写位置推到接近末尾，下一次 Peek 要跨过缓冲区末尾
+    Write(ring, written, 16 * 1024 - 100);
+    ring.Consume(16 * 1024 - 100);
+    read = 16 * 1024 - 100;
+    Write(ring, written, 3000);
+    CHECK(ring.Size() == 3000);
+
+    uint8_t* ptr = nullptr;
+    size_t length = ring.Peek(&ptr, 4096);
+    CHECK(length == 3000);
+    bool match = true;
+    for (size_t i = 0; i < length; i++) {
+        match = match && ptr[i] == Pattern(read + i);
+    }
+    CHECK(match);
+    ring.Consume(length);
+    CHECK(ring.Size() == 0);
+
+    // Peek 的长度不超过 max_peek
+    Write(ring, written, 10000);
+    CHECK(ring.Peek(&ptr, 10000) == 4096);
+}
+
+void TestConcurrentStream() {
+    AudioRingBuffer ring(16 * 1024, 4096);
+    const size_t total = 4 * 1024 * 1024;
+
+    std::thread producer([&]() {
+        std::mt19937 rng(1);
+        size_t written = 0;
+        while (written < total) {
+            size_t chunk = std::min<size_t>(1 + rng() % 5000, total - written);
+            if (!ring.WaitForSpace(1, pdMS_TO_TICKS(1000))) {
+                break;
+            }
+            Write(ring, written, std::min(chunk, ring.Space()));
+        }
+        ring.SetEndOfStream();
+    });
+
+    std::mt19937 rng(2);
+    size_t read = 0;
+    bool match = true;
+    while (true) {
+        size_t want = 1 + rng() % 4096;
+        ring.WaitForData(want, pdMS_TO_TICKS(1000));
+        uint8_t* ptr = nullptr;
+        size_t length = ring.Peek(&ptr, want);
+        if (length == 0 && ring.IsEndOfStream() && ring.Size() == 0) {
+            break;
+        }
+        for (size_t i = 0; i < length; i++) {
+            match = match && ptr[i] == Pattern(read + i);
+        }
+        size_t consumed = length > 1 ? length - rng() % 2 : length;  // 偶尔少消费一个字节
+        ring.Consume(consumed);
+        read += consumed;
+    }
+    producer.join();
+    CHECK(match);
+    CHECK(read == total);
+}
+
+void TestAbortWakesWaiters() {
+    AudioRingBuffer ring(16 * 1024, 4096);
+    std::thread waiter([&]() {
+        CHECK(!ring.WaitForData(1024, portMAX_DELAY));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ring.Abort();
+    waiter.join();
+    CHECK(ring.IsAborted());
+    ring.Reset();
+    CHECK(!ring.IsAborted());
+    CHECK(ring.Size() == 0);
+}
+
+void TestAllocationFallback() {
+    // PSRAM 最多给 100KB：512KB 的请求逐级减半到 64KB
+    host_heap_caps_set_limit(MALLOC_CAP_SPIRAM, 100 * 1024);
+    {
+        AudioRingBuffer ring(512 * 1024, 4096);
+        CHECK(ring.valid());
+        CHECK(ring.capacity() == 64 * 1024);
+    }
+    host_heap_caps_clear_limits();
+
+    // 没有 PSRAM：只有不超过 32KB 时才使用内部 RAM
+    host_heap_caps_set_limit(MALLOC_CAP_SPIRAM, 0);
+    {
+        AudioRingBuffer ring(512 * 1024, 4096);
+        CHECK(ring.valid());
+        CHECK(ring.capacity() == 32 * 1024);
+    }
+
+    // 内部 RAM 也不够：不可用，但 SetEndOfStream / Abort 不会崩溃
+    host_heap_caps_set_limit(MALLOC_CAP_INTERNAL, 0);
+    {
+        AudioRingBuffer ring(512 * 1024, 4096);
+        CHECK(!ring.valid());
+        ring.SetEndOfStream();
+        ring.Abort();
+    }
+    host_heap_caps_clear_limits();
+
+    // 事件组创建失败同样不可用
+    host_event_group_fail_next_create();
+    {
+        AudioRingBuffer ring(16 * 1024, 4096);
+        CHECK(!ring.valid());
+        ring.SetEndOfStream();
+    }
+
+    // 小于 16KB 的容量也能分配
+    {
+        AudioRingBuffer ring(8 * 1024, 1024);
+        CHECK(ring.valid());
+        CHECK(ring.capacity() == 8 * 1024);
+    }
+}
+
+void TestResizeFallback() {
+    AudioRingBuffer ring(64 * 1024, 4096);
+    CHECK(ring.Resize(128 * 1024));
+    CHECK(ring.capacity() == 128 * 1024);
+
+    // 新容量分配不到时逐级减半，得到仍能分配的最大容量
+    host_heap_caps_set_limit(MALLOC_CAP_SPIRAM | MALLOC_CAP_INTERNAL, 128 * 1024 + 4096);
+    CHECK(ring.Resize(512 * 1024));
+    CHECK(ring.capacity() == 128 * 1024);
+    host_heap_caps_clear_limits();
+
+    CHECK(!ring.Resize(3000));  // 不是 2 的幂
+    CHECK(ring.valid());
+}
+
+} // namespace
+
+int main() {
+    TestWrapAroundPeek();
+    TestConcurrentStream();
+    TestAbortWakesWaiters();
+    TestAllocationFallback();
+    TestResizeFallback();
+    return TestResult();
+}
@@ -0,0 +1,40 @@
+#ifndef HOST_BENCH_UTIL_H
+#define HOST_BENCH_UTIL_H
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 主机上的周期计数：x86 用 TSC（频率固定，不等于实际核心周期），其他平台用纳秒代替。
+// 只用于同一台机器上新旧实现的相对比较，板上的周期数需要在 ESP32-S3 上用 esp_cpu_get_cycle_count() 测
+inline uint64_t BenchCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline const char* BenchCycleUnit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "TSC cycles";
+#else
+    return "ns";
+#endif
+}
+
+inline double BenchSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 防止编译器把基准循环的结果优化掉
+template <typename T>
+inline void BenchKeep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // HOST_BENCH_UTIL_H
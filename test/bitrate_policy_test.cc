@@ -0,0 +1,429 @@
+// BitratePolicy：档位选择规则，限速链路上的播放模拟（固定 100kmp3、只在新曲目选档、加上播放中降档），
+// 以及降档时用 Mp3SeekTable 在帧边界切换到另一个档位文件
+#include "bitrate_policy.h"
+#include "mp3_seek_table.h"
+#include "prebuffer_policy.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+
+void TestSelection() {
+    BitratePolicy policy;
+    // 没有测量结果时使用默认档位
+    CHECK(policy.SelectForNewTrack(0) == BitratePolicy::kDefaultVariant);
+    CHECK(BitratePolicy::GetVariant(BitratePolicy::kDefaultVariant).kbps == 100);
+
+    // 降档不受限制，按 1.5 倍余量选择
+    CHECK(policy.SelectForNewTrack(100) == 0);
+    // 升档每首只升一级，且要求 2 倍余量
+    CHECK(policy.SelectForNewTrack(5000) == 1);
+    CHECK(policy.PreviewForNewTrack(5000) == 2);
+    CHECK(policy.PreviewForNewTrack(5000) == 2);  // 预览不改变当前档位
+    CHECK(policy.SelectForNewTrack(5000) == 2);
+    CHECK(policy.SelectForNewTrack(5000) == 3);
+    CHECK(policy.SelectForNewTrack(5000) == 3);
+    // 350kbps 足够 192k 的 1.5 倍余量，直接降一级
+    CHECK(policy.SelectForNewTrack(350) == 2);
+    // 速度够 320k 的 1.5 倍但不够 2 倍，不升档
+    CHECK(policy.SelectForNewTrack(500) == 2);
+    CHECK(policy.SelectForNewTrack(0) == 2);
+
+    CHECK(strcmp(BitratePolicy::GetVariant(-1).br, "48kmp3") == 0);
+    CHECK(strcmp(BitratePolicy::GetVariant(99).br, "320kmp3") == 0);
+}
+
+void TestMidTrack() {
+    BitratePolicy policy;
+    policy.SelectForNewTrack(0);
+    // 缓冲充足时不降档
+    CHECK(policy.CheckMidTrack(1, 50, 8000, 0) == -1);
+    CHECK(policy.CheckMidTrack(1, 50, 8000, 10000) == -1);
+    // 缓冲不足但刚开始变慢，需要持续 3 秒
+    CHECK(policy.CheckMidTrack(1, 50, 1000, 20000) == -1);
+    CHECK(policy.CheckMidTrack(1, 50, 1000, 22000) == -1);
+    // 中间恢复过一次，重新计时
+    CHECK(policy.CheckMidTrack(1, 200, 1000, 22500) == -1);
+    CHECK(policy.CheckMidTrack(1, 50, 1000, 23000) == -1);
+    CHECK(policy.CheckMidTrack(1, 50, 1000, 25500) == -1);
+    CHECK(policy.CheckMidTrack(1, 50, 1000, 26000) == 0);
+    // 新档位也成为下一首的起点
+    CHECK(policy.PreviewForNewTrack(0) == 0);
+    // 最低档不再降
+    CHECK(policy.CheckMidTrack(0, 10, 0, 40000) == -1);
+
+    // 冷却时间内不连续降档，ResetMidTrack 清除冷却
+    BitratePolicy fast;
+    fast.SelectForNewTrack(0);
+    CHECK(fast.CheckMidTrack(3, 200, 0, 0) == -1);
+    CHECK(fast.CheckMidTrack(3, 200, 0, 3000) == 1);  // 直接降到速度能支撑的档位
+    CHECK(fast.CheckMidTrack(1, 60, 0, 4000) == -1);
+    CHECK(fast.CheckMidTrack(1, 60, 0, 8000) == -1);
+    fast.ResetMidTrack();
+    CHECK(fast.CheckMidTrack(1, 60, 0, 9000) == -1);
+    CHECK(fast.CheckMidTrack(1, 60, 0, 12000) == 0);
+}
+
+// ---- 限速链路上的播放模拟 ----
+// 下载线程按链路速度向缓冲写数据（缓冲满时暂停，这段时间不计入测速），播放线程按档位码率消耗；
+// 缓冲以毫秒音频计，容量按当前档位换算成 512KB。播放中降档时旧档位已下载的部分照常播放。
+
+enum class Strategy {
+    kFixed,     // 原来的行为：始终 100kmp3
+    kNewTrack,  // 只在新曲目开始时选档
+    kAdaptive,  // 新曲目选档，播放中持续变慢时降档
+};
+
+struct SimResult {
+    double stall_s = 0;
+    int stalls = 0;
+    double average_kbps = 0;
+    int mid_track_switches = 0;
+    int final_variant = 0;
+};
+
+SimResult Simulate(Strategy strategy, const std::function<int(double)>& link_kbps, int tracks, int track_s) {
+    constexpr int kStepMs = 50;
+    constexpr size_t kRingBytes = 512 * 1024;
+
+    BitratePolicy policy;
+    PrebufferPolicy prebuffer;
+    SimResult result;
+
+    int track = 0;
+    int variant = BitratePolicy::kDefaultVariant;
+    double track_downloaded_ms = 0;  // 当前下载曲目已下载的音频时长
+    double buffered_ms = 0;
+    double played_ms = 0;
+    double played_kbits = 0;
+    bool playing = false;
+    bool had_underrun = false;
+    int64_t next_check_ms = 0;
+    std::vector<std::pair<double, int>> segments;  // 缓冲中按顺序排列的 (时长, 码率)
+
+    auto start_track = [&]() {
+        variant = strategy == Strategy::kFixed ? BitratePolicy::kDefaultVariant
+                                               : policy.SelectForNewTrack(prebuffer.throughput_kbps());
+        policy.ResetMidTrack();
+        track_downloaded_ms = 0;
+    };
+    start_track();
+
+    const double total_ms = (double)tracks * track_s * 1000;
+    for (int64_t now = 0; played_ms < total_ms - 1 && now < total_ms * 20; now += kStepMs) {
+        double link = link_kbps(now / 1000.0);
+
+        // 下载
+        int kbps = BitratePolicy::GetVariant(variant).kbps;
+        double capacity_ms = kRingBytes * 8.0 / kbps;
+        if (track < tracks && buffered_ms < capacity_ms) {
+            double ms = std::min({link * kStepMs / kbps, capacity_ms - buffered_ms, track_s * 1000.0 - track_downloaded_ms});
+            size_t bytes = (size_t)(ms * kbps / 8);
+            prebuffer.AddDownloadSample(bytes, (int64_t)(bytes * 8.0 / link * 1000));
+            if (!segments.empty() && segments.back().second == kbps) {
+                segments.back().first += ms;
+            } else {
+                segments.push_back({ms, kbps});
+            }
+            buffered_ms += ms;
+            track_downloaded_ms += ms;
+
+            if (strategy == Strategy::kAdaptive && now >= next_check_ms) {
+                next_check_ms = now + 500;
+                int lower = policy.CheckMidTrack(variant, prebuffer.throughput_kbps(), (int)buffered_ms, now);
+                if (lower >= 0) {
+                    variant = lower;
+                    result.mid_track_switches++;
+                }
+            }
+            if (track_downloaded_ms >= track_s * 1000.0 - 1e-6) {
+                track++;
+                if (track < tracks) {
+                    start_track();
+                }
+            }
+        }
+
+        // 播放
+        if (!playing) {
+            int target = prebuffer.TargetMs(BitratePolicy::GetVariant(variant).kbps, false);
+            if (buffered_ms >= target || (track >= tracks && buffered_ms > 0)) {
+                playing = true;
+            } else if (played_ms > 0) {
+                result.stall_s += kStepMs / 1000.0;
+            }
+        }
+        if (playing) {
+            double want = kStepMs;
+            while (want > 1e-9 && !segments.empty()) {
+                double take = std::min(want, segments.front().first);
+                played_kbits += take * segments.front().second / 1000;
+                segments.front().first -= take;
+                if (segments.front().first <= 1e-9) {
+                    segments.erase(segments.begin());
+                }
+                want -= take;
+                buffered_ms -= take;
+                played_ms += take;
+            }
+            buffered_ms = std::max(0.0, buffered_ms);
+            if (want > 1e-9 && played_ms < total_ms - 1) {
+                // 断流：重新预缓冲
+                playing = false;
+                had_underrun = true;
+                result.stalls++;
+                result.stall_s += want / 1000.0;
+                prebuffer.OnUnderrun();
+            }
+        }
+        if ((int64_t)(played_ms / (track_s * 1000)) != (int64_t)((played_ms - kStepMs) / (track_s * 1000)) &&
+            played_ms >= track_s * 1000) {
+            prebuffer.OnTrackFinished(had_underrun);
+            had_underrun = false;
+        }
+    }
+    result.average_kbps = played_ms > 0 ? played_kbits * 1000 / played_ms : 0;
+    result.final_variant = variant;
+    return result;
+}
+
+void TestSimulation() {
+    struct Profile {
+        const char* name;
+        std::function<int(double)> link;
+    } profiles[] = {
+        {"wifi 3000k", [](double) { return 3000; }},
+        {"4G 90k", [](double) { return 90; }},
+        {"collapse 1000k->60k @150s", [](double t) { return t < 150 ? 1000 : 60; }},
+        {"4G 400k/120k every 20s", [](double t) { return ((int)t / 20) % 2 == 0 ? 400 : 120; }},
+    };
+    const char* names[] = {"fixed 100k", "new track", "adaptive"};
+    const int kTracks = 6;
+    const int kTrackSeconds = 120;
+
+    printf("%-27s %-11s %8s %7s %9s %9s\n", "link", "strategy", "stall s", "stalls", "avg kbps", "switches");
+    SimResult results[4][3];
+    for (int p = 0; p < 4; p++) {
+        for (int s = 0; s < 3; s++) {
+            results[p][s] = Simulate((Strategy)s, profiles[p].link, kTracks, kTrackSeconds);
+            auto& r = results[p][s];
+            printf("%-27s %-11s %8.1f %7d %9.1f %9d\n", profiles[p].name, names[s], r.stall_s, r.stalls,
+                   r.average_kbps, r.mid_track_switches);
+        }
+    }
+
+    // 快速网络：逐首升到 320k，不断流
+    CHECK(results[0][2].stalls == 0);
+    CHECK(results[0][2].final_variant == BitratePolicy::kVariantCount - 1);
+    CHECK(results[0][2].average_kbps > results[0][0].average_kbps * 1.5);
+    // 慢速 4G：固定 100k 持续断流，自适应降到 48k 后不再断流
+    CHECK(results[1][0].stall_s > 60);
+    CHECK(results[1][2].stall_s < results[1][0].stall_s / 4);
+    CHECK(results[1][2].final_variant == 0);
+    // 播放中网络骤降：播放中降档比等到下一首断流更少
+    CHECK(results[2][2].mid_track_switches >= 1);
+    CHECK(results[2][2].stall_s < results[2][1].stall_s);
+    // 波动的 4G：自适应不比固定档位差
+    CHECK(results[3][2].stall_s <= results[3][0].stall_s);
+}
+
+// ---- 帧边界切换 ----
+
+struct Mp3File {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> frame_offsets;  // 音频帧（不含 Xing 帧）的偏移
+    size_t audio_start = 0;
+    int bitrate_kbps = 0;
+};
+
+// MPEG1 Layer III 44.1kHz CBR，按标准方式插入填充字节保持平均码率，数据中不出现 0xFF
+Mp3File MakeMp3(int bitrate_index, int bitrate_kbps, int frames, bool xing, size_t id3_size) {
+    Mp3File file;
+    file.bitrate_kbps = bitrate_kbps;
+    std::mt19937 rng(bitrate_kbps);
+    if (id3_size > 0) {
+        file.bytes = {'I', 'D', '3', 4, 0, 0};
+        size_t body = id3_size - 10;
+        for (int i = 3; i >= 0; i--) {
+            file.bytes.push_back((body >> (i * 7)) & 0x7F);
+        }
+        file.bytes.resize(id3_size, 0);
+    }
+    file.audio_start = file.bytes.size();
+
+    auto append_frame = [&](int padding, const uint8_t* payload, size_t payload_size) {
+        uint8_t header[4] = {0xFF, 0xFB, (uint8_t)((bitrate_index << 4) | (padding << 1)), 0x44};
+        size_t length = 144000 * bitrate_kbps / 44100 + padding;
+        size_t start = file.bytes.size();
+        file.bytes.insert(file.bytes.end(), header, header + 4);
+        for (size_t i = 4; i < length; i++) {
+            file.bytes.push_back(i - 4 < payload_size ? payload[i - 4] : (uint8_t)(rng() % 255));
+        }
+        return start;
+    };
+
+    // 144000 * kbps 除以 44100 的余数累计满一个字节时加填充
+    std::vector<int> paddings(frames);
+    size_t audio_bytes = 0;
+    int remainder = 0;
+    for (int i = 0; i < frames; i++) {
+        remainder += (144000 * bitrate_kbps) % 44100;
+        if (remainder >= 44100) {
+            remainder -= 44100;
+            paddings[i] = 1;
+        }
+        audio_bytes += 144000 * bitrate_kbps / 44100 + paddings[i];
+    }
+
+    if (xing) {
+        // Xing 帧：帧数、字节数（包含 Xing 帧本身）和线性 TOC，放在双声道的 32 字节边信息之后
+        std::vector<uint8_t> info(32, 0);
+        uint8_t tag[] = {'X', 'i', 'n', 'g', 0, 0, 0, 0x07};
+        info.insert(info.end(), tag, tag + 8);
+        audio_bytes += 144000 * bitrate_kbps / 44100;
+        for (uint32_t v : {(uint32_t)frames, (uint32_t)audio_bytes}) {
+            for (int i = 3; i >= 0; i--) {
+                info.push_back(v >> (i * 8));
+            }
+        }
+        for (int i = 0; i < 100; i++) {
+            info.push_back(i * 256 / 100);
+        }
+        append_frame(0, info.data(), info.size());
+    }
+    for (int i = 0; i < frames; i++) {
+        file.frame_offsets.push_back(append_frame(paddings[i], nullptr, 0));
+    }
+    return file;
+}
+
+void TestFrameBoundaries() {
+    Mp3File file = MakeMp3(9, 128, 400, false, 0);
+    // FindSync 需要连续两个帧头：前面的垃圾里有一个孤立的假帧头
+    std::vector<uint8_t> junk = {0x00, 0xFF, 0xFB, 0x90, 0x44, 0x12, 0x34};
+    junk.insert(junk.end(), file.bytes.begin(), file.bytes.begin() + 5000);
+    CHECK(Mp3SeekTable::FindSync(junk.data(), junk.size()) == 7);
+    CHECK(Mp3SeekTable::FindSync(junk.data(), 7 + 420) == -1);  // 只有一个完整帧
+
+    // 任意切点：FindFrameEnd 返回跨过切点那一帧的结尾，正好是下一帧的帧头
+    std::mt19937 rng(7);
+    for (int i = 0; i < 200; i++) {
+        size_t begin = file.frame_offsets[rng() % 100];
+        size_t cut = begin + 1000 + rng() % 40000;
+        size_t end = 0;
+        bool found = Mp3SeekTable::FindFrameEnd(&file.bytes[begin], cut - begin, end);
+        if (!found) {
+            // 末尾只剩不到 4 字节的帧头
+            auto next = std::lower_bound(file.frame_offsets.begin(), file.frame_offsets.end(), cut);
+            CHECK(next != file.frame_offsets.begin() && cut - *(next - 1) < 4);
+            continue;
+        }
+        CHECK(std::binary_search(file.frame_offsets.begin(), file.frame_offsets.end(), begin + end));
+        CHECK(begin + end >= cut && begin + end < cut + 420);
+    }
+    size_t end = 0;
+    CHECK(Mp3SeekTable::FindFrameEnd(&file.bytes[file.frame_offsets[10]],
+                                     file.frame_offsets[20] - file.frame_offsets[10], end));
+    CHECK(end == file.frame_offsets[20] - file.frame_offsets[10]);
+}
+
+void TestVariantSwitch() {
+    // 192k 带 Xing 头和 ID3 标签切到 48k CBR：旧文件在帧边界结束，新文件从对应时间的帧头开始
+    const int kFrames = 2000;  // 约 52 秒
+    Mp3File high = MakeMp3(11, 192, kFrames, true, 2048);
+    Mp3File low = MakeMp3(3, 48, kFrames, false, 0);
+
+    Mp3SeekTable high_table;
+    int sync = Mp3SeekTable::FindSync(&high.bytes[high.audio_start], 8192);
+    CHECK(sync == 0);
+    CHECK(high_table.Parse(&high.bytes[high.audio_start], 8192, high.audio_start, high.bytes.size()));
+    Mp3SeekTable low_table;
+    CHECK(low_table.Parse(&low.bytes[0], 8192, 0, low.bytes.size()));
+    const double kFrameMs = 1152 * 1000.0 / 44100;
+    CHECK(std::llabs(high_table.duration_ms() - (int64_t)(kFrames * kFrameMs)) < 30);
+    CHECK(std::llabs(low_table.duration_ms() - (int64_t)(kFrames * kFrameMs)) < 100);
+
+    const double kTocMs = high_table.duration_ms() / 256.0;
+    double max_error_ms = 0;
+    std::mt19937 rng(3);
+    for (int i = 0; i < 100; i++) {
+        // 下载线程在某一块数据里决定降档，先下载到这一块末尾那一帧的结尾
+        size_t chunk_start = high.frame_offsets[50 + rng() % 1500];
+        size_t chunk_size = 1000 + rng() % 8000;
+        size_t frame_end = 0;
+        if (!Mp3SeekTable::FindFrameEnd(&high.bytes[chunk_start], chunk_size, frame_end)) {
+            continue;
+        }
+        size_t switch_offset = chunk_start + frame_end;
+        auto it = std::lower_bound(high.frame_offsets.begin(), high.frame_offsets.end(), switch_offset);
+        CHECK(it != high.frame_offsets.end() && *it == switch_offset);
+        double expected_ms = (it - high.frame_offsets.begin()) * kFrameMs;
+
+        int64_t position_ms = high_table.PositionOf(switch_offset);
+        // Xing TOC 每项是截断到 1/256 的字节比例（LAME 也这样写），插值误差最多约为时长的 1/256
+        double error_ms = std::fabs(position_ms - expected_ms);
+        max_error_ms = std::max(max_error_ms, error_ms);
+        CHECK(error_ms < kTocMs + kFrameMs);
+
+        size_t low_offset = 0;
+        int64_t actual_ms = 0;
+        CHECK(low_table.Lookup(position_ms, low_offset, actual_ms));
+        // CBR 估算的偏移不一定正好是帧头，PrepareVariantSwitch 会在读到的数据里再找同步点
+        int resync = Mp3SeekTable::FindSync(&low.bytes[low_offset], std::min<size_t>(4096, low.bytes.size() - low_offset));
+        CHECK(resync >= 0 && resync < 200);
+        size_t low_frame = low_offset + resync;
+        auto low_it = std::lower_bound(low.frame_offsets.begin(), low.frame_offsets.end(), low_frame);
+        CHECK(low_it != low.frame_offsets.end() && *low_it == low_frame);
+        // 新文件的起点和估算的切换时间相差不超过两帧（约 52ms）
+        double low_ms = (low_it - low.frame_offsets.begin()) * kFrameMs;
+        CHECK(std::fabs(low_ms - position_ms) <= 2 * kFrameMs + 1);
+    }
+    printf("variant switch: max position error %.1f ms (TOC resolution %.1f ms)\n", max_error_ms, kTocMs);
+
+    // 定位到结尾时停在最后一帧之前，Range 起点不会超出文件
+    size_t offset = 0;
+    int64_t actual_ms = 0;
+    CHECK(low_table.Lookup(low_table.duration_ms() + 5000, offset, actual_ms));
+    CHECK(offset < low.bytes.size());
+    CHECK(high_table.PositionOf(high.bytes.size() + 100) == high_table.duration_ms());
+}
+
+void TestPrefetchSizing() {
+    // 预取缓冲区按 MaxTargetBytes 分配，任何下载速度和连续断流后的预缓冲目标都不能超过它
+    bool bounded = true;
+    for (int variant = 0; variant < BitratePolicy::kVariantCount; variant++) {
+        int kbps = BitratePolicy::GetVariant(variant).kbps;
+        for (int link : {0, 64, 128, 200, 400, 2000, 20000}) {
+            PrebufferPolicy prebuffer;
+            if (link > 0) {
+                prebuffer.AddDownloadSample(link * 125, 1000000);
+            }
+            // 惩罚在 6 次断流后达到上限
+            for (int underruns = 0; underruns < 7; underruns++) {
+                bounded &= prebuffer.TargetBytes(kbps, false) <= PrebufferPolicy::MaxTargetBytes(kbps);
+                bounded &= prebuffer.TargetBytes(kbps, true) <= PrebufferPolicy::MaxTargetBytes(kbps);
+                prebuffer.OnUnderrun();
+            }
+        }
+        printf("%-6s prefetch need %u bytes\n", BitratePolicy::GetVariant(variant).br,
+               (unsigned int)PrebufferPolicy::MaxTargetBytes(kbps));
+    }
+    CHECK(bounded);
+}
+
+} // namespace
+
+int main() {
+    TestSelection();
+    TestMidTrack();
+    TestSimulation();
+    TestFrameBoundaries();
+    TestVariantSwitch();
+    TestPrefetchSizing();
+    return TestResult();
+}
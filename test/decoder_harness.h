@@ -0,0 +1,75 @@
+#ifndef HOST_DECODER_HARNESS_H
+#define HOST_DECODER_HARNESS_H
+
+#include "audio_stream_decoder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// 按 Esp32Music::PlayAudioStream 的方式驱动解码器：每次最多 Peek kPeekSize 字节，
+// 数据按 arrival 字节一段段到达，consumed 超出当前数据时跳过后续数据，至少消费 1 字节
+struct DecodeResult {
+    std::vector<int16_t> pcm;
+    std::vector<int> frame_samples;
+    int channels = 0;
+    int sample_rate = 0;
+    bool contract_violated = false;  // 数据已给全时仍返回 kNeedMoreData，或调用次数失控
+};
+
+inline DecodeResult RunDecoder(AudioStreamDecoder& decoder, const std::vector<uint8_t>& stream, size_t arrival,
+                               size_t peek_size = 4096) {
+    DecodeResult result;
+    size_t read = 0;
+    size_t written = std::min(arrival, stream.size());
+    size_t skip = 0;
+    size_t calls = 0;
+    size_t max_calls = stream.size() * 4 + 1000;
+
+    while (calls++ < max_calls) {
+        if (skip > 0) {
+            size_t step = std::min(skip, written - read);
+            read += step;
+            skip -= step;
+        }
+        size_t available = std::min(written - read, peek_size);
+        bool eos = written == stream.size();
+        if (available == 0 || skip > 0) {
+            if (eos) {
+                return result;
+            }
+            written = std::min(written + arrival, stream.size());
+            continue;
+        }
+
+        // 拷贝出恰好 available 字节，越界读取在 sanitizer 下能暴露出来
+        std::vector<uint8_t> peek(stream.begin() + read, stream.begin() + read + available);
+        bool more_available = available < peek_size && !eos;
+        size_t consumed = 0;
+        AudioFrame frame;
+        auto status = decoder.Decode(peek.data(), available, more_available, consumed, frame);
+        if (status == AudioStreamDecoder::Status::kNeedMoreData) {
+            if (!more_available) {
+                result.contract_violated = true;
+                return result;
+            }
+            written = std::min(written + arrival, stream.size());
+            continue;
+        }
+        if (consumed > available) {
+            skip = consumed - available;
+            consumed = available;
+        }
+        read += std::max(consumed, (size_t)1);
+        if (status == AudioStreamDecoder::Status::kFrame) {
+            result.pcm.insert(result.pcm.end(), frame.pcm, frame.pcm + frame.samples * frame.channels);
+            result.frame_samples.push_back(frame.samples);
+            result.channels = frame.channels;
+            result.sample_rate = frame.sample_rate;
+        }
+    }
+    result.contract_violated = true;
+    return result;
+}
+
+#endif // HOST_DECODER_HARNESS_H
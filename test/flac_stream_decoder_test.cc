@@ -0,0 +1,535 @@
+// FlacStreamDecoder：测试内的小型编码器覆盖所有子帧类型、声道去相关方式和 Rice 分区，
+// 解码结果必须逐样本一致；另外检查 RFC 9639 附录 D 的示例、超过 Peek 长度的帧、损坏后的重新同步
+#include "flac_stream_decoder.h"
+#include "decoder_harness.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+class BitWriter {
+public:
+    void Write(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            WriteBit((value >> i) & 1);
+        }
+    }
+    void WriteSigned(int32_t value, int bits) { Write((uint32_t)value & (bits == 32 ? ~0u : (1u << bits) - 1), bits); }
+    void WriteUnary(uint32_t zeros) {
+        for (uint32_t i = 0; i < zeros; i++) {
+            WriteBit(0);
+        }
+        WriteBit(1);
+    }
+    void WriteRice(int32_t value, int parameter) {
+        uint32_t u = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        WriteUnary(u >> parameter);
+        Write(u & ((1u << parameter) - 1), parameter);
+    }
+    void Align() {
+        while (bit_count_ != 0) {
+            WriteBit(0);
+        }
+    }
+    std::vector<uint8_t>& bytes() { return bytes_; }
+
+private:
+    std::vector<uint8_t> bytes_;
+    int bit_count_ = 0;
+
+    void WriteBit(int bit) {
+        if (bit_count_ == 0) {
+            bytes_.push_back(0);
+        }
+        bytes_.back() |= bit << (7 - bit_count_);
+        bit_count_ = (bit_count_ + 1) % 8;
+    }
+};
+
+uint8_t Crc8(const uint8_t* data, size_t size) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+uint16_t Crc16(const uint8_t* data, size_t size) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i] << 8;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+enum class SubframeType { kConstant, kVerbatim, kFixed, kLpc };
+
+struct SubframeSpec {
+    SubframeType type = SubframeType::kFixed;
+    int order = 2;
+    std::vector<int32_t> coefs;  // LPC 系数，任意取值都能无损还原，只影响压缩率
+    int precision = 12;
+    int shift = 9;
+    int wasted = 0;              // 所有样本都是 2^wasted 的倍数时使用
+    int partition_order = 0;
+    bool escape_first_partition = false;
+    bool rice5 = false;          // 5 位 Rice 参数
+};
+
+void EncodeResidual(BitWriter& w, const std::vector<int32_t>& residual, int block_size, int order,
+                    const SubframeSpec& spec) {
+    w.Write(spec.rice5 ? 1 : 0, 2);
+    w.Write(spec.partition_order, 4);
+    int partitions = 1 << spec.partition_order;
+    int partition_size = block_size >> spec.partition_order;
+    size_t index = 0;
+    for (int p = 0; p < partitions; p++) {
+        int count = partition_size - (p == 0 ? order : 0);
+        if (p == 0 && spec.escape_first_partition) {
+            int bits = 1;
+            for (int i = 0; i < count; i++) {
+                while (residual[index + i] < -(1 << (bits - 1)) || residual[index + i] >= (1 << (bits - 1))) {
+                    bits++;
+                }
+            }
+            w.Write(spec.rice5 ? 31 : 15, spec.rice5 ? 5 : 4);
+            w.Write(bits, 5);
+            for (int i = 0; i < count; i++) {
+                w.WriteSigned(residual[index++], bits);
+            }
+            continue;
+        }
+        uint64_t sum = 0;
+        for (int i = 0; i < count; i++) {
+            sum += std::abs((int64_t)residual[index + i]) * 2;
+        }
+        int parameter = 0;
+        while (count > 0 && ((uint64_t)count << (parameter + 1)) < sum) {
+            parameter++;
+        }
+        parameter = std::min(parameter, spec.rice5 ? 30 : 14);
+        w.Write(parameter, spec.rice5 ? 5 : 4);
+        for (int i = 0; i < count; i++) {
+            w.WriteRice(residual[index++], parameter);
+        }
+    }
+}
+
+void EncodeSubframe(BitWriter& w, std::vector<int32_t> s, int bits, const SubframeSpec& spec) {
+    int n = s.size();
+    int type_code = 0;
+    switch (spec.type) {
+    case SubframeType::kConstant: type_code = 0; break;
+    case SubframeType::kVerbatim: type_code = 1; break;
+    case SubframeType::kFixed: type_code = 8 + spec.order; break;
+    case SubframeType::kLpc: type_code = 31 + spec.order; break;
+    }
+    w.Write(0, 1);
+    w.Write(type_code, 6);
+    if (spec.wasted > 0) {
+        w.Write(1, 1);
+        w.WriteUnary(spec.wasted - 1);
+        for (auto& v : s) {
+            v >>= spec.wasted;
+        }
+        bits -= spec.wasted;
+    } else {
+        w.Write(0, 1);
+    }
+
+    if (spec.type == SubframeType::kConstant) {
+        w.WriteSigned(s[0], bits);
+        return;
+    }
+    if (spec.type == SubframeType::kVerbatim) {
+        for (int32_t v : s) {
+            w.WriteSigned(v, bits);
+        }
+        return;
+    }
+
+    int order = spec.order;
+    for (int i = 0; i < order; i++) {
+        w.WriteSigned(s[i], bits);
+    }
+    std::vector<int32_t> residual;
+    if (spec.type == SubframeType::kFixed) {
+        static const int kFixed[5][4] = {{0}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}};
+        for (int i = order; i < n; i++) {
+            int64_t prediction = 0;
+            for (int j = 0; j < order; j++) {
+                prediction += (int64_t)kFixed[order][j] * s[i - 1 - j];
+            }
+            residual.push_back(s[i] - (int32_t)prediction);
+        }
+    } else {
+        w.Write(spec.precision - 1, 4);
+        w.WriteSigned(spec.shift, 5);
+        for (int j = 0; j < order; j++) {
+            w.WriteSigned(spec.coefs[j], spec.precision);
+        }
+        for (int i = order; i < n; i++) {
+            int64_t sum = 0;
+            for (int j = 0; j < order; j++) {
+                sum += (int64_t)spec.coefs[j] * s[i - 1 - j];
+            }
+            residual.push_back(s[i] - (int32_t)(sum >> spec.shift));
+        }
+    }
+    EncodeResidual(w, residual, n, order, spec);
+}
+
+struct FrameSpec {
+    int assignment = 1;  // 0-7 独立声道，8 left/side，9 side/right，10 mid/side
+    SubframeSpec subframes[2];
+};
+
+// channels 为按声道排列的原始样本（左右声道，未去相关）
+std::vector<uint8_t> EncodeFrame(const std::vector<std::vector<int32_t>>& channels, int bits, int sample_rate,
+                                 uint32_t frame_number, const FrameSpec& spec) {
+    int n = channels[0].size();
+    std::vector<std::vector<int32_t>> coded = channels;
+    if (spec.assignment >= 8) {
+        auto& l = channels[0];
+        auto& r = channels[1];
+        for (int i = 0; i < n; i++) {
+            int32_t side = l[i] - r[i];
+            switch (spec.assignment) {
+            case 8: coded[1][i] = side; break;
+            case 9: coded[0][i] = side; break;
+            default:
+                coded[0][i] = (l[i] + r[i]) >> 1;
+                coded[1][i] = side;
+                break;
+            }
+        }
+    }
+
+    int rate_code = sample_rate == 44100 ? 9 : (sample_rate == 48000 ? 10 : 0);
+    int size_code = bits == 8 ? 1 : bits == 12 ? 2 : bits == 16 ? 4 : bits == 20 ? 5 : 6;
+    BitWriter w;
+    w.Write(0xFFF8, 16);
+    w.Write(7, 4);
+    w.Write(rate_code, 4);
+    w.Write(spec.assignment, 4);
+    w.Write(size_code, 3);
+    w.Write(0, 1);
+    // UTF-8 方式的帧号
+    if (frame_number < 0x80) {
+        w.Write(frame_number, 8);
+    } else {
+        w.Write(0xC0 | (frame_number >> 6), 8);
+        w.Write(0x80 | (frame_number & 0x3F), 8);
+    }
+    w.Write(n - 1, 16);
+    w.Write(Crc8(w.bytes().data(), w.bytes().size()), 8);
+
+    for (size_t c = 0; c < coded.size(); c++) {
+        bool side = (spec.assignment == 8 && c == 1) || (spec.assignment == 9 && c == 0) ||
+                    (spec.assignment == 10 && c == 1);
+        EncodeSubframe(w, coded[c], bits + (side ? 1 : 0), spec.subframes[c]);
+    }
+    w.Align();
+    uint16_t crc = Crc16(w.bytes().data(), w.bytes().size());
+    w.Write(crc, 16);
+    return w.bytes();
+}
+
+std::vector<uint8_t> StreamInfo(int min_block, int max_block, uint32_t max_frame, int sample_rate, int channels,
+                                int bits, uint64_t total_samples, bool last) {
+    std::vector<uint8_t> b = {(uint8_t)(last ? 0x80 : 0x00), 0, 0, 34};
+    b.push_back(min_block >> 8);
+    b.push_back(min_block);
+    b.push_back(max_block >> 8);
+    b.push_back(max_block);
+    b.insert(b.end(), {0, 0, 0});
+    b.push_back(max_frame >> 16);
+    b.push_back(max_frame >> 8);
+    b.push_back(max_frame);
+    b.push_back(sample_rate >> 12);
+    b.push_back(sample_rate >> 4);
+    b.push_back(((sample_rate & 0x0F) << 4) | ((channels - 1) << 1) | ((bits - 1) >> 4));
+    b.push_back((((bits - 1) & 0x0F) << 4) | (uint8_t)((total_samples >> 32) & 0x0F));
+    for (int i = 3; i >= 0; i--) {
+        b.push_back(total_samples >> (i * 8));
+    }
+    b.insert(b.end(), 16, 0);  // MD5
+    return b;
+}
+
+std::vector<uint8_t> MetadataBlock(int type, size_t length, bool last) {
+    std::vector<uint8_t> b = {(uint8_t)((last ? 0x80 : 0x00) | type), (uint8_t)(length >> 16), (uint8_t)(length >> 8),
+                              (uint8_t)length};
+    b.insert(b.end(), length, 0xA5);
+    return b;
+}
+
+// 正弦加噪声，幅度按位深缩放；wasted 位清零
+std::vector<int32_t> Signal(int n, int bits, double frequency, uint32_t seed, int wasted = 0) {
+    std::mt19937 rng(seed);
+    std::vector<int32_t> s(n);
+    double amplitude = std::ldexp(0.6, bits - 1);
+    for (int i = 0; i < n; i++) {
+        double noise = ((int)(rng() % 2001) - 1000) / 1000.0 * amplitude * 0.05;
+        int32_t v = (int32_t)(std::sin(i * frequency) * amplitude + noise);
+        s[i] = v & ~((1 << wasted) - 1);
+    }
+    return s;
+}
+
+int16_t ToPcm16(int32_t v, int bits) {
+    return (int16_t)(bits >= 16 ? v >> (bits - 16) : v << (16 - bits));
+}
+
+struct Encoded {
+    std::vector<uint8_t> stream;
+    std::vector<int16_t> pcm;  // 期望的交错 16 位输出
+    std::vector<size_t> frame_offsets;
+    std::vector<int> frame_samples;
+};
+
+void AppendFrame(Encoded& e, const std::vector<std::vector<int32_t>>& channels, int bits, int sample_rate,
+                 const FrameSpec& spec) {
+    e.frame_offsets.push_back(e.stream.size());
+    auto frame = EncodeFrame(channels, bits, sample_rate, e.frame_samples.size(), spec);
+    e.stream.insert(e.stream.end(), frame.begin(), frame.end());
+    e.frame_samples.push_back(channels[0].size());
+    for (size_t i = 0; i < channels[0].size(); i++) {
+        for (auto& c : channels) {
+            e.pcm.push_back(ToPcm16(c[i], bits));
+        }
+    }
+}
+
+void AppendHeader(Encoded& e, const std::vector<uint8_t>& metadata) {
+    e.stream.insert(e.stream.begin(), {'f', 'L', 'a', 'C'});
+    e.stream.insert(e.stream.begin() + 4, metadata.begin(), metadata.end());
+    for (auto& offset : e.frame_offsets) {
+        offset += 4 + metadata.size();
+    }
+}
+
+// 立体声 16 位，每帧换一种声道去相关方式和子帧类型
+Encoded StereoStream(std::vector<uint8_t> extra_metadata = {}) {
+    Encoded e;
+    const int kBits = 16;
+    const int kRate = 44100;
+    SubframeSpec fixed0{SubframeType::kFixed, 0};
+    SubframeSpec fixed1{SubframeType::kFixed, 1};
+    SubframeSpec fixed2{SubframeType::kFixed, 2};
+    fixed2.partition_order = 3;
+    SubframeSpec fixed3{SubframeType::kFixed, 3};
+    fixed3.escape_first_partition = true;
+    fixed3.partition_order = 2;
+    SubframeSpec fixed4{SubframeType::kFixed, 4};
+    fixed4.rice5 = true;
+    fixed4.partition_order = 4;
+    SubframeSpec lpc8{SubframeType::kLpc, 8, {1100, -400, 120, 80, -60, 30, -10, 5}, 13, 10};
+    lpc8.partition_order = 2;
+    SubframeSpec lpc32{SubframeType::kLpc, 32, std::vector<int32_t>(32, 7), 15, 14};
+    lpc32.coefs[0] = 16000;
+    SubframeSpec verbatim{SubframeType::kVerbatim};
+    SubframeSpec wasted{SubframeType::kFixed, 2};
+    wasted.wasted = 3;
+    SubframeSpec constant{SubframeType::kConstant};
+    SubframeSpec tail{SubframeType::kFixed, 2};  // 100 个样本不能再分区
+
+    struct Case {
+        int block_size;
+        FrameSpec spec;
+        int wasted_bits[2];
+        bool constant[2];
+    } cases[] = {
+        {4096, {1, {fixed2, fixed2}}, {0, 0}, {false, false}},
+        {1152, {8, {fixed1, fixed3}}, {0, 0}, {false, false}},
+        {4096, {9, {fixed4, fixed0}}, {0, 0}, {false, false}},
+        {2048, {10, {lpc8, lpc32}}, {0, 0}, {false, false}},
+        {192, {1, {verbatim, constant}}, {0, 0}, {false, true}},
+        {4608, {1, {wasted, fixed2}}, {3, 0}, {false, false}},
+        {100, {10, {tail, fixed1}}, {0, 0}, {false, false}},
+    };
+    uint32_t seed = 1;
+    for (auto& c : cases) {
+        std::vector<std::vector<int32_t>> ch = {
+            Signal(c.block_size, kBits, 0.031, seed++, c.wasted_bits[0]),
+            Signal(c.block_size, kBits, 0.047, seed++, c.wasted_bits[1]),
+        };
+        for (int k = 0; k < 2; k++) {
+            if (c.constant[k]) {
+                std::fill(ch[k].begin(), ch[k].end(), -1234);
+            }
+        }
+        AppendFrame(e, ch, kBits, kRate, c.spec);
+    }
+    auto metadata = StreamInfo(100, 4608, 0, kRate, 2, kBits, e.pcm.size() / 2, extra_metadata.empty());
+    metadata.insert(metadata.end(), extra_metadata.begin(), extra_metadata.end());
+    AppendHeader(e, metadata);
+    return e;
+}
+
+void TestKnownVector() {
+    // RFC 9639 附录 D.1：一个立体声样本 (25588, 10416)，两个 VERBATIM 子帧都带 wasted 位
+    const uint8_t kStream[] = {
+        'f', 'L', 'a', 'C',
+        0x80, 0x00, 0x00, 0x22, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x0f,
+        0x0a, 0xc4, 0x42, 0xf0, 0x00, 0x00, 0x00, 0x01,
+        0x3e, 0x84, 0xb4, 0x18, 0x07, 0xdc, 0x69, 0x03, 0x07, 0x58, 0x6a, 0x3d, 0xad, 0x1a, 0x2e, 0x0f,
+        0xff, 0xf8, 0x69, 0x18, 0x00, 0x00, 0xbf, 0x03, 0x58, 0xfd, 0x03, 0x12, 0x8b, 0xaa, 0x9a,
+    };
+    std::vector<uint8_t> stream(kStream, kStream + sizeof(kStream));
+    FlacStreamDecoder decoder;
+    auto result = RunDecoder(decoder, stream, stream.size());
+    CHECK(!result.contract_violated);
+    CHECK(result.sample_rate == 44100);
+    CHECK(result.channels == 2);
+    CHECK(result.pcm == (std::vector<int16_t>{25588, 10416}));
+}
+
+void TestRoundTrip() {
+    Encoded e = StereoStream();
+    for (size_t arrival : {(size_t)1, (size_t)7, (size_t)333, (size_t)4096, e.stream.size()}) {
+        FlacStreamDecoder decoder;
+        auto result = RunDecoder(decoder, e.stream, arrival);
+        CHECK(!result.contract_violated);
+        CHECK(result.frame_samples == e.frame_samples);
+        CHECK(result.pcm == e.pcm);
+        CHECK(result.sample_rate == 44100);
+    }
+
+    // Reset 后复用同一个解码器播放下一首
+    FlacStreamDecoder decoder;
+    RunDecoder(decoder, e.stream, 4096);
+    decoder.Reset();
+    auto again = RunDecoder(decoder, e.stream, 4096);
+    CHECK(again.pcm == e.pcm);
+}
+
+void TestFramesLargerThanPeek(uint32_t max_frame_field) {
+    // 24 位立体声 VERBATIM，每帧约 27KB，远超 4096 字节的 Peek 上限
+    Encoded e;
+    const int kBits = 24;
+    SubframeSpec verbatim{SubframeType::kVerbatim};
+    SubframeSpec fixed2{SubframeType::kFixed, 2};
+    fixed2.rice5 = true;  // 24 位残差需要超过 14 的 Rice 参数
+    uint32_t largest = 0;
+    for (int i = 0; i < 4; i++) {
+        std::vector<std::vector<int32_t>> ch = {Signal(4608, kBits, 0.02, 10 + i), Signal(4608, kBits, 0.03, 20 + i)};
+        size_t before = e.stream.size();
+        AppendFrame(e, ch, kBits, 48000, {i % 2 == 0 ? 1 : 8, {verbatim, i % 2 == 0 ? verbatim : fixed2}});
+        largest = std::max<uint32_t>(largest, e.stream.size() - before);
+    }
+    CHECK(largest > 4096);
+    AppendHeader(e, StreamInfo(4608, 4608, max_frame_field == 1 ? largest : max_frame_field, 48000, 2, kBits,
+                               e.pcm.size() / 2, true));
+
+    for (size_t arrival : {(size_t)100, (size_t)4096, (size_t)5000, e.stream.size()}) {
+        FlacStreamDecoder decoder;
+        auto result = RunDecoder(decoder, e.stream, arrival);
+        CHECK(!result.contract_violated);
+        CHECK(result.frame_samples == e.frame_samples);
+        CHECK(result.pcm == e.pcm);
+    }
+}
+
+void TestResync() {
+    Encoded e = StereoStream();
+
+    // 第 3 帧中间的一个字节损坏：这一帧 CRC 错误被丢弃，其余帧不受影响
+    std::vector<uint8_t> corrupt = e.stream;
+    size_t bad = 2;
+    corrupt[(e.frame_offsets[bad] + e.frame_offsets[bad + 1]) / 2] ^= 0x10;
+    std::vector<int16_t> expected;
+    std::vector<int> expected_samples;
+    size_t sample = 0;
+    for (size_t f = 0; f < e.frame_samples.size(); f++) {
+        size_t count = e.frame_samples[f] * 2;
+        if (f != bad) {
+            expected.insert(expected.end(), e.pcm.begin() + sample, e.pcm.begin() + sample + count);
+            expected_samples.push_back(e.frame_samples[f]);
+        }
+        sample += count;
+    }
+    for (size_t arrival : {(size_t)64, (size_t)4096}) {
+        FlacStreamDecoder decoder;
+        auto result = RunDecoder(decoder, corrupt, arrival);
+        CHECK(!result.contract_violated);
+        CHECK(result.frame_samples == expected_samples);
+        CHECK(result.pcm == expected);
+    }
+
+    // 帧之间插入带假同步码的垃圾数据
+    std::vector<uint8_t> junk = e.stream;
+    const uint8_t kJunk[] = {0xFF, 0xF8, 0x00, 0x12, 0xFF, 0xF9, 0xC9, 0x18, 0x00, 0x00, 0x00, 0xFF};
+    junk.insert(junk.begin() + e.frame_offsets[4], kJunk, kJunk + sizeof(kJunk));
+    FlacStreamDecoder decoder;
+    auto result = RunDecoder(decoder, junk, 1000);
+    CHECK(result.frame_samples == e.frame_samples);
+    CHECK(result.pcm == e.pcm);
+
+    // 流在帧中间结束：最后一帧丢弃，不会等待或死循环
+    std::vector<uint8_t> truncated(e.stream.begin(), e.stream.begin() + e.frame_offsets[3] + 100);
+    FlacStreamDecoder truncated_decoder;
+    auto partial = RunDecoder(truncated_decoder, truncated, 512);
+    CHECK(!partial.contract_violated);
+    CHECK(partial.frame_samples == std::vector<int>(e.frame_samples.begin(), e.frame_samples.begin() + 3));
+}
+
+void TestMetadataBlocks() {
+    // STREAMINFO 之后的 APPLICATION 和超过 Peek 长度的 PADDING 都要跳过
+    auto extra = MetadataBlock(2, 20, false);
+    auto padding = MetadataBlock(1, 10000, true);
+    extra.insert(extra.end(), padding.begin(), padding.end());
+    Encoded e = StereoStream(extra);
+    FlacStreamDecoder decoder;
+    auto result = RunDecoder(decoder, e.stream, 1500);
+    CHECK(!result.contract_violated);
+    CHECK(result.pcm == e.pcm);
+}
+
+void TestUnsupported() {
+    // 3 声道：STREAMINFO 被拒绝，剩余数据全部丢弃
+    Encoded e = StereoStream();
+    std::vector<uint8_t> three = e.stream;
+    three[4 + 4 + 12] = (three[4 + 4 + 12] & ~0x0E) | (2 << 1);
+    FlacStreamDecoder decoder;
+    auto result = RunDecoder(decoder, three, 4096);
+    CHECK(!result.contract_violated);
+    CHECK(result.pcm.empty());
+
+    std::vector<uint8_t> not_flac(5000, 0x55);
+    FlacStreamDecoder other;
+    result = RunDecoder(other, not_flac, 4096);
+    CHECK(!result.contract_violated);
+    CHECK(result.pcm.empty());
+
+    // 第一个元数据块不是 STREAMINFO
+    std::vector<uint8_t> no_info = {'f', 'L', 'a', 'C'};
+    auto padding = MetadataBlock(1, 10, true);
+    no_info.insert(no_info.end(), padding.begin(), padding.end());
+    FlacStreamDecoder third;
+    result = RunDecoder(third, no_info, 4096);
+    CHECK(result.pcm.empty());
+}
+
+} // namespace
+
+int main() {
+    TestKnownVector();
+    TestRoundTrip();
+    TestFramesLargerThanPeek(1);  // STREAMINFO 记录了真实的最大帧长
+    TestFramesLargerThanPeek(0);  // 最大帧长未知，按不压缩估算
+    TestResync();
+    TestMetadataBlocks();
+    TestUnsupported();
+    return TestResult();
+}
@@ -0,0 +1,132 @@
+// JsonStreamExtractor 和原来的做法（整个响应读进字符串后 cJSON_Parse）对比：
+// 随机分块喂入的提取结果必须和 cJSON 解析出的字段完全一致，并打印两者的堆内存峰值和耗时
+#include "json_stream_extractor.h"
+#include "alloc_counter.h"
+#include "kuwo_json_data.h"
+#include "test_util.h"
+
+#include <cJSON.h>
+
+#include <chrono>
+#include <random>
+
+namespace {
+
+const std::vector<std::string> kPaths = {"abslist[].DC_TARGETID", "abslist[].ARTIST", "abslist[].SONGNAME",
+                                         "abslist[].DURATION"};
+
+std::vector<KuwoSong> ExtractStreaming(const std::string& json, std::mt19937& rng) {
+    std::vector<KuwoSong> songs;
+    JsonStreamExtractor extractor(kPaths, [&](int field, int index, const std::string& value) {
+        if (index >= (int)songs.size()) {
+            songs.resize(index + 1);
+        }
+        auto& song = songs[index];
+        switch (field) {
+        case 0: song.id = value; break;
+        case 1: song.artist = value; break;
+        case 2: song.name = value; break;
+        case 3: song.duration = value; break;
+        }
+        return true;
+    });
+    for (size_t offset = 0; offset < json.size();) {
+        size_t size = std::min<size_t>(1 + rng() % 4096, json.size() - offset);
+        extractor.Feed(json.data() + offset, size);
+        offset += size;
+    }
+    CHECK(!extractor.failed());
+    return songs;
+}
+
+// 原来的做法：分块读到的数据先拼成完整字符串，再建整棵树
+std::vector<KuwoSong> ExtractCjson(const std::string& json, std::mt19937& rng) {
+    std::string body;
+    for (size_t offset = 0; offset < json.size();) {
+        size_t size = std::min<size_t>(1 + rng() % 4096, json.size() - offset);
+        body.append(json.data() + offset, size);
+        offset += size;
+    }
+    std::vector<KuwoSong> songs;
+    cJSON* root = cJSON_Parse(body.c_str());
+    CHECK(root != nullptr);
+    cJSON* item;
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(root, "abslist")) {
+        KuwoSong song;
+        cJSON* id = cJSON_GetObjectItem(item, "DC_TARGETID");
+        cJSON* artist = cJSON_GetObjectItem(item, "ARTIST");
+        cJSON* name = cJSON_GetObjectItem(item, "SONGNAME");
+        cJSON* duration = cJSON_GetObjectItem(item, "DURATION");
+        song.id = cJSON_IsString(id) ? id->valuestring : "";
+        song.artist = cJSON_IsString(artist) ? artist->valuestring : "";
+        song.name = cJSON_IsString(name) ? name->valuestring : "";
+        song.duration = cJSON_IsNumber(duration) ? std::to_string(duration->valueint) : "";
+        songs.push_back(song);
+    }
+    cJSON_Delete(root);
+    return songs;
+}
+
+bool SameSongs(const std::vector<KuwoSong>& a, const std::vector<KuwoSong>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].id != b[i].id || a[i].artist != b[i].artist || a[i].name != b[i].name ||
+            a[i].duration != b[i].duration) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename F>
+void Measure(F&& extract, const std::string& json, int runs, size_t& peak, double& us) {
+    std::mt19937 rng(1);
+    size_t baseline = AllocCurrent();
+    AllocResetPeak();
+    extract(json, rng);
+    peak = AllocPeak() - baseline;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        extract(json, rng);
+    }
+    us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+} // namespace
+
+int main() {
+    cJSON_Hooks hooks = {CountedMalloc, CountedFree};
+    cJSON_InitHooks(&hooks);
+
+    printf("%6s %9s | %14s %10s | %14s %10s\n", "songs", "bytes", "stream peak", "stream us", "cJSON peak", "cJSON us");
+    for (int count : {1, 10, 30, 100}) {
+        std::vector<KuwoSong> expected;
+        std::string json = KuwoSearchResponse(count, expected);
+
+        // 同一份响应用 20 种不同的分块方式，结果都要和 cJSON 一致
+        for (uint32_t seed = 0; seed < 20; seed++) {
+            std::mt19937 stream_rng(seed);
+            std::mt19937 cjson_rng(seed);
+            auto streamed = ExtractStreaming(json, stream_rng);
+            auto parsed = ExtractCjson(json, cjson_rng);
+            CHECK(SameSongs(streamed, parsed));
+            CHECK(SameSongs(streamed, expected));
+        }
+
+        size_t stream_peak = 0;
+        size_t cjson_peak = 0;
+        double stream_us = 0;
+        double cjson_us = 0;
+        Measure(ExtractStreaming, json, 50, stream_peak, stream_us);
+        Measure(ExtractCjson, json, 50, cjson_peak, cjson_us);
+        printf("%6d %9zu | %14zu %10.1f | %14zu %10.1f\n", count, json.size(), stream_peak, stream_us,
+               cjson_peak, cjson_us);
+        if (count >= 10) {
+            CHECK(stream_peak * 4 < cjson_peak);
+        }
+    }
+    return TestResult();
+}
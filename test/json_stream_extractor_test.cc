@@ -0,0 +1,201 @@
+// JsonStreamExtractor：同一份响应按各种分块大小喂入，提取结果都必须一致；
+// 提前停止、超长值截断、格式错误和嵌套过深；解析过程的堆内存与响应长度无关
+#include "json_stream_extractor.h"
+#include "alloc_counter.h"
+#include "kuwo_json_data.h"
+#include "test_util.h"
+
+#include <cstring>
+#include <random>
+
+namespace {
+
+enum Field {
+    kSongId,
+    kArtist,
+    kSongName,
+    kDuration,
+    kTotal,
+};
+
+const std::vector<std::string> kPaths = {
+    "abslist[].DC_TARGETID", "abslist[].ARTIST", "abslist[].SONGNAME", "abslist[].DURATION", "TOTAL",
+};
+
+struct Result {
+    std::vector<KuwoSong> songs;
+    std::string total;
+    int callbacks = 0;
+};
+
+// chunk 为 0 时使用随机分块
+Result Extract(const std::string& json, size_t chunk, bool& failed) {
+    Result result;
+    JsonStreamExtractor extractor(kPaths, [&](int field, int index, const std::string& value) {
+        result.callbacks++;
+        if (field == kTotal) {
+            result.total = value;
+            return true;
+        }
+        if (index >= (int)result.songs.size()) {
+            result.songs.resize(index + 1);
+        }
+        auto& song = result.songs[index];
+        switch (field) {
+        case kSongId: song.id = value; break;
+        case kArtist: song.artist = value; break;
+        case kSongName: song.name = value; break;
+        case kDuration: song.duration = value; break;
+        }
+        return true;
+    });
+    std::mt19937 rng(chunk);
+    size_t offset = 0;
+    while (offset < json.size()) {
+        size_t size = chunk > 0 ? chunk : 1 + rng() % 1500;
+        size = std::min(size, json.size() - offset);
+        if (!extractor.Feed(json.data() + offset, size)) {
+            break;
+        }
+        offset += size;
+    }
+    failed = extractor.failed();
+    CHECK(extractor.stopped());  // 根对象结束后自动停止
+    return result;
+}
+
+bool SameSongs(const std::vector<KuwoSong>& a, const std::vector<KuwoSong>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].id != b[i].id || a[i].artist != b[i].artist || a[i].name != b[i].name ||
+            a[i].duration != b[i].duration) {
+            fprintf(stderr, "song %zu differs: '%s' '%s' '%s' '%s'\n", i, a[i].id.c_str(), a[i].artist.c_str(),
+                    a[i].name.c_str(), a[i].duration.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestChunkedInput() {
+    std::vector<KuwoSong> expected;
+    std::string json = KuwoSearchResponse(40, expected);
+    const size_t chunks[] = {1, 2, 3, 5, 7, 13, 64, 511, 4096, 1 << 20, 0};
+    for (size_t chunk : chunks) {
+        bool failed = true;
+        Result result = Extract(json, chunk, failed);
+        CHECK(!failed);
+        CHECK(SameSongs(result.songs, expected));
+        CHECK(result.total == "280");
+        CHECK(result.callbacks == 40 * 4 + 1);
+    }
+}
+
+void TestEarlyStop() {
+    std::vector<KuwoSong> expected;
+    std::string json = KuwoSearchResponse(20, expected);
+    std::string id;
+    int calls = 0;
+    JsonStreamExtractor extractor({"abslist[].DC_TARGETID"}, [&](int, int index, const std::string& value) {
+        calls++;
+        id = value;
+        return false;  // 只要第一首
+    });
+    size_t fed = 0;
+    while (fed < json.size() && extractor.Feed(json.data() + fed, 100)) {
+        fed += 100;
+    }
+    CHECK(calls == 1);
+    CHECK(id == expected[0].id);
+    CHECK(extractor.stopped() && !extractor.failed());
+    CHECK(fed < json.size() / 10);  // 调用方可以在收到第一首后关闭连接
+}
+
+void TestLongValueIsTruncated() {
+    std::string json = "{\"a\":\"" + std::string(1000, 'y') + "\",\"b\":1}";
+    std::string a;
+    std::string b;
+    JsonStreamExtractor extractor({"a", "b"}, [&](int field, int, const std::string& value) {
+        (field == 0 ? a : b) = value;
+        return true;
+    });
+    extractor.Feed(json.data(), json.size());
+    CHECK(a == std::string(JsonStreamExtractor::kMaxValueLength, 'y'));
+    CHECK(b == "1");
+}
+
+void TestMalformedInput() {
+    const char* inputs[] = {
+        "{\"a\" 1}",
+        "{\"a\":1,}",
+        "[1 2]",
+        "{\"a\":\"\\x\"}",
+        "{\"a\":\"\\u12g4\"}",
+        "{\"a\":1]",
+    };
+    for (const char* input : inputs) {
+        JsonStreamExtractor extractor({"a"}, [](int, int, const std::string&) { return true; });
+        CHECK(!extractor.Feed(input, strlen(input)));
+        CHECK(extractor.failed());
+    }
+
+    std::string deep(JsonStreamExtractor::kMaxDepth + 1, '[');
+    JsonStreamExtractor extractor({"a"}, [](int, int, const std::string&) { return true; });
+    extractor.Feed(deep.data(), deep.size());
+    CHECK(extractor.failed());
+}
+
+void TestRootValues() {
+    std::string value;
+    JsonStreamExtractor extractor({"[]"}, [&](int, int index, const std::string& v) {
+        value += v + "@" + std::to_string(index) + ";";
+        return true;
+    });
+    const char* json = "[ 1, \"two\", true, null, [], {} ] trailing";
+    CHECK(!extractor.Feed(json, strlen(json)));
+    CHECK(!extractor.failed());
+    CHECK(value == "1@0;two@1;true@2;null@3;");
+}
+
+// 解析过程中额外占用的堆内存只和嵌套深度、字段长度有关，不随响应变大
+size_t PeakHeap(int count) {
+    std::vector<KuwoSong> expected;
+    std::string json = KuwoSearchResponse(count, expected);
+    size_t baseline = AllocCurrent();
+    AllocResetPeak();
+    {
+        std::string id;
+        JsonStreamExtractor extractor(kPaths, [&](int field, int, const std::string& value) {
+            if (field == kSongId) {
+                id = value;
+            }
+            return true;
+        });
+        for (size_t offset = 0; offset < json.size(); offset += 4096) {
+            extractor.Feed(json.data() + offset, std::min<size_t>(4096, json.size() - offset));
+        }
+    }
+    return AllocPeak() - baseline;
+}
+
+void TestBoundedMemory() {
+    size_t small = PeakHeap(10);
+    size_t large = PeakHeap(1000);
+    printf("extractor peak heap: %zu bytes for 10 songs, %zu bytes for 1000 songs\n", small, large);
+    CHECK(large == small);
+    CHECK(large < 4096);
+}
+
+} // namespace
+
+int main() {
+    TestChunkedInput();
+    TestEarlyStop();
+    TestLongValueIsTruncated();
+    TestMalformedInput();
+    TestRootValues();
+    TestBoundedMemory();
+    return TestResult();
+}
@@ -0,0 +1,60 @@
+#ifndef HOST_KUWO_JSON_DATA_H
+#define HOST_KUWO_JSON_DATA_H
+
+#include <string>
+#include <vector>
+
+// 按酷我搜索接口的结构生成测试用的响应：每首歌除了需要的字段，
+// 还带有嵌套对象、数组和一段长文本，字符串里混有转义、中文和代理对
+struct KuwoSong {
+    std::string id;
+    std::string artist;  // 解码后的 UTF-8
+    std::string name;
+    std::string duration;
+};
+
+inline std::string KuwoSearchResponse(int count, std::vector<KuwoSong>& songs) {
+    static const char* kArtists[][2] = {
+        {"\\u5468\\u6770\\u4f26", "\xE5\x91\xA8\xE6\x9D\xB0\xE4\xBC\xA6"},  // 周杰伦
+        {"Guns N\\u0027 Roses", "Guns N' Roses"},
+        {"AC\\/DC", "AC/DC"},
+        {"\\\"Weird\\\" Al", "\"Weird\" Al"},
+    };
+    static const char* kNames[][2] = {
+        {"\\u6674\\u5929", "\xE6\x99\xB4\xE5\xA4\xA9"},  // 晴天
+        {"Song \\ud83c\\udfb5 Emoji", "Song \xF0\x9F\x8E\xB5 Emoji"},
+        {"Line\\nBreak\\tTab", "Line\nBreak\tTab"},
+        {"Back\\\\slash", "Back\\slash"},
+    };
+
+    std::string json = "{\"ARTISTPN\":\"4000\",\"HIT\":\"" + std::to_string(count * 7) +
+                       "\",\"HITMODE\":\"song\",\"abslist\":[";
+    songs.clear();
+    for (int i = 0; i < count; i++) {
+        KuwoSong song;
+        song.id = std::to_string(228908 + i * 13);
+        song.artist = kArtists[i % 4][1];
+        song.name = kNames[(i / 4) % 4][1];
+        song.duration = std::to_string(180 + i % 120);
+        songs.push_back(song);
+
+        if (i > 0) {
+            json += i % 3 == 0 ? ",\n  " : ",";
+        }
+        json += "{\"AARTIST\":\"\",\"ALBUM\":\"\\u53f6\\u60e0\\u7f8e\",\"ALBUMID\":\"" + std::to_string(i) + "\",";
+        json += "\"ARTIST\":\"" + std::string(kArtists[i % 4][0]) + "\",";
+        json += "\"ARTISTX\":\"decoy\",\"ART\":\"decoy\",";
+        json += "\"DC_TARGETID\":\"" + song.id + "\",";
+        json += "\"DURATION\" : " + song.duration + " ,";
+        json += "\"MVFLAG\":true,\"PAY\":null,\"SCORE100\":-1.5e2,";
+        json += "\"N_MINFO\":[{\"format\":\"mp3\",\"bitrate\":\"128\",\"size\":\"3.2Mb\"},"
+                "{\"format\":\"mp3\",\"bitrate\":\"320\",\"size\":\"8.1Mb\"}],";
+        json += "\"SONGNAME\":\"" + std::string(kNames[(i / 4) % 4][0]) + "\",";
+        json += "\"tags\":[],\"web\":{},\"extra\":{\"abslist\":[{\"DC_TARGETID\":\"nested\"}]},";
+        json += "\"INTRO\":\"" + std::string(400, 'x') + "\"}";
+    }
+    json += "],\"PN\":\"0\",\"RN\":\"" + std::to_string(count) + "\",\"TOTAL\":\"" + std::to_string(count * 7) + "\"}";
+    return json;
+}
+
+#endif // HOST_KUWO_JSON_DATA_H
@@ -0,0 +1,167 @@
+// LatencyHistogram：桶边界、百分位（与排序后的精确值逐一对比）、min/max/avg、负值、
+// 最后一个开放桶、Reset、多线程并发记录，以及 Record 不分配内存
+#include "latency_histogram.h"
+#include "alloc_counter.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Record 把 ms 放进的桶的上界：[0,1) 为 1，[1,2) 为 2，[2,4) 为 4 ...
+int64_t UpperBound(int64_t ms) {
+    int64_t bound = 1;
+    while (bound <= ms) {
+        bound <<= 1;
+    }
+    return bound;
+}
+
+// 与 PercentileLocked 相同的最近秩定义，但在原始数据上计算
+int64_t ExpectedPercentile(std::vector<int64_t> values, int percentile) {
+    std::sort(values.begin(), values.end());
+    size_t target = (values.size() * percentile + 99) / 100;
+    if (target == 0) {
+        target = 1;
+    }
+    int64_t value = values[target - 1];
+    int64_t last_bucket = 1LL << (LatencyHistogram::kBucketCount - 2);
+    return value >= last_bucket ? values.back() : UpperBound(value);
+}
+
+void TestEmpty() {
+    LatencyHistogram h;
+    CHECK(h.count() == 0);
+    CHECK(h.average() == 0);
+    CHECK(h.Percentile(50) == 0);
+    CHECK(h.ToString() == "n=0 avg=0 min=0 p50=0 p90=0 max=0");
+}
+
+void TestBuckets() {
+    // 每个值单独记录时 p100 就是它所在桶的上界
+    const int64_t values[] = {0, 1, 2, 3, 4, 7, 8, 100, 511, 512, 1000, 8191, 8192, 16383};
+    for (int64_t v : values) {
+        LatencyHistogram h;
+        h.Record(v);
+        CHECK(h.Percentile(100) == UpperBound(v));
+        CHECK(h.Percentile(0) == UpperBound(v));
+    }
+
+    // 负值按 0 记录
+    LatencyHistogram negative;
+    negative.Record(-5);
+    CHECK(negative.count() == 1);
+    CHECK(negative.average() == 0);
+    CHECK(negative.Percentile(50) == 1);
+    CHECK(negative.ToString() == "n=1 avg=0 min=0 p50=1 p90=1 max=0");
+
+    // 最后一个桶没有上界，报告观察到的最大值
+    LatencyHistogram open;
+    open.Record(16384);
+    open.Record(40000);
+    CHECK(open.Percentile(50) == 40000);
+    CHECK(open.Percentile(90) == 40000);
+}
+
+void TestStats() {
+    LatencyHistogram h;
+    for (int64_t v : {430, 812, 1870, 640, 990}) {
+        h.Record(v);
+    }
+    CHECK(h.count() == 5);
+    CHECK(h.average() == (430 + 812 + 1870 + 640 + 990) / 5);
+    // 排序后 430 640 812 990 1870：p50 取第 3 个（812，桶 [512,1024)），p90 取第 5 个（1870，桶 [1024,2048)）
+    CHECK(h.Percentile(50) == 1024);
+    CHECK(h.Percentile(90) == 2048);
+    CHECK(h.ToString() == "n=5 avg=948 min=430 p50=1024 p90=2048 max=1870");
+
+    h.Reset();
+    CHECK(h.count() == 0);
+    CHECK(h.ToString() == "n=0 avg=0 min=0 p50=0 p90=0 max=0");
+    // Reset 后 min 从新数据重新开始
+    h.Record(2000);
+    CHECK(h.ToString() == "n=1 avg=2000 min=2000 p50=2048 p90=2048 max=2000");
+}
+
+void TestRandomPercentiles() {
+    // 对数均匀分布，覆盖所有桶；百分位必须与原始数据上的最近秩结果完全一致
+    std::mt19937 rng(24);
+    std::uniform_real_distribution<double> exponent(-1, 15.5);
+    for (int round = 0; round < 50; round++) {
+        LatencyHistogram h;
+        std::vector<int64_t> values(1 + rng() % 500);
+        for (auto& v : values) {
+            v = (int64_t)std::pow(2.0, exponent(rng));
+            h.Record(v);
+        }
+        bool exact = true;
+        for (int p : {1, 10, 50, 90, 99, 100}) {
+            exact &= h.Percentile(p) == ExpectedPercentile(values, p);
+        }
+        CHECK(exact);
+        CHECK(h.count() == values.size());
+    }
+}
+
+void TestThreads() {
+    // 多个任务同时记录，另一个任务同时读取，计数和总和不能丢
+    LatencyHistogram h;
+    const int kThreads = 4;
+    const int kPerThread = 100000;
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        while (!done) {
+            std::string s = h.ToString();
+            (void)h.Percentile(90);
+            (void)s;
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; t++) {
+        writers.emplace_back([&h, t] {
+            for (int i = 0; i < kPerThread; i++) {
+                h.Record(t * 1000 + i % 1000);
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+    done = true;
+    reader.join();
+
+    CHECK(h.count() == kThreads * kPerThread);
+    // 每个线程的平均值为 t*1000 + 499.5
+    CHECK(h.average() == (0 + 1000 + 2000 + 3000) / 4 + 499);
+    CHECK(h.ToString().find("min=0 ") != std::string::npos);
+    CHECK(h.ToString().find("max=3999") != std::string::npos);
+}
+
+void TestNoAllocation() {
+    // 热路径上的 Record 不能分配内存
+    LatencyHistogram h;
+    size_t before = AllocCount();
+    for (int i = 0; i < 10000; i++) {
+        h.Record(i * 3);
+    }
+    (void)h.Percentile(50);
+    (void)h.average();
+    CHECK(AllocCount() == before);
+}
+
+} // namespace
+
+int main() {
+    TestEmpty();
+    TestBuckets();
+    TestStats();
+    TestRandomPercentiles();
+    TestThreads();
+    TestNoAllocation();
+    return TestResult();
+}
@@ -0,0 +1,270 @@
+// PcmOutputStage：声道转换、增益、跨帧连续的重采样和稳定播放时零分配；
+// 之后对比旧路径（PlayAudioStream 分配 mono_buffer 和 payload、AddAudioData 再拷贝一次并重采样、
+// NoAudioCodec::Write 分配 int32 缓冲）和新输出级的每帧分配次数和周期数
+#include "pcm_output_stage.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kMp3Frame = 1152;
+constexpr int kCodecRate = 24000;
+constexpr int kDmaFrame = 240;  // AUDIO_CODEC_DMA_FRAME_NUM
+
+std::vector<int16_t> Tone(int frames, int channels, int rate, double frequency, double amplitude = 12000) {
+    std::vector<int16_t> pcm(frames * channels);
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            pcm[i * channels + c] = (int16_t)(amplitude * std::sin(2 * M_PI * frequency * (c + 1) * i / rate));
+        }
+    }
+    return pcm;
+}
+
+void TestSameRate() {
+    std::mt19937 rng(1);
+    std::vector<int16_t> stereo(kMp3Frame * 2);
+    for (auto& v : stereo) {
+        v = (int16_t)rng();
+    }
+    PcmOutputStage stage;
+    const int16_t* out = nullptr;
+
+    size_t n = stage.Process(stereo.data(), kMp3Frame, 2, 44100, 1, 44100, out);
+    CHECK(n == (size_t)kMp3Frame);
+    bool exact = true;
+    for (int i = 0; i < kMp3Frame; i++) {
+        exact &= out[i] == (int16_t)((stereo[i * 2] + stereo[i * 2 + 1]) >> 1);
+    }
+    CHECK(exact);
+
+    n = stage.Process(stereo.data(), kMp3Frame, 2, 44100, 2, 44100, out);
+    CHECK(n == (size_t)kMp3Frame * 2);
+    CHECK(memcmp(out, stereo.data(), n * sizeof(int16_t)) == 0);
+
+    // 单声道复制到两个声道，增益 0.5
+    stage.SetGain(PcmOutputStage::kUnityGain / 2);
+    n = stage.Process(stereo.data(), kMp3Frame * 2, 1, 44100, 2, 44100, out);
+    CHECK(n == (size_t)kMp3Frame * 4);
+    exact = true;
+    for (int i = 0; i < kMp3Frame * 2; i++) {
+        int16_t expected = (int16_t)(stereo[i] >> 1);
+        exact &= out[i * 2] == expected && out[i * 2 + 1] == expected;
+    }
+    CHECK(exact);
+
+    // 增益大于 1 时饱和而不是回绕
+    stage.SetGain(PcmOutputStage::kUnityGain * 4);
+    const int16_t loud[] = {20000, -20000, 100, -100};
+    n = stage.Process(loud, 4, 1, 16000, 1, 16000, out);
+    CHECK(n == 4);
+    CHECK(out[0] == INT16_MAX && out[1] == INT16_MIN && out[2] == 400 && out[3] == -400);
+
+    CHECK(stage.Process(loud, 0, 1, 16000, 1, 16000, out) == 0);
+    CHECK(stage.Process(loud, 4, 1, 0, 1, 16000, out) == 0);
+}
+
+// 把 input 按给定的分块长度依次送入，拼接所有输出
+std::vector<int16_t> ProcessInChunks(PcmOutputStage& stage, const std::vector<int16_t>& input, int channels,
+                                     int input_rate, int output_channels, const std::vector<int>& chunks) {
+    std::vector<int16_t> result;
+    int total = input.size() / channels;
+    int offset = 0;
+    size_t next = 0;
+    while (offset < total) {
+        int frames = std::min(chunks[next++ % chunks.size()], total - offset);
+        const int16_t* out = nullptr;
+        size_t n = stage.Process(input.data() + offset * channels, frames, channels, input_rate, output_channels,
+                                 kCodecRate, out);
+        result.insert(result.end(), out, out + n);
+        offset += frames;
+    }
+    return result;
+}
+
+void TestResampleContinuity() {
+    // 帧边界不影响结果：一次处理和任意分块处理的输出逐样本相同
+    auto input = Tone(44100, 2, 44100, 997);
+    PcmOutputStage whole;
+    auto expected = ProcessInChunks(whole, input, 2, 44100, 1, {44100});
+    PcmOutputStage chunked;
+    auto actual = ProcessInChunks(chunked, input, 2, 44100, 1, {kMp3Frame, 1, 17, 576, 4000});
+    CHECK(actual == expected);
+    // 1 秒输入约输出 1 秒，差值不超过滤波器延迟
+    CHECK(std::abs((int)expected.size() - kCodecRate) < 64);
+
+    // Reset 后等同于新实例
+    chunked.Reset();
+    auto again = ProcessInChunks(chunked, input, 2, 44100, 1, {kMp3Frame});
+    CHECK(again == expected);
+
+    // 切换采样率后重新配置
+    auto input16k = Tone(16000, 1, 16000, 440);
+    PcmOutputStage fresh;
+    auto expected16k = ProcessInChunks(fresh, input16k, 1, 16000, 1, {kMp3Frame});
+    chunked.Reset();
+    auto switched = ProcessInChunks(chunked, input16k, 1, 16000, 1, {kMp3Frame});
+    CHECK(switched == expected16k);
+}
+
+void TestSteadyStateAllocations() {
+    struct Case {
+        int channels;
+        int rate;
+        int output_channels;
+    } cases[] = {{2, 44100, 1}, {2, 48000, 2}, {1, 22050, 1}, {2, 24000, 1}};
+    for (auto& c : cases) {
+        auto input = Tone(kMp3Frame, c.channels, c.rate, 1000);
+        PcmOutputStage stage;
+        const int16_t* out = nullptr;
+        // 第一帧允许分配（建系数表、缓冲区增长）
+        stage.Process(input.data(), kMp3Frame, c.channels, c.rate, c.output_channels, kCodecRate, out);
+        size_t before = AllocCount();
+        for (int i = 0; i < 200; i++) {
+            stage.Process(input.data(), kMp3Frame, c.channels, c.rate, c.output_channels, kCodecRate, out);
+        }
+        CHECK(AllocCount() == before);
+    }
+}
+
+// ---- 基准 ----
+
+// 旧路径，按原来 PlayAudioStream -> Application::AddAudioData -> NoAudioCodec::Write 的写法复现
+// 输出采样率高于输入时只做整数倍线性插值；低于输入时原来会切换 I2S 时钟，这里不做转换
+size_t LegacyPath(const int16_t* pcm, int frames, int channels, int rate, int volume, int32_t* sink) {
+    const int16_t* final_pcm = pcm;
+    int final_samples = frames * channels;
+    std::vector<int16_t> mono_buffer;
+    if (channels == 2) {
+        mono_buffer.resize(frames);
+        for (int i = 0; i < frames; i++) {
+            mono_buffer[i] = (int16_t)((pcm[i * 2] + pcm[i * 2 + 1]) / 2);
+        }
+        final_pcm = mono_buffer.data();
+        final_samples = frames;
+    }
+    std::vector<uint8_t> payload(final_samples * sizeof(int16_t));
+    memcpy(payload.data(), final_pcm, payload.size());
+
+    // Application::AddAudioData
+    std::vector<int16_t> pcm_data(payload.size() / sizeof(int16_t));
+    memcpy(pcm_data.data(), payload.data(), payload.size());
+    if (rate < kCodecRate) {
+        float ratio = kCodecRate / (float)rate;
+        std::vector<int16_t> resampled;
+        resampled.reserve((size_t)(pcm_data.size() * ratio + 0.5f));
+        int interpolation_count = (int)ratio - 1;
+        for (size_t i = 0; i < pcm_data.size(); i++) {
+            resampled.push_back(pcm_data[i]);
+            if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
+                int16_t current = pcm_data[i];
+                int16_t next = pcm_data[i + 1];
+                for (int j = 1; j <= interpolation_count; j++) {
+                    float t = (float)j / (interpolation_count + 1);
+                    resampled.push_back((int16_t)(current + (next - current) * t));
+                }
+            } else if (interpolation_count > 0) {
+                for (int j = 1; j <= interpolation_count; j++) {
+                    resampled.push_back(pcm_data[i]);
+                }
+            }
+        }
+        pcm_data = std::move(resampled);
+    }
+
+    // NoAudioCodec::Write
+    std::vector<int32_t> buffer(pcm_data.size());
+    int32_t volume_factor = std::pow(volume / 100.0, 2) * 65536;
+    for (size_t i = 0; i < pcm_data.size(); i++) {
+        int64_t temp = (int64_t)pcm_data[i] * volume_factor;
+        buffer[i] = temp > INT32_MAX ? INT32_MAX : temp < INT32_MIN ? INT32_MIN : (int32_t)temp;
+    }
+    memcpy(sink, buffer.data(), std::min<size_t>(buffer.size(), kDmaFrame) * sizeof(int32_t));
+    return buffer.size();
+}
+
+// 新路径：输出级一次完成声道转换、重采样和增益，编解码器按 DMA 帧在栈上转换
+size_t FusedPath(PcmOutputStage& stage, const int16_t* pcm, int frames, int channels, int rate, int volume,
+                 int32_t* sink) {
+    const int16_t* out = nullptr;
+    size_t samples = stage.Process(pcm, frames, channels, rate, 1, kCodecRate, out);
+    int32_t volume_factor = std::pow(volume / 100.0, 2) * 65536;
+    for (size_t offset = 0; offset < samples; offset += kDmaFrame) {
+        size_t count = std::min<size_t>(samples - offset, kDmaFrame);
+        for (size_t i = 0; i < count; i++) {
+            int64_t temp = (int64_t)out[offset + i] * volume_factor;
+            sink[i] = temp > INT32_MAX ? INT32_MAX : temp < INT32_MIN ? INT32_MIN : (int32_t)temp;
+        }
+    }
+    return samples;
+}
+
+void Benchmark() {
+    struct Case {
+        const char* name;
+        int channels;
+        int rate;
+    } cases[] = {
+        {"24k stereo (same rate)", 2, 24000},
+        {"12k stereo (2x up)", 2, 12000},
+        {"22.05k stereo", 2, 22050},
+        {"44.1k stereo", 2, 44100},
+        {"48k mono", 1, 48000},
+    };
+    const int kFrames = 2000;
+    int32_t sink[kDmaFrame];
+
+    printf("%-26s | %-28s | %-28s\n", "", "legacy path", "fused output stage");
+    printf("%-26s | %8s %8s %10s | %8s %8s %10s\n", "input (1152 samples/frame)", "alloc/fr", "alloc/s",
+           "cyc/frame", "alloc/fr", "alloc/s", "cyc/frame");
+    for (auto& c : cases) {
+        auto input = Tone(kMp3Frame, c.channels, c.rate, 1000);
+        double frames_per_second = (double)c.rate / kMp3Frame;
+
+        size_t allocs = AllocCount();
+        uint64_t start = BenchCycles();
+        size_t produced = 0;
+        for (int i = 0; i < kFrames; i++) {
+            produced += LegacyPath(input.data(), kMp3Frame, c.channels, c.rate, 70, sink);
+        }
+        uint64_t legacy_cycles = BenchCycles() - start;
+        double legacy_allocs = (double)(AllocCount() - allocs) / kFrames;
+        BenchKeep(produced);
+
+        PcmOutputStage stage;
+        stage.SetGain(PcmOutputStage::kUnityGain);
+        FusedPath(stage, input.data(), kMp3Frame, c.channels, c.rate, 70, sink);  // 预热：建表和缓冲区
+        allocs = AllocCount();
+        start = BenchCycles();
+        for (int i = 0; i < kFrames; i++) {
+            produced += FusedPath(stage, input.data(), kMp3Frame, c.channels, c.rate, 70, sink);
+        }
+        uint64_t fused_cycles = BenchCycles() - start;
+        double fused_allocs = (double)(AllocCount() - allocs) / kFrames;
+        BenchKeep(produced);
+
+        printf("%-26s | %8.1f %8.1f %10llu | %8.1f %8.1f %10llu\n", c.name, legacy_allocs,
+               legacy_allocs * frames_per_second, (unsigned long long)(legacy_cycles / kFrames), fused_allocs,
+               fused_allocs * frames_per_second, (unsigned long long)(fused_cycles / kFrames));
+        CHECK(fused_allocs == 0);
+    }
+    printf("cycles are %s on this host; the legacy path does no resampling for 22.05k (copies) and 44.1k/48k "
+           "(switches the I2S clock instead)\n", BenchCycleUnit());
+}
+
+} // namespace
+
+int main() {
+    TestSameRate();
+    TestResampleContinuity();
+    TestSteadyStateAllocations();
+    Benchmark();
+    return TestResult();
+}
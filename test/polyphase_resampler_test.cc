@@ -0,0 +1,266 @@
+// PolyphaseResampler：常见比例下的 THD+N、通带增益、抗混叠、直流增益和系数表共享，
+// 并和旧的整数倍线性插值对比；最后给出每个输出样本的周期数
+#include "polyphase_resampler.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr int kChunk = 1152;
+constexpr double kAmplitude = 20000;
+
+std::vector<int16_t> Sine(int frames, int channels, int rate, double frequency) {
+    std::vector<int16_t> x(frames * channels);
+    for (int i = 0; i < frames; i++) {
+        int16_t v = (int16_t)std::lround(kAmplitude * std::sin(2 * M_PI * frequency * i / rate));
+        for (int c = 0; c < channels; c++) {
+            x[i * channels + c] = v;
+        }
+    }
+    return x;
+}
+
+// 按 MP3 帧长度分块重采样，返回第一个声道
+std::vector<double> Resample(PolyphaseResampler& resampler, const std::vector<int16_t>& input, int channels) {
+    std::vector<double> y;
+    std::vector<int16_t> buffer;
+    int frames = input.size() / channels;
+    for (int offset = 0; offset < frames; offset += kChunk) {
+        int n = std::min(kChunk, frames - offset);
+        buffer.resize(resampler.MaxOutputFrames(n) * 2);
+        size_t produced = resampler.Process(&input[offset * channels], n, channels, 1 << 15, buffer.data());
+        for (size_t i = 0; i < produced; i++) {
+            y.push_back(buffer[i * (channels >= 2 ? 2 : 1)]);
+        }
+    }
+    return y;
+}
+
+struct SineFit {
+    double amplitude;
+    double thd_n_db;  // 残差（谐波、噪声、混叠）相对基波的能量
+};
+
+// 最小二乘拟合 frequency 处的正弦加直流，去掉开头的滤波器建立时间和结尾
+SineFit FitSine(const std::vector<double>& signal, double frequency, int rate) {
+    std::vector<double> y(signal.begin() + 256, signal.end() - 64);
+    double w = 2 * M_PI * frequency / rate;
+    double m[3][3] = {};
+    double v[3] = {};
+    for (size_t i = 0; i < y.size(); i++) {
+        double basis[3] = {std::sin(w * i), std::cos(w * i), 1.0};
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                m[r][c] += basis[r] * basis[c];
+            }
+            v[r] += basis[r] * y[i];
+        }
+    }
+    // 3x3 高斯消元
+    for (int p = 0; p < 3; p++) {
+        for (int r = p + 1; r < 3; r++) {
+            double f = m[r][p] / m[p][p];
+            for (int c = p; c < 3; c++) {
+                m[r][c] -= f * m[p][c];
+            }
+            v[r] -= f * v[p];
+        }
+    }
+    double k[3];
+    for (int r = 2; r >= 0; r--) {
+        double sum = v[r];
+        for (int c = r + 1; c < 3; c++) {
+            sum -= m[r][c] * k[c];
+        }
+        k[r] = sum / m[r][r];
+    }
+    double error = 0;
+    double power = 0;
+    for (size_t i = 0; i < y.size(); i++) {
+        double model = k[0] * std::sin(w * i) + k[1] * std::cos(w * i);
+        double residual = y[i] - model - k[2];
+        error += residual * residual;
+        power += model * model;
+    }
+    return {std::hypot(k[0], k[1]), 10 * std::log10(error / power)};
+}
+
+double RmsDb(const std::vector<double>& signal) {
+    double sum = 0;
+    size_t count = 0;
+    for (size_t i = 256; i + 64 < signal.size(); i++) {
+        sum += signal[i] * signal[i];
+        count++;
+    }
+    return 10 * std::log10(sum / count / (kAmplitude * kAmplitude / 2));
+}
+
+// 旧 AddAudioData 的整数倍线性插值（只在输出采样率是输入整数倍附近时有意义）
+std::vector<double> LegacyUpsample(const std::vector<int16_t>& input, int input_rate, int output_rate) {
+    float ratio = output_rate / (float)input_rate;
+    int interpolation_count = (int)ratio - 1;
+    std::vector<double> y;
+    for (size_t i = 0; i < input.size(); i++) {
+        y.push_back(input[i]);
+        for (int j = 1; j <= interpolation_count; j++) {
+            int16_t next = i + 1 < input.size() ? input[i + 1] : input[i];
+            float t = (float)j / (interpolation_count + 1);
+            y.push_back((int16_t)(input[i] + (next - input[i]) * t));
+        }
+    }
+    return y;
+}
+
+struct Ratio {
+    int input;
+    int output;
+};
+
+const Ratio kRatios[] = {
+    {44100, 24000}, {48000, 24000}, {22050, 24000}, {16000, 24000}, {32000, 24000},
+    {11025, 16000}, {44100, 48000}, {48000, 16000}, {8000, 48000},
+};
+
+void TestQuality() {
+    printf("%-14s %10s %10s %12s\n", "ratio", "THD+N 1k", "THD+N 5k", "gain 1k (dB)");
+    for (auto& r : kRatios) {
+        double thd_n[2];
+        double gain_db = 0;
+        const double frequencies[2] = {1000, 5000};
+        for (int t = 0; t < 2; t++) {
+            double f = frequencies[t];
+            if (f > 0.4 * std::min(r.input, r.output)) {
+                thd_n[t] = NAN;
+                continue;
+            }
+            PolyphaseResampler resampler;
+            CHECK(resampler.Configure(r.input, r.output, 1));
+            auto y = Resample(resampler, Sine(r.input, 1, r.input, f), 1);
+            // 1 秒输入输出约 1 秒
+            CHECK(std::abs((int)y.size() - r.output) < 64);
+            SineFit fit = FitSine(y, f, r.output);
+            thd_n[t] = fit.thd_n_db;
+            if (t == 0) {
+                gain_db = 20 * std::log10(fit.amplitude / kAmplitude);
+            }
+            // 16 抽头的短滤波器和最多 256 个相位，目标是 -60dB 以下（旧线性插值约 -35dB）
+            CHECK(fit.thd_n_db < -60);
+        }
+        CHECK(std::fabs(gain_db) < 0.1);
+        printf("%5d->%-7d %10.1f %10.1f %12.3f\n", r.input, r.output, thd_n[0], thd_n[1], gain_db);
+    }
+
+    // 旧路径的线性插值只能处理整数倍，12k->24k 对比
+    auto input = Sine(12000, 1, 12000, 1000);
+    double legacy = FitSine(LegacyUpsample(input, 12000, 24000), 1000, 24000).thd_n_db;
+    PolyphaseResampler resampler;
+    resampler.Configure(12000, 24000, 1);
+    double polyphase = FitSine(Resample(resampler, input, 1), 1000, 24000).thd_n_db;
+    printf("12000->24000 THD+N 1k: linear %.1f dB, polyphase %.1f dB\n", legacy, polyphase);
+    CHECK(polyphase < legacy - 15);
+}
+
+void TestAliasRejection() {
+    // 高于输出奈奎斯特频率的分量必须被滤掉，而不是折叠回可听频段
+    struct Case {
+        Ratio ratio;
+        double frequency;
+    } cases[] = {{{44100, 24000}, 15000}, {{48000, 16000}, 10000}, {{32000, 24000}, 14000}};
+    for (auto& c : cases) {
+        PolyphaseResampler resampler;
+        resampler.Configure(c.ratio.input, c.ratio.output, 1);
+        auto y = Resample(resampler, Sine(c.ratio.input, 1, c.ratio.input, c.frequency), 1);
+        double level = RmsDb(y);
+        printf("%5d->%-7d %.0f Hz alias %.1f dB\n", c.ratio.input, c.ratio.output, c.frequency, level);
+        CHECK(level < -60);
+    }
+}
+
+void TestDcAndStereo() {
+    // 每个相位单独归一化，直流增益为 1
+    PolyphaseResampler resampler;
+    resampler.Configure(44100, 24000, 2);
+    std::vector<int16_t> dc(kChunk * 2);
+    for (int i = 0; i < kChunk; i++) {
+        dc[i * 2] = 10000;
+        dc[i * 2 + 1] = -10000;
+    }
+    std::vector<int16_t> out(resampler.MaxOutputFrames(kChunk) * 2);
+    for (int k = 0; k < 3; k++) {
+        size_t n = resampler.Process(dc.data(), kChunk, 2, 1 << 15, out.data());
+        if (k == 2) {
+            bool exact = true;
+            for (size_t i = 0; i < n; i++) {
+                exact &= std::abs(out[i * 2] - 10000) <= 1 && std::abs(out[i * 2 + 1] + 10000) <= 1;
+            }
+            CHECK(exact);
+        }
+    }
+
+    // 双声道输入合并成单声道
+    PolyphaseResampler mono;
+    mono.Configure(44100, 24000, 1);
+    size_t n = 0;
+    for (int k = 0; k < 3; k++) {
+        n = mono.Process(dc.data(), kChunk, 2, 1 << 15, out.data());
+    }
+    CHECK(n > 0 && std::abs(out[n / 2]) <= 1);
+}
+
+void TestSharedTables() {
+    // 相同比例的实例共享系数表：第二个实例配置时只分配历史缓冲
+    size_t before = AllocCurrent();
+    PolyphaseResampler first;
+    first.Configure(44100, 48000, 2);
+    size_t first_bytes = AllocCurrent() - before;
+    before = AllocCurrent();
+    PolyphaseResampler second;
+    second.Configure(44100, 48000, 2);
+    size_t second_bytes = AllocCurrent() - before;
+    printf("44100->48000 table + history %zu bytes, second instance %zu bytes\n", first_bytes, second_bytes);
+    CHECK(second_bytes * 4 < first_bytes);
+}
+
+void Benchmark() {
+    printf("%-14s %8s %16s %16s\n", "ratio", "channels", "cyc/out sample", "ns/out sample");
+    const Ratio ratios[] = {{44100, 24000}, {48000, 24000}, {22050, 24000}, {44100, 48000}, {16000, 24000}};
+    for (auto& r : ratios) {
+        for (int channels : {1, 2}) {
+            PolyphaseResampler resampler;
+            resampler.Configure(r.input, r.output, channels);
+            auto input = Sine(kChunk, 2, r.input, 1000);
+            std::vector<int16_t> out(resampler.MaxOutputFrames(kChunk) * 2);
+            resampler.Process(input.data(), kChunk, 2, 1 << 15, out.data());
+
+            const int kIterations = 300;
+            size_t produced = 0;
+            double seconds = BenchSeconds();
+            uint64_t start = BenchCycles();
+            for (int i = 0; i < kIterations; i++) {
+                produced += resampler.Process(input.data(), kChunk, 2, 1 << 15, out.data());
+            }
+            uint64_t cycles = BenchCycles() - start;
+            seconds = BenchSeconds() - seconds;
+            BenchKeep(out);
+            size_t samples = produced * channels;
+            printf("%5d->%-7d %8d %16.1f %16.2f\n", r.input, r.output, channels, (double)cycles / samples,
+                   seconds * 1e9 / samples);
+        }
+    }
+    printf("cycles are %s on this host; on the ESP32-S3 measure with esp_cpu_get_cycle_count()\n", BenchCycleUnit());
+}
+
+} // namespace
+
+int main() {
+    TestQuality();
+    TestAliasRejection();
+    TestDcAndStereo();
+    TestSharedTables();
+    Benchmark();
+    return TestResult();
+}
@@ -0,0 +1,275 @@
+// RangeReader 断点续传：替身服务器在随机位置断开连接（出错或提前正常结束），
+// 有时忽略 Range 返回完整内容，读取方按 offset() 重连，最终拼出的数据必须和原文件一致
+#include "range_reader.h"
+#include "test_util.h"
+
+#include <http.h>
+
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct ServerOptions {
+    bool ignore_range = false;     // 重连时返回 200 和完整内容
+    bool unknown_length = false;   // Content-Range 的总长度为 "*"，也没有 Content-Length
+    size_t min_drop = 1024;        // 每个连接在 [min_drop, max_drop] 字节后断开
+    size_t max_drop = 64 * 1024;
+    int fail_connects = 0;         // 之后的若干次连接直接失败
+};
+
+class FakeServer {
+public:
+    FakeServer(size_t size, ServerOptions options) : options_(options), rng_(size) {
+        file_.resize(size);
+        for (size_t i = 0; i < size; i++) {
+            file_[i] = (uint8_t)(rng_() >> 24);
+        }
+    }
+
+    const std::vector<uint8_t>& file() const { return file_; }
+    ServerOptions& options() { return options_; }
+    int connections() const { return connections_; }
+    int drops() const { return drops_; }
+
+    Http* CreateHttp();
+
+private:
+    friend class FakeHttp;
+    std::vector<uint8_t> file_;
+    ServerOptions options_;
+    std::mt19937 rng_;
+    int connections_ = 0;
+    int drops_ = 0;
+};
+
+class FakeHttp : public Http {
+public:
+    explicit FakeHttp(FakeServer* server) : server_(server) {}
+
+    void SetTimeout(int) override {}
+    void SetHeader(const std::string& key, const std::string& value) override { headers_[key] = value; }
+    void SetContent(std::string&&) override {}
+
+    bool Open(const std::string& method, const std::string& url) override {
+        server_->connections_++;
+        if (server_->options_.fail_connects > 0) {
+            server_->options_.fail_connects--;
+            return false;
+        }
+        size_t size = server_->file_.size();
+        size_t start = 0;
+        auto range = headers_.find("Range");
+        if (range != headers_.end()) {
+            start = strtoul(range->second.c_str() + strlen("bytes="), nullptr, 10);
+        }
+        if (start > 0 && server_->options_.ignore_range) {
+            status_ = 200;
+            position_ = 0;
+        } else if (start >= size) {
+            status_ = 416;
+            return true;
+        } else {
+            status_ = range != headers_.end() ? 206 : 200;
+            position_ = start;
+        }
+        auto& options = server_->options_;
+        size_t drop = options.min_drop + server_->rng_() % (options.max_drop - options.min_drop + 1);
+        // 忽略 Range 时也在请求的起点之后才断开，否则永远下载不到新数据
+        end_ = std::min(size, std::max(position_, start) + drop);
+        error_on_drop_ = server_->rng_() % 2 == 0;
+        response_headers_["Content-Range"] = "bytes " + std::to_string(start) + "-" + std::to_string(size - 1) +
+            "/" + (options.unknown_length ? std::string("*") : std::to_string(size));
+        return true;
+    }
+
+    void Close() override {}
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (position_ >= end_) {
+            if (end_ < server_->file_.size()) {
+                server_->drops_++;
+                end_ = server_->file_.size() + 1;  // 只报告一次
+                position_ = end_;
+                return error_on_drop_ ? -1 : 0;
+            }
+            return 0;
+        }
+        // 每次返回的长度不固定，和真实网络一样
+        size_t length = std::min({buffer_size, end_ - position_, (size_t)(1 + server_->rng_() % 3000)});
+        memcpy(buffer, server_->file_.data() + position_, length);
+        position_ += length;
+        return (int)length;
+    }
+
+    int Write(const char*, size_t) override { return -1; }
+    int GetStatusCode() override { return status_; }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        auto it = response_headers_.find(key);
+        return it != response_headers_.end() ? it->second : "";
+    }
+
+    size_t GetBodyLength() override {
+        return server_->options_.unknown_length || status_ != 200 ? 0 : server_->file_.size();
+    }
+
+    std::string ReadAll() override { return ""; }
+
+private:
+    FakeServer* server_;
+    std::map<std::string, std::string> headers_;
+    std::map<std::string, std::string> response_headers_;
+    int status_ = 0;
+    size_t position_ = 0;
+    size_t end_ = 0;
+    bool error_on_drop_ = false;
+};
+
+Http* FakeServer::CreateHttp() {
+    return new FakeHttp(this);
+}
+
+// 和 DownloadTrack 的重连方式相同：连接断开后按已下载的长度重新打开
+// 返回 false 表示打开失败且不是 416
+bool Download(RangeReader& reader, const std::string& url, std::vector<uint8_t>& output, int max_attempts) {
+    std::mt19937 rng(7);
+    std::vector<char> buffer(4096);
+    int attempts = 0;
+    while (true) {
+        if (!reader.is_open()) {
+            if (!reader.Open(url, output.size())) {
+                if (reader.status_code() == 416 && !output.empty()) {
+                    return true;
+                }
+                if (++attempts > max_attempts) {
+                    return false;
+                }
+                continue;
+            }
+        }
+        int bytes_read = reader.Read(buffer.data(), 1 + rng() % buffer.size());
+        if (bytes_read < 0) {
+            if (++attempts > max_attempts) {
+                return false;
+            }
+            continue;
+        }
+        if (bytes_read == 0) {
+            return true;
+        }
+        attempts = 0;
+        output.insert(output.end(), buffer.data(), buffer.data() + bytes_read);
+        CHECK(reader.offset() == output.size());
+    }
+}
+
+void TestResumeAfterDrops() {
+    FakeServer server(1024 * 1024 + 123, ServerOptions());
+    RangeReader reader([&]() { return server.CreateHttp(); });
+    std::vector<uint8_t> output;
+    CHECK(Download(reader, "http://music/a.mp3", output, 3));
+    CHECK(output == server.file());
+    CHECK(reader.content_length() == server.file().size());
+    CHECK(server.drops() > 10);
+    printf("resume: %zu bytes over %d connections, %d drops\n",
+           output.size(), server.connections(), server.drops());
+}
+
+void TestServerIgnoresRange() {
+    ServerOptions options;
+    options.ignore_range = true;
+    options.min_drop = 100 * 1024;
+    options.max_drop = 200 * 1024;
+    FakeServer server(512 * 1024, options);
+    RangeReader reader([&]() { return server.CreateHttp(); });
+    std::vector<uint8_t> output;
+    CHECK(Download(reader, "http://music/b.mp3", output, 3));
+    CHECK(output == server.file());
+}
+
+void TestConnectFailuresAreRetried() {
+    ServerOptions options;
+    options.fail_connects = 2;
+    FakeServer server(64 * 1024, options);
+    RangeReader reader([&]() { return server.CreateHttp(); });
+    std::vector<uint8_t> output;
+    CHECK(Download(reader, "http://music/c.mp3", output, 3));
+    CHECK(output == server.file());
+
+    // 一直连不上时放弃
+    server.options().fail_connects = 100;
+    RangeReader failing([&]() { return server.CreateHttp(); });
+    output.clear();
+    CHECK(!Download(failing, "http://music/c.mp3", output, 3));
+    CHECK(failing.status_code() == 0);
+}
+
+void TestRangeAtEndOfFile() {
+    ServerOptions options;
+    options.min_drop = options.max_drop = 1000000;
+    FakeServer server(4096, options);
+    RangeReader reader([&]() { return server.CreateHttp(); });
+    // 从文件末尾续传：416，调用方按下载完成处理
+    CHECK(!reader.Open("http://music/d.mp3", 4096));
+    CHECK(reader.status_code() == 416);
+    CHECK(!reader.is_open());
+}
+
+void TestUnknownLength() {
+    // 不知道文件长度时无法发现提前结束，只能按读完处理，不会无限重连
+    ServerOptions options;
+    options.unknown_length = true;
+    FakeServer server(256 * 1024, options);
+    RangeReader reader([&]() { return server.CreateHttp(); });
+    std::vector<uint8_t> output;
+    Download(reader, "http://music/e.mp3", output, 3);
+    CHECK(reader.content_length() == 0);
+    CHECK(output.size() <= server.file().size());
+    CHECK(memcmp(output.data(), server.file().data(), output.size()) == 0);
+}
+
+void TestStopWhileDiscarding() {
+    ServerOptions options;
+    options.ignore_range = true;
+    FakeServer server(256 * 1024, options);
+    bool keep_going = false;
+    RangeReader reader([&]() { return server.CreateHttp(); }, [&]() { return keep_going; });
+    CHECK(!reader.Open("http://music/f.mp3", 100 * 1024));
+    CHECK(!reader.is_open());
+}
+
+void TestNewUrlRefreshesLength() {
+    FakeServer small(1000, ServerOptions());
+    FakeServer large(5000, ServerOptions());
+    FakeServer* current = &small;
+    RangeReader reader([&]() { return current->CreateHttp(); });
+    CHECK(reader.Open("http://music/128k.mp3", 0));
+    CHECK(reader.content_length() == 1000);
+    current = &large;
+    CHECK(reader.Open("http://music/64k.mp3", 10));
+    CHECK(reader.content_length() == 5000);
+}
+
+void TestParseContentRange() {
+    CHECK(RangeReader::ParseContentRangeTotal("bytes 100-999/1000") == 1000);
+    CHECK(RangeReader::ParseContentRangeTotal("bytes 0-0/*") == 0);
+    CHECK(RangeReader::ParseContentRangeTotal("bytes 0-10/") == 0);
+    CHECK(RangeReader::ParseContentRangeTotal("") == 0);
+}
+
+} // namespace
+
+int main() {
+    TestResumeAfterDrops();
+    TestServerIgnoresRange();
+    TestConnectFailuresAreRetried();
+    TestRangeAtEndOfFile();
+    TestUnknownLength();
+    TestStopWhileDiscarding();
+    TestNewUrlRefreshesLength();
+    TestParseContentRange();
+    return TestResult();
+}
@@ -0,0 +1,156 @@
+// 主机测试用的 ESP-IDF / FreeRTOS 最小实现
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Limit {
+    uint32_t caps;
+    size_t max_size;
+};
+
+std::mutex limits_mutex;
+std::vector<Limit> limits;
+bool fail_next_event_group = false;
+
+bool Allowed(size_t size, uint32_t caps) {
+    std::lock_guard<std::mutex> lock(limits_mutex);
+    for (const auto& limit : limits) {
+        if ((caps & limit.caps) != 0 && size > limit.max_size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return Allowed(size, caps) ? malloc(size) : nullptr;
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    return Allowed(n * size, caps) ? calloc(n, size) : nullptr;
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return 8 * 1024 * 1024;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return 4 * 1024 * 1024;
+}
+
+void host_heap_caps_set_limit(uint32_t caps, size_t max_size) {
+    std::lock_guard<std::mutex> lock(limits_mutex);
+    limits.push_back({caps, max_size});
+}
+
+void host_heap_caps_clear_limits() {
+    std::lock_guard<std::mutex> lock(limits_mutex);
+    limits.clear();
+}
+
+// 小于 0 表示使用真实时钟
+static std::atomic<int64_t> frozen_time_us{-1};
+
+int64_t esp_timer_get_time() {
+    int64_t frozen = frozen_time_us.load();
+    if (frozen >= 0) {
+        return frozen;
+    }
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void host_timer_freeze(int64_t now_us) {
+    frozen_time_us = now_us;
+}
+
+void host_timer_advance(int64_t delta_us) {
+    frozen_time_us += delta_us;
+}
+
+void host_timer_release() {
+    frozen_time_us = -1;
+}
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate() {
+    if (fail_next_event_group) {
+        fail_next_event_group = false;
+        return nullptr;
+    }
+    return new HostEventGroup;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    if (group == nullptr) {
+        abort();  // 和设备上一样，空句柄直接断言失败
+    }
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t timeout) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto ready = [&]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    if (timeout == portMAX_DELAY) {
+        group->cv.wait(lock, ready);
+    } else {
+        group->cv.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+    }
+    EventBits_t result = group->bits;
+    if (ready() && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+void host_event_group_fail_next_create() {
+    fail_next_event_group = true;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
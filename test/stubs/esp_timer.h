@@ -0,0 +1,14 @@
+#ifndef HOST_STUB_ESP_TIMER_H
+#define HOST_STUB_ESP_TIMER_H
+
+#include <cstdint>
+
+// 单调时钟，单位微秒
+int64_t esp_timer_get_time();
+
+// 测试用的可控时钟：冻结在 now_us 后只由 host_timer_advance 推进，release 后恢复真实时钟
+void host_timer_freeze(int64_t now_us);
+void host_timer_advance(int64_t delta_us);
+void host_timer_release();
+
+#endif // HOST_STUB_ESP_TIMER_H
@@ -0,0 +1,8 @@
+#ifndef HOST_STUB_TASK_H
+#define HOST_STUB_TASK_H
+
+#include "FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
+
+#endif // HOST_STUB_TASK_H
@@ -0,0 +1,26 @@
+#ifndef HOST_TEST_UTIL_H
+#define HOST_TEST_UTIL_H
+
+#include <cstdio>
+
+// 失败时打印位置并继续执行，main 最后返回 TestResult()
+inline int g_test_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_test_failures++;                                                       \
+        }                                                                            \
+    } while (0)
+
+inline int TestResult() {
+    if (g_test_failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", g_test_failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
+
+#endif // HOST_TEST_UTIL_H
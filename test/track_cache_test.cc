@@ -0,0 +1,206 @@
+// TrackCache 在主机目录上运行：完整下载才进索引、按最近最少使用淘汰、CRC 校验失败时删除，
+// 以及断电场景：只剩临时索引时恢复，索引之外的文件在加载时删除
+#include "track_cache.h"
+#include "test_util.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr size_t kTrackSize = 300 * 1024;
+
+std::string MakeTempDir() {
+    char path[] = "/tmp/track_cache_testXXXXXX";
+    CHECK(mkdtemp(path) != nullptr);
+    return path;
+}
+
+void RemoveDir(const std::string& path) {
+    StdioTrackStorage storage(path);
+    for (auto& name : storage.List()) {
+        storage.Remove(name);
+    }
+    rmdir(path.c_str());
+}
+
+std::vector<uint8_t> TrackData(int seed) {
+    std::vector<uint8_t> data(kTrackSize);
+    std::mt19937 rng(seed);
+    for (auto& byte : data) {
+        byte = (uint8_t)rng();
+    }
+    return data;
+}
+
+std::unique_ptr<TrackCache> OpenCache(const std::string& dir, size_t budget) {
+    auto cache = std::make_unique<TrackCache>(std::make_unique<StdioTrackStorage>(dir), budget);
+    cache->Load();
+    return cache;
+}
+
+// 按下载线程的方式分块写入
+bool Store(TrackCache& cache, const std::string& id, const std::vector<uint8_t>& data, const std::string& name) {
+    auto writer = cache.OpenWriter(id, data.size(), name, "artist");
+    if (!writer) {
+        return false;
+    }
+    for (size_t offset = 0; offset < data.size(); offset += 4096) {
+        if (!writer->Append(data.data() + offset, std::min<size_t>(4096, data.size() - offset))) {
+            return false;
+        }
+    }
+    return writer->Commit();
+}
+
+bool ReadBack(TrackCache& cache, const std::string& id, const std::vector<uint8_t>& expected) {
+    auto reader = cache.OpenReader(id, 0);
+    if (!reader) {
+        return false;
+    }
+    std::vector<uint8_t> data(reader->size());
+    size_t total = 0;
+    size_t bytes;
+    while (total < data.size() && (bytes = reader->Read(data.data() + total, std::min<size_t>(4096, data.size() - total))) > 0) {
+        total += bytes;
+    }
+    return reader->Verify() && data == expected;
+}
+
+void TestStoreAndReload() {
+    std::string dir = MakeTempDir();
+    auto track = TrackData(1);
+    {
+        auto cache = OpenCache(dir, 4 * kTrackSize);
+        CHECK(Store(*cache, "1001", track, "song one"));
+        CHECK(cache->Contains("1001"));
+        CHECK(cache->used_bytes() == kTrackSize);
+    }
+    {
+        // 重启后索引仍然有效，可以按歌名找到
+        auto cache = OpenCache(dir, 4 * kTrackSize);
+        CHECK(cache->Contains("1001"));
+        std::string id, artist;
+        CHECK(cache->FindByName("song one", id, artist));
+        CHECK(id == "1001" && artist == "artist");
+        CHECK(ReadBack(*cache, "1001", track));
+
+        // 从中间开始读
+        auto reader = cache->OpenReader("1001", 1000);
+        CHECK(reader != nullptr);
+        uint8_t byte = 0;
+        CHECK(reader && reader->Read(&byte, 1) == 1 && byte == track[1000]);
+    }
+    RemoveDir(dir);
+}
+
+void TestIncompleteDownloadIsDiscarded() {
+    std::string dir = MakeTempDir();
+    auto cache = OpenCache(dir, 4 * kTrackSize);
+    auto track = TrackData(2);
+    {
+        auto writer = cache->OpenWriter("2001", track.size(), "partial", "artist");
+        CHECK(writer != nullptr);
+        writer->Append(track.data(), track.size() / 2);
+        // 下载中断，没有 Commit
+    }
+    CHECK(!cache->Contains("2001"));
+    {
+        // 长度不一致时 Commit 失败
+        auto writer = cache->OpenWriter("2002", track.size(), "short", "artist");
+        writer->Append(track.data(), track.size() - 1);
+        CHECK(!writer->Commit());
+    }
+    CHECK(!cache->Contains("2002"));
+    CHECK(cache->used_bytes() == 0);
+    CHECK(StdioTrackStorage(dir).List().size() <= 1);  // 只剩索引
+    RemoveDir(dir);
+}
+
+void TestLruEviction() {
+    std::string dir = MakeTempDir();
+    auto cache = OpenCache(dir, 3 * kTrackSize);
+    CHECK(Store(*cache, "a", TrackData(10), "a"));
+    CHECK(Store(*cache, "b", TrackData(11), "b"));
+    CHECK(Store(*cache, "c", TrackData(12), "c"));
+    // 重新播放 a，b 成为最久未用
+    CHECK(ReadBack(*cache, "a", TrackData(10)));
+    CHECK(Store(*cache, "d", TrackData(13), "d"));
+    CHECK(cache->Contains("a"));
+    CHECK(!cache->Contains("b"));
+    CHECK(cache->Contains("c") && cache->Contains("d"));
+    CHECK(cache->used_bytes() <= cache->budget());
+
+    // 超过预算的文件不缓存
+    CHECK(cache->OpenWriter("huge", 4 * kTrackSize, "huge", "") == nullptr);
+    RemoveDir(dir);
+}
+
+void TestCorruptionIsEvicted() {
+    std::string dir = MakeTempDir();
+    auto cache = OpenCache(dir, 4 * kTrackSize);
+    auto track = TrackData(3);
+    CHECK(Store(*cache, "3001", track, "corrupt"));
+
+    // 改动文件中的一个字节，长度不变
+    std::string path = dir + "/3001.mp3";
+    FILE* file = fopen(path.c_str(), "r+b");
+    CHECK(file != nullptr);
+    fseek(file, 1234, SEEK_SET);
+    fputc(track[1234] ^ 0xFF, file);
+    fclose(file);
+
+    CHECK(!ReadBack(*cache, "3001", track));
+    CHECK(!cache->Contains("3001"));
+    RemoveDir(dir);
+}
+
+void TestPowerLossRecovery() {
+    std::string dir = MakeTempDir();
+    auto track = TrackData(4);
+    {
+        auto cache = OpenCache(dir, 4 * kTrackSize);
+        CHECK(Store(*cache, "4001", track, "kept"));
+    }
+    StdioTrackStorage storage(dir);
+    // 替换索引时在删除旧索引之后、重命名之前断电
+    CHECK(storage.Rename("index.json", "index.tmp"));
+    // 写入中断留下的临时文件，以及提交后还没进索引的歌曲文件
+    auto leftover = storage.Open("5001.tmp", true);
+    leftover->Write(track.data(), 1000);
+    leftover.reset();
+    auto orphan = storage.Open("6001.mp3", true);
+    orphan->Write(track.data(), 2000);
+    orphan.reset();
+
+    auto cache = OpenCache(dir, 4 * kTrackSize);
+    CHECK(cache->Contains("4001"));
+    CHECK(ReadBack(*cache, "4001", track));
+    size_t size = 0;
+    CHECK(!storage.GetSize("5001.tmp", size));
+    CHECK(!storage.GetSize("6001.mp3", size));
+    CHECK(storage.GetSize("index.json", size));
+
+    // 索引里的文件被截断：加载时丢弃该条目
+    cache.reset();
+    truncate((dir + "/4001.mp3").c_str(), 100);
+    cache = OpenCache(dir, 4 * kTrackSize);
+    CHECK(!cache->Contains("4001"));
+    RemoveDir(dir);
+}
+
+} // namespace
+
+int main() {
+    TestStoreAndReload();
+    TestIncompleteDownloadIsDiscarded();
+    TestLruEviction();
+    TestCorruptionIsEvicted();
+    TestPowerLossRecovery();
+    return TestResult();
+}
@@ -0,0 +1,327 @@
+// VoiceLatencyTracer：用脚本化的模拟服务器驱动一轮轮对话（冻结时钟，按脚本推进），
+// 检查各阶段的拆分、跳过的事件并入下一阶段、本地提示音不结束一轮、Begin(restart=false)、
+// 被打断的一轮被丢弃、最近记录的环形缓冲（最新在前），以及 ToJson 的直方图和 PrintStats；
+// 最后在多个任务同时打点和读取时检查不会死锁、JSON 始终完整
+#include "voice_latency_tracer.h"
+#include "test_util.h"
+
+#include <cJSON.h>
+#include <esp_timer.h>
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Tracer = VoiceLatencyTracer;
+
+const char* const kStageNames[Tracer::kEventCount] = {
+    "total", "connect", "first_send", "stt", "llm", "tts", "playout",
+};
+
+// 一轮对话中服务器和设备各阶段的耗时，单位微秒；小于 0 表示这一事件不发生
+struct Script {
+    const char* trigger;
+    int64_t connect_us;       // 需要打开音频通道时的 TLS 连接和 hello
+    int64_t first_send_us;
+    int64_t stt_us;           // 服务器不返回识别文本时为 -1
+    int64_t llm_us;
+    int64_t tts_us;
+    int64_t playout_us;
+    int64_t local_sound_us;   // TTS 之前播放的本地提示音（如唤醒提示），-1 表示没有
+};
+
+// 期望的一轮结果，-1 表示没有这一阶段
+struct Expected {
+    const char* trigger;
+    int64_t stages[Tracer::kEventCount];
+};
+
+// 测试侧的镜像：和被测对象记录相同的数据，用来核对 ToJson
+struct Mirror {
+    LatencyHistogram histograms[Tracer::kEventCount];
+    std::vector<Expected> turns;
+
+    void Add(const Expected& turn) {
+        for (int i = 0; i < Tracer::kEventCount; i++) {
+            if (turn.stages[i] >= 0) {
+                histograms[i].Record(turn.stages[i]);
+            }
+        }
+        turns.push_back(turn);
+    }
+};
+
+Mirror mirror;
+
+// 模拟服务器按脚本推进时钟并在设备侧打点，返回期望的拆分
+Expected RunTurn(const Script& script) {
+    auto& tracer = Tracer::GetInstance();
+    static const Tracer::Event kEvents[] = {
+        Tracer::kChannelOpened, Tracer::kFirstAudioSent, Tracer::kSttReceived,
+        Tracer::kTtsStarted, Tracer::kFirstPacketQueued, Tracer::kFirstOutput,
+    };
+    const int64_t durations[] = {
+        script.connect_us, script.first_send_us, script.stt_us,
+        script.llm_us, script.tts_us, script.playout_us,
+    };
+
+    Expected expected = {script.trigger, {}};
+    tracer.Begin(script.trigger);
+    CHECK(tracer.active());
+    int64_t since_last = 0;  // 自上一个发生的事件起
+    int64_t total = 0;
+    for (int n = 0; n < 6; n++) {
+        int event = kEvents[n];
+        if (durations[n] < 0) {
+            expected.stages[event] = -1;
+            // 跳过的事件不打点，它的耗时（如果有）算入下一阶段
+            continue;
+        }
+        host_timer_advance(durations[n]);
+        since_last += durations[n];
+        total += durations[n];
+        if (event == Tracer::kFirstAudioSent && script.local_sound_us >= 0) {
+            // 唤醒提示音在 TTS 之前写入 codec，不能结束这一轮
+            tracer.Mark(Tracer::kFirstOutput);
+            CHECK(tracer.active());
+        }
+        tracer.Mark((Tracer::Event)event);
+        // 重复打点只有第一次有效
+        tracer.Mark((Tracer::Event)event);
+        expected.stages[event] = since_last / 1000;
+        since_last = 0;
+    }
+    expected.stages[Tracer::kTrigger] = total / 1000;
+    CHECK(!tracer.active());
+    mirror.Add(expected);
+    return expected;
+}
+
+// 各阶段加上不足 1ms 的零头，检查按微秒计算后再截断
+int64_t Ms(std::mt19937& rng, int min_ms, int max_ms) {
+    return (min_ms + (int64_t)(rng() % (max_ms - min_ms + 1))) * 1000 + rng() % 1000;
+}
+
+cJSON* ParseStats() {
+    std::string json = Tracer::GetInstance().ToJson();
+    cJSON* root = cJSON_Parse(json.c_str());
+    CHECK(root != nullptr);
+    return root;
+}
+
+int64_t Number(cJSON* object, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(object, name);
+    return cJSON_IsNumber(item) ? (int64_t)item->valuedouble : -1;
+}
+
+// ToJson 必须和镜像中的直方图、最近的 kHistorySize 轮完全一致
+void CheckJson() {
+    cJSON* root = ParseStats();
+    if (root == nullptr) {
+        return;
+    }
+    cJSON* stages = cJSON_GetObjectItem(root, "stages");
+    CHECK(cJSON_IsObject(stages));
+    bool stages_match = true;
+    for (int i = 0; i < Tracer::kEventCount; i++) {
+        auto& h = mirror.histograms[i];
+        cJSON* stage = cJSON_GetObjectItem(stages, kStageNames[i]);
+        if (h.count() == 0) {
+            stages_match &= stage == nullptr;
+            continue;
+        }
+        stages_match &= stage != nullptr && Number(stage, "count") == h.count() &&
+            Number(stage, "avg") == h.average() && Number(stage, "p50") == h.Percentile(50) &&
+            Number(stage, "p90") == h.Percentile(90);
+    }
+    CHECK(stages_match);
+
+    cJSON* recent = cJSON_GetObjectItem(root, "recent");
+    CHECK(cJSON_IsArray(recent));
+    int expected_size = std::min<int>(mirror.turns.size(), Tracer::kHistorySize);
+    CHECK(cJSON_GetArraySize(recent) == expected_size);
+    bool recent_match = true;
+    for (int n = 0; n < expected_size && n < cJSON_GetArraySize(recent); n++) {
+        cJSON* item = cJSON_GetArrayItem(recent, n);
+        const Expected& turn = mirror.turns[mirror.turns.size() - 1 - n];
+        cJSON* trigger = cJSON_GetObjectItem(item, "trigger");
+        recent_match &= cJSON_IsString(trigger) && std::string(trigger->valuestring) == turn.trigger;
+        for (int i = 0; i < Tracer::kEventCount; i++) {
+            recent_match &= Number(item, kStageNames[i]) == turn.stages[i];
+        }
+    }
+    CHECK(recent_match);
+    cJSON_Delete(root);
+}
+
+void TestBeforeAnyTurn() {
+    auto& tracer = Tracer::GetInstance();
+    CHECK(!tracer.active());
+    // 没有进行中的一轮时打点无效
+    tracer.Mark(Tracer::kSttReceived);
+    tracer.Mark(Tracer::kFirstOutput);
+    CHECK(!tracer.active());
+    CHECK(tracer.ToJson() == "{\"stages\":{},\"recent\":[]}");
+    tracer.PrintStats();
+}
+
+void TestScriptedTurns() {
+    // 第一轮：按键唤醒，需要先建立连接
+    Expected e = RunTurn({"button", 350000, 40000, 900000, 1200000, 300000, 60000, -1});
+    CHECK(e.stages[Tracer::kChannelOpened] == 350);
+    CHECK(e.stages[Tracer::kTrigger] == 2850);
+    CheckJson();
+
+    // 通道已经打开：first_send 直接从唤醒开始算
+    e = RunTurn({"wake word", -1, 25000, 800000, 1000000, 250000, 50000, 0});
+    CHECK(e.stages[Tracer::kChannelOpened] == -1);
+    CHECK(e.stages[Tracer::kFirstAudioSent] == 25);
+
+    // 服务器没有返回识别文本：stt 没有，llm 从首包发送开始算，包含了识别时间
+    e = RunTurn({"wake word", -1, 30000, -1, 1700000, 250000, 40000, -1});
+    CHECK(e.stages[Tracer::kSttReceived] == -1);
+    CHECK(e.stages[Tracer::kTtsStarted] == 1700);
+    CheckJson();
+
+    // 结束后的打点无效，不会改变上一轮
+    auto& tracer = Tracer::GetInstance();
+    host_timer_advance(500000);
+    tracer.Mark(Tracer::kFirstOutput);
+    tracer.Mark(Tracer::kSttReceived);
+    CHECK(!tracer.active());
+    CheckJson();
+}
+
+void TestRestartAndInterrupt() {
+    auto& tracer = Tracer::GetInstance();
+
+    // 被打断的一轮：用户在回复之前再次按键，前一轮被丢弃，不进入统计
+    tracer.Begin("button");
+    host_timer_advance(30000);
+    tracer.Mark(Tracer::kFirstAudioSent);
+    host_timer_advance(400000);
+    tracer.Mark(Tracer::kSttReceived);
+    host_timer_advance(200000);
+    RunTurn({"button", -1, 20000, 600000, 900000, 200000, 50000, -1});
+    CheckJson();
+
+    // 说完话后自动恢复聆听：Begin(restart=false) 在没有进行中的一轮时开始新的一轮
+    tracer.Begin("listening", false);
+    CHECK(tracer.active());
+    host_timer_advance(20000);
+    tracer.Mark(Tracer::kFirstAudioSent);
+    // 进行中时 Begin(restart=false) 保留原来的开始时间和触发方式
+    host_timer_advance(100000);
+    tracer.Begin("other", false);
+    host_timer_advance(500000);
+    tracer.Mark(Tracer::kSttReceived);
+    host_timer_advance(800000);
+    tracer.Mark(Tracer::kTtsStarted);
+    host_timer_advance(150000);
+    tracer.Mark(Tracer::kFirstPacketQueued);
+    host_timer_advance(45000);
+    tracer.Mark(Tracer::kFirstOutput);
+    CHECK(!tracer.active());
+    mirror.Add({"listening", {1615, -1, 20, 600, 800, 150, 45}});
+    CheckJson();
+
+    // PrintStats 只在有新完成的一轮时输出，这里只检查反复调用不出错
+    tracer.PrintStats();
+    tracer.PrintStats();
+}
+
+void TestManyTurns() {
+    // 超过 kHistorySize 轮后只保留最近的，直方图覆盖全部
+    std::mt19937 rng(24);
+    const char* const triggers[] = {"wake word", "button", "listening"};
+    for (int n = 0; n < 200; n++) {
+        bool connect = rng() % 4 == 0;
+        bool stt = rng() % 8 != 0;
+        bool sound = rng() % 2 == 0;
+        RunTurn({triggers[rng() % 3], connect ? Ms(rng, 200, 3000) : -1, Ms(rng, 5, 80),
+                 stt ? Ms(rng, 300, 2500) : -1, Ms(rng, 400, 5000), Ms(rng, 100, 900), Ms(rng, 20, 200),
+                 sound ? 0 : -1});
+        if (n % 37 == 0) {
+            CheckJson();
+        }
+    }
+    CheckJson();
+    Tracer::GetInstance().PrintStats();
+
+    cJSON* root = ParseStats();
+    cJSON* total = cJSON_GetObjectItem(cJSON_GetObjectItem(root, "stages"), "total");
+    printf("%zu turns, total avg %lld ms p50 %lld p90 %lld\n", mirror.turns.size(), (long long)Number(total, "avg"),
+           (long long)Number(total, "p50"), (long long)Number(total, "p90"));
+    cJSON_Delete(root);
+}
+
+void TestConcurrentReaders() {
+    // 网络任务和音频任务打点时，MCP 工具调用 ToJson、主循环调用 PrintStats
+    auto& tracer = Tracer::GetInstance();
+    cJSON* root = ParseStats();
+    int64_t before = Number(cJSON_GetObjectItem(cJSON_GetObjectItem(root, "stages"), "total"), "count");
+    cJSON_Delete(root);
+
+    const int kTurns = 2000;
+    std::atomic<bool> done{false};
+    std::atomic<int> bad_json{0};
+    std::thread reader([&] {
+        while (!done) {
+            cJSON* json = cJSON_Parse(tracer.ToJson().c_str());
+            cJSON* recent = cJSON_GetObjectItem(json, "recent");
+            if (json == nullptr || cJSON_GetArraySize(recent) > Tracer::kHistorySize) {
+                bad_json++;
+            }
+            cJSON_Delete(json);
+            tracer.PrintStats();
+        }
+    });
+    std::thread network([&] {
+        for (int n = 0; n < kTurns; n++) {
+            tracer.Begin("wake word");
+            host_timer_advance(1000);
+            tracer.Mark(Tracer::kFirstAudioSent);
+            host_timer_advance(1000);
+            tracer.Mark(Tracer::kSttReceived);
+            host_timer_advance(1000);
+            tracer.Mark(Tracer::kTtsStarted);
+            host_timer_advance(1000);
+            tracer.Mark(Tracer::kFirstPacketQueued);
+            // 音频任务写入第一个样本
+            std::thread audio([&] {
+                host_timer_advance(1000);
+                if (tracer.active()) {
+                    tracer.Mark(Tracer::kFirstOutput);
+                }
+            });
+            audio.join();
+        }
+    });
+    network.join();
+    done = true;
+    reader.join();
+
+    root = ParseStats();
+    int64_t after = Number(cJSON_GetObjectItem(cJSON_GetObjectItem(root, "stages"), "total"), "count");
+    cJSON_Delete(root);
+    CHECK(bad_json == 0);
+    CHECK(after - before == kTurns);
+}
+
+} // namespace
+
+int main() {
+    // 时间 0 在被测对象中表示“事件没有发生”，从一个非零时刻开始
+    host_timer_freeze(1000000);
+    TestBeforeAnyTurn();
+    TestScriptedTurns();
+    TestRestartAndInterrupt();
+    TestManyTurns();
+    TestConcurrentReaders();
+    host_timer_release();
+    return TestResult();
+}
@@ -0,0 +1,138 @@
+// WavStreamDecoder：8/16/24 位、单双声道、fmt 前后的其他块、奇数长度块的填充字节、
+// 长度字段为 0 的流式文件，以及 data 块之后的尾部块
+#include "wav_stream_decoder.h"
+#include "decoder_harness.h"
+#include "test_util.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+void PutLe16(std::vector<uint8_t>& b, uint16_t v) {
+    b.push_back(v);
+    b.push_back(v >> 8);
+}
+
+void PutLe32(std::vector<uint8_t>& b, uint32_t v) {
+    PutLe16(b, v);
+    PutLe16(b, v >> 16);
+}
+
+void PutChunk(std::vector<uint8_t>& b, const char* id, const std::vector<uint8_t>& payload) {
+    b.insert(b.end(), id, id + 4);
+    PutLe32(b, payload.size());
+    b.insert(b.end(), payload.begin(), payload.end());
+    if (payload.size() & 1) {
+        b.push_back(0);
+    }
+}
+
+struct Wav {
+    std::vector<uint8_t> stream;
+    std::vector<int16_t> pcm;
+};
+
+// streaming 为 true 时 data 块长度写 0，表示一直到流结束
+Wav MakeWav(int channels, int bits, int frames, bool streaming, bool trailing_chunk) {
+    std::mt19937 rng(bits * 10 + channels);
+    std::vector<uint8_t> data;
+    Wav wav;
+    for (int i = 0; i < frames * channels; i++) {
+        int32_t v = (int32_t)rng() >> (32 - bits);
+        switch (bits) {
+        case 8:
+            data.push_back((uint8_t)(v + 128));
+            wav.pcm.push_back((int16_t)(v * 256));
+            break;
+        case 16:
+            PutLe16(data, v);
+            wav.pcm.push_back((int16_t)v);
+            break;
+        default:
+            PutLe16(data, v);
+            data.push_back(v >> 16);
+            wav.pcm.push_back((int16_t)(v >> 8));
+            break;
+        }
+    }
+
+    std::vector<uint8_t> fmt;
+    PutLe16(fmt, 1);
+    PutLe16(fmt, channels);
+    PutLe32(fmt, 22050);
+    PutLe32(fmt, 22050 * channels * bits / 8);
+    PutLe16(fmt, channels * bits / 8);
+    PutLe16(fmt, bits);
+
+    std::vector<uint8_t>& b = wav.stream;
+    b.insert(b.end(), {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E'});
+    PutChunk(b, "fact", {1, 2, 3, 4});
+    PutChunk(b, "fmt ", fmt);
+    PutChunk(b, "LIST", std::vector<uint8_t>(5001, 'x'));  // 奇数长度且超过 Peek 上限
+    if (streaming) {
+        b.insert(b.end(), {'d', 'a', 't', 'a', 0, 0, 0, 0});
+        b.insert(b.end(), data.begin(), data.end());
+    } else {
+        PutChunk(b, "data", data);
+    }
+    if (trailing_chunk) {
+        PutChunk(b, "id3 ", std::vector<uint8_t>(64, 0));
+    }
+    return wav;
+}
+
+void TestFormats() {
+    for (int bits : {8, 16, 24}) {
+        for (int channels : {1, 2}) {
+            Wav wav = MakeWav(channels, bits, 3001, false, true);
+            for (size_t arrival : {(size_t)1, (size_t)777, wav.stream.size()}) {
+                WavStreamDecoder decoder;
+                auto result = RunDecoder(decoder, wav.stream, arrival);
+                CHECK(!result.contract_violated);
+                CHECK(result.channels == channels);
+                CHECK(result.sample_rate == 22050);
+                CHECK(result.pcm == wav.pcm);
+            }
+        }
+    }
+}
+
+void TestStreamingLength() {
+    // 长度未知的 data 块：一直解码到流结束，末尾不足一个采样块的字节丢弃
+    Wav wav = MakeWav(2, 16, 1000, true, false);
+    wav.stream.push_back(0x12);
+    WavStreamDecoder decoder;
+    auto result = RunDecoder(decoder, wav.stream, 1024);
+    CHECK(!result.contract_violated);
+    CHECK(result.pcm == wav.pcm);
+}
+
+void TestInvalid() {
+    Wav wav = MakeWav(2, 16, 100, false, false);
+    // 改成 32 位浮点（format 3）
+    std::vector<uint8_t> f32 = wav.stream;
+    size_t fmt = 12 + 8 + 4;
+    CHECK(memcmp(&f32[fmt], "fmt ", 4) == 0);
+    f32[fmt + 8] = 3;
+    WavStreamDecoder decoder;
+    auto result = RunDecoder(decoder, f32, 4096);
+    CHECK(!result.contract_violated);
+    CHECK(result.pcm.empty());
+
+    std::vector<uint8_t> not_wav(100, 0);
+    WavStreamDecoder other;
+    result = RunDecoder(other, not_wav, 4096);
+    CHECK(!result.contract_violated);
+    CHECK(result.pcm.empty());
+}
+
+} // namespace
+
+int main() {
+    TestFormats();
+    TestStreamingLength();
+    TestInvalid();
+    return TestResult();
+}